@@ -0,0 +1,120 @@
+#include "arena.h"
+#include <string.h>
+
+// enough for any of the model structs (and doubles/pointers on every supported platform)
+#define ARENA_ALIGNMENT 16
+
+static size_t heap_alloc_count = 0;
+
+static arena_block_t *new_block(size_t capacity);
+
+arena_t *arena_create(size_t block_size) {
+    arena_t *arena = malloc(sizeof(arena_t));
+    if (!arena) {
+        return NULL;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->block_count = 0;
+    arena->alloc_count = 0;
+    arena->strings = NULL;
+    return arena;
+}
+
+arena_t *arena_destroy(arena_t *arena) {
+    if (!arena) {
+        return NULL;
+    }
+
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+    return NULL;
+}
+
+void arena_reset(arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+    for (arena_block_t *block = arena->head; block != NULL; block = block->next) {
+        block->used = 0;
+    }
+    arena->current = arena->head;
+    arena->alloc_count = 0;
+    arena->strings = NULL;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    if (!arena) {
+        heap_alloc_count++;
+        return malloc(size);
+    }
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+
+    // blocks before `current` are full; blocks after it are empty (after a reset)
+    arena_block_t *block = arena->current;
+    while (block && (block->used + size > block->capacity)) {
+        block = block->next;
+    }
+    if (!block) {
+        block = new_block(size > arena->block_size ? size : arena->block_size);
+        if (!block) {
+            return NULL;
+        }
+        arena->block_count++;
+        if (!arena->head) {
+            arena->head = block;
+        } else {
+            arena_block_t *last = arena->current ? arena->current : arena->head;
+            while (last->next) {
+                last = last->next;
+            }
+            last->next = block;
+        }
+    }
+    arena->current = block;
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->alloc_count++;
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t count, size_t size) {
+    if (!arena) {
+        heap_alloc_count++;
+        return calloc(count, size);
+    }
+
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+size_t arena_heap_alloc_count(void) {
+    return heap_alloc_count;
+}
+
+/*
+ * The block header and its data are a single allocation.
+ */
+static arena_block_t *new_block(size_t capacity) {
+    size_t header_size = (sizeof(arena_block_t) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+    arena_block_t *block = malloc(header_size + capacity);
+    if (!block) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    block->data = (char *) block + header_size;
+    return block;
+}
@@ -0,0 +1,49 @@
+#ifndef BCE_ARENA_H
+#define BCE_ARENA_H
+
+#include <stdlib.h>
+
+/*
+ * Region allocator for per-request data (command tree, word lists, recommendations).
+ * Everything allocated from an arena is released at once, with `arena_reset()` or `arena_destroy()`.
+ *
+ * A NULL arena means the heap: `arena_alloc(NULL, size)` is `malloc()`, and the memory must be
+ * released with `free()` as usual. Heap allocations made this way are counted (see `arena_heap_alloc_count()`).
+ */
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+typedef struct arena_block_t {
+    struct arena_block_t *next;
+    size_t capacity;
+    size_t used;
+    char *data;
+} arena_block_t;
+
+typedef struct arena_t {
+    arena_block_t *head;
+    arena_block_t *current;
+    size_t block_size;
+    size_t block_count;     /* heap allocations made by the arena */
+    size_t alloc_count;     /* allocations served since the last reset */
+    struct str_pool_t *strings;     /* interned strings (see str_pool.h), allocated in the arena */
+} arena_t;
+
+/* Caller should use `arena_destroy()` when done */
+arena_t *arena_create(size_t block_size);
+
+arena_t *arena_destroy(arena_t *arena);
+
+/* Release everything allocated from the arena, but keep its blocks for reuse */
+void arena_reset(arena_t *arena);
+
+/* Allocate `size` bytes (uninitialized) from the arena, or from the heap if `arena` is NULL */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/* Same as `arena_alloc()`, but zeroed */
+void *arena_calloc(arena_t *arena, size_t count, size_t size);
+
+/* Number of heap allocations made through `arena_alloc(NULL, ...)` */
+size_t arena_heap_alloc_count(void);
+
+#endif // BCE_ARENA_H
@@ -0,0 +1,319 @@
+/*
+ * Bash loadable builtin: completion inside the bash process (no fork/exec per TAB press).
+ *
+ *   $ enable -f /path/to/libbce_bash.so bce_complete
+ *   $ _bce() { bce_complete; }
+ *   $ complete -F _bce kubectl
+ *
+ * The command trees are cached between calls (see `completion_cache_t`), and reloaded when the database changes.
+ * Build with `cmake -DBCE_BASH_BUILTIN=ON` (needs the bash development headers).
+ */
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "loadables.h"
+#include "completion.h"
+#include "prune.h"
+#include "input.h"
+#include "linked_list.h"
+#include "data_model.h"
+#include "history_index.h"
+#include "output_buffer.h"
+#include "arena.h"
+#include "error.h"
+
+#define BCE_EXPORT __attribute__((visibility("default")))
+#define BCE_OMITTED_VAR "BCE_OMITTED"
+
+static completion_cache_t *cache = NULL;
+static char cache_db_filename[PATH_MAX + 1] = "";
+static arena_t *arena = NULL;   /* per-call data, reset after each call */
+
+static completion_cache_t *get_cache(const char *db_filename, bce_error_t *err);
+
+static completion_input_t *create_input(bce_error_t *err);
+
+static completion_input_t *create_input_from_words(SHELL_VAR *words_var, const char *cword, bce_error_t *err);
+
+static void set_compreply(const linked_list_t *recommendation_list, output_format_t format, size_t omitted);
+
+BCE_EXPORT int bce_complete_builtin(WORD_LIST *list) {
+    const char *db_filename = BCE_DB_FILENAME;
+    size_t max_results = 0;
+    int opt;
+    reset_internal_getopt();
+    while ((opt = internal_getopt(list, "d:n:")) != -1) {
+        switch (opt) {
+            case 'd':
+                db_filename = list_optarg;
+                break;
+            case 'n':
+                max_results = parse_max_results(list_optarg);
+                if (max_results == 0) {
+                    builtin_error("%s: invalid count", list_optarg);
+                    return EX_USAGE;
+                }
+                break;
+            CASE_HELPOPT;
+            default:
+                builtin_usage();
+                return EX_USAGE;
+        }
+    }
+
+    int result = EXECUTION_FAILURE;
+    bce_error_t err = ERR_NONE;
+    completion_input_t *input = NULL;
+    bce_command_t *completion_command = NULL;
+    linked_list_t *word_list = NULL;
+    linked_list_t *recommendation_list = NULL;
+    bce_str_t command_name = NULL;
+    usage_table_t *usage = NULL;
+    history_index_t *history = NULL;
+    char histfile[PATH_MAX];
+
+    input = create_input(&err);
+    if (err != ERR_NONE) {
+        if ((err == ERR_MISSING_ENV_COMP_LINE) || (err == ERR_MISSING_ENV_COMP_POINT)) {
+            builtin_error("%s and %s must be set (call from a `complete -F` function)", BASH_LINE_VAR, BASH_CURSOR_VAR);
+        }
+        goto done;
+    }
+    // a shell variable (it need not be exported)
+    input->match_mode = parse_match_mode(get_string_value(BCE_MATCH_VAR));
+    input->correct_words = parse_flag(get_string_value(BCE_CORRECT_VAR));
+    input->max_results = (max_results > 0) ? max_results : parse_max_results(get_string_value(BCE_MAX_RESULTS_VAR));
+    input->output_format = parse_output_format(get_string_value(BCE_OUTPUT_VAR));
+    if (!arena) {
+        arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    }
+    command_name = get_command_word_in(arena, input);
+    if (bce_str_len(command_name) == 0) {
+        goto done;
+    }
+
+    completion_cache_t *command_cache = get_cache(db_filename, &err);
+    if (err != ERR_NONE) {
+        builtin_error("unable to open %s (error %d)", db_filename, err);
+        goto done;
+    }
+
+    // copy only the sub-commands on the command line
+    word_list = completion_input_to_list_in(arena, input);
+    completion_command = completion_cache_get_command(command_cache, arena, command_name, word_list,
+                                                     completion_index_prefix_in(arena, input), &err);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+
+    // with BCE_CORRECT, copy it again as if the misspelled words had been typed correctly
+    while (input->correct_words && correct_misspelled_words(completion_command, input)) {
+        completion_command = bce_command_free(completion_command);
+        word_list = completion_input_to_list_in(arena, input);
+        completion_command = completion_cache_get_command(command_cache, arena, command_name, word_list,
+                                                         completion_index_prefix_in(arena, input), &err);
+        if (err != ERR_NONE) {
+            goto done;
+        }
+    }
+
+    recommendation_list = ll_create_unique_in(arena, NULL);
+    size_t omitted = 0;
+    usage = usage_load(command_cache->usage_filename, command_cache->usage_log_filename, command_name,
+                       time(NULL));
+    if (history_file_path(histfile, sizeof(histfile), get_string_value("HISTFILE"))) {
+        history = history_index_load(command_cache->history_index_filename, histfile, command_name);
+        history_index_merge(history, completion_command);
+    }
+    err = completion_collect(completion_command, input, usage, recommendation_list, NULL, &omitted);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+
+    set_compreply(recommendation_list, input->output_format, omitted);
+    result = EXECUTION_SUCCESS;
+
+    done:
+    usage = usage_free(usage);
+    history = history_index_free(history);
+    recommendation_list = ll_destroy(recommendation_list);
+    completion_command = bce_command_free(completion_command);
+    word_list = ll_destroy(word_list);
+    arena_reset(arena);
+    input = free_completion_input(input);
+    return result;
+}
+
+/* Called by `enable -f`. Return 1 on success */
+BCE_EXPORT int bce_complete_builtin_load(char *name) {
+    return 1;
+}
+
+/* Called by `enable -d` */
+BCE_EXPORT void bce_complete_builtin_unload(char *name) {
+    cache = completion_cache_free(cache);
+    cache_db_filename[0] = '\0';
+    arena = arena_destroy(arena);
+}
+
+BCE_EXPORT char *bce_complete_doc[] = {
+        "Complete the current command line, using the bce database.",
+        "",
+        "Reads COMP_WORDS and COMP_CWORD (or COMP_LINE and COMP_POINT), and sets COMPREPLY.",
+        "Set BCE_MATCH=fuzzy to match the current word as a subsequence, best matches first.",
+        "Command trees are cached between calls.",
+        "",
+        "With -n (or BCE_MAX_RESULTS), only the best recommendations are kept, and",
+        "BCE_OMITTED is set to the number of the others.",
+        "",
+        "With BCE_OUTPUT=words, COMPREPLY gets the quoted words to insert, and a",
+        "word<TAB>display<TAB>description line per recommendation is written to",
+        "the file descriptor in BCE_DESC_FD (if set).",
+        "",
+        "Options:",
+        "  -d database\tcompletion database (default: " BCE_DB_FILENAME ")",
+        "  -n count\tkeep at most count recommendations",
+        (char *) NULL
+};
+
+BCE_EXPORT struct builtin bce_complete_struct = {
+        "bce_complete",
+        bce_complete_builtin,
+        BUILTIN_ENABLED,
+        bce_complete_doc,
+        "bce_complete [-d database] [-n count]",
+        0
+};
+
+/*
+ * Use the words bash has already split (COMP_WORDS/COMP_CWORD), so the line is not split again.
+ * Falls back to COMP_LINE/COMP_POINT, the same variables `complete -C` would pass in the environment.
+ */
+static completion_input_t *create_input(bce_error_t *err) {
+    SHELL_VAR *words_var = find_variable(BASH_WORDS_VAR);
+    const char *cword = get_string_value(BASH_CWORD_VAR);
+    if (words_var && array_p(words_var) && cword) {
+        return create_input_from_words(words_var, cword, err);
+    }
+
+    const char *line = get_string_value(BASH_LINE_VAR);
+    const char *point = get_string_value(BASH_CURSOR_VAR);
+    if (!line) {
+        *err = ERR_MISSING_ENV_COMP_LINE;
+        return NULL;
+    }
+    if (!point) {
+        *err = ERR_MISSING_ENV_COMP_POINT;
+        return NULL;
+    }
+    char *line_var = malloc(strlen(BASH_LINE_VAR) + strlen(line) + 2);
+    char *point_var = malloc(strlen(BASH_CURSOR_VAR) + strlen(point) + 2);
+    completion_input_t *input = NULL;
+    if (line_var && point_var) {
+        sprintf(line_var, "%s=%s", BASH_LINE_VAR, line);
+        sprintf(point_var, "%s=%s", BASH_CURSOR_VAR, point);
+        const char *envp[] = {line_var, point_var, NULL};
+        input = create_completion_input_from_env(envp, err);
+    } else {
+        *err = ERR_OUT_OF_MEMORY;
+    }
+    free(line_var);
+    free(point_var);
+    return input;
+}
+
+static completion_input_t *create_input_from_words(SHELL_VAR *words_var, const char *cword, bce_error_t *err) {
+    char *end = NULL;
+    long current_word = strtol(cword, &end, 10);
+    if ((end == cword) || (*end != '\0') || (current_word < 0) || (current_word > INT_MAX)) {
+        *err = ERR_INVALID_COMP_CWORD;
+        return NULL;
+    }
+
+    // COMP_WORDS is never sparse, but don't rely on it
+    ARRAY *words_array = array_cell(words_var);
+    arrayind_t max_index = array_max_index(words_array);
+    size_t word_count = (max_index >= 0) ? (size_t) max_index + 1 : 0;
+    const char **words = malloc(((word_count > 0) ? word_count : 1) * sizeof(char *));
+    if (!words) {
+        *err = ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    for (size_t i = 0; i < word_count; i++) {
+        const char *word = array_reference(words_array, (arrayind_t) i);
+        words[i] = word ? word : "";
+    }
+    completion_input_t *input = create_completion_input_from_words(words, word_count, (int) current_word, err);
+    free(words);
+    return input;
+}
+
+/*
+ * Get the cache for the database, (re)opening it when the database changes.
+ */
+static completion_cache_t *get_cache(const char *db_filename, bce_error_t *err) {
+    *err = ERR_NONE;
+
+    // relative names depend on the current directory, which changes between calls
+    char resolved[PATH_MAX + 1];
+    if (realpath(db_filename, resolved)) {
+        db_filename = resolved;
+    }
+    if (cache && (strncmp(cache_db_filename, db_filename, PATH_MAX) == 0)) {
+        return cache;
+    }
+
+    cache = completion_cache_free(cache);
+    cache_db_filename[0] = '\0';
+    cache = completion_cache_create(db_filename, err);
+    if (*err != ERR_NONE) {
+        return NULL;
+    }
+    strncat(cache_db_filename, db_filename, PATH_MAX);
+    return cache;
+}
+
+/*
+ * Replace COMPREPLY with the recommendations, and BCE_OMITTED with the number left out (e.g. to show "and N more").
+ * With OUTPUT_WORDS, COMPREPLY only gets the word of each record; the whole records go to $BCE_DESC_FD.
+ */
+static void set_compreply(const linked_list_t *recommendation_list, output_format_t format, size_t omitted) {
+    char count[32];
+    snprintf(count, sizeof(count), "%zu", omitted);
+    bind_variable(BCE_OMITTED_VAR, count, 0);
+
+    unbind_variable_noref("COMPREPLY");
+    SHELL_VAR *reply = make_new_array_variable("COMPREPLY");
+    if (!reply) {
+        return;
+    }
+
+    int desc_fd = (format == OUTPUT_WORDS) ? parse_fd(get_string_value(BCE_DESC_FD_VAR)) : -1;
+    output_buffer_t desc;
+    output_buffer_init(&desc);
+    arrayind_t i = 0;
+    for (linked_list_node_t *node = recommendation_list->head; node != NULL; node = node->next) {
+        char *recommendation = (char *) node->data;
+        if (format != OUTPUT_WORDS) {
+            array_insert(array_cell(reply), i++, recommendation);
+            continue;
+        }
+        if (desc_fd >= 0) {
+            output_buffer_append(&desc, recommendation, strlen(recommendation));
+            output_buffer_append_char(&desc, '\n');
+        }
+        // the record is in the arena: cut it at the word
+        char *tab = strchr(recommendation, '\t');
+        if (tab) {
+            *tab = '\0';
+        }
+        array_insert(array_cell(reply), i++, recommendation);
+    }
+    if (desc_fd >= 0) {
+        output_buffer_write(&desc, desc_fd);
+    }
+    output_buffer_free(&desc);
+}
@@ -0,0 +1,27 @@
+# Completion with the words bash has already split, instead of COMP_LINE/COMP_POINT:
+#
+#   $ source bce.bash
+#   $ complete -F _bce_words kubectl
+#
+# `bce --words` gets COMP_WORDS as arguments, so bash's quoting and escaping rules apply to each word.
+# With BCE_OUTPUT=words, bce prints only the (quoted) words to insert, one per line, so COMPREPLY is read as-is.
+# Set BCE_BIN to use another `bce` executable, and BCE_DESC_FD to a file descriptor to get the descriptions.
+
+_bce_words() {
+    mapfile -t COMPREPLY < <(BCE_OUTPUT=words "${BCE_BIN:-bce}" --words "$COMP_CWORD" "${COMP_WORDS[@]}" 2>/dev/null)
+}
+
+# Record the words of each command line, so the ones used most (and most recently) are recommended first:
+#
+#   $ PROMPT_COMMAND="_bce_record${PROMPT_COMMAND:+;$PROMPT_COMMAND}"
+#
+# `bce --record` runs in the background: it never delays the prompt.
+_bce_record() {
+    # a new command since the last prompt?
+    [[ $HISTCMD == "$_bce_histcmd" ]] && return
+    _bce_histcmd=$HISTCMD
+    local line
+    line=$(HISTTIMEFORMAT='' builtin history 1)
+    line=${line#*[0-9]  }
+    ("${BCE_BIN:-bce}" --record "$line" >/dev/null 2>&1 &)
+}
@@ -1,6 +1,8 @@
 #include "cli.h"
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include <sqlite3.h>
 #include <json-c/json.h>
 #include "error.h"
@@ -8,28 +10,52 @@
 #include "data_model.h"
 #include "uuid4.h"
 #include "download.h"
+#include "server.h"
+#include "snapshot.h"
+#include "stmt_cache.h"
+#include "import_writer.h"
+#include "json_import.h"
+#include "import_dir.h"
 
 static const size_t URL_SIZE = 1024;
 
-static bce_error_t process_import_sqlite(const char *filename);
+static bce_error_t process_import_sqlite(const char *filename, bool vacuum);
 
 static bce_error_t process_export_sqlite(const char *command_name, const char *filename);
 
-static bce_error_t process_import_json_url(const char *url);
+static bce_error_t process_import_json_url(const char *url, bool vacuum);
 
-static bce_error_t process_import_json_file(const char *json_filename);
+static bce_error_t process_import_json_file(const char *json_filename, bool vacuum);
+
+static bce_error_t import_json_tree(import_writer_t *writer, const char *json_filename);
+
+static bce_error_t process_import_dir(const char *dir_name, bool vacuum);
+
+static bce_command_t *load_json_command(arena_t *arena, const char *json_filename, bce_error_t *err);
+
+static void report_import(const import_writer_t *writer, const struct timespec *start);
+
+static bce_error_t optimize_database(sqlite3 *conn, const char *filename);
 
 static bce_error_t process_export_json(const char *command_name, const char *filename);
 
+static bce_error_t process_compile_snapshot(const char *filename);
+
 static sqlite3 *open_db_with_xa(const char *filename, int *rc);
 
-static bce_command_t *bce_command_from_json(const char *parent_cmd_uuid, const struct json_object *j_command);
+static bce_str_t generate_uuid(arena_t *arena);
 
-static bce_command_alias_t *bce_command_alias_from_json(const char *cmd_uuid, const struct json_object *j_alias);
+static bce_command_t *bce_command_from_json(arena_t *arena, const char *parent_cmd_uuid,
+                                            const struct json_object *j_command);
 
-static bce_command_arg_t *bce_command_arg_from_json(const char *cmd_uuid, const struct json_object *j_arg);
+static bce_command_alias_t *bce_command_alias_from_json(arena_t *arena, const char *cmd_uuid,
+                                                        const struct json_object *j_alias);
 
-static bce_command_opt_t *bce_command_opt_from_json(const char *arg_uuid, const struct json_object *j_opt);
+static bce_command_arg_t *bce_command_arg_from_json(arena_t *arena, const char *cmd_uuid,
+                                                    const struct json_object *j_arg);
+
+static bce_command_opt_t *bce_command_opt_from_json(arena_t *arena, const char *arg_uuid,
+                                                    const struct json_object *j_opt);
 
 static json_object *bce_command_to_json(const bce_command_t *cmd);
 
@@ -50,7 +76,11 @@ bce_error_t process_cli_impl(const int argc, const char **argv) {
     char filename[FILENAME_MAX + 1];
     char command_name[NAME_FIELD_SIZE + 1];
     char url[URL_SIZE + 1];
+    filename[0] = '\0';
+    command_name[0] = '\0';
+    url[0] = '\0';
     format_t format = FORMAT_SQLITE;
+    bool vacuum = false;
     for (int i = 1; i < argc; i++) {
         if ((strncmp(HELP_ARG_LONGNAME, argv[i], strlen(HELP_ARG_LONGNAME)) == 0)
             // *** help ***
@@ -71,11 +101,39 @@ bce_error_t process_cli_impl(const int argc, const char **argv) {
                 break;
             }
         }
+        else if ((strncmp(IMPORT_DIR_ARG_LONGNAME, argv[i], strlen(IMPORT_DIR_ARG_LONGNAME)) == 0)
+                 || (strncmp(IMPORT_DIR_ARG_SHORTNAME, argv[i], strlen(IMPORT_DIR_ARG_SHORTNAME)) == 0)) {
+            // *** import a directory of json specs (before --import, which it starts with) ***
+            op = OP_IMPORT_DIR;
+            // next parameter should be the directory
+            if ((i + 1) < argc) {
+                filename[0] = '\0';
+                strncat(filename, argv[++i], FILENAME_MAX);
+            } else {
+                op = OP_NONE;
+                break;
+            }
+        }
         else if ((strncmp(IMPORT_ARG_LONGNAME, argv[i], strlen(IMPORT_ARG_LONGNAME)) == 0)
                  || (strncmp(IMPORT_ARG_SHORTNAME, argv[i], strlen(IMPORT_ARG_SHORTNAME)) == 0)) {
             // *** import ***
             op = OP_IMPORT;
         }
+        else if ((strncmp(VACUUM_ARG_LONGNAME, argv[i], strlen(VACUUM_ARG_LONGNAME)) == 0)
+                 || (strncmp(VACUUM_ARG_SHORTNAME, argv[i], strlen(VACUUM_ARG_SHORTNAME)) == 0)) {
+            // *** vacuum (after the import) ***
+            vacuum = true;
+        }
+        else if ((strncmp(SERVE_ARG_LONGNAME, argv[i], strlen(SERVE_ARG_LONGNAME)) == 0)
+                 || (strncmp(SERVE_ARG_SHORTNAME, argv[i], strlen(SERVE_ARG_SHORTNAME)) == 0)) {
+            // *** serve ***
+            op = OP_SERVE;
+        }
+        else if ((strncmp(COMPILE_SNAPSHOT_ARG_LONGNAME, argv[i], strlen(COMPILE_SNAPSHOT_ARG_LONGNAME)) == 0)
+                 || (strncmp(COMPILE_SNAPSHOT_ARG_SHORTNAME, argv[i], strlen(COMPILE_SNAPSHOT_ARG_SHORTNAME)) == 0)) {
+            // *** compile snapshot ***
+            op = OP_COMPILE_SNAPSHOT;
+        }
         else if ((strncmp(FILE_ARG_LONGNAME, argv[i], strlen(FILE_ARG_LONGNAME)) == 0)
                  || (strncmp(FILE_ARG_SHORTNAME, argv[i], strlen(FILE_ARG_SHORTNAME)) == 0)) {
             // *** filename ***
@@ -148,15 +206,24 @@ bce_error_t process_cli_impl(const int argc, const char **argv) {
             if (format == FORMAT_JSON) {
                 if (strlen(url) > 0) {
                     // import from URL
-                    err = process_import_json_url(url);
+                    err = process_import_json_url(url, vacuum);
                 } else {
                     // import from local file
-                    err = process_import_json_file(filename);
+                    err = process_import_json_file(filename, vacuum);
                 }
             } else {
-                err = process_import_sqlite(filename);
+                err = process_import_sqlite(filename, vacuum);
             }
             break;
+        case OP_IMPORT_DIR:
+            err = process_import_dir(filename, vacuum);
+            break;
+        case OP_SERVE:
+            err = process_serve(BCE_DB_FILENAME);
+            break;
+        case OP_COMPILE_SNAPSHOT:
+            err = process_compile_snapshot((strlen(filename) > 0) ? filename : BCE_SNAPSHOT_FILENAME);
+            break;
         case OP_NONE:
             fprintf(stderr, "Invalid arguments\n");
             err = ERR_INVALID_CLI_ARGUMENT;
@@ -170,25 +237,48 @@ void show_usage(void) {
     printf("\nbce (bash_complete_extension)\n");
     printf("usage:\n");
     printf("  bce --export <command> --format <sqlite|json> --file <filename>\n");
-    printf("  bce --import --format <sqlite|json> --file <filename>\n");
-    printf("  bce --import --format json --url <url-of-json-file>\n");
+    printf("  bce --import --format <sqlite|json> --file <filename> [--vacuum]\n");
+    printf("  bce --import --format json --url <url-of-json-file> [--vacuum]\n");
+    printf("  bce --import-dir <directory> [--vacuum]\n");
+    printf("  bce --serve\n");
+    printf("  bce --compile-snapshot [--file <filename>]\n");
+    printf("  bce --words <COMP_CWORD> <COMP_WORDS...>\n");
+    printf("  bce --limit <count> [--words <COMP_CWORD> <COMP_WORDS...>]\n");
+    printf("  bce --record <command-line>\n");
     printf("\narguments:\n");
     printf("  %s (%s) : export command data to file\n",
            EXPORT_ARG_LONGNAME, EXPORT_ARG_SHORTNAME);
     printf("  %s (%s) : import command data from file\n",
            IMPORT_ARG_LONGNAME, IMPORT_ARG_SHORTNAME);
+    printf("  %s (%s) : import every json file in a directory, parsed in parallel\n",
+           IMPORT_DIR_ARG_LONGNAME, IMPORT_DIR_ARG_SHORTNAME);
     printf("  %s (%s) : format to read/write data [sqlite|json] (default=sqlite)\n",
            FORMAT_ARG_LONGNAME, FORMAT_ARG_SHORTNAME);
     printf("  %s (%s) : filename to import/export\n",
            FILE_ARG_LONGNAME, FILE_ARG_SHORTNAME);
     printf("  %s (%s) : url of json file to import\n",
            URL_ARG_LONGNAME, URL_ARG_SHORTNAME);
+    printf("  %s (%s) : reclaim space (VACUUM) and update the statistics (ANALYZE) after importing\n",
+           VACUUM_ARG_LONGNAME, VACUUM_ARG_SHORTNAME);
+    printf("  %s (%s) : answer completion requests from bce_client over a Unix socket\n",
+           SERVE_ARG_LONGNAME, SERVE_ARG_SHORTNAME);
+    printf("  %s (%s) : write a read-only snapshot of the database, used for completion (default=%s)\n",
+           COMPILE_SNAPSHOT_ARG_LONGNAME, COMPILE_SNAPSHOT_ARG_SHORTNAME, BCE_SNAPSHOT_FILENAME);
+    printf("  %s (%s) : complete the words split by bash (from a `complete -F` function)\n",
+           WORDS_ARG_LONGNAME, WORDS_ARG_SHORTNAME);
+    printf("  %s (%s) : only complete with the best <count> recommendations (overrides $BCE_MAX_RESULTS)\n",
+           LIMIT_ARG_LONGNAME, LIMIT_ARG_SHORTNAME);
+    printf("  %s (%s) : record the words of a command line, to rank the recommendations by (e.g. from PROMPT_COMMAND)\n",
+           RECORD_ARG_LONGNAME, RECORD_ARG_SHORTNAME);
     printf("\n");
 }
 
-static bce_error_t process_import_sqlite(const char *filename) {
+static bce_error_t process_import_sqlite(const char *filename, bool vacuum) {
     int rc = SQLITE_OK;
     bce_error_t err = 0;
+    import_writer_t writer = {0};
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
     // open the source database
     sqlite3 *src_db = db_open_with_xa(filename, &rc);
@@ -206,6 +296,8 @@ static bce_error_t process_import_sqlite(const char *filename) {
         goto done;
     }
 
+    import_writer_init(&writer, dest_db);
+
     // get a list of the top-level commands in source database
     linked_list_t *cmd_names = ll_create(NULL);
     rc = db_query_root_command_names(src_db, cmd_names);
@@ -236,13 +328,11 @@ static bce_error_t process_import_sqlite(const char *filename) {
             goto done;
         }
 
-        // vacuum the database (reclaim space)
-        rc = sqlite3_exec(dest_db, "VACUUM", NULL, NULL, NULL);
-
-        // write cmd to dest database
-        rc = db_store_command(dest_db, cmd);
-        if (rc != SQLITE_OK) {
-            err = ERR_SQLITE_ERROR;
+        // write cmd to dest database (before it is freed)
+        import_writer_add_command(&writer, cmd);
+        err = import_writer_flush(&writer);
+        if (err != ERR_NONE) {
+            fprintf(stderr, "Unable to import command: %s. error: %d\n", cmd_name, err);
             goto done;
         }
 
@@ -250,6 +340,11 @@ static bce_error_t process_import_sqlite(const char *filename) {
         cmd = bce_command_free(cmd);
     }
 
+    err = import_writer_finish(&writer);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+
     // commit transaction
     rc = sqlite3_exec(dest_db, "COMMIT;", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
@@ -257,10 +352,19 @@ static bce_error_t process_import_sqlite(const char *filename) {
         err = ERR_SQLITE_ERROR;
         goto done;
     }
+    report_import(&writer, &start);
+    if (vacuum) {
+        err = optimize_database(dest_db, BCE_DB_FILENAME);
+    }
 
     done:
-    sqlite3_close(src_db);
-    sqlite3_close(dest_db);
+    import_writer_finish(&writer);
+#ifdef DEBUG
+    stmt_cache_print_stats(src_db, filename, stdout);
+    stmt_cache_print_stats(dest_db, BCE_DB_FILENAME, stdout);
+#endif
+    db_close(src_db);
+    db_close(dest_db);
     return err;
 }
 
@@ -314,12 +418,16 @@ static int process_export_sqlite(const char *command_name, const char *filename)
     if (completion_command) {
         completion_command = bce_command_free(completion_command);
     }
-    sqlite3_close(src_db);
-    sqlite3_close(dest_db);
+#ifdef DEBUG
+    stmt_cache_print_stats(src_db, BCE_DB_FILENAME, stdout);
+    stmt_cache_print_stats(dest_db, filename, stdout);
+#endif
+    db_close(src_db);
+    db_close(dest_db);
     return err;
 }
 
-static bce_error_t process_import_json_url(const char *url) {
+static bce_error_t process_import_json_url(const char *url, bool vacuum) {
     bce_error_t err = ERR_NONE;
     char json_filename[L_tmpnam + 1];
     json_filename[0] = '\0';
@@ -342,7 +450,7 @@ static bce_error_t process_import_json_url(const char *url) {
         goto done;
     }
 
-    err = process_import_json_file(json_filename);
+    err = process_import_json_file(json_filename, vacuum);
 
     done:
     if (strlen(json_filename) > 0) {
@@ -351,9 +459,12 @@ static bce_error_t process_import_json_url(const char *url) {
     return err;
 }
 
-static bce_error_t process_import_json_file(const char *json_filename) {
+static bce_error_t process_import_json_file(const char *json_filename, bool vacuum) {
     bce_error_t err = ERR_NONE;
     int rc = SQLITE_OK;
+    import_writer_t writer = {0};
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     const char *db_filename = BCE_DB_FILENAME;
     if (uuid4_init() != UUID4_ESUCCESS) {
         fprintf(stderr, "UUID init failure\n");
@@ -361,11 +472,6 @@ static bce_error_t process_import_json_file(const char *json_filename) {
         goto done;
     }
 
-    // parse the json
-    struct json_object *parsed_json = json_object_from_file(json_filename);
-    struct json_object *j_command = json_object_object_get(parsed_json, "command");
-    bce_command_t *command = bce_command_from_json(NULL, j_command);
-
     // open the database
     sqlite3 *dest_db = db_open_with_xa(db_filename, &rc);
     if (rc != SQLITE_OK) {
@@ -374,18 +480,115 @@ static bce_error_t process_import_json_file(const char *json_filename) {
         goto done;
     }
 
-    // delete cmd (recurse) from dest database
-    rc = db_delete_command(dest_db, command->name);
+    // replace the command, writing it as the json is parsed
+    import_writer_init(&writer, dest_db);
+    err = json_import_file(&writer, json_filename);
+    if (err == ERR_JSON_KEY_ORDER) {
+        // fields after the nested arrays: start over, from the whole command tree
+        import_writer_finish(&writer);
+        rc = sqlite3_exec(dest_db, "ROLLBACK; BEGIN TRANSACTION;", NULL, NULL, NULL);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Unable to restart transaction, error: %d, database: %s\n", rc, db_filename);
+            err = ERR_SQLITE_ERROR;
+            goto done;
+        }
+        import_writer_init(&writer, dest_db);
+        err = import_json_tree(&writer, json_filename);
+    }
+    if (err == ERR_NONE) {
+        err = import_writer_finish(&writer);
+    }
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Unable to import file: %s. error: %d\n", json_filename, err);
+        goto done;
+    }
+
+    // commit transaction
+    rc = sqlite3_exec(dest_db, "COMMIT;", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "Unable to delete the command before importing. command %s, error: %d\n", command->name, rc);
+        fprintf(stderr, "Unable to commit transaction, error: %d, database: %s\n", rc, db_filename);
         err = ERR_SQLITE_ERROR;
         goto done;
     }
+    report_import(&writer, &start);
+    if (vacuum) {
+        err = optimize_database(dest_db, db_filename);
+    }
+
+    done:
+    import_writer_finish(&writer);
+#ifdef DEBUG
+    stmt_cache_print_stats(dest_db, db_filename, stdout);
+#endif
+    db_close(dest_db);
+    return err;
+}
+
+/* The json-c DOM, then the command tree: the whole spec in memory, with its fields in any order */
+static bce_error_t import_json_tree(import_writer_t *writer, const char *json_filename) {
+    arena_t *arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    if (!arena) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    bce_error_t err = ERR_NONE;
+    bce_command_t *command = load_json_command(arena, json_filename, &err);
+    if (command) {
+        // delete cmd (recurse) from dest database
+        err = db_delete_command(writer->conn, command->name);
+        if (err == ERR_NONE) {
+            import_writer_add_command(writer, command);
+            err = import_writer_finish(writer);
+        }
+    }
+    arena_destroy(arena);
+    return err;
+}
+
+static bce_error_t process_import_dir(const char *dir_name, bool vacuum) {
+    bce_error_t err = ERR_NONE;
+    int rc = SQLITE_OK;
+    import_writer_t writer = {0};
+    sqlite3 *dest_db = NULL;
+    import_dir_t *result = NULL;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const char *db_filename = BCE_DB_FILENAME;
+    if (uuid4_init() != UUID4_ESUCCESS) {
+        fprintf(stderr, "UUID init failure\n");
+        err = ERR_UUID_ERR;
+        goto done;
+    }
 
-    // insert cmd data
-    rc = db_store_command(dest_db, command);
+    // open the database
+    dest_db = db_open_with_xa(db_filename, &rc);
     if (rc != SQLITE_OK) {
-        err = ERR_SQLITE_ERROR;
+        fprintf(stderr, "Unable to open database. error: %d, database: %s\n", rc, db_filename);
+        err = ERR_OPEN_DATABASE;
+        goto done;
+    }
+
+    // specs are parsed by the workers, and written here (in one transaction)
+    import_writer_init(&writer, dest_db);
+    result = import_dir_run(&writer, dir_name, 0, load_json_command, &err);
+    if (!result) {
+        fprintf(stderr, "Unable to read directory: %s. error: %d\n", dir_name, err);
+        goto done;
+    }
+    for (size_t i = 0; i < result->file_count; i++) {
+        const import_dir_file_t *file = &result->files[i];
+        if (file->err == ERR_NONE) {
+            printf("%s: %zu rows, loaded in %.1f ms, written in %.1f ms\n", file->filename, file->row_count,
+                   file->load_seconds * 1000, file->write_seconds * 1000);
+        } else {
+            fprintf(stderr, "Unable to import file: %s. error: %d\n", file->filename, file->err);
+        }
+    }
+    if (err == ERR_NONE) {
+        err = import_writer_finish(&writer);
+    }
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Unable to import directory: %s. error: %d\n", dir_name, err);
+        sqlite3_exec(dest_db, "ROLLBACK;", NULL, NULL, NULL);
         goto done;
     }
 
@@ -396,12 +599,65 @@ static bce_error_t process_import_json_file(const char *json_filename) {
         err = ERR_SQLITE_ERROR;
         goto done;
     }
+    printf("%zu of %zu files imported, with %d workers\n", result->file_count - result->failed_count,
+           result->file_count, result->worker_count);
+    report_import(&writer, &start);
+    if (vacuum) {
+        err = optimize_database(dest_db, db_filename);
+    }
+    // the others were committed, but the first skipped spec is still an error
+    for (size_t i = 0; (i < result->file_count) && (err == ERR_NONE); i++) {
+        err = result->files[i].err;
+    }
 
     done:
-    sqlite3_close(dest_db);
+    import_writer_finish(&writer);
+    result = import_dir_free(result);
+#ifdef DEBUG
+    stmt_cache_print_stats(dest_db, db_filename, stdout);
+#endif
+    db_close(dest_db);
     return err;
 }
 
+/* A spec, converted into `arena` (from any thread: nothing is allocated outside it) */
+static bce_command_t *load_json_command(arena_t *arena, const char *json_filename, bce_error_t *err) {
+    struct json_object *parsed_json = json_object_from_file(json_filename);
+    if (!parsed_json) {
+        *err = ERR_INVALID_JSON;
+        return NULL;
+    }
+    bce_command_t *command = NULL;
+    struct json_object *j_command = json_object_object_get(parsed_json, "command");
+    if (j_command) {
+        command = bce_command_from_json(arena, NULL, j_command);
+        *err = command ? ERR_NONE : ERR_OUT_OF_MEMORY;
+    } else {
+        *err = ERR_INVALID_CMD;
+    }
+    json_object_put(parsed_json);
+    return command;
+}
+
+/* Import throughput, for specs with many opts */
+static void report_import(const import_writer_t *writer, const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double) (end.tv_sec - start->tv_sec) + (double) (end.tv_nsec - start->tv_nsec) / 1e9;
+    printf("Imported %zu rows with %zu statements in %.3f s (%.0f rows/s)\n", writer->row_count,
+           writer->statement_count, seconds, (seconds > 0) ? (double) writer->row_count / seconds : 0.0);
+}
+
+/* Once, after the import is committed (VACUUM can't run in a transaction) */
+static bce_error_t optimize_database(sqlite3 *conn, const char *filename) {
+    int rc = sqlite3_exec(conn, "VACUUM; ANALYZE;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Unable to vacuum the database, error: %d, database: %s\n", rc, filename);
+        return ERR_SQLITE_ERROR;
+    }
+    return ERR_NONE;
+}
+
 static bce_error_t process_export_json(const char *command_name, const char *filename) {
     int rc = SQLITE_OK;
     bce_error_t err = ERR_NONE;
@@ -438,7 +694,39 @@ static bce_error_t process_export_json(const char *command_name, const char *fil
     if (completion_command) {
         completion_command = bce_command_free(completion_command);
     }
-    sqlite3_close(src_db);
+#ifdef DEBUG
+    stmt_cache_print_stats(src_db, BCE_DB_FILENAME, stdout);
+#endif
+    db_close(src_db);
+    return err;
+}
+
+static bce_error_t process_compile_snapshot(const char *filename) {
+    int rc = SQLITE_OK;
+    bce_error_t err = ERR_NONE;
+
+    // open the source database
+    sqlite3 *src_db = db_open_with_xa(BCE_DB_FILENAME, &rc);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Unable to open database. error: %d, database: %s\n", rc, BCE_DB_FILENAME);
+        err = ERR_OPEN_DATABASE;
+        goto done;
+    }
+
+    err = snapshot_compile(src_db, filename);
+    if (err != ERR_NONE) {
+        fprintf(stderr, "snapshot_compile() returned %d\n", err);
+        goto done;
+    }
+
+    // end the read transaction
+    sqlite3_exec(src_db, "COMMIT;", NULL, NULL, NULL);
+
+    done:
+    if (err) {
+        fprintf(stderr, "Snapshot did not complete successfully. error: %d\n", err);
+    }
+    db_close(src_db);
     return err;
 }
 
@@ -451,25 +739,36 @@ static bce_error_t process_export_json(const char *command_name, const char *fil
   "sub_commands": []
 }
  */
-static bce_command_t *bce_command_from_json(const char *parent_cmd_uuid, const struct json_object *j_command) {
-    bce_command_t *bce_command = bce_command_new();
+static bce_str_t generate_uuid(arena_t *arena) {
+    // the generator's state is shared by the --import-dir workers
+    static pthread_mutex_t uuid_mutex = PTHREAD_MUTEX_INITIALIZER;
+    char uuid[UUID4_LEN];
+    pthread_mutex_lock(&uuid_mutex);
+    uuid4_generate(uuid);
+    pthread_mutex_unlock(&uuid_mutex);
+    return str_pool_intern(arena, uuid);
+}
+
+static bce_command_t *bce_command_from_json(arena_t *arena, const char *parent_cmd_uuid,
+                                            const struct json_object *j_command) {
+    bce_command_t *bce_command = bce_command_new_in(arena);
     json_object *j_obj = NULL;
 
     if (parent_cmd_uuid) {
-        strncat(bce_command->parent_cmd_uuid, parent_cmd_uuid, UUID_FIELD_SIZE);
+        bce_command->parent_cmd_uuid = str_pool_intern(bce_command->arena, parent_cmd_uuid);
     }
 
     j_obj = json_object_object_get(j_command, "uuid");
     if (j_obj) {
         const char *uuid = json_object_get_string(j_obj);
-        strncat(bce_command->uuid, uuid, UUID_FIELD_SIZE);
+        bce_command->uuid = str_pool_intern(bce_command->arena, uuid);
     } else {
-        uuid4_generate(bce_command->uuid);
+        bce_command->uuid = generate_uuid(bce_command->arena);
     }
     j_obj = json_object_object_get(j_command, "name");
     if (j_obj) {
         const char *name = json_object_get_string(j_obj);
-        strncat(bce_command->name, name, NAME_FIELD_SIZE);
+        bce_command->name = str_pool_intern(bce_command->arena, name);
     }
     j_obj = json_object_object_get(j_command, "aliases");
     if (j_obj) {
@@ -477,7 +776,7 @@ static bce_command_t *bce_command_from_json(const char *parent_cmd_uuid, const s
             size_t len = json_object_array_length(j_obj);
             for (size_t i = 0; i < len; i++) {
                 struct json_object *j_alias = json_object_array_get_idx(j_obj, i);
-                bce_command_alias_t *alias = bce_command_alias_from_json(bce_command->uuid, j_alias);
+                bce_command_alias_t *alias = bce_command_alias_from_json(arena, bce_command->uuid, j_alias);
                 ll_append_item(bce_command->aliases, alias);
             }
         }
@@ -488,7 +787,7 @@ static bce_command_t *bce_command_from_json(const char *parent_cmd_uuid, const s
             size_t len = json_object_array_length(j_obj);
             for (size_t i = 0; i < len; i++) {
                 struct json_object *j_arg = json_object_array_get_idx(j_obj, i);
-                bce_command_arg_t *arg = bce_command_arg_from_json(bce_command->uuid, j_arg);
+                bce_command_arg_t *arg = bce_command_arg_from_json(arena, bce_command->uuid, j_arg);
                 ll_append_item(bce_command->args, arg);
             }
         }
@@ -499,7 +798,7 @@ static bce_command_t *bce_command_from_json(const char *parent_cmd_uuid, const s
             size_t len = json_object_array_length(j_obj);
             for (size_t i = 0; i < len; i++) {
                 struct json_object *j_sub = json_object_array_get_idx(j_obj, i);
-                bce_command_t *sub = bce_command_from_json(bce_command->uuid, j_sub);
+                bce_command_t *sub = bce_command_from_json(arena, bce_command->uuid, j_sub);
                 ll_append_item(bce_command->sub_commands, sub);
             }
         }
@@ -514,23 +813,24 @@ static bce_command_t *bce_command_from_json(const char *parent_cmd_uuid, const s
   "name": "str"
 }
  */
-static bce_command_alias_t *bce_command_alias_from_json(const char *cmd_uuid, const struct json_object *j_alias) {
-    bce_command_alias_t *bce_alias = bce_command_alias_new();
+static bce_command_alias_t *bce_command_alias_from_json(arena_t *arena, const char *cmd_uuid,
+                                                        const struct json_object *j_alias) {
+    bce_command_alias_t *bce_alias = bce_command_alias_new_in(arena);
     json_object *j_obj = NULL;
 
-    strncat(bce_alias->cmd_uuid, cmd_uuid, UUID_FIELD_SIZE);
+    bce_alias->cmd_uuid = str_pool_intern(bce_alias->arena, cmd_uuid);
 
     j_obj = json_object_object_get(j_alias, "uuid");
     if (j_obj) {
         const char *uuid = json_object_get_string(j_obj);
-        strncat(bce_alias->uuid, uuid, UUID_FIELD_SIZE);
+        bce_alias->uuid = str_pool_intern(bce_alias->arena, uuid);
     } else {
-        uuid4_generate(bce_alias->uuid);
+        bce_alias->uuid = generate_uuid(bce_alias->arena);
     }
     j_obj = json_object_object_get(j_alias, "name");
     if (j_obj) {
         const char *name = json_object_get_string(j_obj);
-        strncat(bce_alias->name, name, NAME_FIELD_SIZE);
+        bce_alias->name = str_pool_intern(bce_alias->arena, name);
     }
 
     return bce_alias;
@@ -546,38 +846,39 @@ static bce_command_alias_t *bce_command_alias_from_json(const char *cmd_uuid, co
   "opts": []
 }
  */
-static bce_command_arg_t *bce_command_arg_from_json(const char *cmd_uuid, const struct json_object *j_arg) {
-    bce_command_arg_t *bce_arg = bce_command_arg_new();
+static bce_command_arg_t *bce_command_arg_from_json(arena_t *arena, const char *cmd_uuid,
+                                                    const struct json_object *j_arg) {
+    bce_command_arg_t *bce_arg = bce_command_arg_new_in(arena);
     json_object *j_obj = NULL;
 
-    strncat(bce_arg->cmd_uuid, cmd_uuid, UUID_FIELD_SIZE);
+    bce_arg->cmd_uuid = str_pool_intern(bce_arg->arena, cmd_uuid);
 
     j_obj = json_object_object_get(j_arg, "uuid");
     if (j_obj) {
         const char *uuid = json_object_get_string(j_obj);
-        strncat(bce_arg->uuid, uuid, UUID_FIELD_SIZE);
+        bce_arg->uuid = str_pool_intern(bce_arg->arena, uuid);
     } else {
-        uuid4_generate(bce_arg->uuid);
+        bce_arg->uuid = generate_uuid(bce_arg->arena);
     }
     j_obj = json_object_object_get(j_arg, "arg_type");
     if (j_obj) {
         const char *arg_type = json_object_get_string(j_obj);
-        strncat(bce_arg->arg_type, arg_type, CMD_TYPE_FIELD_SIZE);
+        bce_arg->arg_type = str_pool_intern(bce_arg->arena, arg_type);
     }
     j_obj = json_object_object_get(j_arg, "description");
     if (j_obj) {
         const char *description = json_object_get_string(j_obj);
-        strncat(bce_arg->description, description, DESCRIPTION_FIELD_SIZE);
+        bce_arg->description = str_pool_intern(bce_arg->arena, description);
     }
     j_obj = json_object_object_get(j_arg, "long_name");
     if (j_obj) {
         const char *long_name = json_object_get_string(j_obj);
-        strncat(bce_arg->long_name, long_name, NAME_FIELD_SIZE);
+        bce_arg->long_name = str_pool_intern(bce_arg->arena, long_name);
     }
     j_obj = json_object_object_get(j_arg, "short_name");
     if (j_obj) {
         const char *short_name = json_object_get_string(j_obj);
-        strncat(bce_arg->short_name, short_name, SHORTNAME_FIELD_SIZE);
+        bce_arg->short_name = str_pool_intern(bce_arg->arena, short_name);
     }
 
     j_obj = json_object_object_get(j_arg, "opts");
@@ -586,7 +887,7 @@ static bce_command_arg_t *bce_command_arg_from_json(const char *cmd_uuid, const
             size_t len = json_object_array_length(j_obj);
             for (size_t i = 0; i < len; i++) {
                 struct json_object *j_opt = json_object_array_get_idx(j_obj, i);
-                bce_command_opt_t *opt = bce_command_opt_from_json(bce_arg->uuid, j_opt);
+                bce_command_opt_t *opt = bce_command_opt_from_json(arena, bce_arg->uuid, j_opt);
                 ll_append_item(bce_arg->opts, opt);
             }
         }
@@ -601,24 +902,25 @@ static bce_command_arg_t *bce_command_arg_from_json(const char *cmd_uuid, const
   "name": "str"
 }
  */
-static bce_command_opt_t *bce_command_opt_from_json(const char *arg_uuid, const struct json_object *j_opt) {
-    bce_command_opt_t *bce_opt = bce_command_opt_new();
+static bce_command_opt_t *bce_command_opt_from_json(arena_t *arena, const char *arg_uuid,
+                                                    const struct json_object *j_opt) {
+    bce_command_opt_t *bce_opt = bce_command_opt_new_in(arena);
     json_object *j_obj = NULL;
 
     j_obj = json_object_object_get(j_opt, "uuid");
     if (j_obj) {
         const char *uuid = json_object_get_string(j_obj);
-        strncat(bce_opt->uuid, uuid, UUID_FIELD_SIZE);
+        bce_opt->uuid = str_pool_intern(bce_opt->arena, uuid);
     } else {
-        uuid4_generate(bce_opt->uuid);
+        bce_opt->uuid = generate_uuid(bce_opt->arena);
     }
     j_obj = json_object_object_get(j_opt, "name");
     if (j_obj) {
         const char *name = json_object_get_string(j_obj);
-        strncat(bce_opt->name, name, NAME_FIELD_SIZE);
+        bce_opt->name = str_pool_intern(bce_opt->arena, name);
     }
 
-    strncat(bce_opt->cmd_arg_uuid, arg_uuid, UUID_FIELD_SIZE);
+    bce_opt->cmd_arg_uuid = str_pool_intern(bce_opt->arena, arg_uuid);
     return bce_opt;
 }
 
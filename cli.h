@@ -8,7 +8,10 @@ typedef enum operation_t {
     OP_NONE,
     OP_HELP,
     OP_EXPORT,
-    OP_IMPORT
+    OP_IMPORT,
+    OP_IMPORT_DIR,
+    OP_SERVE,
+    OP_COMPILE_SNAPSHOT
 } operation_t;
 
 typedef enum format_t {
@@ -22,12 +25,26 @@ static const char *EXPORT_ARG_LONGNAME = "--export";
 static const char *EXPORT_ARG_SHORTNAME = "-e";
 static const char *IMPORT_ARG_LONGNAME = "--import";
 static const char *IMPORT_ARG_SHORTNAME = "-i";
+static const char *IMPORT_DIR_ARG_LONGNAME = "--import-dir";
+static const char *IMPORT_DIR_ARG_SHORTNAME = "-d";
 static const char *FORMAT_ARG_LONGNAME = "--format";
 static const char *FORMAT_ARG_SHORTNAME = "-o";
 static const char *FILE_ARG_LONGNAME = "--file";
 static const char *FILE_ARG_SHORTNAME = "-f";
 static const char *URL_ARG_LONGNAME = "--url";
 static const char *URL_ARG_SHORTNAME = "-u";
+static const char *VACUUM_ARG_LONGNAME = "--vacuum";
+static const char *VACUUM_ARG_SHORTNAME = "-v";
+static const char *SERVE_ARG_LONGNAME = "--serve";
+static const char *SERVE_ARG_SHORTNAME = "-s";
+static const char *COMPILE_SNAPSHOT_ARG_LONGNAME = "--compile-snapshot";
+static const char *COMPILE_SNAPSHOT_ARG_SHORTNAME = "-c";
+static const char *WORDS_ARG_LONGNAME = "--words";
+static const char *WORDS_ARG_SHORTNAME = "-w";
+static const char *LIMIT_ARG_LONGNAME = "--limit";
+static const char *LIMIT_ARG_SHORTNAME = "-l";
+static const char *RECORD_ARG_LONGNAME = "--record";
+static const char *RECORD_ARG_SHORTNAME = "-r";
 
 void show_usage(void);
 
@@ -0,0 +1,167 @@
+/*
+ * bce_client: thin completion client for `bce --serve`.
+ *
+ * Register with `complete -C bce_client <command>`. The client forwards COMP_LINE/COMP_POINT to the
+ * server and prints the reply. If the server can't be reached (or doesn't answer in time), the full `bce`
+ * binary is exec'd to perform the completion in-process.
+ *
+ * Only links against libc; SQLite, json-c and cURL are never loaded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ipc.h"
+
+#define CLIENT_TIMEOUT_VAR          "BCE_CLIENT_TIMEOUT_MS"
+#define CLIENT_DEFAULT_TIMEOUT_MS   100
+#define BCE_BIN_VAR                 "BCE_BIN"
+#define BCE_DEFAULT_BIN             "bce"
+#define BCE_OUTPUT_VAR              "BCE_OUTPUT"
+#define BCE_DESC_FD_VAR             "BCE_DESC_FD"
+
+static int connect_to_server(void);
+
+static bool request_completion(int fd, char **response, size_t *response_len);
+
+static bool write_words(const char *response, size_t len, const char *omitted);
+
+static int fallback_to_bce(void);
+
+int main(void) {
+    int fd = connect_to_server();
+    if (fd < 0) {
+        return fallback_to_bce();
+    }
+
+    char *response = NULL;
+    size_t response_len = 0;
+    bool result = request_completion(fd, &response, &response_len);
+    close(fd);
+    if (!result) {
+        return fallback_to_bce();
+    }
+
+    // the number of recommendations left out, if any, follows a NUL
+    const char *omitted = memchr(response, '\0', response_len);
+    size_t len = omitted ? (size_t) (omitted - response) : response_len;
+    const char *output = getenv(BCE_OUTPUT_VAR);
+    bool omitted_written = false;
+    if (output && (strcmp(output, "words") == 0)) {
+        omitted_written = write_words(response, len, omitted ? omitted + 1 : NULL);
+    } else {
+        ipc_write_all(STDOUT_FILENO, response, len);
+    }
+    if (omitted && !omitted_written) {
+        fprintf(stderr, BCE_OMITTED_FORMAT, omitted + 1);
+    }
+    free(response);
+    return 0;
+}
+
+static int connect_to_server(void) {
+    char socket_path[FILENAME_MAX + 1];
+    if (!ipc_socket_path(socket_path, sizeof(socket_path))) {
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strncat(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // connecting to a Unix socket either succeeds or fails immediately (no server/stale socket)
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool request_completion(int fd, char **response, size_t *response_len) {
+    // send the forwarded variables as NUL-terminated `KEY=VALUE` strings
+    for (const char **name = IPC_FORWARDED_VARS; *name != NULL; name++) {
+        const char *value = getenv(*name);
+        if (!value) {
+            continue;
+        }
+        if (!ipc_write_all(fd, *name, strlen(*name))
+            || !ipc_write_all(fd, "=", 1)
+            || !ipc_write_all(fd, value, strlen(value) + 1)) {
+            return false;
+        }
+    }
+    shutdown(fd, SHUT_WR);
+
+    int timeout_ms = CLIENT_DEFAULT_TIMEOUT_MS;
+    const char *timeout_str = getenv(CLIENT_TIMEOUT_VAR);
+    if (timeout_str && (strlen(timeout_str) > 0)) {
+        timeout_ms = (int) strtol(timeout_str, (char **) NULL, 10);
+    }
+
+    return ipc_read_all(fd, response, response_len, IPC_MAX_RESPONSE_SIZE, timeout_ms);
+}
+
+/*
+ * The response has a `<word>\t<display>\t<description>` line per recommendation: write the words to stdout, and
+ * the whole lines to $BCE_DESC_FD (if set), followed by the number `omitted` (if not NULL).
+ * Returns whether `omitted` was written.
+ */
+static bool write_words(const char *response, size_t len, const char *omitted) {
+    int desc_fd = -1;
+    const char *desc_fd_str = getenv(BCE_DESC_FD_VAR);
+    if (desc_fd_str && (strlen(desc_fd_str) > 0)) {
+        desc_fd = (int) strtol(desc_fd_str, (char **) NULL, 10);
+    }
+    if (desc_fd >= 0) {
+        ipc_write_all(desc_fd, response, len);
+        if (omitted) {
+            dprintf(desc_fd, BCE_OMITTED_RECORD_FORMAT, omitted);
+        }
+    }
+
+    // one write for all the words
+    char *words = malloc(len + 1);
+    if (!words) {
+        return desc_fd >= 0;
+    }
+    size_t words_len = 0;
+    const char *end = response + len;
+    for (const char *line = response; line < end;) {
+        const char *line_end = memchr(line, '\n', (size_t) (end - line));
+        if (!line_end) {
+            line_end = end;
+        }
+        const char *tab = memchr(line, '\t', (size_t) (line_end - line));
+        size_t word_len = (size_t) ((tab ? tab : line_end) - line);
+        memcpy(words + words_len, line, word_len);
+        words_len += word_len;
+        words[words_len++] = '\n';
+        line = line_end + 1;
+    }
+    ipc_write_all(STDOUT_FILENO, words, words_len);
+    free(words);
+    return desc_fd >= 0;
+}
+
+static int fallback_to_bce(void) {
+    const char *bce_bin = getenv(BCE_BIN_VAR);
+    if (!bce_bin || (strlen(bce_bin) == 0)) {
+        bce_bin = BCE_DEFAULT_BIN;
+    }
+
+    // COMP_LINE and COMP_POINT are inherited through the environment
+    char *const argv[] = {(char *) bce_bin, NULL};
+    execvp(bce_bin, argv);
+    fprintf(stderr, "Unable to run %s\n", bce_bin);
+    return 1;
+}
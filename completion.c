@@ -0,0 +1,293 @@
+#include "completion.h"
+#include <stdio.h>
+#include <string.h>
+#include <sqlite3.h>
+#include "dbutil.h"
+#include "prune.h"
+#include "state_file.h"
+
+static const char *DATA_VERSION_SQL =
+        " PRAGMA data_version ";
+
+static bool is_command_named(const bce_command_t *cmd, const char *command_name);
+
+static void free_cached_command(bce_command_t *cmd);
+
+static int query_data_version(completion_cache_t *cache);
+
+sqlite3 *completion_db_open(const char *filename, bce_error_t *err) {
+    int rc = 0;
+    *err = ERR_NONE;
+
+    sqlite3 *conn = db_open(filename, &rc);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Error %d opening database\n", rc);
+        *err = ERR_OPEN_DATABASE;
+        return NULL;
+    }
+
+    int schema_version = db_get_schema_version(conn);
+    if (schema_version == 0) {
+        // create the schema
+        *err = db_create_schema(conn);
+        if (*err != ERR_NONE) {
+            fprintf(stderr, "Unable to create database schema\n");
+            db_close(conn);
+            return NULL;
+        }
+        schema_version = db_get_schema_version(conn);
+    }
+    if (schema_version != DB_SCHEMA_VERSION) {
+        fprintf(stderr, "Schema version %d does not match expected version %d\n", schema_version, DB_SCHEMA_VERSION);
+        *err = ERR_DATABASE_SCHEMA_VERSION_MISMATCH;
+        db_close(conn);
+        return NULL;
+    }
+
+    return conn;
+}
+
+sqlite3 *completion_db_open_readonly(const char *filename, bce_error_t *err) {
+    *err = ERR_NONE;
+
+    // a missing (or empty) database still needs its schema created
+    int schema_version = db_read_schema_stamp(filename);
+    if (schema_version <= 0) {
+        return completion_db_open(filename, err);
+    }
+
+    int rc = 0;
+    sqlite3 *conn = db_open_readonly(filename, &rc);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Error %d opening database\n", rc);
+        *err = ERR_OPEN_DATABASE;
+        return NULL;
+    }
+
+    // the file header does not reflect changes that are still in the WAL
+    if (db_has_wal_content(filename)) {
+        schema_version = db_get_schema_version(conn);
+    }
+    if (schema_version != DB_SCHEMA_VERSION) {
+        fprintf(stderr, "Schema version %d does not match expected version %d\n", schema_version, DB_SCHEMA_VERSION);
+        *err = ERR_DATABASE_SCHEMA_VERSION_MISMATCH;
+        db_close(conn);
+        return NULL;
+    }
+
+    return conn;
+}
+
+bce_error_t completion_load_command(sqlite3 *conn, bce_command_t *cmd, const char *command_name,
+                                    const linked_list_t *word_list) {
+    // explicitly start a transaction, since this will be done automatically (per statement) otherwise
+    int rc = sqlite3_exec(conn, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "begin transaction returned %d\n", rc);
+        return ERR_SQLITE_ERROR;
+    }
+
+    // search for the command directly (either the sub-commands on the command line, or all descendents)
+    bce_error_t err = word_list ? db_query_command_path(conn, cmd, command_name, word_list)
+                                : db_query_command_tree(conn, cmd, command_name);
+    if (err != ERR_NONE) {
+        rc = sqlite3_extended_errcode(conn);
+        fprintf(stderr, "loading command returned %d\n", rc);
+        sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL);
+        return err;
+    }
+
+    rc = sqlite3_exec(conn, "COMMIT;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "commit transaction returned %d\n", rc);
+        return ERR_SQLITE_ERROR;
+    }
+    return ERR_NONE;
+}
+
+bce_error_t completion_collect(bce_command_t *cmd, const completion_input_t *input, const usage_table_t *usage,
+                               linked_list_t *recommendation_list, bool *has_required, size_t *omitted) {
+    if (!cmd) {
+        return ERR_INVALID_CMD;
+    }
+    if (!input) {
+        return ERR_MISSING_ENV_COMP_LINE;
+    }
+
+    bce_str_t current_word = get_current_word_in(cmd->arena, input);
+    bce_str_t previous_word = get_previous_word_in(cmd->arena, input);
+    bce_str_t prefix = get_completion_prefix_in(cmd->arena, input);
+
+    // remove non-relevant command data
+    prune_command(cmd, input);
+
+    // build the command recommendations (the options of the arg at the cursor are for the next word: not filtered)
+    recommendation_filter_t filter;
+    recommendation_filter_init(&filter, MATCH_PREFIX, bce_str_empty(), input);
+    filter.usage = usage;
+    bool required;
+    if ((input->output_format == OUTPUT_WORDS) && (bce_str_len(prefix) > 0) && get_current_arg(cmd, current_word)) {
+        // words to insert: with the cursor still in the arg, it is the word to complete
+        required = collect_word_recommendation(recommendation_list, &filter, prefix);
+    } else {
+        required = collect_required_recommendations(recommendation_list, cmd, current_word, previous_word, &filter);
+    }
+    if (!required) {
+        recommendation_filter_free(&filter);
+        recommendation_filter_init(&filter, input->match_mode, prefix, input);
+        filter.usage = usage;
+        collect_optional_recommendations(recommendation_list, cmd, current_word, previous_word, &filter);
+        if ((filter.matched == 0) && (bce_str_len(prefix) > 0)) {
+            // did you mean: the names the word misspells
+            recommendation_filter_free(&filter);
+            recommendation_filter_init(&filter, MATCH_TYPO, prefix, input);
+            filter.usage = usage;
+            collect_optional_recommendations(recommendation_list, cmd, current_word, previous_word, &filter);
+        }
+    }
+    recommendation_filter_rank(&filter, recommendation_list);
+    if (has_required) {
+        *has_required = required;
+    }
+    if (omitted) {
+        *omitted = recommendation_filter_omitted(&filter);
+    }
+    recommendation_filter_free(&filter);
+    return ERR_NONE;
+}
+
+bce_str_t completion_index_prefix_in(arena_t *arena, const completion_input_t *input) {
+    if ((input->match_mode != MATCH_PREFIX) || input->correct_words) {
+        return bce_str_empty();
+    }
+    return get_completion_prefix_in(arena, input);
+}
+
+completion_cache_t *completion_cache_create(const char *db_filename, bce_error_t *err) {
+    sqlite3 *conn = completion_db_open(db_filename, err);
+    if (*err != ERR_NONE) {
+        return NULL;
+    }
+
+    completion_cache_t *cache = malloc(sizeof(completion_cache_t));
+    if (!cache) {
+        db_close(conn);
+        *err = ERR_OPEN_DATABASE;
+        return NULL;
+    }
+    cache->conn = conn;
+    cache->commands = ll_create((ll_free_node_func) &free_cached_command);
+    // resolved once the database exists
+    state_file_path(cache->usage_filename, sizeof(cache->usage_filename), db_filename, BCE_USAGE_FILENAME);
+    state_file_path(cache->usage_log_filename, sizeof(cache->usage_log_filename), db_filename,
+                    BCE_USAGE_LOG_FILENAME);
+    state_file_path(cache->history_index_filename, sizeof(cache->history_index_filename), db_filename,
+                    BCE_HISTORY_INDEX_FILENAME);
+    cache->data_version_stmt = NULL;
+    int rc = sqlite3_prepare_v3(conn, DATA_VERSION_SQL, -1, SQLITE_PREPARE_PERSISTENT, &cache->data_version_stmt,
+                                NULL);
+    if (rc != SQLITE_OK) {
+        *err = ERR_SQLITE_ERROR;
+        return completion_cache_free(cache);
+    }
+    cache->data_version = query_data_version(cache);
+
+    *err = ERR_NONE;
+    return cache;
+}
+
+completion_cache_t *completion_cache_free(completion_cache_t *cache) {
+    if (!cache) {
+        return NULL;
+    }
+
+    cache->commands = ll_destroy(cache->commands);
+    sqlite3_finalize(cache->data_version_stmt);
+    db_close(cache->conn);
+    free(cache);
+    return NULL;
+}
+
+bce_command_t *completion_cache_get_command(completion_cache_t *cache, arena_t *arena, const char *command_name,
+                                           const linked_list_t *word_list, bce_str_t prefix, bce_error_t *err) {
+    *err = ERR_NONE;
+    if (!cache || !command_name) {
+        *err = ERR_INVALID_CMD_NAME;
+        return NULL;
+    }
+
+    // discard the cached trees if another connection has modified the database
+    int data_version = query_data_version(cache);
+    if (data_version != cache->data_version) {
+        cache->commands = ll_destroy(cache->commands);
+        cache->commands = ll_create((ll_free_node_func) &free_cached_command);
+        cache->data_version = data_version;
+    }
+
+    for (linked_list_node_t *node = cache->commands->head; node != NULL; node = node->next) {
+        bce_command_t *cmd = (bce_command_t *) node->data;
+        if (is_command_named(cmd, command_name)) {
+            return word_list ? bce_command_clone_path_prefix_in(arena, cmd, word_list, prefix) : bce_command_clone(cmd);
+        }
+    }
+
+    // the whole tree is cached, so later requests don't need the database
+    // (in an arena of its own, so its strings are released along with it when the database changes)
+    arena_t *tree_arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    bce_command_t *cmd = bce_command_new_in(tree_arena);
+    if (!cmd) {
+        arena_destroy(tree_arena);
+        *err = ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    *err = completion_load_command(cache->conn, cmd, command_name, NULL);
+    if (*err != ERR_NONE) {
+        free_cached_command(cmd);
+        return NULL;
+    }
+
+    // unknown commands are not cached; the caller still gets an (empty) command
+    if (strlen(cmd->uuid) == 0) {
+        bce_command_t *copy = word_list ? bce_command_new_in(arena) : bce_command_new();
+        free_cached_command(cmd);
+        return copy;
+    }
+    // indexed once, so each request only copies the sub-commands on the command line and the ones matching `prefix`
+    bce_command_build_index(cmd);
+    ll_append_item(cache->commands, cmd);
+    return word_list ? bce_command_clone_path_prefix_in(arena, cmd, word_list, prefix) : bce_command_clone(cmd);
+}
+
+static bool is_command_named(const bce_command_t *cmd, const char *command_name) {
+    if (strcmp(cmd->name, command_name) == 0) {
+        return true;
+    }
+    if (cmd->aliases) {
+        for (linked_list_node_t *node = cmd->aliases->head; node != NULL; node = node->next) {
+            const bce_command_alias_t *alias = (const bce_command_alias_t *) node->data;
+            if (strcmp(alias->name, command_name) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int query_data_version(completion_cache_t *cache) {
+    int version = 0;
+    sqlite3_stmt *stmt = cache->data_version_stmt;
+    if (stmt && (sqlite3_step(stmt) == SQLITE_ROW)) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+    return version;
+}
+
+static void free_cached_command(bce_command_t *cmd) {
+    if (!cmd) {
+        return;
+    }
+    arena_t *arena = cmd->arena;
+    bce_command_free_index(cmd);
+    arena_destroy(arena);
+}
@@ -0,0 +1,70 @@
+#ifndef BCE_COMPLETION_H
+#define BCE_COMPLETION_H
+
+#include <stdbool.h>
+#include <limits.h>
+#include <sqlite3.h>
+#include "linked_list.h"
+#include "data_model.h"
+#include "input.h"
+#include "usage.h"
+#include "error.h"
+
+/* Command trees kept in memory between completion requests (used by `bce --serve`) */
+typedef struct completion_cache_t {
+    sqlite3 *conn;
+    sqlite3_stmt *data_version_stmt;
+    int data_version;
+    linked_list_t *commands;    /* bce_command_t, each allocated (with its strings) in an arena of its own */
+    /* the state files, next to the database (see `state_file_path()`) */
+    char usage_filename[PATH_MAX];
+    char usage_log_filename[PATH_MAX];
+    char history_index_filename[PATH_MAX];
+} completion_cache_t;
+
+/* Open the completion database, creating or verifying the schema */
+sqlite3 *completion_db_open(const char *filename, bce_error_t *err);
+
+/*
+ * Open the completion database read-only (no pragmas, schema checked from the file header).
+ * Falls back to `completion_db_open()` when the database has not been created yet.
+ */
+sqlite3 *completion_db_open_readonly(const char *filename, bce_error_t *err);
+
+/*
+ * Load the command hierarchy within a single read transaction.
+ * With a `word_list` (see `bash_input_to_list()`), only the sub-commands on the command line are loaded.
+ */
+bce_error_t completion_load_command(sqlite3 *conn, bce_command_t *cmd, const char *command_name,
+                                    const linked_list_t *word_list);
+
+/*
+ * Prune the command tree, based on the input, and collect the recommendations.
+ * If none matches the word under the cursor, the names it misspells are recommended instead, nearest first.
+ * With `input->max_results`, only the best ones are collected; `omitted` is set to the number of the others.
+ * With the command's recorded `usage` (see `usage_load()`), the most used of equally matching ones come first.
+ */
+bce_error_t completion_collect(bce_command_t *cmd, const completion_input_t *input, const usage_table_t *usage,
+                               linked_list_t *recommendation_list, bool *has_required, size_t *omitted);
+
+/*
+ * The prefix to narrow the copy of a cached command by (see `completion_cache_get_command()`): the word under the
+ * cursor, or empty when matching fuzzily (the index only finds names by prefix) or correcting misspelled words
+ * (see `correct_misspelled_words()`).
+ */
+bce_str_t completion_index_prefix_in(arena_t *arena, const completion_input_t *input);
+
+completion_cache_t *completion_cache_create(const char *db_filename, bce_error_t *err);
+
+completion_cache_t *completion_cache_free(completion_cache_t *cache);
+
+/*
+ * Get a private copy of the command (only the sub-commands in `word_list`, if not NULL), loading it on first use.
+ * Of the children of the deepest sub-command, only the ones that could match `prefix` (see
+ * `get_completion_prefix_in()`) are copied. The copy of the path is allocated from `arena` when given.
+ * Caller should use `bce_command_free()`
+ */
+bce_command_t *completion_cache_get_command(completion_cache_t *cache, arena_t *arena, const char *command_name,
+                                           const linked_list_t *word_list, bce_str_t prefix, bce_error_t *err);
+
+#endif // BCE_COMPLETION_H
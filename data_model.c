@@ -1,5 +1,9 @@
 #include "data_model.h"
 #include "linked_list.h"
+#include "hash_map.h"
+#include "stmt_cache.h"
+#include "import_writer.h"
+#include "input.h"
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
@@ -37,6 +41,73 @@ static const char *COMMAND_OPT_READ_SQL =
         " WHERE ca.uuid = ?1 "
         " ORDER BY co.name ";
 
+// SQL statements used to load a command hierarchy in a fixed number of queries
+#define COMMAND_TREE_CTE \
+        " WITH RECURSIVE tree(uuid, depth) AS ( " \
+        "   SELECT ?1, 0 " \
+        "   UNION ALL " \
+        "   SELECT c.uuid, t.depth + 1 FROM command c JOIN tree t ON c.parent_cmd = t.uuid " \
+        " ) "
+
+// parents are returned before their children, siblings are ordered by name
+static const char *COMMAND_TREE_READ_SQL =
+        COMMAND_TREE_CTE
+        " SELECT c.uuid, c.name, c.parent_cmd "
+        " FROM tree t "
+        " JOIN command c ON c.uuid = t.uuid "
+        " WHERE t.depth > 0 "
+        " ORDER BY t.depth, c.name ";
+
+static const char *COMMAND_TREE_ALIAS_READ_SQL =
+        COMMAND_TREE_CTE
+        " SELECT a.uuid, a.cmd_uuid, a.name "
+        " FROM tree t "
+        " JOIN command_alias a ON a.cmd_uuid = t.uuid ";
+
+static const char *COMMAND_TREE_ARG_READ_SQL =
+        COMMAND_TREE_CTE
+        " SELECT ca.uuid, ca.cmd_uuid, ca.arg_type, ca.description, ca.long_name, ca.short_name "
+        " FROM tree t "
+        " JOIN command_arg ca ON ca.cmd_uuid = t.uuid "
+        " ORDER BY ca.long_name, ca.short_name ";
+
+static const char *COMMAND_TREE_OPT_READ_SQL =
+        COMMAND_TREE_CTE
+        " SELECT co.uuid, co.cmd_arg_uuid, co.name "
+        " FROM tree t "
+        " JOIN command_arg ca ON ca.cmd_uuid = t.uuid "
+        " JOIN command_opt co ON co.cmd_arg_uuid = ca.uuid "
+        " ORDER BY co.name ";
+
+// SQL statements used to load the sub-commands on the command line (one level at a time)
+static const char *SUB_COMMAND_ALIAS_READ_SQL =
+        " SELECT a.uuid, a.cmd_uuid, a.name "
+        " FROM command c "
+        " JOIN command_alias a ON a.cmd_uuid = c.uuid "
+        " WHERE c.parent_cmd = ?1 ";
+
+static const char *COMMAND_ARG_OPT_READ_SQL =
+        " SELECT co.uuid, co.cmd_arg_uuid, co.name "
+        " FROM command_arg ca "
+        " JOIN command_opt co ON co.cmd_arg_uuid = ca.uuid "
+        " WHERE ca.cmd_uuid = ?1 "
+        " ORDER BY co.name ";
+
+static const char *SUB_COMMAND_ARG_READ_SQL =
+        " SELECT ca.uuid, ca.cmd_uuid, ca.arg_type, ca.description, ca.long_name, ca.short_name "
+        " FROM command c "
+        " JOIN command_arg ca ON ca.cmd_uuid = c.uuid "
+        " WHERE c.parent_cmd = ?1 "
+        " ORDER BY ca.long_name, ca.short_name ";
+
+static const char *SUB_COMMAND_OPT_READ_SQL =
+        " SELECT co.uuid, co.cmd_arg_uuid, co.name "
+        " FROM command c "
+        " JOIN command_arg ca ON ca.cmd_uuid = c.uuid "
+        " JOIN command_opt co ON co.cmd_arg_uuid = ca.uuid "
+        " WHERE c.parent_cmd = ?1 "
+        " ORDER BY co.name ";
+
 // SQL statements used for IMPORT/EXPORT
 static const char *ROOT_COMMAND_NAMES_SQL =
         " SELECT c.name "
@@ -44,12 +115,6 @@ static const char *ROOT_COMMAND_NAMES_SQL =
         " WHERE c.parent_cmd IS NULL "
         " ORDER BY c.name ";
 
-static const char *COMMAND_WRITE_SQL =
-        " INSERT INTO command "
-        " (uuid, name, parent_cmd) "
-        " VALUES "
-        " (?1, ?2, ?3) ";
-
 static const char *COMMAND_ALIAS_WRITE_SQL =
         " INSERT INTO command_alias "
         " (uuid, cmd_uuid, name) "
@@ -74,6 +139,44 @@ static const char *COMMAND_DELETE_SQL =
         " WHERE name = ?1 "
         " AND parent_cmd IS NULL ";
 
+static bce_error_t read_root_command(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name);
+
+static bce_error_t query_children(struct sqlite3 *conn, const char *sql, const char *uuid, const hash_map_t *parents,
+                                  void (*read_rows)(sqlite3_stmt *, const hash_map_t *, hash_map_t *));
+
+static bce_error_t query_args(struct sqlite3 *conn, const char *arg_sql, const char *opt_sql, const char *uuid,
+                              const hash_map_t *commands, hash_map_t *args);
+
+static void read_alias_rows(sqlite3_stmt *stmt, const hash_map_t *commands, hash_map_t *unused);
+
+static void read_arg_rows(sqlite3_stmt *stmt, const hash_map_t *commands, hash_map_t *args);
+
+static void read_opt_rows(sqlite3_stmt *stmt, const hash_map_t *args, hash_map_t *unused);
+
+static void read_command_row(sqlite3_stmt *stmt, bce_command_t *cmd);
+
+static bce_command_t *clone_command_node(const bce_command_t *cmd, arena_t *arena);
+
+static bce_command_t *clone_command_path(const bce_command_t *cmd, arena_t *arena, const hash_map_t *word_set,
+                                        const linked_list_t *word_list, bce_str_t prefix);
+
+static const bce_command_t *find_sub_command_on_cmdline(const bce_command_t *cmd, const hash_map_t *word_set,
+                                                        const linked_list_t *word_list);
+
+static bool clone_matching_sub_commands(const bce_command_t *cmd, bce_command_t *copy, bce_str_t prefix);
+
+static int compare_command_names(const void *a, const void *b);
+
+static bool index_sub_command(name_index_t *index, bce_command_t *sub_cmd);
+
+static void read_alias_row(sqlite3_stmt *stmt, bce_command_alias_t *alias);
+
+static void read_arg_row(sqlite3_stmt *stmt, bce_command_arg_t *arg);
+
+static void read_opt_row(sqlite3_stmt *stmt, bce_command_opt_t *opt);
+
+static bce_str_t column_str(sqlite3_stmt *stmt, int col, arena_t *arena);
+
 bce_error_t db_query_root_command_names(struct sqlite3 *conn, linked_list_t *cmd_names) {
     if (!conn) {
         return ERR_NO_DATABASE_CONNECTION;
@@ -83,16 +186,17 @@ bce_error_t db_query_root_command_names(struct sqlite3 *conn, linked_list_t *cmd
     }
 
     // try to find the command by name
-    sqlite3_stmt *stmt;
-    // try to find the command by name
-    int rc = sqlite3_prepare_v3(conn, ROOT_COMMAND_NAMES_SQL, -1, 0, &stmt, NULL);
+    int rc;
+    sqlite3_stmt *stmt = stmt_cache_acquire(conn, ROOT_COMMAND_NAMES_SQL, &rc);
     if (rc == SQLITE_OK) {
         for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
-            char *cmd_name = calloc(NAME_FIELD_SIZE + 1, sizeof(char));
-            strncat(cmd_name, (const char *) sqlite3_column_text(stmt, 0), NAME_FIELD_SIZE);
+            size_t len = (size_t) sqlite3_column_bytes(stmt, 0);
+            char *cmd_name = calloc(len + 1, sizeof(char));
+            memcpy(cmd_name, sqlite3_column_text(stmt, 0), len);
             ll_append_item(cmd_names, cmd_name);
         }
     }
+    stmt_cache_release(stmt);
 
     bce_error_t err = ERR_NONE;
     if (rc != SQLITE_OK) {
@@ -104,18 +208,17 @@ bce_error_t db_query_root_command_names(struct sqlite3 *conn, linked_list_t *cmd
 bce_error_t db_query_command(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name) {
     int rc;
     bce_error_t err = ERR_NONE;
-    unsigned int prep_flags = SQLITE_PREPARE_PERSISTENT;
 
-    memset(cmd->uuid, 0, UUID_FIELD_SIZE + 1);
-    memset(cmd->name, 0, NAME_FIELD_SIZE + 1);
-    memset(cmd->parent_cmd_uuid, 0, UUID_FIELD_SIZE + 1);
+    cmd->uuid = bce_str_empty();
+    cmd->name = bce_str_empty();
+    cmd->parent_cmd_uuid = bce_str_empty();
     cmd->aliases = NULL;
     cmd->sub_commands = NULL;
     cmd->args = NULL;
 
     // prepare SQL statement
     sqlite3_stmt *stmt;
-    rc = sqlite3_prepare_v3(conn, COMMAND_READ_SQL, -1, prep_flags, &stmt, NULL);
+    stmt = stmt_cache_acquire(conn, COMMAND_READ_SQL, &rc);
     if (rc != SQLITE_OK) {
         err = ERR_SQLITE_ERROR;
         goto done;
@@ -126,20 +229,20 @@ bce_error_t db_query_command(struct sqlite3 *conn, bce_command_t *cmd, const cha
     sqlite3_bind_text(stmt, 2, command_name, -1, NULL);
     int step = sqlite3_step(stmt);
     if (step == SQLITE_ROW) {
-        strncat(cmd->uuid, (const char *) sqlite3_column_text(stmt, 0), UUID_FIELD_SIZE);
-        strncat(cmd->name, (const char *) sqlite3_column_text(stmt, 1), NAME_FIELD_SIZE);
+        cmd->uuid = column_str(stmt, 0, cmd->arena);
+        cmd->name = column_str(stmt, 1, cmd->arena);
         if (sqlite3_column_type(stmt, 2) == SQLITE_TEXT) {
-            strncat(cmd->parent_cmd_uuid, (const char *) sqlite3_column_text(stmt, 2), UUID_FIELD_SIZE);
+            cmd->parent_cmd_uuid = column_str(stmt, 2, cmd->arena);
         } else {
-            memset(cmd->parent_cmd_uuid, 0, UUID_FIELD_SIZE + 1);
+            cmd->parent_cmd_uuid = bce_str_empty();
         }
         ll_free_node_func free_command = (ll_free_node_func) &bce_command_free;
         ll_free_node_func free_alias = (ll_free_node_func) &bce_command_alias_free;
         ll_free_node_func free_arg = (ll_free_node_func) &bce_command_arg_free;
 
-        cmd->aliases = ll_create(free_alias);
-        cmd->sub_commands = ll_create(free_command);
-        cmd->args = ll_create(free_arg);
+        cmd->aliases = ll_create_in(cmd->arena, free_alias);
+        cmd->sub_commands = ll_create_in(cmd->arena, free_command);
+        cmd->args = ll_create_in(cmd->arena, free_arg);
 
         // populate child aliases
         err = db_query_command_aliases(conn, cmd);
@@ -161,20 +264,17 @@ bce_error_t db_query_command(struct sqlite3 *conn, bce_command_t *cmd, const cha
     }
 
     done:
-    if (stmt) {
-        sqlite3_finalize(stmt);
-    }
+    stmt_cache_release(stmt);
     return err;
 }
 
 bce_error_t db_query_command_aliases(struct sqlite3 *conn, bce_command_t *parent_cmd) {
     int rc;
     bce_error_t err = ERR_NONE;
-    unsigned int prep_flags = SQLITE_PREPARE_PERSISTENT;
 
     // prepare SQL statement
     sqlite3_stmt *stmt;
-    rc = sqlite3_prepare_v3(conn, COMMAND_ALIAS_READ_SQL, -1, prep_flags, &stmt, NULL);
+    stmt = stmt_cache_acquire(conn, COMMAND_ALIAS_READ_SQL, &rc);
     if (rc != SQLITE_OK) {
         err = ERR_SQLITE_ERROR;
         goto done;
@@ -182,30 +282,27 @@ bce_error_t db_query_command_aliases(struct sqlite3 *conn, bce_command_t *parent
 
     sqlite3_bind_text(stmt, 1, parent_cmd->uuid, -1, NULL);
     for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
-        bce_command_alias_t *alias = bce_command_alias_new();
-        strncat(alias->uuid, (const char *) sqlite3_column_text(stmt, 0), UUID_FIELD_SIZE);
-        strncat(alias->cmd_uuid, (const char *) sqlite3_column_text(stmt, 1), UUID_FIELD_SIZE);
-        strncat(alias->name, (const char *) sqlite3_column_text(stmt, 2), NAME_FIELD_SIZE);
+        bce_command_alias_t *alias = bce_command_alias_new_in(parent_cmd->arena);
+        alias->uuid = column_str(stmt, 0, alias->arena);
+        alias->cmd_uuid = column_str(stmt, 1, alias->arena);
+        alias->name = column_str(stmt, 2, alias->arena);
 
         // add this alias to the parent
         ll_append_item(parent_cmd->aliases, alias);
     }
 
     done:
-    if (stmt) {
-        sqlite3_finalize(stmt);
-    }
+    stmt_cache_release(stmt);
     return err;
 }
 
 bce_error_t db_query_sub_commands(struct sqlite3 *conn, bce_command_t *parent_cmd) {
     int rc;
     bce_error_t err = ERR_NONE;
-    unsigned int prep_flags = SQLITE_PREPARE_PERSISTENT;
 
     // prepare SQL statement
     sqlite3_stmt *stmt;
-    rc = sqlite3_prepare_v3(conn, SUB_COMMAND_READ_SQL, -1, prep_flags, &stmt, NULL);
+    stmt = stmt_cache_acquire(conn, SUB_COMMAND_READ_SQL, &rc);
     if (rc != SQLITE_OK) {
         err = ERR_SQLITE_ERROR;
         goto done;
@@ -214,13 +311,13 @@ bce_error_t db_query_sub_commands(struct sqlite3 *conn, bce_command_t *parent_cm
     sqlite3_bind_text(stmt, 1, parent_cmd->uuid, -1, NULL);
     for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
         // create bce_command_t
-        bce_command_t *sub_cmd = bce_command_new();
-        strncat(sub_cmd->uuid, (const char *) sqlite3_column_text(stmt, 0), UUID_FIELD_SIZE);
-        strncat(sub_cmd->name, (const char *) sqlite3_column_text(stmt, 1), NAME_FIELD_SIZE);
+        bce_command_t *sub_cmd = bce_command_new_in(parent_cmd->arena);
+        sub_cmd->uuid = column_str(stmt, 0, sub_cmd->arena);
+        sub_cmd->name = column_str(stmt, 1, sub_cmd->arena);
         if (sqlite3_column_type(stmt, 2) == SQLITE_TEXT) {
-            strncat(sub_cmd->parent_cmd_uuid, (const char *) sqlite3_column_text(stmt, 2), UUID_FIELD_SIZE);
+            sub_cmd->parent_cmd_uuid = column_str(stmt, 2, sub_cmd->arena);
         } else {
-            memset(sub_cmd->parent_cmd_uuid, 0, UUID_FIELD_SIZE + 1);
+            sub_cmd->parent_cmd_uuid = bce_str_empty();
         }
 
         // populate child aliases
@@ -246,9 +343,7 @@ bce_error_t db_query_sub_commands(struct sqlite3 *conn, bce_command_t *parent_cm
     }
 
     done:
-    if (stmt) {
-        sqlite3_finalize(stmt);
-    }
+    stmt_cache_release(stmt);
     return err;
 }
 
@@ -265,14 +360,13 @@ bce_error_t db_query_command_args(sqlite3 *conn, bce_command_t *parent_cmd) {
     // ensure cmd->args is fresh
     parent_cmd->args = ll_destroy(parent_cmd->args);
     ll_free_node_func free_arg = (ll_free_node_func) &bce_command_arg_free;
-    parent_cmd->args = ll_create(free_arg);
+    parent_cmd->args = ll_create_in(parent_cmd->arena, free_arg);
 
-    char *command_uuid = parent_cmd->uuid;
+    bce_str_t command_uuid = parent_cmd->uuid;
 
     // pull statement from cache
-    unsigned int prep_flags = SQLITE_PREPARE_PERSISTENT;
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v3(conn, COMMAND_ARG_READ_SQL, -1, prep_flags, &stmt, NULL);
+    int rc;
+    sqlite3_stmt *stmt = stmt_cache_acquire(conn, COMMAND_ARG_READ_SQL, &rc);
     if (rc != SQLITE_OK) {
         err = ERR_SQLITE_ERROR;
         goto done;
@@ -280,25 +374,25 @@ bce_error_t db_query_command_args(sqlite3 *conn, bce_command_t *parent_cmd) {
 
     sqlite3_bind_text(stmt, 1, command_uuid, -1, NULL);
     for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
-        bce_command_arg_t *arg = bce_command_arg_new();
+        bce_command_arg_t *arg = bce_command_arg_new_in(parent_cmd->arena);
         // ca.uuid, ca.cmd_uuid, ca.arg_type, ca.long_name, ca.short_name
-        strncat(arg->uuid, (const char *) sqlite3_column_text(stmt, 0), UUID_FIELD_SIZE);
-        strncat(arg->cmd_uuid, (const char *) sqlite3_column_text(stmt, 1), UUID_FIELD_SIZE);
-        strncat(arg->arg_type, (const char *) sqlite3_column_text(stmt, 2), CMD_TYPE_FIELD_SIZE);
+        arg->uuid = column_str(stmt, 0, arg->arena);
+        arg->cmd_uuid = column_str(stmt, 1, arg->arena);
+        arg->arg_type = column_str(stmt, 2, arg->arena);
         if (sqlite3_column_type(stmt, 4) == SQLITE_TEXT) {
-            strncat(arg->description, (const char *) sqlite3_column_text(stmt, 3), DESCRIPTION_FIELD_SIZE);
+            arg->description = column_str(stmt, 3, arg->arena);
         } else {
-            memset(arg->description, 0, DESCRIPTION_FIELD_SIZE + 1);
+            arg->description = bce_str_empty();
         }
         if (sqlite3_column_type(stmt, 4) == SQLITE_TEXT) {
-            strncat(arg->long_name, (const char *) sqlite3_column_text(stmt, 4), NAME_FIELD_SIZE);
+            arg->long_name = column_str(stmt, 4, arg->arena);
         } else {
-            memset(arg->long_name, 0, NAME_FIELD_SIZE + 1);
+            arg->long_name = bce_str_empty();
         }
         if (sqlite3_column_type(stmt, 5) == SQLITE_TEXT) {
-            strncat(arg->short_name, (const char *) sqlite3_column_text(stmt, 5), SHORTNAME_FIELD_SIZE);
+            arg->short_name = column_str(stmt, 5, arg->arena);
         } else {
-            memset(arg->short_name, 0, SHORTNAME_FIELD_SIZE + 1);
+            arg->short_name = bce_str_empty();
         }
         err = db_query_command_opts(conn, arg);
         if (err != ERR_NONE) {
@@ -309,9 +403,7 @@ bce_error_t db_query_command_args(sqlite3 *conn, bce_command_t *parent_cmd) {
     }
 
     done:
-    if (stmt) {
-        sqlite3_finalize(stmt);
-    }
+    stmt_cache_release(stmt);
     return err;
 }
 
@@ -328,92 +420,443 @@ bce_error_t db_query_command_opts(struct sqlite3 *conn, bce_command_arg_t *paren
     // ensure arg->opts is fresh
     parent_arg->opts = ll_destroy(parent_arg->opts);
     ll_free_node_func free_opt = (ll_free_node_func) &bce_command_opt_free;
-    parent_arg->opts = ll_create(free_opt);
+    parent_arg->opts = ll_create_in(parent_arg->arena, free_opt);
 
     // pull statement from cache
-    unsigned int prep_flags = SQLITE_PREPARE_PERSISTENT;
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v3(conn, COMMAND_OPT_READ_SQL, -1, prep_flags, &stmt, NULL);
+    int rc;
+    sqlite3_stmt *stmt = stmt_cache_acquire(conn, COMMAND_OPT_READ_SQL, &rc);
     if (rc != SQLITE_OK) {
         goto done;
     }
 
-    char *arg_uuid = parent_arg->uuid;
+    bce_str_t arg_uuid = parent_arg->uuid;
     sqlite3_bind_text(stmt, 1, arg_uuid, -1, NULL);
     for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
-        bce_command_opt_t *opt = bce_command_opt_new();
+        bce_command_opt_t *opt = bce_command_opt_new_in(parent_arg->arena);
         // co.uuid, co.cmd_arg_uuid, co.name
-        strncat(opt->uuid, (const char *) sqlite3_column_text(stmt, 0), UUID_FIELD_SIZE);
-        strncat(opt->cmd_arg_uuid, (const char *) sqlite3_column_text(stmt, 1), UUID_FIELD_SIZE);
-        strncat(opt->name, (const char *) sqlite3_column_text(stmt, 2), NAME_FIELD_SIZE);
+        opt->uuid = column_str(stmt, 0, opt->arena);
+        opt->cmd_arg_uuid = column_str(stmt, 1, opt->arena);
+        opt->name = column_str(stmt, 2, opt->arena);
         ll_append_item(parent_arg->opts, opt);
     }
 
     done:
-    if (stmt) {
-        sqlite3_finalize(stmt);
+    stmt_cache_release(stmt);
+    return err;
+}
+
+/*
+ * Load a command and all of its descendents, using a fixed number of queries
+ * (rather than several queries per node, like `db_query_command()`).
+ */
+bce_error_t db_query_command_tree(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name) {
+    if (!conn) {
+        return ERR_NO_DATABASE_CONNECTION;
+    }
+    if (!cmd || !command_name) {
+        return ERR_INVALID_CMD;
+    }
+
+    bce_error_t err = ERR_NONE;
+    sqlite3_stmt *stmt = NULL;
+    hash_map_t *commands = NULL;
+    hash_map_t *args = NULL;
+
+    // find the root command
+    err = read_root_command(conn, cmd, command_name);
+    if ((err != ERR_NONE) || (strlen(cmd->uuid) == 0)) {
+        goto done;
+    }
+
+    commands = hm_create(64);
+    args = hm_create(64);
+    if (!commands || !args) {
+        err = ERR_SQLITE_ERROR;
+        goto done;
+    }
+    hm_put(commands, cmd->uuid, cmd);
+
+    // sub-commands (parents are always read before their children)
+    int rc;
+    stmt = stmt_cache_acquire(conn, COMMAND_TREE_READ_SQL, &rc);
+    if (rc != SQLITE_OK) {
+        err = ERR_SQLITE_ERROR;
+        goto done;
+    }
+    sqlite3_bind_text(stmt, 1, cmd->uuid, -1, NULL);
+    for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
+        bce_command_t *parent_cmd = (bce_command_t *) hm_get(commands, (const char *) sqlite3_column_text(stmt, 2));
+        if (!parent_cmd) {
+            continue;
+        }
+        bce_command_t *sub_cmd = bce_command_new_in(parent_cmd->arena);
+        read_command_row(stmt, sub_cmd);
+        ll_append_item(parent_cmd->sub_commands, sub_cmd);
+        hm_put(commands, sub_cmd->uuid, sub_cmd);
+    }
+    stmt_cache_release(stmt);
+    stmt = NULL;
+
+    // aliases, args and opts for the whole tree
+    err = query_children(conn, COMMAND_TREE_ALIAS_READ_SQL, cmd->uuid, commands, read_alias_rows);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+    err = query_args(conn, COMMAND_TREE_ARG_READ_SQL, COMMAND_TREE_OPT_READ_SQL, cmd->uuid, commands, args);
+
+    done:
+    stmt_cache_release(stmt);
+    commands = hm_destroy(commands);
+    args = hm_destroy(args);
+    return err;
+}
+
+/*
+ * Load a command, following only the sub-commands found in `word_list` (the words on the command line).
+ * The deepest sub-command on the path also gets its children (with their aliases and args, but no sub-commands).
+ * The cost is proportional to the depth of the command line, rather than the size of the tree.
+ */
+bce_error_t db_query_command_path(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name,
+                                  const linked_list_t *word_list) {
+    if (!conn) {
+        return ERR_NO_DATABASE_CONNECTION;
+    }
+    if (!cmd || !command_name) {
+        return ERR_INVALID_CMD;
+    }
+
+    bce_error_t err = ERR_NONE;
+    sqlite3_stmt *sub_cmd_stmt = NULL;
+    hash_map_t *path = NULL;
+    hash_map_t *children = NULL;
+    hash_map_t *args = NULL;
+    hash_map_t *word_set = NULL;
+
+    // find the root command
+    err = read_root_command(conn, cmd, command_name);
+    if ((err != ERR_NONE) || (strlen(cmd->uuid) == 0)) {
+        goto done;
     }
+
+    path = hm_create(16);
+    args = hm_create(64);
+    word_set = word_set_create(word_list);
+    if (!path || !args || (word_list && !word_set)) {
+        err = ERR_SQLITE_ERROR;
+        goto done;
+    }
+    hm_put(path, cmd->uuid, cmd);
+    err = query_children(conn, COMMAND_ALIAS_READ_SQL, cmd->uuid, path, read_alias_rows);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+
+    int rc;
+    sub_cmd_stmt = stmt_cache_acquire(conn, SUB_COMMAND_READ_SQL, &rc);
+    if (rc != SQLITE_OK) {
+        err = ERR_SQLITE_ERROR;
+        goto done;
+    }
+
+    // walk down the sub-commands that are present on the command line
+    bce_command_t *current_cmd = cmd;
+    while (current_cmd) {
+        err = query_args(conn, COMMAND_ARG_READ_SQL, COMMAND_ARG_OPT_READ_SQL, current_cmd->uuid, path, args);
+        if (err != ERR_NONE) {
+            goto done;
+        }
+
+        children = hm_create(16);
+        if (!children) {
+            err = ERR_SQLITE_ERROR;
+            goto done;
+        }
+        sqlite3_reset(sub_cmd_stmt);
+        sqlite3_bind_text(sub_cmd_stmt, 1, current_cmd->uuid, -1, NULL);
+        for (int step = sqlite3_step(sub_cmd_stmt); step == SQLITE_ROW; step = sqlite3_step(sub_cmd_stmt)) {
+            bce_command_t *sub_cmd = bce_command_new_in(current_cmd->arena);
+            read_command_row(sub_cmd_stmt, sub_cmd);
+            ll_append_item(current_cmd->sub_commands, sub_cmd);
+            hm_put(children, sub_cmd->uuid, sub_cmd);
+        }
+        err = query_children(conn, SUB_COMMAND_ALIAS_READ_SQL, current_cmd->uuid, children, read_alias_rows);
+        if (err != ERR_NONE) {
+            goto done;
+        }
+
+        // keep only the first sub-command found on the command line (like `prune_command()`)
+        bce_command_t *next_cmd = NULL;
+        for (linked_list_node_t *node = current_cmd->sub_commands->head; node != NULL; node = node->next) {
+            bce_command_t *sub_cmd = (bce_command_t *) node->data;
+            if (bce_command_is_on_cmdline(sub_cmd, word_set)) {
+                next_cmd = sub_cmd;
+                break;
+            }
+        }
+        if (!next_cmd) {
+            // the deepest command: its children stay, without their own sub-commands
+            err = query_args(conn, SUB_COMMAND_ARG_READ_SQL, SUB_COMMAND_OPT_READ_SQL, current_cmd->uuid, children,
+                             args);
+            break;
+        }
+        children = hm_destroy(children);
+        linked_list_node_t *node = current_cmd->sub_commands->head;
+        while (node) {
+            linked_list_node_t *next_node = node->next;
+            if (node->data != next_cmd) {
+                ll_remove_item(current_cmd->sub_commands, node);
+            }
+            node = next_node;
+        }
+        hm_put(path, next_cmd->uuid, next_cmd);
+        current_cmd = next_cmd;
+    }
+
+    done:
+    stmt_cache_release(sub_cmd_stmt);
+    path = hm_destroy(path);
+    children = hm_destroy(children);
+    args = hm_destroy(args);
+    word_set = hm_destroy(word_set);
     return err;
 }
 
+/*
+ * Check if the command (or one of its aliases) is one of the words on the command line.
+ */
+bool bce_command_is_on_cmdline(const bce_command_t *cmd, const hash_map_t *word_set) {
+    if (!cmd || !word_set) {
+        return false;
+    }
+    if (is_word_in_set(word_set, cmd->name)) {
+        return true;
+    }
+    if (cmd->aliases) {
+        for (linked_list_node_t *node = cmd->aliases->head; node != NULL; node = node->next) {
+            const bce_command_alias_t *alias = (const bce_command_alias_t *) node->data;
+            if (is_word_in_set(word_set, alias->name)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * Find the root command, by name or alias. `cmd` is left empty if not found.
+ */
+static bce_error_t read_root_command(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name) {
+    int rc;
+    sqlite3_stmt *stmt = stmt_cache_acquire(conn, COMMAND_READ_SQL, &rc);
+    if (rc != SQLITE_OK) {
+        return ERR_SQLITE_ERROR;
+    }
+    sqlite3_bind_text(stmt, 1, command_name, -1, NULL);
+    sqlite3_bind_text(stmt, 2, command_name, -1, NULL);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        read_command_row(stmt, cmd);
+    }
+    stmt_cache_release(stmt);
+    return ERR_NONE;
+}
+
+/*
+ * Run a query (bound to `uuid`), and attach each row to its parent found in `parents`.
+ */
+static bce_error_t query_children(struct sqlite3 *conn, const char *sql, const char *uuid, const hash_map_t *parents,
+                                  void (*read_rows)(sqlite3_stmt *, const hash_map_t *, hash_map_t *)) {
+    int rc;
+    sqlite3_stmt *stmt = stmt_cache_acquire(conn, sql, &rc);
+    if (rc != SQLITE_OK) {
+        return ERR_SQLITE_ERROR;
+    }
+    sqlite3_bind_text(stmt, 1, uuid, -1, NULL);
+    read_rows(stmt, parents, NULL);
+    stmt_cache_release(stmt);
+    return ERR_NONE;
+}
+
+/*
+ * Run the arg and opt queries (bound to `uuid`), attaching args to `commands` and opts to their args.
+ */
+static bce_error_t query_args(struct sqlite3 *conn, const char *arg_sql, const char *opt_sql, const char *uuid,
+                              const hash_map_t *commands, hash_map_t *args) {
+    int rc;
+    sqlite3_stmt *stmt = stmt_cache_acquire(conn, arg_sql, &rc);
+    if (rc != SQLITE_OK) {
+        return ERR_SQLITE_ERROR;
+    }
+    sqlite3_bind_text(stmt, 1, uuid, -1, NULL);
+    read_arg_rows(stmt, commands, args);
+    stmt_cache_release(stmt);
+
+    return query_children(conn, opt_sql, uuid, args, read_opt_rows);
+}
+
+static void read_alias_rows(sqlite3_stmt *stmt, const hash_map_t *commands, hash_map_t *unused) {
+    for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
+        bce_command_t *parent_cmd = (bce_command_t *) hm_get(commands, (const char *) sqlite3_column_text(stmt, 1));
+        if (!parent_cmd) {
+            continue;
+        }
+        bce_command_alias_t *alias = bce_command_alias_new_in(parent_cmd->arena);
+        read_alias_row(stmt, alias);
+        ll_append_item(parent_cmd->aliases, alias);
+    }
+}
+
+static void read_arg_rows(sqlite3_stmt *stmt, const hash_map_t *commands, hash_map_t *args) {
+    for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
+        bce_command_t *parent_cmd = (bce_command_t *) hm_get(commands, (const char *) sqlite3_column_text(stmt, 1));
+        if (!parent_cmd) {
+            continue;
+        }
+        bce_command_arg_t *arg = bce_command_arg_new_in(parent_cmd->arena);
+        read_arg_row(stmt, arg);
+        ll_append_item(parent_cmd->args, arg);
+        hm_put(args, arg->uuid, arg);
+    }
+}
+
+static void read_opt_rows(sqlite3_stmt *stmt, const hash_map_t *args, hash_map_t *unused) {
+    for (int step = sqlite3_step(stmt); step == SQLITE_ROW; step = sqlite3_step(stmt)) {
+        bce_command_arg_t *parent_arg = (bce_command_arg_t *) hm_get(args, (const char *) sqlite3_column_text(stmt, 1));
+        if (!parent_arg) {
+            continue;
+        }
+        bce_command_opt_t *opt = bce_command_opt_new_in(parent_arg->arena);
+        read_opt_row(stmt, opt);
+        ll_append_item(parent_arg->opts, opt);
+    }
+}
+
+/* c.uuid, c.name, c.parent_cmd */
+static void read_command_row(sqlite3_stmt *stmt, bce_command_t *cmd) {
+    cmd->uuid = column_str(stmt, 0, cmd->arena);
+    cmd->name = column_str(stmt, 1, cmd->arena);
+    if (sqlite3_column_type(stmt, 2) == SQLITE_TEXT) {
+        cmd->parent_cmd_uuid = column_str(stmt, 2, cmd->arena);
+    }
+}
+
+/* a.uuid, a.cmd_uuid, a.name */
+static void read_alias_row(sqlite3_stmt *stmt, bce_command_alias_t *alias) {
+    alias->uuid = column_str(stmt, 0, alias->arena);
+    alias->cmd_uuid = column_str(stmt, 1, alias->arena);
+    alias->name = column_str(stmt, 2, alias->arena);
+}
+
+/* ca.uuid, ca.cmd_uuid, ca.arg_type, ca.description, ca.long_name, ca.short_name */
+static void read_arg_row(sqlite3_stmt *stmt, bce_command_arg_t *arg) {
+    arg->uuid = column_str(stmt, 0, arg->arena);
+    arg->cmd_uuid = column_str(stmt, 1, arg->arena);
+    arg->arg_type = column_str(stmt, 2, arg->arena);
+    if (sqlite3_column_type(stmt, 3) == SQLITE_TEXT) {
+        arg->description = column_str(stmt, 3, arg->arena);
+    }
+    if (sqlite3_column_type(stmt, 4) == SQLITE_TEXT) {
+        arg->long_name = column_str(stmt, 4, arg->arena);
+    }
+    if (sqlite3_column_type(stmt, 5) == SQLITE_TEXT) {
+        arg->short_name = column_str(stmt, 5, arg->arena);
+    }
+}
+
+/* co.uuid, co.cmd_arg_uuid, co.name */
+static void read_opt_row(sqlite3_stmt *stmt, bce_command_opt_t *opt) {
+    opt->uuid = column_str(stmt, 0, opt->arena);
+    opt->cmd_arg_uuid = column_str(stmt, 1, opt->arena);
+    opt->name = column_str(stmt, 2, opt->arena);
+}
+
+/* A text column, interned in the arena's pool (NULL is the empty string) */
+static bce_str_t column_str(sqlite3_stmt *stmt, int col, arena_t *arena) {
+    const char *text = (const char *) sqlite3_column_text(stmt, col);
+    return str_pool_intern_n(arena, text, (size_t) sqlite3_column_bytes(stmt, col));
+}
+
 bce_command_t *bce_command_new(void) {
-    bce_command_t *cmd = malloc(sizeof(bce_command_t));
+    return bce_command_new_in(NULL);
+}
+
+bce_command_alias_t *bce_command_alias_new(void) {
+    return bce_command_alias_new_in(NULL);
+}
+
+bce_command_arg_t *bce_command_arg_new(void) {
+    return bce_command_arg_new_in(NULL);
+}
+
+bce_command_opt_t *bce_command_opt_new(void) {
+    return bce_command_opt_new_in(NULL);
+}
+
+bce_command_t *bce_command_new_in(arena_t *arena) {
+    bce_command_t *cmd = arena_alloc(arena, sizeof(bce_command_t));
     if (cmd) {
-        memset(cmd->uuid, 0, UUID_FIELD_SIZE + 1);
-        memset(cmd->parent_cmd_uuid, 0, UUID_FIELD_SIZE + 1);
-        memset(cmd->name, 0, NAME_FIELD_SIZE + 1);
+        cmd->uuid = bce_str_empty();
+        cmd->parent_cmd_uuid = bce_str_empty();
+        cmd->name = bce_str_empty();
 
         ll_free_node_func free_command = (ll_free_node_func) &bce_command_free;
         ll_free_node_func free_alias = (ll_free_node_func) &bce_command_alias_free;
         ll_free_node_func free_arg = (ll_free_node_func) &bce_command_arg_free;
 
-        cmd->aliases = ll_create(free_alias);
-        cmd->sub_commands = ll_create(free_command);
-        cmd->args = ll_create(free_arg);
+        cmd->arena = arena;
+        cmd->aliases = ll_create_in(arena, free_alias);
+        cmd->sub_commands = ll_create_in(arena, free_command);
+        cmd->args = ll_create_in(arena, free_arg);
         cmd->is_present_on_cmdline = false;
+        cmd->sub_command_index = NULL;
     }
     return cmd;
 }
 
-bce_command_alias_t *bce_command_alias_new(void) {
-    bce_command_alias_t *alias = malloc(sizeof(bce_command_alias_t));
+bce_command_alias_t *bce_command_alias_new_in(arena_t *arena) {
+    bce_command_alias_t *alias = arena_alloc(arena, sizeof(bce_command_alias_t));
     if (alias) {
-        memset(alias->uuid, 0, UUID_FIELD_SIZE + 1);
-        memset(alias->cmd_uuid, 0, UUID_FIELD_SIZE + 1);
-        memset(alias->name, 0, NAME_FIELD_SIZE + 1);
+        alias->uuid = bce_str_empty();
+        alias->cmd_uuid = bce_str_empty();
+        alias->name = bce_str_empty();
+        alias->arena = arena;
     }
     return alias;
 }
 
-bce_command_arg_t *bce_command_arg_new(void) {
-    bce_command_arg_t *arg = malloc(sizeof(bce_command_arg_t));
+bce_command_arg_t *bce_command_arg_new_in(arena_t *arena) {
+    bce_command_arg_t *arg = arena_alloc(arena, sizeof(bce_command_arg_t));
     if (arg) {
-        memset(arg->uuid, 0, UUID_FIELD_SIZE + 1);
-        memset(arg->cmd_uuid, 0, UUID_FIELD_SIZE + 1);
-        memset(arg->arg_type, 0, CMD_TYPE_FIELD_SIZE + 1);
-        memset(arg->description, 0, DESCRIPTION_FIELD_SIZE + 1);
-        memset(arg->long_name, 0, NAME_FIELD_SIZE + 1);
-        memset(arg->short_name, 0, SHORTNAME_FIELD_SIZE + 1);
+        arg->uuid = bce_str_empty();
+        arg->cmd_uuid = bce_str_empty();
+        arg->arg_type = bce_str_empty();
+        arg->description = bce_str_empty();
+        arg->long_name = bce_str_empty();
+        arg->short_name = bce_str_empty();
         arg->is_present_on_cmdline = false;
+        arg->arena = arena;
 
         ll_free_node_func free_opt = (ll_free_node_func) bce_command_opt_free;
-        arg->opts = ll_create(free_opt);
+        arg->opts = ll_create_in(arena, free_opt);
     }
     return arg;
 }
 
-bce_command_opt_t *bce_command_opt_new(void) {
-    bce_command_opt_t *opt = malloc(sizeof(bce_command_opt_t));
+bce_command_opt_t *bce_command_opt_new_in(arena_t *arena) {
+    bce_command_opt_t *opt = arena_alloc(arena, sizeof(bce_command_opt_t));
     if (opt) {
-        memset(opt->uuid, 0, UUID_FIELD_SIZE + 1);
-        memset(opt->name, 0, NAME_FIELD_SIZE + 1);
-        memset(opt->cmd_arg_uuid, 0, UUID_FIELD_SIZE + 1);
+        opt->uuid = bce_str_empty();
+        opt->name = bce_str_empty();
+        opt->cmd_arg_uuid = bce_str_empty();
+        opt->arena = arena;
     }
     return opt;
 }
 
+/*
+ * The `*_free()` functions ignore objects allocated from an arena; those are released with the arena.
+ */
 bce_command_t *bce_command_free(bce_command_t *cmd) {
-    if (!cmd) {
+    if (!cmd || cmd->arena) {
         return NULL;
     }
 
@@ -421,13 +864,14 @@ bce_command_t *bce_command_free(bce_command_t *cmd) {
     cmd->aliases = ll_destroy(cmd->aliases);
     cmd->sub_commands = ll_destroy(cmd->sub_commands);
     cmd->args = ll_destroy(cmd->args);
+    cmd->sub_command_index = name_index_destroy(cmd->sub_command_index);
 
     free(cmd);
     return NULL;
 }
 
 bce_command_alias_t *bce_command_alias_free(bce_command_alias_t *alias) {
-    if (!alias) {
+    if (!alias || alias->arena) {
         return NULL;
     }
 
@@ -436,7 +880,7 @@ bce_command_alias_t *bce_command_alias_free(bce_command_alias_t *alias) {
 }
 
 bce_command_arg_t *bce_command_arg_free(bce_command_arg_t *arg) {
-    if (!arg) {
+    if (!arg || arg->arena) {
         return NULL;
     }
 
@@ -447,7 +891,7 @@ bce_command_arg_t *bce_command_arg_free(bce_command_arg_t *arg) {
 }
 
 bce_command_opt_t *bce_command_opt_free(bce_command_opt_t *opt) {
-    if (!opt) {
+    if (!opt || opt->arena) {
         return NULL;
     }
 
@@ -457,71 +901,271 @@ bce_command_opt_t *bce_command_opt_free(bce_command_opt_t *opt) {
     return NULL;
 }
 
-bce_error_t db_store_command(struct sqlite3 *conn, const bce_command_t *completion_command) {
-    if (!completion_command) {
-        return ERR_INVALID_CMD;
+/*
+ * Deep copy a command hierarchy.
+ * The copy is independent of the source, so it can be pruned without affecting the original.
+ */
+bce_command_t *bce_command_clone(const bce_command_t *cmd) {
+    bce_command_t *copy = clone_command_node(cmd, NULL);
+    if (!copy) {
+        return NULL;
     }
 
-    sqlite3_stmt *stmt;
-    int rc;
+    if (cmd->sub_commands) {
+        for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+            bce_command_t *sub_copy = bce_command_clone((const bce_command_t *) node->data);
+            ll_append_item(copy->sub_commands, sub_copy);
+        }
+    }
 
-    // insert the command
-    rc = sqlite3_prepare_v3(conn, COMMAND_WRITE_SQL, -1, 0, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        goto done;
+    return copy;
+}
+
+/*
+ * Copy only the path of sub-commands found in `word_list`, plus the children of the deepest one
+ * (see `db_query_command_path()`).
+ */
+bce_command_t *bce_command_clone_path(const bce_command_t *cmd, const linked_list_t *word_list) {
+    return bce_command_clone_path_in(NULL, cmd, word_list);
+}
+
+bce_command_t *bce_command_clone_path_in(arena_t *arena, const bce_command_t *cmd, const linked_list_t *word_list) {
+    return bce_command_clone_path_prefix_in(arena, cmd, word_list, bce_str_empty());
+}
+
+bce_command_t *bce_command_clone_path_prefix_in(arena_t *arena, const bce_command_t *cmd,
+                                                const linked_list_t *word_list, bce_str_t prefix) {
+    hash_map_t *word_set = word_set_create(word_list);
+    bce_command_t *copy = clone_command_path(cmd, arena, word_set, word_list, prefix ? prefix : bce_str_empty());
+    word_set = hm_destroy(word_set);
+    return copy;
+}
+
+static bce_command_t *clone_command_path(const bce_command_t *cmd, arena_t *arena, const hash_map_t *word_set,
+                                        const linked_list_t *word_list, bce_str_t prefix) {
+    bce_command_t *copy = clone_command_node(cmd, arena);
+    if (!copy || !cmd->sub_commands) {
+        return copy;
     }
-    sqlite3_bind_text(stmt, 1, completion_command->uuid, -1, NULL);
-    sqlite3_bind_text(stmt, 2, completion_command->name, -1, NULL);
-    if (strlen(completion_command->parent_cmd_uuid) > 0) {
-        sqlite3_bind_text(stmt, 3, completion_command->parent_cmd_uuid, -1, NULL);
-    } else {
-        sqlite3_bind_null(stmt, 3);
+
+    const bce_command_t *next_cmd = find_sub_command_on_cmdline(cmd, word_set, word_list);
+    if (next_cmd) {
+        ll_append_item(copy->sub_commands, clone_command_path(next_cmd, arena, word_set, word_list, prefix));
+        return copy;
     }
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE) {
-        goto done;
+    // if none matches, the word may be misspelled: copy them all to look for the name it was meant to be
+    if (cmd->sub_command_index && (bce_str_len(prefix) > 0) && clone_matching_sub_commands(cmd, copy, prefix)) {
+        return copy;
+    }
+    for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+        ll_append_item(copy->sub_commands, clone_command_node((const bce_command_t *) node->data, arena));
     }
+    return copy;
+}
 
-    // insert the aliases
-    if (completion_command->aliases) {
-        for (linked_list_node_t *node = completion_command->aliases->head; node != NULL; node = node->next) {
-            bce_command_alias_t *alias = (bce_command_alias_t *) node->data;
-            rc = db_store_command_alias(conn, alias);
-            if (rc != SQLITE_OK) {
-                goto done;
+/*
+ * The first sub-command (in name order, like the lists loaded from the database) that is on the command line.
+ * With an index, only the sub-commands indexed under one of the words are checked.
+ */
+static const bce_command_t *find_sub_command_on_cmdline(const bce_command_t *cmd, const hash_map_t *word_set,
+                                                        const linked_list_t *word_list) {
+    if (!cmd->sub_command_index || !word_list) {
+        for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+            const bce_command_t *sub_cmd = (const bce_command_t *) node->data;
+            if (bce_command_is_on_cmdline(sub_cmd, word_set)) {
+                return sub_cmd;
             }
         }
+        return NULL;
     }
 
-    // insert each sub-command
-    if (completion_command->sub_commands) {
-        for (linked_list_node_t *node = completion_command->sub_commands->head; node != NULL; node = node->next) {
-            bce_command_t *subcmd = (bce_command_t *) node->data;
-            rc = db_store_command(conn, subcmd);
-            if (rc != SQLITE_OK) {
-                goto done;
+    const name_index_t *index = cmd->sub_command_index;
+    const bce_command_t *found = NULL;
+    for (linked_list_node_t *node = word_list->head; node != NULL; node = node->next) {
+        bce_str_t word = (bce_str_t) node->data;
+        size_t first;
+        size_t count = name_index_find(index, word, bce_str_len(word), &first);
+        for (size_t i = first; i < first + count; i++) {
+            const bce_command_t *sub_cmd = (const bce_command_t *) index->entries[i].item;
+            if ((!found || (compare_command_names(&sub_cmd, &found) < 0))
+                && bce_command_is_on_cmdline(sub_cmd, word_set)) {
+                found = sub_cmd;
             }
         }
     }
+    return found;
+}
 
-    // insert each of the command_args
-    if (completion_command->args) {
-        for (linked_list_node_t *node = completion_command->args->head; node != NULL; node = node->next) {
-            bce_command_arg_t *arg = (bce_command_arg_t *) node->data;
-            rc = db_store_command_arg(conn, arg);
-            if (rc != SQLITE_OK) {
-                goto done;
+/*
+ * Copy the sub-commands indexed under a name starting with `prefix`, once each and in name order.
+ * Returns false if there is none (or they can't be sorted).
+ */
+static bool clone_matching_sub_commands(const bce_command_t *cmd, bce_command_t *copy, bce_str_t prefix) {
+    const name_index_t *index = cmd->sub_command_index;
+    size_t first;
+    size_t count = name_index_find_prefix(index, prefix, bce_str_len(prefix), &first);
+    if (count == 0) {
+        return false;
+    }
+    const bce_command_t **matches = malloc(count * sizeof(bce_command_t *));
+    if (!matches) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        matches[i] = (const bce_command_t *) index->entries[first + i].item;
+    }
+    qsort(matches, count, sizeof(bce_command_t *), &compare_command_names);
+    for (size_t i = 0; i < count; i++) {
+        if ((i == 0) || (matches[i] != matches[i - 1])) {
+            ll_append_item(copy->sub_commands, clone_command_node(matches[i], copy->arena));
+        }
+    }
+    free(matches);
+    return true;
+}
+
+/* By name, then by address (so the entries for the same sub-command are adjacent) */
+static int compare_command_names(const void *a, const void *b) {
+    const bce_command_t *cmd_a = *(const bce_command_t *const *) a;
+    const bce_command_t *cmd_b = *(const bce_command_t *const *) b;
+    int result = strcmp(cmd_a->name, cmd_b->name);
+    if (result != 0) {
+        return result;
+    }
+    return (cmd_a < cmd_b) ? -1 : (cmd_a > cmd_b) ? 1 : 0;
+}
+
+bool bce_command_build_index(bce_command_t *cmd) {
+    if (!cmd) {
+        return false;
+    }
+    if (!cmd->sub_commands || (cmd->sub_commands->size == 0)) {
+        return true;
+    }
+
+    cmd->sub_command_index = name_index_destroy(cmd->sub_command_index);
+    name_index_t *index = name_index_create(cmd->sub_commands->size * 2);
+    if (!index) {
+        return false;
+    }
+    for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+        bce_command_t *sub_cmd = (bce_command_t *) node->data;
+        if (!index_sub_command(index, sub_cmd) || !bce_command_build_index(sub_cmd)) {
+            name_index_destroy(index);
+            return false;
+        }
+    }
+    name_index_sort(index);
+    cmd->sub_command_index = index;
+    return true;
+}
+
+void bce_command_free_index(bce_command_t *cmd) {
+    // only commands with sub-commands are indexed
+    if (!cmd || !cmd->sub_command_index) {
+        return;
+    }
+    cmd->sub_command_index = name_index_destroy(cmd->sub_command_index);
+    for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+        bce_command_free_index((bce_command_t *) node->data);
+    }
+}
+
+static bool index_sub_command(name_index_t *index, bce_command_t *sub_cmd) {
+    bool ok = true;
+    if (bce_str_len(sub_cmd->name) > 0) {
+        ok = name_index_add(index, sub_cmd->name, sub_cmd);
+    }
+    for (linked_list_node_t *node = sub_cmd->aliases->head; ok && (node != NULL); node = node->next) {
+        const bce_command_alias_t *alias = (const bce_command_alias_t *) node->data;
+        if (bce_str_len(alias->name) > 0) {
+            ok = name_index_add(index, alias->name, sub_cmd);
+        }
+    }
+    for (linked_list_node_t *node = sub_cmd->args->head; ok && (node != NULL); node = node->next) {
+        const bce_command_arg_t *arg = (const bce_command_arg_t *) node->data;
+        if (bce_str_len(arg->long_name) > 0) {
+            ok = name_index_add(index, arg->long_name, sub_cmd);
+        }
+        if (ok && (bce_str_len(arg->short_name) > 0)) {
+            ok = name_index_add(index, arg->short_name, sub_cmd);
+        }
+        for (linked_list_node_t *opt_node = arg->opts->head; ok && (opt_node != NULL); opt_node = opt_node->next) {
+            const bce_command_opt_t *opt = (const bce_command_opt_t *) opt_node->data;
+            if (bce_str_len(opt->name) > 0) {
+                ok = name_index_add(index, opt->name, sub_cmd);
             }
         }
     }
+    return ok;
+}
 
-    done:
-    sqlite3_finalize(stmt);
-    if ((rc == SQLITE_DONE) || (rc == SQLITE_OK)) {
-        return ERR_NONE;
-    } else {
-        return ERR_SQLITE_ERROR;
+/*
+ * Copy a command with its aliases and args, but not its sub-commands.
+ */
+static bce_command_t *clone_command_node(const bce_command_t *cmd, arena_t *arena) {
+    if (!cmd) {
+        return NULL;
+    }
+
+    bce_command_t *copy = bce_command_new_in(arena);
+    if (!copy) {
+        return NULL;
+    }
+    copy->uuid = str_pool_copy(copy->arena, cmd->uuid);
+    copy->name = str_pool_copy(copy->arena, cmd->name);
+    copy->parent_cmd_uuid = str_pool_copy(copy->arena, cmd->parent_cmd_uuid);
+    copy->is_present_on_cmdline = cmd->is_present_on_cmdline;
+
+    if (cmd->aliases) {
+        for (linked_list_node_t *node = cmd->aliases->head; node != NULL; node = node->next) {
+            const bce_command_alias_t *alias = (const bce_command_alias_t *) node->data;
+            bce_command_alias_t *alias_copy = bce_command_alias_new_in(arena);
+            alias_copy->uuid = str_pool_copy(alias_copy->arena, alias->uuid);
+            alias_copy->cmd_uuid = str_pool_copy(alias_copy->arena, alias->cmd_uuid);
+            alias_copy->name = str_pool_copy(alias_copy->arena, alias->name);
+            ll_append_item(copy->aliases, alias_copy);
+        }
+    }
+
+    if (cmd->args) {
+        for (linked_list_node_t *node = cmd->args->head; node != NULL; node = node->next) {
+            const bce_command_arg_t *arg = (const bce_command_arg_t *) node->data;
+            bce_command_arg_t *arg_copy = bce_command_arg_new_in(arena);
+            arg_copy->uuid = str_pool_copy(arg_copy->arena, arg->uuid);
+            arg_copy->cmd_uuid = str_pool_copy(arg_copy->arena, arg->cmd_uuid);
+            arg_copy->arg_type = str_pool_copy(arg_copy->arena, arg->arg_type);
+            arg_copy->description = str_pool_copy(arg_copy->arena, arg->description);
+            arg_copy->long_name = str_pool_copy(arg_copy->arena, arg->long_name);
+            arg_copy->short_name = str_pool_copy(arg_copy->arena, arg->short_name);
+            arg_copy->is_present_on_cmdline = arg->is_present_on_cmdline;
+            if (arg->opts) {
+                for (linked_list_node_t *opt_node = arg->opts->head; opt_node != NULL; opt_node = opt_node->next) {
+                    const bce_command_opt_t *opt = (const bce_command_opt_t *) opt_node->data;
+                    bce_command_opt_t *opt_copy = bce_command_opt_new_in(arena);
+                    opt_copy->uuid = str_pool_copy(opt_copy->arena, opt->uuid);
+                    opt_copy->cmd_arg_uuid = str_pool_copy(opt_copy->arena, opt->cmd_arg_uuid);
+                    opt_copy->name = str_pool_copy(opt_copy->arena, opt->name);
+                    ll_append_item(arg_copy->opts, opt_copy);
+                }
+            }
+            ll_append_item(copy->args, arg_copy);
+        }
     }
+
+    return copy;
+}
+
+bce_error_t db_store_command(struct sqlite3 *conn, const bce_command_t *completion_command) {
+    if (!completion_command) {
+        return ERR_INVALID_CMD;
+    }
+
+    // batched, parents first (see import_writer.h)
+    import_writer_t writer;
+    import_writer_init(&writer, conn);
+    import_writer_add_command(&writer, completion_command);
+    return import_writer_finish(&writer);
 }
 
 bce_error_t db_store_command_alias(struct sqlite3 *conn, const bce_command_alias_t *alias) {
@@ -533,7 +1177,7 @@ bce_error_t db_store_command_alias(struct sqlite3 *conn, const bce_command_alias
     int rc;
 
     // insert the alias
-    rc = sqlite3_prepare_v3(conn, COMMAND_ALIAS_WRITE_SQL, -1, 0, &stmt, NULL);
+    stmt = stmt_cache_acquire(conn, COMMAND_ALIAS_WRITE_SQL, &rc);
     // uuid, cmd_uuid, arg_type, description, long_name, short_name
     if (rc != SQLITE_OK) {
         goto done;
@@ -547,7 +1191,7 @@ bce_error_t db_store_command_alias(struct sqlite3 *conn, const bce_command_alias
     }
 
     done:
-    sqlite3_finalize(stmt);
+    stmt_cache_release(stmt);
     if ((rc == SQLITE_DONE) || (rc == SQLITE_OK)) {
         return ERR_NONE;
     } else {
@@ -564,7 +1208,7 @@ bce_error_t db_store_command_arg(struct sqlite3 *conn, const bce_command_arg_t *
     int rc;
 
     // insert the arg
-    rc = sqlite3_prepare_v3(conn, COMMAND_ARG_WRITE_SQL, -1, 0, &stmt, NULL);
+    stmt = stmt_cache_acquire(conn, COMMAND_ARG_WRITE_SQL, &rc);
     // uuid, cmd_uuid, arg_type, description, long_name, short_name
     if (rc != SQLITE_OK) {
         goto done;
@@ -604,7 +1248,7 @@ bce_error_t db_store_command_arg(struct sqlite3 *conn, const bce_command_arg_t *
     }
 
     done:
-    sqlite3_finalize(stmt);
+    stmt_cache_release(stmt);
     if ((rc == SQLITE_DONE) || (rc == SQLITE_OK)) {
         return ERR_NONE;
     } else {
@@ -621,7 +1265,7 @@ bce_error_t db_store_command_opt(struct sqlite3 *conn, const bce_command_opt_t *
     int rc;
 
     // insert the opt
-    rc = sqlite3_prepare_v3(conn, COMMAND_OPT_WRITE_SQL, -1, 0, &stmt, NULL);
+    stmt = stmt_cache_acquire(conn, COMMAND_OPT_WRITE_SQL, &rc);
     // uuid, cmd_arg_uuid, name
     if (rc != SQLITE_OK) {
         goto done;
@@ -635,7 +1279,7 @@ bce_error_t db_store_command_opt(struct sqlite3 *conn, const bce_command_opt_t *
     }
 
     done:
-    sqlite3_finalize(stmt);
+    stmt_cache_release(stmt);
     if ((rc == SQLITE_DONE) || (rc == SQLITE_OK)) {
         return ERR_NONE;
     } else {
@@ -652,7 +1296,7 @@ bce_error_t db_delete_command(struct sqlite3 *conn, const char *command_name) {
     int rc;
 
     // delete the command (CASCADE should happen for all FKs)
-    rc = sqlite3_prepare_v3(conn, COMMAND_DELETE_SQL, -1, 0, &stmt, NULL);
+    stmt = stmt_cache_acquire(conn, COMMAND_DELETE_SQL, &rc);
     if (rc != SQLITE_OK) {
         goto done;
     }
@@ -663,7 +1307,7 @@ bce_error_t db_delete_command(struct sqlite3 *conn, const char *command_name) {
     }
 
     done:
-    sqlite3_finalize(stmt);
+    stmt_cache_release(stmt);
     if ((rc == SQLITE_DONE) || (rc == SQLITE_OK)) {
         return ERR_NONE;
     } else {
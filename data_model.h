@@ -3,51 +3,66 @@
 
 #include <stdbool.h>
 #include <sqlite3.h>
+#include "arena.h"
+#include "str_pool.h"
 #include "linked_list.h"
+#include "hash_map.h"
+#include "name_index.h"
 #include "error.h"
 
 #define DB_SCHEMA_VERSION      1
 
+// sizes of the buffers for generated uuids and names read from the CLI (the model strings have no limit)
 #define UUID_FIELD_SIZE        36
 #define NAME_FIELD_SIZE        50
-#define SHORTNAME_FIELD_SIZE   5
-#define CMD_TYPE_FIELD_SIZE    20
-#define DESCRIPTION_FIELD_SIZE 1024
 
 // TODO: Figure out the proper location for the database file
 #define BCE_DB_FILENAME "completion.db"
-
+#define BCE_SNAPSHOT_FILENAME "completion.snapshot"
+#define BCE_USAGE_FILENAME "completion.usage"
+#define BCE_USAGE_LOG_FILENAME "completion.usage.log"
+#define BCE_HISTORY_INDEX_FILENAME "completion.history"
+
+/*
+ * Strings are interned in the pool of the object's arena (see str_pool.h); they are never NULL.
+ * Set them with `str_pool_intern(obj->arena, ...)`.
+ */
 typedef struct bce_command_t {
-    char uuid[UUID_FIELD_SIZE + 1];
-    char name[NAME_FIELD_SIZE + 1];
-    char parent_cmd_uuid[UUID_FIELD_SIZE + 1];
+    bce_str_t uuid;
+    bce_str_t name;
+    bce_str_t parent_cmd_uuid;
     struct linked_list_t *aliases;          /* bce_command_alias_t */
     struct linked_list_t *sub_commands;     /* bce_command_t */
     struct linked_list_t *args              /* bce_command_arg_t */;
     bool is_present_on_cmdline;
+    name_index_t *sub_command_index;        /* see `bce_command_build_index()`; NULL if not built */
+    arena_t *arena;                         /* NULL if allocated on the heap */
 } bce_command_t;
 
 typedef struct bce_command_alias_t {
-    char uuid[UUID_FIELD_SIZE + 1];
-    char cmd_uuid[UUID_FIELD_SIZE + 1];
-    char name[NAME_FIELD_SIZE + 1];
+    bce_str_t uuid;
+    bce_str_t cmd_uuid;
+    bce_str_t name;
+    arena_t *arena;
 } bce_command_alias_t;
 
 typedef struct bce_command_arg_t {
-    char uuid[UUID_FIELD_SIZE + 1];
-    char cmd_uuid[UUID_FIELD_SIZE + 1];
-    char arg_type[CMD_TYPE_FIELD_SIZE + 1];
-    char description[DESCRIPTION_FIELD_SIZE + 1];
-    char long_name[NAME_FIELD_SIZE + 1];
-    char short_name[SHORTNAME_FIELD_SIZE + 1];
+    bce_str_t uuid;
+    bce_str_t cmd_uuid;
+    bce_str_t arg_type;
+    bce_str_t description;
+    bce_str_t long_name;
+    bce_str_t short_name;
     bool is_present_on_cmdline;
     struct linked_list_t *opts;
+    arena_t *arena;
 } bce_command_arg_t;
 
 typedef struct bce_command_opt_t {
-    char uuid[UUID_FIELD_SIZE + 1];
-    char cmd_arg_uuid[UUID_FIELD_SIZE + 1];
-    char name[NAME_FIELD_SIZE + 1];
+    bce_str_t uuid;
+    bce_str_t cmd_arg_uuid;
+    bce_str_t name;
+    arena_t *arena;
 } bce_command_opt_t;
 
 bce_command_t *bce_command_new(void);
@@ -58,6 +73,18 @@ bce_command_arg_t *bce_command_arg_new(void);
 
 bce_command_opt_t *bce_command_opt_new(void);
 
+/*
+ * Same as the `*_new()` functions, but allocated from `arena` (along with their lists).
+ * Children should be created in the same arena; the `*_free()` functions leave arena objects alone.
+ */
+bce_command_t *bce_command_new_in(arena_t *arena);
+
+bce_command_alias_t *bce_command_alias_new_in(arena_t *arena);
+
+bce_command_arg_t *bce_command_arg_new_in(arena_t *arena);
+
+bce_command_opt_t *bce_command_opt_new_in(arena_t *arena);
+
 bce_command_t *bce_command_free(bce_command_t *cmd);
 
 bce_command_alias_t *bce_command_alias_free(bce_command_alias_t *alias);
@@ -66,12 +93,50 @@ bce_command_arg_t *bce_command_arg_free(bce_command_arg_t *arg);
 
 bce_command_opt_t *bce_command_opt_free(bce_command_opt_t *opt);
 
+/* Deep copy a command hierarchy (aliases, sub-commands, args, opts) */
+bce_command_t *bce_command_clone(const bce_command_t *cmd);
+
+/* Deep copy of only the sub-commands in `word_list` (see `db_query_command_path()`) */
+bce_command_t *bce_command_clone_path(const bce_command_t *cmd, const linked_list_t *word_list);
+
+bce_command_t *bce_command_clone_path_in(arena_t *arena, const bce_command_t *cmd, const linked_list_t *word_list);
+
+/*
+ * Same as `bce_command_clone_path_in()`, but only the children of the deepest sub-command that have a name
+ * starting with `prefix` are copied (see `bce_command_build_index()`). Without an index, or if none matches, every
+ * child is copied.
+ */
+bce_command_t *bce_command_clone_path_prefix_in(arena_t *arena, const bce_command_t *cmd,
+                                                const linked_list_t *word_list, bce_str_t prefix);
+
+/*
+ * Index the sub-commands of every command in the tree (for trees kept between requests, e.g. in `completion_cache_t`).
+ * A sub-command is indexed under its name and aliases, and the names of its args and opts: every name
+ * that could be recommended for it. The tree must not be modified afterwards.
+ * The indexes are on the heap: `bce_command_free()` releases them for a heap tree, `bce_command_free_index()`
+ * for a tree in an arena.
+ */
+bool bce_command_build_index(bce_command_t *cmd);
+
+/* Release the sub-command indexes of every command in the tree (see `bce_command_build_index()`) */
+void bce_command_free_index(bce_command_t *cmd);
+
+/* Check if the command, or one of its aliases, is in `word_set` (see `word_set_create()`) */
+bool bce_command_is_on_cmdline(const bce_command_t *cmd, const hash_map_t *word_set);
+
 /* Query to root command names stored in SQLite */
 bce_error_t db_query_root_command_names(struct sqlite3 *conn, linked_list_t *cmd_names);
 
 /* Query a specific command in SQLite */
 bce_error_t db_query_command(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name);
 
+/* Query a specific command and all of its descendents, in a fixed number of queries */
+bce_error_t db_query_command_tree(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name);
+
+/* Query a specific command, following only the sub-commands in `word_list` (the words on the command line) */
+bce_error_t db_query_command_path(struct sqlite3 *conn, bce_command_t *cmd, const char *command_name,
+                                  const linked_list_t *word_list);
+
 /* Query the command aliases */
 bce_error_t db_query_command_aliases(struct sqlite3 *conn, bce_command_t *parent_cmd);
 
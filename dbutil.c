@@ -1,10 +1,20 @@
 #include "dbutil.h"
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <sqlite3.h>
 #include "error.h"
 #include "data_model.h"
+#include "stmt_cache.h"
+
+// see https://www.sqlite.org/fileformat.html#the_database_header
+#define DB_HEADER_SIZE                  100
+#define DB_HEADER_USER_VERSION_OFFSET   60
 
 static const char *SCHEMA_VERSION_SQL =
         " PRAGMA user_version ";
@@ -117,7 +127,7 @@ sqlite3 *db_open_with_xa(const char *filename, int *rc) {
     int schema_version = db_get_schema_version(conn);
     if (schema_version == 0) {
         // create the schema
-        if (!db_create_schema(conn)) {
+        if (db_create_schema(conn) != ERR_NONE) {
             fprintf(stderr, "Unable to create database schema. database: %s\n", filename);
             return NULL;
         }
@@ -139,6 +149,107 @@ sqlite3 *db_open_with_xa(const char *filename, int *rc) {
     return conn;
 }
 
+/*
+ * Open the database for completion only: read-only, no mutexes, no pragma writes and no schema checks.
+ * Not `immutable`: an import can commit or checkpoint while this connection reads, and SQLite must see it.
+ */
+sqlite3 *db_open_readonly(const char *filename, int *result) {
+    sqlite3 *conn = NULL;
+    char *uri = db_filename_to_uri(filename);
+    if (!uri) {
+        *result = SQLITE_NOMEM;
+        return NULL;
+    }
+
+    *result = sqlite3_open_v2(uri, &conn, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI, NULL);
+    free(uri);
+    if (*result != SQLITE_OK) {
+        sqlite3_close(conn);
+        return NULL;
+    }
+
+    // map the file, rather than copying pages into the page cache
+    sqlite3_int64 mmap_size = DB_MMAP_SIZE;
+    sqlite3_file_control(conn, "main", SQLITE_FCNTL_MMAP_SIZE, &mmap_size);
+
+    *result = SQLITE_OK;
+    return conn;
+}
+
+/*
+ * Build a read-only `file:` URI for `sqlite3_open_v2()`.
+ * Caller should `free()` the result.
+ */
+char *db_filename_to_uri(const char *filename) {
+    static const char *hex = "0123456789ABCDEF";
+    const char *params = "?mode=ro";
+    size_t len = strlen(filename);
+    char *uri = malloc(strlen("file:") + (len * 3) + strlen(params) + 1);
+    if (!uri) {
+        return NULL;
+    }
+
+    char *p = uri;
+    p += sprintf(p, "file:");
+    for (const char *c = filename; *c != '\0'; c++) {
+        if ((*c == '%') || (*c == '?') || (*c == '#')) {
+            *p++ = '%';
+            *p++ = hex[(unsigned char) *c >> 4];
+            *p++ = hex[(unsigned char) *c & 0x0f];
+        } else {
+            *p++ = *c;
+        }
+    }
+    strcpy(p, params);
+    return uri;
+}
+
+/*
+ * Check for un-checkpointed changes (a non-empty `-wal` file next to the database).
+ */
+bool db_has_wal_content(const char *filename) {
+    char wal_filename[FILENAME_MAX + 1];
+    snprintf(wal_filename, sizeof(wal_filename), "%s-wal", filename);
+    struct stat wal_stat;
+    return (stat(wal_filename, &wal_stat) == 0) && (wal_stat.st_size > 0);
+}
+
+/*
+ * Read the schema version (`PRAGMA user_version`) from the database file header, without opening a connection.
+ * Returns -1 if the file is missing, 0 for an empty file. Changes still in the WAL are not seen.
+ */
+int db_read_schema_stamp(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    unsigned char header[DB_HEADER_SIZE];
+    ssize_t n = pread(fd, header, sizeof(header), 0);
+    close(fd);
+    if (n == 0) {
+        return 0;
+    }
+    if ((n != sizeof(header)) || (memcmp(header, "SQLite format 3", 16) != 0)) {
+        return -1;
+    }
+
+    // big-endian, at offset 60
+    const unsigned char *v = header + DB_HEADER_USER_VERSION_OFFSET;
+    return (int) (((uint32_t) v[0] << 24) | ((uint32_t) v[1] << 16) | ((uint32_t) v[2] << 8) | (uint32_t) v[3]);
+}
+
+/*
+ * Finalize the statements cached for the connection, then close it.
+ */
+int db_close(struct sqlite3 *conn) {
+    if (!conn) {
+        return SQLITE_OK;
+    }
+    stmt_cache_close(conn);
+    return sqlite3_close(conn);
+}
+
 int db_get_schema_version(struct sqlite3 *conn) {
     int version = 0;
     sqlite3_stmt *stmt;
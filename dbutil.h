@@ -5,10 +5,26 @@
 #include <stdbool.h>
 #include "error.h"
 
+/* memory-mapped I/O limit for read-only connections */
+#define DB_MMAP_SIZE (64 * 1024 * 1024)
+
 sqlite3 *db_open(const char *filename, int *result);
 
 sqlite3 *db_open_with_xa(const char *filename, int *result);
 
+/* Read-only connection for completion (see `completion_db_open_readonly()`); `*result` is SQLite's result code */
+sqlite3 *db_open_readonly(const char *filename, int *result);
+
+char *db_filename_to_uri(const char *filename);
+
+bool db_has_wal_content(const char *filename);
+
+/* Schema version read from the file header (-1 if the file is missing) */
+int db_read_schema_stamp(const char *filename);
+
+/* Close the connection (and the statements cached for it) */
+int db_close(struct sqlite3 *conn);
+
 int db_get_schema_version(struct sqlite3 *conn);
 
 bce_error_t db_create_schema(struct sqlite3 *conn);
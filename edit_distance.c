@@ -0,0 +1,61 @@
+#include "edit_distance.h"
+#include <string.h>
+
+bool edit_pattern_init(edit_pattern_t *pattern, const char *str, size_t len) {
+    if (len > EDIT_DISTANCE_MAX_PATTERN) {
+        return false;
+    }
+    memset(pattern->peq, 0, sizeof(pattern->peq));
+    for (size_t i = 0; i < len; i++) {
+        pattern->peq[(unsigned char) str[i]] |= (uint64_t) 1 << i;
+    }
+    pattern->len = len;
+    return true;
+}
+
+/*
+ * VP/VN: the vertical deltas (+1/-1) of the current column; HP/HN: the horizontal deltas of the new one.
+ * D0 marks the diagonal deltas that are 0 (a match, or a path through one); TR adds the transpositions: a match
+ * of the previous character of the text with the next one of the pattern, where the previous column had none.
+ * `score` follows the last row, D[m][j]: the distance between the pattern and `str[0..j)`.
+ */
+int edit_distance(const edit_pattern_t *pattern, const char *str, size_t len, int max_distance) {
+    size_t m = pattern->len;
+    size_t length_difference = (m > len) ? m - len : len - m;
+    if (length_difference > (size_t) max_distance) {
+        return max_distance + 1;
+    }
+    if (m == 0) {
+        return (int) len;
+    }
+
+    const uint64_t last = (uint64_t) 1 << (m - 1);
+    uint64_t vp = ~(uint64_t) 0;
+    uint64_t vn = 0;
+    uint64_t d0 = 0;
+    uint64_t previous_eq = 0;
+    size_t score = m;
+    for (size_t j = 0; j < len; j++) {
+        uint64_t eq = pattern->peq[(unsigned char) str[j]];
+        uint64_t tr = (((~d0) & eq) << 1) & previous_eq;
+        d0 = (((eq & vp) + vp) ^ vp) | eq | vn | tr;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = vp & d0;
+        if (hp & last) {
+            score++;
+        } else if (hn & last) {
+            score--;
+        }
+        // each of the remaining characters lowers the distance by 1 at most
+        if (score > (size_t) max_distance + (len - j - 1)) {
+            return max_distance + 1;
+        }
+        // row 0 is D[0][j] = j: its horizontal delta is always +1
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        previous_eq = eq;
+    }
+    return (score <= (size_t) max_distance) ? (int) score : max_distance + 1;
+}
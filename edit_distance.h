@@ -0,0 +1,34 @@
+#ifndef BCE_EDIT_DISTANCE_H
+#define BCE_EDIT_DISTANCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Edit distance with insertions, deletions, substitutions and transpositions of adjacent characters
+ * (the "optimal string alignment" variant of Damerau-Levenshtein: `gte` is 1 edit from `get`).
+ *
+ * Computed with Myers' bit-parallel algorithm, as formulated (and extended to transpositions) by Hyyrö: a column
+ * of the DP matrix is kept as bit vectors of deltas, so each character of the text costs a dozen word operations,
+ * whatever the pattern length. Patterns are limited to 64 characters (one machine word). Characters are compared
+ * exactly (case-sensitive).
+ */
+
+#define EDIT_DISTANCE_MAX_PATTERN   64
+
+typedef struct edit_pattern_t {
+    size_t len;
+    uint64_t peq[256];      /* bit `i` of `peq[c]` is set if character `i` of the pattern is `c` */
+} edit_pattern_t;
+
+/* Prepare a pattern; returns false if it is longer than EDIT_DISTANCE_MAX_PATTERN */
+bool edit_pattern_init(edit_pattern_t *pattern, const char *str, size_t len);
+
+/*
+ * The edit distance between the pattern and `str[0..len)`, if it is at most `max_distance`;
+ * `max_distance + 1` otherwise (the computation stops as soon as the distance can no longer be reached).
+ */
+int edit_distance(const edit_pattern_t *pattern, const char *str, size_t len, int max_distance);
+
+#endif // BCE_EDIT_DISTANCE_H
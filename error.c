@@ -18,6 +18,8 @@ char *get_bce_error_msg(const bce_error_t err) {
             break;
         case ERR_INVALID_CLI_ARGUMENT:
             break;
+        case ERR_INVALID_COMP_CWORD:
+            break;
         case ERR_NO_DATABASE_CONNECTION:
             break;
         case ERR_INVALID_CMD_NAME:
@@ -48,6 +50,16 @@ char *get_bce_error_msg(const bce_error_t err) {
             break;
         case ERR_CREATE_TEMP_FILE:
             break;
+        case ERR_SOCKET:
+            break;
+        case ERR_SNAPSHOT:
+            break;
+        case ERR_OUT_OF_MEMORY:
+            break;
+        case ERR_INVALID_JSON:
+            break;
+        case ERR_JSON_KEY_ORDER:
+            break;
     }
     return msg;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ typedef enum {
     ERR_MISSING_ENV_COMP_POINT = -3,
     ERR_INVALID_ENV_COMP_POINT = -4,
     ERR_INVALID_CLI_ARGUMENT = -5,
+    ERR_INVALID_COMP_CWORD = -6,
     ERR_NO_DATABASE_CONNECTION = -20,
     ERR_INVALID_CMD_NAME = -21,
     ERR_INVALID_CMD = -22,
@@ -23,6 +24,11 @@ typedef enum {
     ERR_DOWNLOAD_ERR = -107,
     ERR_UUID_ERR = -108,
     ERR_CREATE_TEMP_FILE = -109,
+    ERR_SOCKET = -110,
+    ERR_SNAPSHOT = -111,
+    ERR_OUT_OF_MEMORY = -112,
+    ERR_INVALID_JSON = -113,
+    ERR_JSON_KEY_ORDER = -114,
 } bce_error_t;
 
 char *get_bce_error_msg(const bce_error_t err);
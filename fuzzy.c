@@ -0,0 +1,199 @@
+#include "fuzzy.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define FUZZY_HAVE_SSE2
+#include <emmintrin.h>
+// the last block may be loaded past the end of the string, but never past its page (as `strlen()` does)
+#define FUZZY_PAGE_SIZE 4096
+#if defined(__GNUC__)
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define NO_SANITIZE_ADDRESS
+#endif
+#endif
+
+// fzf's scores: every matched character counts, and more at the start of a word or after another match
+#define SCORE_MATCH             16
+#define SCORE_GAP_START         (-3)
+#define SCORE_GAP_EXTENSION     (-1)
+#define BONUS_BOUNDARY          (SCORE_MATCH / 2)
+#define BONUS_NON_WORD          (SCORE_MATCH / 2)
+#define BONUS_CAMEL_CASE        (BONUS_BOUNDARY + SCORE_GAP_EXTENSION)
+#define BONUS_CONSECUTIVE       (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_FIRST_CHAR        2
+
+typedef enum char_class_t {
+    CHAR_NON_WORD,
+    CHAR_LOWER,
+    CHAR_UPPER,
+    CHAR_DIGIT
+} char_class_t;
+
+static size_t match_end(const fuzzy_pattern_t *pattern, const char *str, size_t len);
+
+static inline char to_lower(char c) {
+    return ((c >= 'A') && (c <= 'Z')) ? (char) (c - 'A' + 'a') : c;
+}
+
+static inline char to_upper(char c) {
+    return ((c >= 'a') && (c <= 'z')) ? (char) (c - 'a' + 'A') : c;
+}
+
+static inline char_class_t char_class(char c) {
+    if ((c >= 'a') && (c <= 'z')) {
+        return CHAR_LOWER;
+    }
+    if ((c >= 'A') && (c <= 'Z')) {
+        return CHAR_UPPER;
+    }
+    if ((c >= '0') && (c <= '9')) {
+        return CHAR_DIGIT;
+    }
+    // bytes >= 0x80 are (part of) letters
+    return ((unsigned char) c >= 0x80) ? CHAR_LOWER : CHAR_NON_WORD;
+}
+
+/* Bonus for a match at a character of class `cls`, following one of class `prev` */
+static inline int char_bonus(char_class_t prev, char_class_t cls) {
+    if ((prev == CHAR_NON_WORD) && (cls != CHAR_NON_WORD)) {
+        return BONUS_BOUNDARY;
+    }
+    if (((prev == CHAR_LOWER) && (cls == CHAR_UPPER)) || ((prev != CHAR_DIGIT) && (cls == CHAR_DIGIT))) {
+        return BONUS_CAMEL_CASE;
+    }
+    if (cls == CHAR_NON_WORD) {
+        return BONUS_NON_WORD;
+    }
+    return 0;
+}
+
+bool fuzzy_pattern_init(fuzzy_pattern_t *pattern, const char *str, size_t len) {
+    bool result = true;
+    if (len > FUZZY_MAX_PATTERN) {
+        len = FUZZY_MAX_PATTERN;
+        result = false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        pattern->lower[i] = to_lower(str[i]);
+        pattern->upper[i] = to_upper(str[i]);
+    }
+    pattern->len = len;
+    return result;
+}
+
+/*
+ * fzf's "v1" algorithm: find the first occurrence of the pattern as a subsequence, then walk back from its end
+ * to the latest start (the shortest match ending there), and score that window.
+ */
+int fuzzy_score(const fuzzy_pattern_t *pattern, const char *str, size_t len) {
+    if (pattern->len == 0) {
+        return 0;
+    }
+    if (pattern->len > len) {
+        return FUZZY_NO_MATCH;
+    }
+
+    // forward: the end of the first match
+    size_t end = match_end(pattern, str, len);
+    if (end == 0) {
+        return FUZZY_NO_MATCH;
+    }
+
+    // backward: the latest start of a match that ends at `end`
+    size_t start = end;
+    for (size_t i = pattern->len; i > 0; start--) {
+        if (to_lower(str[start - 1]) == pattern->lower[i - 1]) {
+            i--;
+        }
+    }
+
+    int score = 0;
+    int first_bonus = 0;
+    size_t consecutive = 0;
+    bool in_gap = false;
+    size_t p = 0;
+    char_class_t prev_class = (start > 0) ? char_class(str[start - 1]) : CHAR_NON_WORD;
+    for (size_t i = start; i < end; i++) {
+        char_class_t cls = char_class(str[i]);
+        if (to_lower(str[i]) == pattern->lower[p]) {
+            int bonus = char_bonus(prev_class, cls);
+            if (consecutive == 0) {
+                first_bonus = bonus;
+            } else {
+                // a run of matches keeps the bonus of its first character
+                if ((bonus == BONUS_BOUNDARY) && (bonus > first_bonus)) {
+                    first_bonus = bonus;
+                }
+                bonus = (bonus > first_bonus) ? bonus : first_bonus;
+                bonus = (bonus > BONUS_CONSECUTIVE) ? bonus : BONUS_CONSECUTIVE;
+            }
+            score += SCORE_MATCH + ((p == 0) ? bonus * BONUS_FIRST_CHAR : bonus);
+            in_gap = false;
+            consecutive++;
+            p++;
+        } else {
+            score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            in_gap = true;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+        prev_class = cls;
+    }
+    return score;
+}
+
+/*
+ * One past the last character of the first match of the whole pattern, going left to right (0 if there is none).
+ *
+ * With SSE2, each block of 16 bytes is compared with every remaining character of the pattern at once: bit `n` of
+ * a mask is set if byte `n` is that character, and the next match is the lowest bit past the previous one. The
+ * last (partial) block is loaded in place unless that would cross into the next page; then it is copied.
+ */
+#ifdef FUZZY_HAVE_SSE2
+NO_SANITIZE_ADDRESS
+#endif
+static size_t match_end(const fuzzy_pattern_t *pattern, const char *str, size_t len) {
+    size_t p = 0;
+#ifdef FUZZY_HAVE_SSE2
+    for (size_t block = 0; block < len; block += 16) {
+        __m128i v;
+        unsigned valid = 0xFFFFu;
+        if (block + 16 > len) {
+            valid = (1u << (len - block)) - 1;
+        }
+        if ((block + 16 <= len) || (((uintptr_t) (str + block) % FUZZY_PAGE_SIZE) <= FUZZY_PAGE_SIZE - 16)) {
+            v = _mm_loadu_si128((const __m128i *) (str + block));
+        } else {
+            char tail[16] = {0};
+            memcpy(tail, str + block, len - block);
+            v = _mm_loadu_si128((const __m128i *) tail);
+        }
+        // the bits from `from` on are still to be searched
+        unsigned from = 0;
+        while (from < 16) {
+            unsigned mask = (unsigned) _mm_movemask_epi8(_mm_or_si128(
+                    _mm_cmpeq_epi8(v, _mm_set1_epi8(pattern->lower[p])),
+                    _mm_cmpeq_epi8(v, _mm_set1_epi8(pattern->upper[p]))));
+            mask &= valid & (0xFFFFu << from);
+            if (!mask) {
+                break;
+            }
+            from = (unsigned) __builtin_ctz(mask) + 1;
+            if (++p == pattern->len) {
+                return block + from;
+            }
+        }
+    }
+#else
+    for (size_t i = 0; i < len; i++) {
+        if (to_lower(str[i]) == pattern->lower[p]) {
+            if (++p == pattern->len) {
+                return i + 1;
+            }
+        }
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BCE_FUZZY_H
+#define BCE_FUZZY_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Fuzzy (subsequence) matching, scored like fzf: `gt` matches `get`, and `ns` ranks `namespace` above `dns`.
+ *
+ * Matching is case-insensitive. The characters of the pattern are found 16 bytes at a time (SSE2, when
+ * available), so names that don't match are rejected without visiting each of their characters.
+ */
+
+#define FUZZY_MAX_PATTERN   64
+#define FUZZY_NO_MATCH      INT_MIN
+
+typedef struct fuzzy_pattern_t {
+    size_t len;
+    char lower[FUZZY_MAX_PATTERN];
+    char upper[FUZZY_MAX_PATTERN];
+} fuzzy_pattern_t;
+
+/* Prepare a pattern; returns false (and keeps the first FUZZY_MAX_PATTERN characters) if it is longer */
+bool fuzzy_pattern_init(fuzzy_pattern_t *pattern, const char *str, size_t len);
+
+/*
+ * Score `str[0..len)` against the pattern: FUZZY_NO_MATCH if the pattern is not a subsequence of it,
+ * otherwise higher is better (0 for an empty pattern; long gaps can make it negative).
+ */
+int fuzzy_score(const fuzzy_pattern_t *pattern, const char *str, size_t len);
+
+#endif // BCE_FUZZY_H
@@ -0,0 +1,145 @@
+#include "hash_map.h"
+#include <string.h>
+
+#define HM_MIN_CAPACITY 16
+
+static hash_map_entry_t *find_entry(hash_map_entry_t *entries, size_t capacity, const char *key, size_t key_len,
+                                    uint32_t hash);
+
+static bool grow(hash_map_t *map);
+
+/*
+ * Create a new hash map, sized so `expected_size` keys fit without growing.
+ * Caller should use `hm_destroy()` when done.
+ */
+hash_map_t *hm_create(size_t expected_size) {
+    hash_map_t *map = malloc(sizeof(hash_map_t));
+    if (!map) {
+        return NULL;
+    }
+
+    // keep the load factor at or below 1/2
+    size_t capacity = HM_MIN_CAPACITY;
+    while (capacity < expected_size * 2) {
+        capacity *= 2;
+    }
+    map->entries = calloc(capacity, sizeof(hash_map_entry_t));
+    if (!map->entries) {
+        free(map);
+        return NULL;
+    }
+    map->capacity = capacity;
+    map->size = 0;
+    return map;
+}
+
+/*
+ * Frees the map. The keys and values are owned by the caller.
+ */
+hash_map_t *hm_destroy(hash_map_t *map) {
+    if (!map) {
+        return NULL;
+    }
+
+    free(map->entries);
+    free(map);
+    return NULL;
+}
+
+bool hm_put(hash_map_t *map, const char *key, void *value) {
+    if (!key) {
+        return false;
+    }
+    return hm_put_n(map, key, strlen(key), value);
+}
+
+bool hm_put_n(hash_map_t *map, const char *key, size_t key_len, void *value) {
+    if (!map || !key) {
+        return false;
+    }
+    if ((map->size + 1) * 2 > map->capacity) {
+        if (!grow(map)) {
+            return false;
+        }
+    }
+
+    uint32_t hash = hm_hash(key, key_len);
+    hash_map_entry_t *entry = find_entry(map->entries, map->capacity, key, key_len, hash);
+    if (!entry->key) {
+        entry->key = key;
+        entry->key_len = key_len;
+        entry->hash = hash;
+        map->size++;
+    }
+    entry->value = value;
+    return true;
+}
+
+void *hm_get(const hash_map_t *map, const char *key) {
+    if (!key) {
+        return NULL;
+    }
+    return hm_get_n(map, key, strlen(key));
+}
+
+void *hm_get_n(const hash_map_t *map, const char *key, size_t key_len) {
+    if (!map || !key) {
+        return NULL;
+    }
+    hash_map_entry_t *entry = find_entry(map->entries, map->capacity, key, key_len, hm_hash(key, key_len));
+    return entry->key ? entry->value : NULL;
+}
+
+bool hm_contains(const hash_map_t *map, const char *key) {
+    if (!map || !key) {
+        return false;
+    }
+    size_t key_len = strlen(key);
+    return find_entry(map->entries, map->capacity, key, key_len, hm_hash(key, key_len))->key != NULL;
+}
+
+uint32_t hm_hash(const char *key, size_t key_len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < key_len; i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Find the entry for `key`, or the empty slot where it belongs.
+ */
+static hash_map_entry_t *find_entry(hash_map_entry_t *entries, size_t capacity, const char *key, size_t key_len,
+                                    uint32_t hash) {
+    size_t mask = capacity - 1;
+    size_t slot = hash & mask;
+    for (;;) {
+        hash_map_entry_t *entry = &entries[slot];
+        if (!entry->key) {
+            return entry;
+        }
+        if ((entry->hash == hash) && (entry->key_len == key_len) && (memcmp(entry->key, key, key_len) == 0)) {
+            return entry;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static bool grow(hash_map_t *map) {
+    size_t capacity = map->capacity * 2;
+    hash_map_entry_t *entries = calloc(capacity, sizeof(hash_map_entry_t));
+    if (!entries) {
+        return false;
+    }
+    for (size_t i = 0; i < map->capacity; i++) {
+        hash_map_entry_t *entry = &map->entries[i];
+        if (entry->key) {
+            *find_entry(entries, capacity, entry->key, entry->key_len, entry->hash) = *entry;
+        }
+    }
+    free(map->entries);
+    map->entries = entries;
+    map->capacity = capacity;
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef BCE_HASH_MAP_H
+#define BCE_HASH_MAP_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * String-keyed hash map (open addressing, linear probing).
+ * Keys are not copied; they must outlive the map.
+ */
+
+typedef struct hash_map_entry_t {
+    const char *key;
+    size_t key_len;
+    uint32_t hash;
+    void *value;
+} hash_map_entry_t;
+
+typedef struct hash_map_t {
+    size_t size;
+    size_t capacity;
+    hash_map_entry_t *entries;
+} hash_map_t;
+
+hash_map_t *hm_create(size_t expected_size);
+
+hash_map_t *hm_destroy(hash_map_t *map);
+
+/* Insert or replace the value for `key` */
+bool hm_put(hash_map_t *map, const char *key, void *value);
+
+/* Same as `hm_put()`, for keys that are not NUL-terminated */
+bool hm_put_n(hash_map_t *map, const char *key, size_t key_len, void *value);
+
+/* Get the value for `key` (NULL if not found) */
+void *hm_get(const hash_map_t *map, const char *key);
+
+void *hm_get_n(const hash_map_t *map, const char *key, size_t key_len);
+
+bool hm_contains(const hash_map_t *map, const char *key);
+
+/* FNV-1a hash, as used by the map */
+uint32_t hm_hash(const char *key, size_t key_len);
+
+#endif // BCE_HASH_MAP_H
@@ -0,0 +1,513 @@
+#include "history_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "hash_map.h"
+#include "input.h"
+#include "state_file.h"
+
+#define HISTORY_MAX_READ        (1024 * 1024)   /* of a history file read from the start: its end */
+
+static char *read_history(const char *filename, history_index_t *index, size_t *size);
+
+static bool add_value(history_index_t *index, hash_map_t *positions, const char *command, size_t command_len,
+                      const char *arg, size_t arg_len, const char *value, size_t value_len, uint64_t sequence);
+
+static void read_header(history_index_t *index);
+
+static bool read_index(history_index_t *index, hash_map_t *positions, const char *command_name);
+
+static bool add_history_line(history_index_t *index, hash_map_t *positions, const char *line, size_t len);
+
+static bool is_value(const char *word, size_t len);
+
+static bool write_index(history_index_t *index, const char *index_filename);
+
+static int compare_recent_first(const void *a, const void *b);
+
+static void merge_arg_values(const history_index_t *index, bce_command_arg_t *arg);
+
+bool history_file_path(char *dest, size_t max_len, const char *histfile) {
+    if (!histfile || (*histfile == '\0')) {
+        histfile = getenv("HISTFILE");
+    }
+    int len;
+    if (histfile && (*histfile != '\0')) {
+        len = snprintf(dest, max_len, "%s", histfile);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || (*home == '\0')) {
+            return false;
+        }
+        len = snprintf(dest, max_len, "%s/%s", home, HISTORY_DEFAULT_FILE);
+    }
+    return (len > 0) && ((size_t) len < max_len);
+}
+
+history_index_t *history_index_load(const char *index_filename, const char *history_filename,
+                                    const char *command_name) {
+    // values already indexed are still offered if the update fails
+    history_index_update(index_filename, history_filename);
+
+    history_index_t *index = calloc(1, sizeof(history_index_t));
+    if (!index) {
+        return NULL;
+    }
+    size_t size = 0;
+    index->data = state_file_read(index_filename, &size);
+    if (!index->data || !read_index(index, NULL, command_name) || (index->value_count == 0)) {
+        return history_index_free(index);
+    }
+    return index;
+}
+
+bce_error_t history_index_update(const char *index_filename, const char *history_filename) {
+    bce_error_t err = ERR_NONE;
+    history_index_t index = {0};
+    hash_map_t *positions = NULL;
+    char *history = NULL;
+    size_t size = 0;
+
+    index.data = state_file_read(index_filename, &size);
+    read_header(&index);
+    uint64_t offset = index.offset;
+    history = read_history(history_filename, &index, &size);
+    if (index.offset == offset) {
+        // nothing new
+        goto done;
+    }
+
+    index.arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    positions = hm_create(HISTORY_MAX_ENTRIES);
+    if (!index.arena || !positions || !read_index(&index, positions, NULL)) {
+        err = ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+    char *end = history ? history + size : NULL;
+    for (char *line = history; line && (line < end);) {
+        char *line_end = memchr(line, '\n', (size_t) (end - line));
+        if (!line_end) {
+            break;
+        }
+        *line_end = '\0';
+        if (!add_history_line(&index, positions, line, (size_t) (line_end - line))) {
+            err = ERR_OUT_OF_MEMORY;
+            goto done;
+        }
+        line = line_end + 1;
+    }
+    if (!write_index(&index, index_filename)) {
+        err = ERR_CREATE_TEMP_FILE;
+    }
+
+    done:
+    free(history);
+    hm_destroy(positions);
+    free(index.data);
+    free(index.values);
+    arena_destroy(index.arena);
+    return err;
+}
+
+history_index_t *history_index_free(history_index_t *index) {
+    if (!index) {
+        return NULL;
+    }
+    free(index->data);
+    free(index->values);
+    arena_destroy(index->arena);
+    free(index);
+    return NULL;
+}
+
+void history_index_merge(const history_index_t *index, bce_command_t *cmd) {
+    if (!index || !cmd) {
+        return;
+    }
+    for (linked_list_node_t *node = cmd->args->head; node != NULL; node = node->next) {
+        bce_command_arg_t *arg = (bce_command_arg_t *) node->data;
+        if (strcmp(arg->arg_type, "NONE") != 0) {
+            merge_arg_values(index, arg);
+        }
+    }
+    for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+        history_index_merge(index, (bce_command_t *) node->data);
+    }
+}
+
+/*
+ * The lines of the history file added since `index->offset` (the end of the file, up to the last complete line, if
+ * it is another file, or shorter, or was rewritten), moving the offset past them. NULL if there are none.
+ */
+static char *read_history(const char *filename, history_index_t *index, size_t *size) {
+    *size = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    char *data = NULL;
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+        goto done;
+    }
+    uint64_t file_size = (uint64_t) st.st_size;
+    uint64_t start = index->offset;
+    char before = '\n';
+    if (((uint64_t) st.st_ino != index->inode) || (file_size < start)
+        || ((start > 0) && (pread(fd, &before, 1, (off_t) start - 1) != 1)) || (before != '\n')) {
+        start = 0;
+    }
+    if (start == file_size) {
+        goto done;
+    }
+    bool partial_first_line = false;
+    if (file_size - start > HISTORY_MAX_READ) {
+        start = file_size - HISTORY_MAX_READ;
+        partial_first_line = true;
+    }
+    size_t len = (size_t) (file_size - start);
+    data = malloc(len + 1);
+    if (!data) {
+        goto done;
+    }
+    while (*size < len) {
+        ssize_t n = pread(fd, data + *size, len - *size, (off_t) (start + *size));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        *size += (size_t) n;
+    }
+    data[*size] = '\0';
+
+    // a line being written is read by the next update
+    const char *last_line_end = NULL;
+    for (size_t i = *size; i > 0; i--) {
+        if (data[i - 1] == '\n') {
+            last_line_end = data + i - 1;
+            break;
+        }
+    }
+    if (!last_line_end) {
+        free(data);
+        data = NULL;
+        *size = 0;
+        goto done;
+    }
+    *size = (size_t) (last_line_end - data) + 1;
+    index->inode = (uint64_t) st.st_ino;
+    index->offset = start + *size;
+    if (partial_first_line) {
+        const char *first_line_end = memchr(data, '\n', *size);
+        size_t skipped = (size_t) (first_line_end - data) + 1;
+        memmove(data, data + skipped, *size - skipped);
+        *size -= skipped;
+    }
+
+    done:
+    close(fd);
+    return data;
+}
+
+/*
+ * Add a value (the fields are contiguous, tab-separated, as in the index), or move it to `sequence` if it is already
+ * in `positions` (NULL: no lookup, when reading the values of one command)
+ */
+static bool add_value(history_index_t *index, hash_map_t *positions, const char *command, size_t command_len,
+                      const char *arg, size_t arg_len, const char *value, size_t value_len, uint64_t sequence) {
+    size_t key_len = command_len + 1 + arg_len + 1 + value_len;
+    if (positions) {
+        size_t position = (size_t) (uintptr_t) hm_get_n(positions, command, key_len);
+        if (position > 0) {
+            history_value_t *existing = &index->values[position - 1];
+            if (sequence > existing->sequence) {
+                existing->sequence = sequence;
+            }
+            return true;
+        }
+    }
+    if (index->value_count == index->value_capacity) {
+        size_t capacity = (index->value_capacity > 0) ? index->value_capacity * 2 : 64;
+        history_value_t *values = realloc(index->values, capacity * sizeof(history_value_t));
+        if (!values) {
+            return false;
+        }
+        index->values = values;
+        index->value_capacity = capacity;
+    }
+    if (positions && !hm_put_n(positions, command, key_len, (void *) (uintptr_t) (index->value_count + 1))) {
+        return false;
+    }
+    history_value_t *entry = &index->values[index->value_count++];
+    entry->command = command;
+    entry->command_len = command_len;
+    entry->arg = arg;
+    entry->arg_len = arg_len;
+    entry->value = value;
+    entry->value_len = value_len;
+    entry->sequence = sequence;
+    return true;
+}
+
+/* The first line of `index->data` (`#\t<inode>\t<offset>\t<sequence>`) */
+static void read_header(history_index_t *index) {
+    if (!index->data || (index->data[0] != '#')) {
+        return;
+    }
+    char *field_end = NULL;
+    index->inode = strtoull(index->data + 1, &field_end, 10);
+    index->offset = strtoull(field_end, &field_end, 10);
+    index->sequence = strtoull(field_end, NULL, 10);
+}
+
+/* The values (only `command_name`'s, if not NULL) of `index->data` */
+static bool read_index(history_index_t *index, hash_map_t *positions, const char *command_name) {
+    const char *data = index->data;
+    if (!data) {
+        return true;
+    }
+    const char *end = data + strlen(data);
+    size_t command_name_len = command_name ? strlen(command_name) : 0;
+    for (const char *line = data; line < end;) {
+        const char *line_end = memchr(line, '\n', (size_t) (end - line));
+        if (!line_end) {
+            break;
+        }
+        if (*line == '#') {
+            line = line_end + 1;
+            continue;
+        }
+        const char *pos = line;
+        size_t command_len = 0;
+        size_t arg_len = 0;
+        size_t value_len = 0;
+        state_file_next_field(&pos, line_end, &value_len);
+        const char *command = state_file_next_field(&pos, line_end, &command_len);
+        const char *arg = command ? state_file_next_field(&pos, line_end, &arg_len) : NULL;
+        const char *value = arg ? pos : NULL;
+        if (value && (value <= line_end)) {
+            value_len = (size_t) (line_end - value);
+        }
+        if (value && (value <= line_end) && (value_len > 0)
+            && (!command_name || ((command_len == command_name_len)
+                                  && (strncmp(command, command_name, command_len) == 0)))
+            && !add_value(index, positions, command, command_len, arg, arg_len, value, value_len,
+                          strtoull(line, NULL, 10))) {
+            return false;
+        }
+        line = line_end + 1;
+    }
+    return true;
+}
+
+/*
+ * The values typed in a history line: the word after an arg (`-n`, `--namespace`, or `--namespace=`), unless it
+ * looks like an arg itself. Timestamp lines (`#<time>`) are skipped. `line` is NUL-terminated.
+ */
+static bool add_history_line(history_index_t *index, hash_map_t *positions, const char *line, size_t len) {
+    if ((len == 0) || (*line == '#') || !memchr(line, '-', len)) {
+        return true;
+    }
+    uint64_t sequence = ++index->sequence;
+    bce_error_t err = ERR_NONE;
+    completion_input_t *input = create_completion_input_from_line(line, (int) len, &err);
+    if (err != ERR_NONE) {
+        // not a line that can be completed
+        return true;
+    }
+    bool result = true;
+    size_t command_len = 0;
+    const char *command = get_token(input, 0, &command_len);
+    if (!command || !is_value(command, command_len) || memchr(command, '/', command_len)) {
+        goto done;
+    }
+    for (int i = 1; (size_t) (i + 1) < input->token_count; i++) {
+        size_t arg_len = 0;
+        size_t value_len = 0;
+        const char *arg = get_token(input, i, &arg_len);
+        if (is_command_separator(arg, arg_len)) {
+            break;
+        }
+        if ((arg_len < 2) || (arg[0] != '-') || ((arg_len == 2) && (arg[1] == '-')) || !is_value(arg, arg_len)) {
+            continue;
+        }
+        const char *value = get_token(input, i + 1, &value_len);
+        if (!is_value(value, value_len) || (value[0] == '-') || is_command_separator(value, value_len)) {
+            continue;
+        }
+        char *key = arena_alloc(index->arena, command_len + 1 + arg_len + 1 + value_len);
+        if (!key) {
+            result = false;
+            goto done;
+        }
+        memcpy(key, command, command_len);
+        key[command_len] = '\t';
+        memcpy(key + command_len + 1, arg, arg_len);
+        key[command_len + 1 + arg_len] = '\t';
+        memcpy(key + command_len + 1 + arg_len + 1, value, value_len);
+        if (!add_value(index, positions, key, command_len, key + command_len + 1, arg_len,
+                       key + command_len + 1 + arg_len + 1, value_len, sequence)) {
+            result = false;
+            goto done;
+        }
+        i++;
+    }
+
+    done:
+    free_completion_input(input);
+    return result;
+}
+
+/* Nothing that would break a line of the index */
+static bool is_value(const char *word, size_t len) {
+    if ((len == 0) || (len > HISTORY_MAX_VALUE_LEN)) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) word[i];
+        if ((c < 0x20) || (c == 0x7f)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Write the values worth keeping, the most recent first: HISTORY_MAX_VALUES per (command, arg), HISTORY_MAX_ENTRIES
+ * in all (to a temporary file, renamed over the index)
+ */
+static bool write_index(history_index_t *index, const char *index_filename) {
+    hash_map_t *counts = hm_create(256);
+    if (!counts) {
+        return false;
+    }
+    state_file_writer_t writer;
+    if (!state_file_write_begin(&writer, index_filename)) {
+        hm_destroy(counts);
+        return false;
+    }
+    FILE *file = writer.file;
+    if (index->value_count > 0) {
+        qsort(index->values, index->value_count, sizeof(history_value_t), compare_recent_first);
+    }
+    fprintf(file, "#\t%llu\t%llu\t%llu\n", (unsigned long long) index->inode, (unsigned long long) index->offset,
+            (unsigned long long) index->sequence);
+    bool written = true;
+    size_t kept = 0;
+    for (size_t i = 0; (i < index->value_count) && (kept < HISTORY_MAX_ENTRIES); i++) {
+        const history_value_t *value = &index->values[i];
+        size_t key_len = value->command_len + 1 + value->arg_len;
+        size_t count = (size_t) (uintptr_t) hm_get_n(counts, value->command, key_len);
+        if (count >= HISTORY_MAX_VALUES) {
+            continue;
+        }
+        if (!hm_put_n(counts, value->command, key_len, (void *) (uintptr_t) (count + 1))) {
+            written = false;
+            break;
+        }
+        fprintf(file, "%llu\t%.*s\t%.*s\t%.*s\n", (unsigned long long) value->sequence,
+                (int) value->command_len, value->command, (int) value->arg_len, value->arg,
+                (int) value->value_len, value->value);
+        kept++;
+    }
+    hm_destroy(counts);
+    return state_file_write_end(&writer, written);
+}
+
+/* The most recent first; the values of the same line in the order of their keys, so the index is reproducible */
+static int compare_recent_first(const void *a, const void *b) {
+    const history_value_t *value_a = (const history_value_t *) a;
+    const history_value_t *value_b = (const history_value_t *) b;
+    if (value_a->sequence != value_b->sequence) {
+        return (value_a->sequence < value_b->sequence) ? 1 : -1;
+    }
+    size_t len_a = (size_t) (value_a->value + value_a->value_len - value_a->command);
+    size_t len_b = (size_t) (value_b->value + value_b->value_len - value_b->command);
+    int cmp = memcmp(value_a->command, value_b->command, (len_a < len_b) ? len_a : len_b);
+    return (cmp != 0) ? cmp : (len_a > len_b) - (len_a < len_b);
+}
+
+static bool is_arg_name(const char *name, size_t len, bce_str_t arg_name) {
+    return (bce_str_len(arg_name) == len) && (strncmp(arg_name, name, len) == 0);
+}
+
+/*
+ * Put the values typed for `arg` (the index is in the order it was written: the most recent first) ahead of its
+ * opts; the opts they duplicate are dropped
+ */
+static void merge_arg_values(const history_index_t *index, bce_command_arg_t *arg) {
+    linked_list_node_t *static_head = arg->opts->head;
+    linked_list_node_t *static_tail = arg->opts->tail;
+    size_t static_count = arg->opts->size;
+    arg->opts->head = NULL;
+    arg->opts->tail = NULL;
+    arg->opts->size = 0;
+
+    for (size_t i = 0; i < index->value_count; i++) {
+        const history_value_t *value = &index->values[i];
+        if (!is_arg_name(value->arg, value->arg_len, arg->long_name)
+            && !is_arg_name(value->arg, value->arg_len, arg->short_name)) {
+            continue;
+        }
+        bce_str_t name = str_pool_intern_n(arg->arena, value->value, value->value_len);
+        bool duplicate = false;
+        for (linked_list_node_t *node = arg->opts->head; node != NULL; node = node->next) {
+            if (strcmp(((bce_command_opt_t *) node->data)->name, name) == 0) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate) {
+            continue;
+        }
+        bce_command_opt_t *opt = bce_command_opt_new_in(arg->arena);
+        if (!opt) {
+            break;
+        }
+        opt->cmd_arg_uuid = arg->uuid;
+        opt->name = name;
+        if (!ll_append_item(arg->opts, opt)) {
+            bce_command_opt_free(opt);
+            break;
+        }
+    }
+    size_t history_count = arg->opts->size;
+
+    // the opts from the database follow
+    if (static_head) {
+        if (arg->opts->tail) {
+            arg->opts->tail->next = static_head;
+        } else {
+            arg->opts->head = static_head;
+        }
+        arg->opts->tail = static_tail;
+        arg->opts->size += static_count;
+    }
+    if (history_count == 0) {
+        return;
+    }
+    linked_list_node_t *node = static_head;
+    while (node) {
+        linked_list_node_t *next = node->next;
+        bce_str_t name = ((bce_command_opt_t *) node->data)->name;
+        size_t position = 0;
+        for (linked_list_node_t *history = arg->opts->head; position < history_count;
+             history = history->next, position++) {
+            if (strcmp(((bce_command_opt_t *) history->data)->name, name) == 0) {
+                ll_remove_item(arg->opts, node);
+                break;
+            }
+        }
+        node = next;
+    }
+}
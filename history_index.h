@@ -0,0 +1,71 @@
+#ifndef BCE_HISTORY_INDEX_H
+#define BCE_HISTORY_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "data_model.h"
+#include "error.h"
+
+/*
+ * The values typed for args in the bash history (`kubectl get pods -n kube-system`: `kube-system` for `-n`),
+ * recommended along with the args' opts.
+ *
+ * index: `#\t<inode>\t<offset>\t<sequence>` (the history file, and how far it has been read), then
+ *        `<sequence>\t<command>\t<arg>\t<value>` per value, the sequence number of the last line it was typed in
+ *
+ * Each update only reads the lines added to the history since the last one (all of it, if the file was replaced or
+ * truncated). The index keeps the HISTORY_MAX_VALUES most recent values of each (command, arg), and at most
+ * HISTORY_MAX_ENTRIES in all. Args are keyed by the name typed and the command by its name: which sub-command an arg
+ * belongs to is only known with the command tree, and `kubectl get pods -n x` is a root command's arg.
+ */
+
+#define HISTORY_MAX_VALUES      16
+#define HISTORY_MAX_ENTRIES     4096
+#define HISTORY_MAX_VALUE_LEN   128
+#define HISTORY_DEFAULT_FILE    ".bash_history"
+
+typedef struct history_value_t {
+    const char *command;        /* not NUL-terminated */
+    size_t command_len;
+    const char *arg;
+    size_t arg_len;
+    const char *value;
+    size_t value_len;
+    uint64_t sequence;
+} history_value_t;
+
+typedef struct history_index_t {
+    uint64_t inode;             /* of the history file */
+    uint64_t offset;            /* where the next update starts reading it */
+    uint64_t sequence;          /* of the last line read */
+    char *data;                 /* the index file, as read; the values point into it */
+    arena_t *arena;             /* the values that don't */
+    history_value_t *values;
+    size_t value_count;
+    size_t value_capacity;
+} history_index_t;
+
+/* The history file: $HISTFILE (or `histfile`, if not NULL), or ~/.bash_history */
+bool history_file_path(char *dest, size_t max_len, const char *histfile);
+
+/*
+ * Bring the index up to date with the history file, writing it if anything was added, and read the values typed
+ * for `command_name`'s args. NULL if there are none.
+ */
+history_index_t *history_index_load(const char *index_filename, const char *history_filename,
+                                    const char *command_name);
+
+/* Update the index (see `history_index_load()`) */
+bce_error_t history_index_update(const char *index_filename, const char *history_filename);
+
+history_index_t *history_index_free(history_index_t *index);
+
+/*
+ * Add the values typed for each arg that takes one (in `cmd` and its sub-commands) to its opts: the most recent
+ * first, ahead of the ones in the database. Values typed for the short and the long name are merged.
+ */
+void history_index_merge(const history_index_t *index, bce_command_t *cmd);
+
+#endif // BCE_HISTORY_INDEX_H
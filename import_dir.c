@@ -0,0 +1,267 @@
+#include "import_dir.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef struct loaded_spec_t {
+    size_t file_index;
+    bce_command_t *cmd;             /* NULL if it failed to load (or wasn't, after a database error) */
+    arena_t *arena;
+} loaded_spec_t;
+
+typedef struct import_dir_pool_t {
+    import_dir_t *result;
+    import_dir_load_fn load;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_full;                        /* `next_write` moved on */
+    pthread_cond_t not_empty;                       /* a slot was filled */
+    size_t next_file;                               /* the next one to load */
+    size_t next_write;                              /* the next one to write: they are written by name */
+    loaded_spec_t slots[IMPORT_DIR_QUEUE_SIZE];     /* spec `i` waits in slot `i % IMPORT_DIR_QUEUE_SIZE` */
+    bool filled[IMPORT_DIR_QUEUE_SIZE];
+    bool stopped;                                   /* by a database error: specs are no longer loaded */
+} import_dir_pool_t;
+
+static bool list_specs(import_dir_t *result, const char *dir_name);
+
+static int compare_filenames(const void *a, const void *b);
+
+static void *load_specs(void *data);
+
+static loaded_spec_t take_spec(import_dir_pool_t *pool);
+
+static void write_spec(import_dir_pool_t *pool, import_writer_t *writer, const loaded_spec_t *spec, bce_error_t *err);
+
+static double elapsed_seconds(const struct timespec *start);
+
+import_dir_t *import_dir_run(import_writer_t *writer, const char *dir_name, int worker_count, import_dir_load_fn load,
+                             bce_error_t *err) {
+    *err = ERR_NONE;
+    import_dir_t *result = calloc(1, sizeof(import_dir_t));
+    if (!result) {
+        *err = ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    if (!list_specs(result, dir_name)) {
+        *err = ERR_READ_FILE;
+        return import_dir_free(result);
+    }
+    if (result->file_count == 0) {
+        return result;
+    }
+
+    if (worker_count <= 0) {
+        long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = (cpu_count > 0) ? (int) cpu_count : 1;
+    }
+    if (worker_count > IMPORT_DIR_MAX_WORKERS) {
+        worker_count = IMPORT_DIR_MAX_WORKERS;
+    }
+    if ((size_t) worker_count > result->file_count) {
+        worker_count = (int) result->file_count;
+    }
+
+    import_dir_pool_t pool;
+    memset(&pool, 0, sizeof(import_dir_pool_t));
+    pool.result = result;
+    pool.load = load;
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.not_full, NULL);
+    pthread_cond_init(&pool.not_empty, NULL);
+
+    pthread_t workers[IMPORT_DIR_MAX_WORKERS];
+    for (int i = 0; i < worker_count; i++) {
+        if (pthread_create(&workers[i], NULL, load_specs, &pool) != 0) {
+            worker_count = i;
+            break;
+        }
+    }
+    result->worker_count = worker_count;
+
+    if (worker_count == 0) {
+        *err = ERR_OUT_OF_MEMORY;
+        result->failed_count = result->file_count;
+        for (size_t i = 0; i < result->file_count; i++) {
+            result->files[i].err = ERR_OUT_OF_MEMORY;
+        }
+    } else {
+        // every spec comes through its slot, loaded or not, in the order of the files
+        for (size_t i = 0; i < result->file_count; i++) {
+            loaded_spec_t spec = take_spec(&pool);
+            write_spec(&pool, writer, &spec, err);
+            arena_destroy(spec.arena);
+        }
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_cond_destroy(&pool.not_empty);
+    pthread_cond_destroy(&pool.not_full);
+    pthread_mutex_destroy(&pool.mutex);
+    return result;
+}
+
+import_dir_t *import_dir_free(import_dir_t *result) {
+    if (result) {
+        for (size_t i = 0; i < result->file_count; i++) {
+            free(result->files[i].filename);
+        }
+        free(result->files);
+        free(result);
+    }
+    return NULL;
+}
+
+/* The regular files with the suffix, by name */
+static bool list_specs(import_dir_t *result, const char *dir_name) {
+    DIR *dir = opendir(dir_name);
+    if (!dir) {
+        return false;
+    }
+    bool ok = true;
+    size_t capacity = 0;
+    size_t suffix_len = strlen(IMPORT_DIR_SUFFIX);
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        size_t name_len = strlen(entry->d_name);
+        if ((entry->d_name[0] == '.') || (name_len <= suffix_len)
+            || (strcmp(entry->d_name + name_len - suffix_len, IMPORT_DIR_SUFFIX) != 0)) {
+            continue;
+        }
+        size_t path_len = strlen(dir_name) + 1 + name_len;
+        char *path = malloc(path_len + 1);
+        if (!path) {
+            ok = false;
+            break;
+        }
+        snprintf(path, path_len + 1, "%s/%s", dir_name, entry->d_name);
+        struct stat st;
+        if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+        if (result->file_count == capacity) {
+            capacity = (capacity > 0) ? capacity * 2 : 64;
+            import_dir_file_t *files = realloc(result->files, capacity * sizeof(import_dir_file_t));
+            if (!files) {
+                free(path);
+                ok = false;
+                break;
+            }
+            result->files = files;
+        }
+        import_dir_file_t *file = &result->files[result->file_count++];
+        memset(file, 0, sizeof(import_dir_file_t));
+        file->filename = path;
+    }
+    closedir(dir);
+    if (result->file_count > 1) {
+        qsort(result->files, result->file_count, sizeof(import_dir_file_t), compare_filenames);
+    }
+    return ok;
+}
+
+static int compare_filenames(const void *a, const void *b) {
+    return strcmp(((const import_dir_file_t *) a)->filename, ((const import_dir_file_t *) b)->filename);
+}
+
+/* Worker: load the next spec, until there are none left */
+static void *load_specs(void *data) {
+    import_dir_pool_t *pool = (import_dir_pool_t *) data;
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        size_t index = pool->next_file++;
+        bool stopped = pool->stopped;
+        pthread_mutex_unlock(&pool->mutex);
+        if (index >= pool->result->file_count) {
+            break;
+        }
+
+        // the file is only this worker's until it is queued
+        import_dir_file_t *file = &pool->result->files[index];
+        loaded_spec_t spec = {index, NULL, NULL};
+        if (!stopped) {
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            spec.arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+            if (spec.arena) {
+                spec.cmd = pool->load(spec.arena, file->filename, &file->err);
+                if (!spec.cmd && (file->err == ERR_NONE)) {
+                    file->err = ERR_INVALID_CMD;
+                }
+            } else {
+                file->err = ERR_OUT_OF_MEMORY;
+            }
+            file->load_seconds = elapsed_seconds(&start);
+        }
+
+        // the spec the writer waits for always has a slot: files are taken in order
+        pthread_mutex_lock(&pool->mutex);
+        while (index >= pool->next_write + IMPORT_DIR_QUEUE_SIZE) {
+            pthread_cond_wait(&pool->not_full, &pool->mutex);
+        }
+        pool->slots[index % IMPORT_DIR_QUEUE_SIZE] = spec;
+        pool->filled[index % IMPORT_DIR_QUEUE_SIZE] = true;
+        pthread_cond_signal(&pool->not_empty);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return NULL;
+}
+
+/* Writer: wait for the next spec by name (the others loaded meanwhile wait in their slots) */
+static loaded_spec_t take_spec(import_dir_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    size_t slot = pool->next_write % IMPORT_DIR_QUEUE_SIZE;
+    while (!pool->filled[slot]) {
+        pthread_cond_wait(&pool->not_empty, &pool->mutex);
+    }
+    loaded_spec_t spec = pool->slots[slot];
+    pool->filled[slot] = false;
+    pool->next_write++;
+    // any of the workers may be waiting for it
+    pthread_cond_broadcast(&pool->not_full);
+    pthread_mutex_unlock(&pool->mutex);
+    return spec;
+}
+
+/* Writer: replace the spec's command, and flush it (its arena is freed next) */
+static void write_spec(import_dir_pool_t *pool, import_writer_t *writer, const loaded_spec_t *spec, bce_error_t *err) {
+    import_dir_file_t *file = &pool->result->files[spec->file_index];
+    if ((file->err == ERR_NONE) && (*err != ERR_NONE)) {
+        // not loaded, after a database error
+        file->err = *err;
+    }
+    if (file->err == ERR_NONE) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t row_count = writer->row_count;
+        file->err = db_delete_command(writer->conn, spec->cmd->name);
+        if (file->err == ERR_NONE) {
+            import_writer_add_command(writer, spec->cmd);
+            file->err = import_writer_flush(writer);
+        }
+        file->row_count = writer->row_count - row_count;
+        file->write_seconds = elapsed_seconds(&start);
+        if (file->err != ERR_NONE) {
+            *err = file->err;
+            pthread_mutex_lock(&pool->mutex);
+            pool->stopped = true;
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+    if (file->err != ERR_NONE) {
+        pool->result->failed_count++;
+    }
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double) (end.tv_sec - start->tv_sec) + (double) (end.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,51 @@
+#ifndef BCE_IMPORT_DIR_H
+#define BCE_IMPORT_DIR_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "data_model.h"
+#include "import_writer.h"
+#include "error.h"
+
+/*
+ * Imports every `*.json` spec of a directory, within the caller's transaction. Worker threads load the specs in
+ * parallel, each into its own arena. The calling thread is the only writer: it takes the loaded commands in the
+ * order of their filenames, replaces each command (by name) through the import writer, and frees the spec's arena.
+ * At most IMPORT_DIR_QUEUE_SIZE loaded specs wait for the writer.
+ *
+ * As with importing the specs one at a time, by filename: if two specs have the same command, the last one is kept.
+ */
+
+#define IMPORT_DIR_MAX_WORKERS 16
+#define IMPORT_DIR_QUEUE_SIZE 8
+#define IMPORT_DIR_SUFFIX ".json"
+
+/* Load a spec into `arena`. Called from the worker threads, at the same time */
+typedef bce_command_t *(*import_dir_load_fn)(arena_t *arena, const char *filename, bce_error_t *err);
+
+typedef struct import_dir_file_t {
+    char *filename;                 /* the directory, then the name */
+    bce_error_t err;                /* why the spec wasn't imported */
+    double load_seconds;            /* on a worker */
+    double write_seconds;           /* on the writer */
+    size_t row_count;
+} import_dir_file_t;
+
+typedef struct import_dir_t {
+    import_dir_file_t *files;       /* by name */
+    size_t file_count;
+    size_t failed_count;
+    int worker_count;
+} import_dir_t;
+
+/*
+ * Import the specs in `dir_name` with `worker_count` threads (0: one per online CPU). Specs that fail to load are
+ * skipped (see their `err`); a database error stops the import and is returned in `err`, and the transaction should
+ * be rolled back. Returns NULL if the directory can't be read. Caller should use `import_dir_free()`
+ */
+import_dir_t *import_dir_run(import_writer_t *writer, const char *dir_name, int worker_count, import_dir_load_fn load,
+                             bce_error_t *err);
+
+import_dir_t *import_dir_free(import_dir_t *result);
+
+#endif // BCE_IMPORT_DIR_H
@@ -0,0 +1,207 @@
+#include "import_writer.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct import_table_info_t {
+    const char *insert;             /* up to VALUES */
+    int column_count;
+} import_table_info_t;
+
+static const import_table_info_t TABLES[IMPORT_TABLE_COUNT] = {
+        {"INSERT INTO command (uuid, name, parent_cmd) VALUES ",                                         3},
+        {"INSERT INTO command_alias (uuid, cmd_uuid, name) VALUES ",                                     3},
+        {"INSERT INTO command_arg (uuid, cmd_uuid, arg_type, description, long_name, short_name) VALUES ", 6},
+        {"INSERT INTO command_opt (uuid, cmd_arg_uuid, name) VALUES ",                                   3},
+};
+
+static sqlite3_stmt *prepare_insert(struct sqlite3 *conn, import_table_t table, int row_count, int *rc);
+
+static void queue_row(import_writer_t *writer, import_table_t table, const void *row);
+
+static void flush_table(import_writer_t *writer, import_table_t table);
+
+static void bind_row(sqlite3_stmt *stmt, int first, import_table_t table, const void *row);
+
+static void bind_str(sqlite3_stmt *stmt, int index, bce_str_t str, bool empty_is_null);
+
+bce_error_t import_writer_init(import_writer_t *writer, struct sqlite3 *conn) {
+    memset(writer, 0, sizeof(import_writer_t));
+    writer->conn = conn;
+    if (!conn) {
+        writer->err = ERR_NO_DATABASE_CONNECTION;
+    }
+    return writer->err;
+}
+
+bce_error_t import_writer_add_command(import_writer_t *writer, const bce_command_t *cmd) {
+    if (!cmd) {
+        return ERR_INVALID_CMD;
+    }
+    queue_row(writer, IMPORT_TABLE_COMMAND, cmd);
+    for (linked_list_node_t *node = cmd->aliases ? cmd->aliases->head : NULL; node != NULL; node = node->next) {
+        queue_row(writer, IMPORT_TABLE_ALIAS, node->data);
+    }
+    for (linked_list_node_t *node = cmd->sub_commands ? cmd->sub_commands->head : NULL; node != NULL;
+         node = node->next) {
+        import_writer_add_command(writer, (const bce_command_t *) node->data);
+    }
+    for (linked_list_node_t *node = cmd->args ? cmd->args->head : NULL; node != NULL; node = node->next) {
+        const bce_command_arg_t *arg = (const bce_command_arg_t *) node->data;
+        queue_row(writer, IMPORT_TABLE_ARG, arg);
+        if (arg->opts) {
+            for (linked_list_node_t *opt_node = arg->opts->head; opt_node != NULL; opt_node = opt_node->next) {
+                queue_row(writer, IMPORT_TABLE_OPT, opt_node->data);
+            }
+        }
+    }
+    return writer->err;
+}
+
+bce_error_t import_writer_add_row(import_writer_t *writer, import_table_t table, const void *row) {
+    queue_row(writer, table, row);
+    return writer->err;
+}
+
+bce_error_t import_writer_flush(import_writer_t *writer) {
+    for (int table = 0; table < IMPORT_TABLE_COUNT; table++) {
+        flush_table(writer, (import_table_t) table);
+    }
+    return writer->err;
+}
+
+bce_error_t import_writer_finish(import_writer_t *writer) {
+    import_writer_flush(writer);
+    for (int table = 0; table < IMPORT_TABLE_COUNT; table++) {
+        for (int i = 0; i < IMPORT_WRITER_BATCH_ROWS; i++) {
+            sqlite3_finalize(writer->stmts[table][i]);
+            writer->stmts[table][i] = NULL;
+        }
+    }
+    return writer->err;
+}
+
+/* `INSERT INTO <table> (...) VALUES (?,?,?),(?,?,?)...` for `row_count` rows */
+static sqlite3_stmt *prepare_insert(struct sqlite3 *conn, import_table_t table, int row_count, int *rc) {
+    const import_table_info_t *info = &TABLES[table];
+    size_t insert_len = strlen(info->insert);
+    size_t row_len = 2 + (size_t) info->column_count * 2;   // "(?,?,?)," per row
+    char *sql = malloc(insert_len + (size_t) row_count * row_len + 1);
+    if (!sql) {
+        *rc = SQLITE_NOMEM;
+        return NULL;
+    }
+    char *p = sql;
+    memcpy(p, info->insert, insert_len);
+    p += insert_len;
+    for (int row = 0; row < row_count; row++) {
+        if (row > 0) {
+            *p++ = ',';
+        }
+        *p++ = '(';
+        for (int column = 0; column < info->column_count; column++) {
+            if (column > 0) {
+                *p++ = ',';
+            }
+            *p++ = '?';
+        }
+        *p++ = ')';
+    }
+    *p = '\0';
+
+    sqlite3_stmt *stmt = NULL;
+    *rc = sqlite3_prepare_v3(conn, sql, (int) (p - sql), SQLITE_PREPARE_PERSISTENT, &stmt, NULL);
+    free(sql);
+    return stmt;
+}
+
+/* Queue a row, inserting the full queue (after the queues of the tables it refers to) */
+static void queue_row(import_writer_t *writer, import_table_t table, const void *row) {
+    if (writer->err != ERR_NONE) {
+        return;
+    }
+    writer->pending[table][writer->pending_count[table]++] = row;
+    if (writer->pending_count[table] < IMPORT_WRITER_BATCH_ROWS) {
+        return;
+    }
+    for (int parent = 0; parent < (int) table; parent++) {
+        flush_table(writer, (import_table_t) parent);
+    }
+    flush_table(writer, table);
+}
+
+/* Insert the queued rows, with one INSERT */
+static void flush_table(import_writer_t *writer, import_table_t table) {
+    size_t count = writer->pending_count[table];
+    writer->pending_count[table] = 0;
+    if ((writer->err != ERR_NONE) || (count == 0)) {
+        return;
+    }
+    sqlite3_stmt **stmt = &writer->stmts[table][count - 1];
+    if (!*stmt) {
+        int rc;
+        *stmt = prepare_insert(writer->conn, table, (int) count, &rc);
+        if (rc != SQLITE_OK) {
+            writer->err = ERR_SQLITE_ERROR;
+            return;
+        }
+    }
+    int column_count = TABLES[table].column_count;
+    for (size_t row = 0; row < count; row++) {
+        bind_row(*stmt, (int) row * column_count + 1, table, writer->pending[table][row]);
+    }
+    int rc = sqlite3_step(*stmt);
+    sqlite3_reset(*stmt);
+    writer->statement_count++;
+    if (rc != SQLITE_DONE) {
+        writer->err = ERR_SQLITE_ERROR;
+        return;
+    }
+    writer->row_count += count;
+}
+
+static void bind_row(sqlite3_stmt *stmt, int first, import_table_t table, const void *row) {
+    switch (table) {
+        case IMPORT_TABLE_COMMAND: {
+            const bce_command_t *cmd = (const bce_command_t *) row;
+            bind_str(stmt, first, cmd->uuid, false);
+            bind_str(stmt, first + 1, cmd->name, false);
+            bind_str(stmt, first + 2, cmd->parent_cmd_uuid, true);
+            break;
+        }
+        case IMPORT_TABLE_ALIAS: {
+            const bce_command_alias_t *alias = (const bce_command_alias_t *) row;
+            bind_str(stmt, first, alias->uuid, false);
+            bind_str(stmt, first + 1, alias->cmd_uuid, false);
+            bind_str(stmt, first + 2, alias->name, false);
+            break;
+        }
+        case IMPORT_TABLE_ARG: {
+            const bce_command_arg_t *arg = (const bce_command_arg_t *) row;
+            bind_str(stmt, first, arg->uuid, false);
+            bind_str(stmt, first + 1, arg->cmd_uuid, false);
+            bind_str(stmt, first + 2, arg->arg_type, false);
+            bind_str(stmt, first + 3, arg->description, true);
+            bind_str(stmt, first + 4, arg->long_name, true);
+            bind_str(stmt, first + 5, arg->short_name, true);
+            break;
+        }
+        case IMPORT_TABLE_OPT: {
+            const bce_command_opt_t *opt = (const bce_command_opt_t *) row;
+            bind_str(stmt, first, opt->uuid, false);
+            bind_str(stmt, first + 1, opt->cmd_arg_uuid, false);
+            bind_str(stmt, first + 2, opt->name, false);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void bind_str(sqlite3_stmt *stmt, int index, bce_str_t str, bool empty_is_null) {
+    size_t len = bce_str_len(str);
+    if (empty_is_null && (len == 0)) {
+        sqlite3_bind_null(stmt, index);
+    } else {
+        sqlite3_bind_text(stmt, index, str, (int) len, SQLITE_STATIC);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef BCE_IMPORT_WRITER_H
+#define BCE_IMPORT_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sqlite3.h>
+#include "data_model.h"
+#include "error.h"
+
+/*
+ * Writes command hierarchies to the database: rows are queued per table and inserted up to IMPORT_WRITER_BATCH_ROWS
+ * at a time, each queue with a single multi-row INSERT. The INSERT for a table and row count is prepared when first
+ * needed, and reused for the life of the writer. Values are bound with their lengths, as SQLITE_STATIC: the
+ * hierarchies must outlive the writer, up to `import_writer_finish()`.
+ *
+ * Parent rows are always inserted before their children (foreign keys): when a table's queue is full, the queues
+ * of the tables it refers to are flushed first.
+ */
+
+#define IMPORT_WRITER_BATCH_ROWS 64     /* 384 variables for command_arg: below SQLite's historical limit of 999 */
+
+typedef enum import_table_t {
+    IMPORT_TABLE_COMMAND,
+    IMPORT_TABLE_ALIAS,
+    IMPORT_TABLE_ARG,
+    IMPORT_TABLE_OPT,
+    IMPORT_TABLE_COUNT
+} import_table_t;
+
+typedef struct import_writer_t {
+    struct sqlite3 *conn;
+    sqlite3_stmt *stmts[IMPORT_TABLE_COUNT][IMPORT_WRITER_BATCH_ROWS];    /* by row count, minus 1 */
+    const void *pending[IMPORT_TABLE_COUNT][IMPORT_WRITER_BATCH_ROWS];
+    size_t pending_count[IMPORT_TABLE_COUNT];
+    size_t row_count;               /* inserted so far */
+    size_t statement_count;         /* INSERTs run so far */
+    bce_error_t err;                /* the first error: nothing is written after it */
+} import_writer_t;
+
+/* Start writing (within the caller's transaction, if any) */
+bce_error_t import_writer_init(import_writer_t *writer, struct sqlite3 *conn);
+
+/* Queue a command and its hierarchy (aliases, sub-commands, args, opts) */
+bce_error_t import_writer_add_command(import_writer_t *writer, const bce_command_t *cmd);
+
+/*
+ * Queue a single row: a bce_command_t, bce_command_alias_t, bce_command_arg_t or bce_command_opt_t (by `table`).
+ * Only its own fields are written. Its parent row must have been added first
+ */
+bce_error_t import_writer_add_row(import_writer_t *writer, import_table_t table, const void *row);
+
+/* Insert whatever is queued: the hierarchies added so far may then be freed */
+bce_error_t import_writer_flush(import_writer_t *writer);
+
+/* Insert whatever is still queued, and finalize the statements. Returns the first error, if any */
+bce_error_t import_writer_finish(import_writer_t *writer);
+
+#endif // BCE_IMPORT_WRITER_H
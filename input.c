@@ -1,175 +1,576 @@
 #include "input.h"
 #include <string.h>
 #include <errno.h>
-#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include "line_scan.h"
 #include "error.h"
 
-static inline bool is_space_or_equals(int c) {
-    if (isspace(c)) {
-        return true;
-    } else {
-        if (c == '=') {
-            return true;
-        }
-    }
-    return false;
+#define MIN_TOKEN_CAPACITY 16
+
+static bool next_token(const char *line, size_t end, size_t *pos, completion_token_t *token);
+
+static bool copy_token(const completion_input_t *input, int index, size_t max_token_len, char *dest, size_t max_len);
+
+static bce_str_t intern_token(arena_t *arena, const completion_input_t *input, int index, size_t max_token_len);
+
+static size_t current_word_len(const completion_input_t *input);
+
+static void find_current_token(completion_input_t *input);
+
+static size_t append_word(completion_input_t *input, const char *word, size_t pos);
+
+static void *keep_word(void *word);
+
+static inline completion_token_t make_token(size_t offset, size_t length, token_quote_t quote) {
+    completion_token_t token = {(uint32_t) offset, (uint32_t) length, (uint8_t) quote};
+    return token;
 }
 
 completion_input_t *create_completion_input(bce_error_t *err) {
-    const char *line = getenv(BASH_LINE_VAR);
+    return create_completion_input_from_env(NULL, err);
+}
+
+completion_input_t *create_completion_input_from_env(const char **envp, bce_error_t *err) {
+    const char *line = get_env_value(envp, BASH_LINE_VAR);
     if (!line || strlen(line) == 0) {
         *err = ERR_MISSING_ENV_COMP_LINE;
         return NULL;
     }
-    const char *str_cursor_pos = getenv(BASH_CURSOR_VAR);
+    const char *str_cursor_pos = get_env_value(envp, BASH_CURSOR_VAR);
     if (!str_cursor_pos || strlen(str_cursor_pos) == 0) {
         *err = ERR_MISSING_ENV_COMP_POINT;
         return NULL;
     }
-    completion_input_t *input = malloc(sizeof(completion_input_t));
-    input->line[0] = '\0';
-    strncat(input->line, line, MAX_CMD_LINE_SIZE);
-    input->cursor_pos = (int) strtol(str_cursor_pos, (char **) NULL, 10);
-    if ((input->cursor_pos == 0) && (errno != 0)) {
-        free(input);
+    int cursor_pos = (int) strtol(str_cursor_pos, (char **) NULL, 10);
+    if ((cursor_pos == 0) && (errno != 0)) {
         *err = ERR_INVALID_ENV_COMP_POINT;
         return NULL;
     }
+    completion_input_t *input = create_completion_input_from_line(line, cursor_pos, err);
+    if (input) {
+        input->match_mode = parse_match_mode(get_env_value(envp, BCE_MATCH_VAR));
+        input->correct_words = parse_flag(get_env_value(envp, BCE_CORRECT_VAR));
+        input->max_results = parse_max_results(get_env_value(envp, BCE_MAX_RESULTS_VAR));
+        input->output_format = parse_output_format(get_env_value(envp, BCE_OUTPUT_VAR));
+    }
+    return input;
+}
+
+/*
+ * The line is copied right after the struct, in the same allocation. Caller should use `free_completion_input()`
+ */
+completion_input_t *create_completion_input_from_line(const char *line, int cursor_pos, bce_error_t *err) {
+    size_t line_len = strlen(line);
+    completion_input_t *input = malloc(sizeof(completion_input_t) + line_len + 1);
+    if (!input) {
+        *err = ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    input->line = (char *) (input + 1);
+    memcpy(input->line, line, line_len + 1);
+    input->line_len = line_len;
+    input->cursor_pos = cursor_pos;
+    input->tokens = NULL;
+    input->token_count = 0;
+    input->token_capacity = 0;
+    input->pre_split = false;
+    input->match_mode = MATCH_PREFIX;
+    input->correct_words = false;
+    input->max_results = 0;
+    input->output_format = OUTPUT_DISPLAY;
+    input->corrections = NULL;
+    *err = tokenize_completion_input(input);
+    if (*err != ERR_NONE) {
+        return free_completion_input(input);
+    }
+    return input;
+}
+
+/*
+ * The words are joined with spaces into `line` (after the struct, in the same allocation), so the tokens
+ * point into it like the ones split from COMP_LINE. Caller should use `free_completion_input()`
+ */
+completion_input_t *create_completion_input_from_words(const char **words, size_t word_count, int current_word,
+                                                       bce_error_t *err) {
+    if ((current_word < 0) || ((size_t) current_word > word_count)) {
+        *err = ERR_INVALID_COMP_CWORD;
+        return NULL;
+    }
+
+    // a separator before each word, and one more for a new word after the last
+    size_t line_size = word_count + 1;
+    for (size_t i = 0; i < word_count; i++) {
+        line_size += strlen(words[i]);
+    }
+    completion_input_t *input = malloc(sizeof(completion_input_t) + line_size);
+    completion_token_t *tokens = malloc(((word_count > 0) ? word_count : 1) * sizeof(completion_token_t));
+    if (!input || !tokens) {
+        free(input);
+        free(tokens);
+        *err = ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    input->line = (char *) (input + 1);
+    input->tokens = tokens;
+    input->token_count = 0;
+    input->token_capacity = (word_count > 0) ? word_count : 1;
+    input->pre_split = true;
+    input->match_mode = MATCH_PREFIX;
+    input->correct_words = false;
+    input->max_results = 0;
+    input->output_format = OUTPUT_DISPLAY;
+    input->corrections = NULL;
+
+    size_t pos = 0;
+    size_t cursor_pos = 0;
+    for (size_t i = 0; i < word_count; i++) {
+        if (i > 0) {
+            input->line[pos++] = ' ';
+        }
+        pos = append_word(input, words[i], pos);
+        if (i == (size_t) current_word) {
+            cursor_pos = pos;
+        }
+    }
+    if ((size_t) current_word == word_count) {
+        input->line[pos++] = ' ';
+        cursor_pos = pos;
+    }
+    input->line[pos] = '\0';
+    input->line_len = pos;
+    input->cursor_pos = (int) cursor_pos;
+    find_current_token(input);
+
     *err = ERR_NONE;
     return input;
 }
 
+/*
+ * Copy a word to `line + pos` without its quotes and escapes, and add its token (an unquoted word must not be
+ * empty or "="). As on COMP_LINE, a quoted word ends at its closing quote. Returns the position after the word.
+ */
+static size_t append_word(completion_input_t *input, const char *word, size_t pos) {
+    char *line = input->line;
+    token_quote_t quote = TOKEN_UNQUOTED;
+    char closing_quote = '\0';
+    if ((word[0] == '\'') || (word[0] == '"')) {
+        quote = (word[0] == '\'') ? TOKEN_SINGLE_QUOTED : TOKEN_DOUBLE_QUOTED;
+        closing_quote = word[0];
+        line[pos++] = *word++;
+    } else if (strcmp(word, "=") == 0) {
+        line[pos++] = '=';
+        return pos;
+    }
+
+    size_t offset = pos;
+    for (; (*word != '\0') && (*word != closing_quote); word++) {
+        // bash keeps the backslashes in COMP_WORDS; inside double quotes, only these characters are escaped
+        if ((*word == '\\') && (word[1] != '\0') && (quote != TOKEN_SINGLE_QUOTED)
+            && ((quote == TOKEN_UNQUOTED) || (strchr("\"\\$`", word[1]) != NULL))) {
+            word++;
+        }
+        line[pos++] = *word;
+    }
+    size_t length = pos - offset;
+    if (*word != '\0') {
+        line[pos++] = *word;
+    }
+
+    if ((length > 0) || (quote != TOKEN_UNQUOTED)) {
+        input->tokens[input->token_count++] = make_token(offset, length, quote);
+    }
+    return pos;
+}
+
+/*
+ * Split the line once. The current word is found afterwards (see `find_current_token()`).
+ */
+bce_error_t tokenize_completion_input(completion_input_t *input) {
+    if (input->pre_split) {
+        find_current_token(input);
+        return ERR_NONE;
+    }
+    input->token_count = 0;
+    free(input->corrections);
+    input->corrections = NULL;
+
+    size_t pos = 0;
+    completion_token_t token;
+    while (next_token(input->line, input->line_len, &pos, &token)) {
+        if (input->token_count == input->token_capacity) {
+            size_t capacity = (input->token_capacity > 0) ? input->token_capacity * 2 : MIN_TOKEN_CAPACITY;
+            completion_token_t *tokens = realloc(input->tokens, capacity * sizeof(completion_token_t));
+            if (!tokens) {
+                return ERR_OUT_OF_MEMORY;
+            }
+            input->tokens = tokens;
+            input->token_capacity = capacity;
+        }
+        input->tokens[input->token_count++] = token;
+    }
+    find_current_token(input);
+    return ERR_NONE;
+}
+
+/*
+ * The current word is the last one that starts before the cursor (counting the opening quote),
+ * as if only the line up to the cursor had been split.
+ */
+static void find_current_token(completion_input_t *input) {
+    input->current_token = -1;
+    for (size_t i = 0; i < input->token_count; i++) {
+        const completion_token_t *token = &input->tokens[i];
+        size_t start = token->offset - ((token->quote != TOKEN_UNQUOTED) ? 1 : 0);
+        if ((input->cursor_pos <= 0) || (start >= (size_t) input->cursor_pos)) {
+            break;
+        }
+        input->current_token = (int) i;
+    }
+}
+
+const char *get_token(const completion_input_t *input, int index, size_t *len) {
+    if (!input || (index < 0) || ((size_t) index >= input->token_count)) {
+        return NULL;
+    }
+    if (input->corrections && input->corrections[index]) {
+        if (len) {
+            *len = bce_str_len(input->corrections[index]);
+        }
+        return input->corrections[index];
+    }
+    const completion_token_t *token = &input->tokens[index];
+    if (len) {
+        *len = token->length;
+    }
+    return input->line + token->offset;
+}
+
+const char *get_env_value(const char **envp, const char *name) {
+    if (!envp) {
+        return getenv(name);
+    }
+    size_t name_len = strlen(name);
+    for (const char **var = envp; *var != NULL; var++) {
+        if ((strncmp(*var, name, name_len) == 0) && ((*var)[name_len] == '=')) {
+            return *var + name_len + 1;
+        }
+    }
+    return NULL;
+}
+
+match_mode_t parse_match_mode(const char *value) {
+    if (value && (strcmp(value, "fuzzy") == 0)) {
+        return MATCH_FUZZY;
+    }
+    return MATCH_PREFIX;
+}
+
+bool parse_flag(const char *value) {
+    if (!value) {
+        return false;
+    }
+    return (strcmp(value, "1") == 0) || (strcmp(value, "true") == 0) || (strcmp(value, "yes") == 0)
+           || (strcmp(value, "on") == 0);
+}
+
+size_t parse_max_results(const char *value) {
+    if (!value) {
+        return 0;
+    }
+    char *end = NULL;
+    long long count = strtoll(value, &end, 10);
+    if ((end == value) || (*end != '\0') || (count <= 0)) {
+        return 0;
+    }
+    return (size_t) count;
+}
+
+output_format_t parse_output_format(const char *value) {
+    if (value && (strcmp(value, "words") == 0)) {
+        return OUTPUT_WORDS;
+    }
+    return OUTPUT_DISPLAY;
+}
+
+int parse_fd(const char *value) {
+    if (!value) {
+        return -1;
+    }
+    char *end = NULL;
+    long fd = strtol(value, &end, 10);
+    if ((end == value) || (*end != '\0') || (fd < 0) || (fd > INT_MAX) || (fcntl((int) fd, F_GETFD) == -1)) {
+        return -1;
+    }
+    return (int) fd;
+}
+
+bool correct_completion_input_word(completion_input_t *input, int index, bce_str_t word) {
+    if ((index < 0) || ((size_t) index >= input->token_count)) {
+        return false;
+    }
+    if (!input->corrections) {
+        input->corrections = calloc(input->token_count, sizeof(bce_str_t));
+        if (!input->corrections) {
+            return false;
+        }
+    }
+    input->corrections[index] = word;
+    return true;
+}
+
 completion_input_t *free_completion_input(completion_input_t *input) {
+    if (input) {
+        free(input->tokens);
+        free(input->corrections);
+    }
     free(input);
     return NULL;
 }
 
 bool get_command_from_input(const completion_input_t *input, char *dest, const size_t max_len) {
-    bool result = false;
-    memset(dest, 0, max_len);
-    linked_list_t *list = bash_input_to_list(input->line, MAX_CMD_LINE_SIZE);
-    if (list) {
-        if (list->head) {
-            char *data = (char *) list->head->data;
-            strncat(dest, data, max_len);
-            result = true;
-        }
-    }
-    return result;
+    return copy_token(input, 0, SIZE_MAX, dest, max_len);
 }
 
 bool get_current_word(const completion_input_t *input, char *dest, const size_t max_len) {
-    memset(dest, 0, max_len);
-    bool result = false;
-
-    // build a list of words, up to the current cursor position
-    linked_list_t *list = bash_input_to_list(input->line, input->cursor_pos);
-    if (list) {
-        if (list->size > 0) {
-            size_t elem = list->size - 1;
-            char *data = (char *) ll_get_nth_item(list, elem);
-            strncat(dest, data, max_len);
-            result = true;
-        }
-    }
-    list = ll_destroy(list);
-    return result;
+    return copy_token(input, input->current_token, current_word_len(input), dest, max_len);
 }
 
 bool get_previous_word(const completion_input_t *input, char *dest, size_t max_len) {
-    memset(dest, 0, max_len);
-    bool result = false;
-
-    // build a list of words, up to the current cursor position
-    linked_list_t *list = bash_input_to_list(input->line, input->cursor_pos);
-    if (list) {
-        if (list->size > 1) {
-            size_t elem = list->size - 2;   // next-to-last element (0-based)
-            char *data = (char *) ll_get_nth_item(list, elem);
-            strncat(dest, data, max_len);
-            result = true;
+    return copy_token(input, input->current_token - 1, SIZE_MAX, dest, max_len);
+}
+
+bce_str_t get_command_word_in(arena_t *arena, const completion_input_t *input) {
+    return intern_token(arena, input, 0, SIZE_MAX);
+}
+
+bce_str_t get_current_word_in(arena_t *arena, const completion_input_t *input) {
+    return intern_token(arena, input, input->current_token, current_word_len(input));
+}
+
+bce_str_t get_previous_word_in(arena_t *arena, const completion_input_t *input) {
+    return intern_token(arena, input, input->current_token - 1, SIZE_MAX);
+}
+
+bce_str_t get_completion_prefix_in(arena_t *arena, const completion_input_t *input) {
+    if (get_cursor_token(input) < 0) {
+        return bce_str_empty();
+    }
+    return intern_token(arena, input, input->current_token, current_word_len(input));
+}
+
+int get_cursor_token(const completion_input_t *input) {
+    if (input->current_token < 0) {
+        return -1;
+    }
+    // the cursor may be right after the closing quote
+    const completion_token_t *token = &input->tokens[input->current_token];
+    size_t end = token->offset + token->length + ((token->quote != TOKEN_UNQUOTED) ? 1 : 0);
+    if ((size_t) input->cursor_pos > end) {
+        return -1;
+    }
+    return input->current_token;
+}
+
+token_quote_t get_cursor_quote(const completion_input_t *input) {
+    int index = get_cursor_token(input);
+    return (index < 0) ? TOKEN_UNQUOTED : (token_quote_t) input->tokens[index].quote;
+}
+
+/*
+ * Unquoted, the characters special to the shell are escaped with a backslash. In quotes, only the ones that end or
+ * expand inside them are: in double quotes with a backslash, in single quotes by closing and reopening them.
+ */
+char *quote_word_in(arena_t *arena, const char *word, size_t len, token_quote_t quote) {
+    // at most `'$'\ooo''` for each character
+    char *quoted = arena_alloc(arena, (len * 9) + 1);
+    if (!quoted) {
+        return NULL;
+    }
+    const char *close_and_reopen = (quote == TOKEN_SINGLE_QUOTED) ? "'" : (quote == TOKEN_DOUBLE_QUOTED) ? "\"" : "";
+    char *p = quoted;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) word[i];
+        if ((c < 0x20) || (c == 0x7f)) {
+            p += sprintf(p, "%s$'\\%03o'%s", close_and_reopen, c, close_and_reopen);
+            continue;
+        }
+        if (quote == TOKEN_SINGLE_QUOTED) {
+            if (c == '\'') {
+                p += sprintf(p, "'\\''");
+                continue;
+            }
+        } else if (((quote == TOKEN_DOUBLE_QUOTED) && (strchr("\"\\$`", c) != NULL))
+                   || ((quote == TOKEN_UNQUOTED) && (strchr(" '\"\\$`<>|&;()*?[]{}!#~^", c) != NULL))) {
+            *p++ = '\\';
         }
+        *p++ = (char) c;
     }
-    list = ll_destroy(list);
-    return result;
+    *p = '\0';
+    return quoted;
+}
+
+/*
+ * The current word stops at the cursor.
+ */
+static size_t current_word_len(const completion_input_t *input) {
+    if (input->current_token < 0) {
+        return 0;
+    }
+    return (size_t) input->cursor_pos - input->tokens[input->current_token].offset;
+}
+
+/*
+ * Copy up to `max_token_len` characters of a token into `dest` (empty, and false, if there is no such token).
+ * `dest` is only terminated, not cleared.
+ */
+static bool copy_token(const completion_input_t *input, int index, size_t max_token_len, char *dest, size_t max_len) {
+    dest[0] = '\0';
+    size_t len = 0;
+    const char *text = get_token(input, index, &len);
+    if (!text) {
+        return false;
+    }
+    if (len > max_token_len) {
+        len = max_token_len;
+    }
+    strncat(dest, text, (len < max_len) ? len : max_len);
+    return true;
+}
+
+static bce_str_t intern_token(arena_t *arena, const completion_input_t *input, int index, size_t max_token_len) {
+    size_t len = 0;
+    const char *text = get_token(input, index, &len);
+    if (!text) {
+        return bce_str_empty();
+    }
+    return str_pool_intern_n(arena, text, (len < max_token_len) ? len : max_token_len);
 }
 
 /*
  * Split the cmd_line into discrete items, based on the same rules that BASH uses.
  */
 linked_list_t *bash_input_to_list(const char *cmd_line, const size_t max_len) {
-    linked_list_t *list = ll_create(NULL);
-
-    enum states {
-        NADA, IN_WORD, IN_QUOTE, IN_DBL_QUOTE
-    } state = NADA;
-
-    const char *p;                  // pointer to the current character
-    char *start_of_word = NULL;     // pointer to the start of a word
-    size_t c_count = 0;             // num of parsed characters (don't exceed max_len)
-
-    for (p = cmd_line; *p != '\0'; p++) {
-        bool got_word = false;
-        int c = (unsigned char) *p;  // convert to unsigned char for is* functions
-        switch (state) {
-            case NADA:  // not in a word or quotes
-                if (isspace(c)) {
-                    // ignore
-                    break;
-                }
-                // not a space - transition to new state
-                if (c == '\'') {
-                    state = IN_QUOTE;
-                    start_of_word = (char *) p + 1;  // word starts at next char
-                    break;
-                } else if (c == '"') {
-                    state = IN_DBL_QUOTE;
-                    start_of_word = (char *) p + 1;  // word starts at next char
-                    break;
-                } else {
-                    state = IN_WORD;
-                    start_of_word = (char *) p;
-                    break;
-                }
-            case IN_WORD:
-                // keep going until we get a space
-                got_word = is_space_or_equals(c);
-                break;
-            case IN_QUOTE:
-                // keep going until get a quote
-                got_word = (c == '\'');
-                break;
-            case IN_DBL_QUOTE:
-                got_word = (c == '"');
-                break;
+    return bash_input_to_list_in(NULL, cmd_line, max_len);
+}
+
+/*
+ * Same as `bash_input_to_list()`, but the list and its words are allocated from `arena`.
+ */
+linked_list_t *bash_input_to_list_in(arena_t *arena, const char *cmd_line, const size_t max_len) {
+    // the words are interned, and released with their pool
+    linked_list_t *list = ll_create_in(arena, &keep_word);
+
+    size_t end = strnlen(cmd_line, max_len);
+    size_t pos = 0;
+    completion_token_t token;
+    while (next_token(cmd_line, end, &pos, &token)) {
+        ll_append_item(list, str_pool_intern_n(arena, cmd_line + token.offset, token.length));
+    }
+    return list;
+}
+
+/*
+ * Same as `bash_input_to_list_in()`, from the tokens already split by `tokenize_completion_input()`.
+ * The word under the cursor is still being typed, so it is left out: it is what is being completed.
+ */
+linked_list_t *completion_input_to_list_in(arena_t *arena, const completion_input_t *input) {
+    linked_list_t *list = ll_create_in(arena, &keep_word);
+    int cursor_token = get_cursor_token(input);
+    for (int i = 0; i < (int) input->token_count; i++) {
+        if (i == cursor_token) {
+            continue;
         }
-        if (got_word) {
-            // collect the word we just read, from start_of_word..p (exclusive)
-            size_t word_len = p - start_of_word;
-            char *word = calloc(word_len + 1, sizeof(char));
-            strncat(word, start_of_word, word_len);
-            ll_append_item(list, word);
-            // change state
-            state = NADA;
-            got_word = false;
-            start_of_word = NULL;
+        size_t len = 0;
+        const char *word = get_token(input, i, &len);
+        ll_append_item(list, str_pool_intern_n(arena, word, len));
+    }
+    return list;
+}
+
+/*
+ * Find the next word in `line[*pos..end)`, based on the same rules that BASH uses, and move `pos` past it.
+ * Quoted words exclude their quotes. Only the word boundaries are visited: `line_scan_find()` skips over
+ * the characters in between.
+ */
+static bool next_token(const char *line, size_t end, size_t *pos, completion_token_t *token) {
+    // skip the spaces between words
+    size_t i = line_scan_find(line, *pos, end, LINE_SCAN_NOT_SPACE);
+    if (i >= end) {
+        *pos = end;
+        return false;
+    }
+
+    // the word ends at the closing quote, or at a space or '=' (the last one may not be terminated)
+    token_quote_t quote = TOKEN_UNQUOTED;
+    size_t start_of_word = i;
+    size_t end_of_word;
+    if (line[i] == '\'') {
+        quote = TOKEN_SINGLE_QUOTED;
+        start_of_word = i + 1;
+        end_of_word = line_scan_find(line, start_of_word, end, LINE_SCAN_QUOTE);
+    } else if (line[i] == '"') {
+        quote = TOKEN_DOUBLE_QUOTED;
+        start_of_word = i + 1;
+        end_of_word = line_scan_find(line, start_of_word, end, LINE_SCAN_DBL_QUOTE);
+    } else {
+        end_of_word = line_scan_find(line, i + 1, end, LINE_SCAN_SPACE_OR_EQUALS);
+    }
+    *token = make_token(start_of_word, end_of_word - start_of_word, quote);
+
+    // continue after the delimiter
+    *pos = end_of_word + 1;
+    return true;
+}
+
+/*
+ * Hash the words once, so each lookup is O(1) instead of a scan of the command line.
+ */
+hash_map_t *word_set_create(const linked_list_t *word_list) {
+    if (!word_list) {
+        return NULL;
+    }
+    hash_map_t *word_set = hm_create(word_list->size);
+    if (!word_set) {
+        return NULL;
+    }
+    for (linked_list_node_t *node = word_list->head; node != NULL; node = node->next) {
+        bce_str_t word = (bce_str_t) node->data;
+        if (bce_str_len(word) > 0) {
+            hm_put_n(word_set, word, bce_str_len(word), (void *) word);
         }
-        // make sure we only compare up to `max_len` characters
-        c_count++;
-        if (c_count >= max_len) {
-            break;
+    }
+    return word_set;
+}
+
+hash_map_t *word_set_create_from_input(const completion_input_t *input) {
+    if (!input) {
+        return NULL;
+    }
+    hash_map_t *word_set = hm_create(input->token_count);
+    if (!word_set) {
+        return NULL;
+    }
+    // as in `completion_input_to_list_in()`, the word under the cursor is not on the command line yet
+    int cursor_token = get_cursor_token(input);
+    for (int i = 0; i < (int) input->token_count; i++) {
+        size_t len = 0;
+        const char *word = get_token(input, i, &len);
+        if ((len > 0) && (i != cursor_token)) {
+            hm_put_n(word_set, word, len, (void *) word);
         }
     }
+    return word_set;
+}
 
-    // check if we have a remaining word in the buffer
-    if ((state != NADA) && (start_of_word)) {
-        // make sure we don't consider more characters than allowed
-        // `(p + 1) - start_of_word` gets all characters (inclusive)
-        size_t word_len = (p + 1) - start_of_word;
-        char *word = calloc(word_len + 1, sizeof(char));
-        strncat(word, start_of_word, word_len);
-        ll_append_item(list, word);
+bool is_word_in_set(const hash_map_t *word_set, bce_str_t str) {
+    if (!word_set || !str || (bce_str_len(str) == 0)) {
+        return false;
     }
+    return hm_get_n(word_set, str, bce_str_len(str)) != NULL;
+}
 
-    return list;
-}
\ No newline at end of file
+static void *keep_word(void *word) {
+    return NULL;
+}
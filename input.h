@@ -3,29 +3,183 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "linked_list.h"
+#include "str_pool.h"
+#include "hash_map.h"
 #include "error.h"
 
-#define MAX_CMD_LINE_SIZE  4096
-
 static const char *BASH_LINE_VAR = "COMP_LINE";
 static const char *BASH_CURSOR_VAR = "COMP_POINT";
+static const char *BASH_WORDS_VAR = "COMP_WORDS";
+static const char *BASH_CWORD_VAR = "COMP_CWORD";
+static const char *BCE_MATCH_VAR = "BCE_MATCH";
+static const char *BCE_CORRECT_VAR = "BCE_CORRECT";
+static const char *BCE_MAX_RESULTS_VAR = "BCE_MAX_RESULTS";
+static const char *BCE_OUTPUT_VAR = "BCE_OUTPUT";
+static const char *BCE_DESC_FD_VAR = "BCE_DESC_FD";
+
+/* How the word under the cursor selects the recommendations ($BCE_MATCH: `prefix`, the default, or `fuzzy`) */
+typedef enum match_mode_t {
+    MATCH_PREFIX = 0,       /* the ones starting with it */
+    MATCH_FUZZY,            /* the ones containing its characters in order, best first (see fuzzy.h) */
+    MATCH_TYPO              /* the ones a typo or two away, nearest first (not selectable: used if nothing matched) */
+} match_mode_t;
+
+/* What is collected (and printed) for each recommendation ($BCE_OUTPUT: `display`, the default, or `words`) */
+typedef enum output_format_t {
+    OUTPUT_DISPLAY = 0,     /* the text to show, e.g. `get (g)` or `--namespace (-n)` */
+    OUTPUT_WORDS            /* `<word>\t<display>\t<description>`: the word to insert, quoted (see `quote_word_in()`) */
+} output_format_t;
+
+typedef enum token_quote_t {
+    TOKEN_UNQUOTED = 0,
+    TOKEN_SINGLE_QUOTED,
+    TOKEN_DOUBLE_QUOTED
+} token_quote_t;
 
+/* A word on the command line: `length` characters at `line + offset`, without the quotes */
+typedef struct completion_token_t {
+    uint32_t offset;
+    uint32_t length;
+    uint8_t quote;          /* token_quote_t; the closing quote may be missing */
+} completion_token_t;
+
+/* The command line (of any length), and its words */
 typedef struct completion_input_t {
-    char line[MAX_CMD_LINE_SIZE + 1];
+    char *line;             /* allocated with the input */
+    size_t line_len;
     int cursor_pos;
+    /* `line`, split once by `tokenize_completion_input()` */
+    completion_token_t *tokens;
+    size_t token_count;
+    size_t token_capacity;
+    int current_token;      /* the word at (or just before) the cursor; -1 if none */
+    bool pre_split;         /* the tokens are bash's words (see `create_completion_input_from_words()`) */
+    match_mode_t match_mode;
+    bool correct_words;     /* $BCE_CORRECT=1: complete as if misspelled sub-commands and args were typed correctly */
+    size_t max_results;     /* $BCE_MAX_RESULTS: only recommend the best ones (0: all of them) */
+    output_format_t output_format;
+    bce_str_t *corrections; /* per token: the word read instead of it (NULL if not corrected, or none is) */
 } completion_input_t;
 
 completion_input_t *create_completion_input(bce_error_t *err);
 
+/*
+ * Same as `create_completion_input()`, but reads the variables (and BCE_MATCH, BCE_CORRECT, BCE_MAX_RESULTS and
+ * BCE_OUTPUT) from a NULL-terminated `KEY=VALUE` array
+ */
+completion_input_t *create_completion_input_from_env(const char **envp, bce_error_t *err);
+
+/* Same as `create_completion_input()`, from the values of COMP_LINE and COMP_POINT (matching by prefix) */
+completion_input_t *create_completion_input_from_line(const char *line, int cursor_pos, bce_error_t *err);
+
+/*
+ * Same as `create_completion_input()`, from the words bash has already split (COMP_WORDS) and the index of
+ * the word at the cursor (COMP_CWORD), e.g. passed by a `complete -F` function. The line is not split again:
+ * each word is one token, with its quotes and backslash escapes removed. Bash splits `--name=value` into
+ * `--name`, `=` and `value`; the `=` words are skipped, as '=' ends a word on COMP_LINE.
+ * The cursor is at the end of the current word (`current_word` may be `word_count`, for a new word).
+ */
+completion_input_t *create_completion_input_from_words(const char **words, size_t word_count, int current_word,
+                                                       bce_error_t *err);
+
+/*
+ * Read `word` instead of the token at `index` from now on (`get_token()` and everything built on it),
+ * e.g. the correction of a misspelled one. `word` is not copied. Splitting the line again drops the corrections.
+ */
+bool correct_completion_input_word(completion_input_t *input, int index, bce_str_t word);
+
+/* Look up `name` in a NULL-terminated `KEY=VALUE` array (uses the process environment when `envp` is NULL) */
+const char *get_env_value(const char **envp, const char *name);
+
+/* The match mode named by `value` (MATCH_PREFIX if NULL or unknown) */
+match_mode_t parse_match_mode(const char *value);
+
+/* Whether `value` turns an option on (`1`, `true`, `yes` or `on`) */
+bool parse_flag(const char *value);
+
+/* The number of recommendations `value` limits the output to (0, for no limit, if NULL or not a positive number) */
+size_t parse_max_results(const char *value);
+
+/* The output format named by `value` (OUTPUT_DISPLAY if NULL or unknown) */
+output_format_t parse_output_format(const char *value);
+
+/* The file descriptor number in `value` (e.g. $BCE_DESC_FD), or -1 if NULL, not a number or not open */
+int parse_fd(const char *value);
+
 completion_input_t *free_completion_input(completion_input_t *input);
 
+/*
+ * Split `line` into tokens (done on creation); call again after changing `cursor_pos`.
+ * Inputs built from bash's words keep their tokens, and only find the current one again.
+ */
+bce_error_t tokenize_completion_input(completion_input_t *input);
+
+/*
+ * The characters of a token (or its correction), not NUL-terminated, and their number in `len`
+ * (NULL if there is no such token)
+ */
+const char *get_token(const completion_input_t *input, int index, size_t *len);
+
+/* Split (at most `max_len` characters of) the command line into words (interned `bce_str_t`, in the process-wide pool) */
 linked_list_t *bash_input_to_list(const char *str, size_t max_len);
 
+/* Same as `bash_input_to_list()`, with the list and the words in `arena` */
+linked_list_t *bash_input_to_list_in(arena_t *arena, const char *str, size_t max_len);
+
+/*
+ * Same as `bash_input_to_list_in()`, from the input's tokens (without splitting the line again).
+ * The word under the cursor (see `get_cursor_token()`) is left out: it is being completed, not typed yet.
+ */
+linked_list_t *completion_input_to_list_in(arena_t *arena, const completion_input_t *input);
+
+/*
+ * Hash the words from `bash_input_to_list()`, for exact lookups with `is_word_in_set()` (NULL if `word_list` is).
+ * The words are not copied. Caller should use `hm_destroy()`
+ */
+hash_map_t *word_set_create(const linked_list_t *word_list);
+
+/*
+ * Same as `word_set_create()`, keyed by the input's tokens, except the word under the cursor
+ * (nothing is copied; the set must not outlive `input`)
+ */
+hash_map_t *word_set_create_from_input(const completion_input_t *input);
+
+/* Check if `str` is one of the words on the command line (exact match; never matches an empty string) */
+bool is_word_in_set(const hash_map_t *word_set, bce_str_t str);
+
+/* Copy (at most `max_len` characters of) the 1st word, the current word (up to the cursor) or the word before it */
 bool get_command_from_input(const completion_input_t *input, char *dest, size_t max_len);
 
 bool get_current_word(const completion_input_t *input, char *dest, size_t max_len);
 
 bool get_previous_word(const completion_input_t *input, char *dest, size_t max_len);
 
+/* Same as the above, interned in `arena`'s pool whatever their length (empty if there is no such word) */
+bce_str_t get_command_word_in(arena_t *arena, const completion_input_t *input);
+
+bce_str_t get_current_word_in(arena_t *arena, const completion_input_t *input);
+
+bce_str_t get_previous_word_in(arena_t *arena, const completion_input_t *input);
+
+/* How the word under the cursor is quoted (TOKEN_UNQUOTED if the cursor is not in a word) */
+token_quote_t get_cursor_quote(const completion_input_t *input);
+
+/*
+ * Quote `len` characters of `word` so the shell reads them back as one word, after the opening quote (if any)
+ * of the word under the cursor: special characters are escaped, and control characters are written as $'\ooo',
+ * so the result has no tabs or newlines. Allocated in `arena`.
+ */
+char *quote_word_in(arena_t *arena, const char *word, size_t len, token_quote_t quote);
+
+/*
+ * The part of the word under the cursor that precedes it, to filter the recommendations with
+ * (empty if the cursor is not in a word, e.g. after a space).
+ */
+bce_str_t get_completion_prefix_in(arena_t *arena, const completion_input_t *input);
+
+/* The index of the token the cursor is in, i.e. the one `get_completion_prefix_in()` is from (-1 if none) */
+int get_cursor_token(const completion_input_t *input);
+
 #endif // BCE_INPUT_H
@@ -0,0 +1,118 @@
+#include "ipc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+bool ipc_socket_path(char *dest, size_t max_len) {
+    int len;
+    const char *path = getenv(BCE_SOCKET_VAR);
+    if (path && (strlen(path) > 0)) {
+        len = snprintf(dest, max_len, "%s", path);
+    } else {
+        const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+        if (runtime_dir && (strlen(runtime_dir) > 0)) {
+            len = snprintf(dest, max_len, "%s/%s", runtime_dir, BCE_SOCKET_FILENAME);
+        } else {
+            len = snprintf(dest, max_len, "/tmp/bce-%u.sock", (unsigned int) getuid());
+        }
+    }
+    return (len > 0) && ((size_t) len < max_len);
+}
+
+bool ipc_write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, buf, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += written;
+        len -= (size_t) written;
+    }
+    return true;
+}
+
+bool ipc_read_all(int fd, char **pbuf, size_t *len, size_t max_len, int timeout_ms) {
+    size_t capacity = 4096;
+    size_t used = 0;
+    char *buf = malloc(capacity + 1);
+    if (!buf) {
+        return false;
+    }
+
+    for (;;) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            // timeout or error
+            free(buf);
+            return false;
+        }
+
+        if (used == capacity) {
+            if (capacity >= max_len) {
+                free(buf);
+                return false;
+            }
+            capacity *= 2;
+            char *bigger = realloc(buf, capacity + 1);
+            if (!bigger) {
+                free(buf);
+                return false;
+            }
+            buf = bigger;
+        }
+
+        ssize_t count = read(fd, buf + used, capacity - used);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            free(buf);
+            return false;
+        }
+        if (count == 0) {
+            // EOF
+            break;
+        }
+        used += (size_t) count;
+    }
+
+    buf[used] = '\0';
+    *pbuf = buf;
+    *len = used;
+    return true;
+}
+
+const char **ipc_request_to_envp(char *buf, size_t len) {
+    // count the NUL-terminated strings
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] == '\0') {
+            count++;
+        }
+    }
+
+    const char **envp = calloc(count + 1, sizeof(char *));
+    if (!envp) {
+        return NULL;
+    }
+    size_t n = 0;
+    char *start = buf;
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] == '\0') {
+            envp[n++] = start;
+            start = buf + i + 1;
+        }
+    }
+    envp[n] = NULL;
+    return envp;
+}
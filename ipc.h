@@ -0,0 +1,45 @@
+#ifndef BCE_IPC_H
+#define BCE_IPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Wire protocol between the completion client and `bce --serve`.
+ *
+ * request:  NUL-terminated `KEY=VALUE` strings (e.g. COMP_LINE, COMP_POINT), ended by the client's write shutdown
+ * response: the recommendations, one per line, ended by the server closing the connection; if BCE_MAX_RESULTS left
+ *           some out, they are followed by a NUL and their number (in decimal). With BCE_OUTPUT=words, each line is
+ *           a `<word>\t<display>\t<description>` record
+ *
+ * This header must not depend on SQLite, json-c or cURL, since the client is built without them.
+ */
+
+#define BCE_SOCKET_VAR          "BCE_SOCKET"
+#define BCE_SOCKET_FILENAME     "bce.sock"
+#define IPC_MAX_REQUEST_SIZE    (16 * 1024 * 1024)
+#define IPC_MAX_RESPONSE_SIZE   (16 * 1024 * 1024)
+
+/* Variables forwarded from the client's environment to the server */
+static const char *IPC_FORWARDED_VARS[] = {"COMP_LINE", "COMP_POINT", "BCE_MATCH", "BCE_CORRECT", "BCE_MAX_RESULTS",
+                                           "BCE_OUTPUT", NULL};
+
+/* Shown on stderr, after the recommendations, with the number of the ones left out by BCE_MAX_RESULTS */
+#define BCE_OMITTED_FORMAT      "... and %s more\n"
+
+/* With BCE_OUTPUT=words and $BCE_DESC_FD open, the count goes there instead: a last record, with no word to insert */
+#define BCE_OMITTED_RECORD_FORMAT   "\t... and %s more\t\n"
+
+/* Determine the path of the server socket ($BCE_SOCKET, $XDG_RUNTIME_DIR/bce.sock or /tmp/bce-<uid>.sock) */
+bool ipc_socket_path(char *dest, size_t max_len);
+
+/* Write the entire buffer, retrying on partial writes */
+bool ipc_write_all(int fd, const char *buf, size_t len);
+
+/* Read until EOF (or `max_len` bytes), waiting at most `timeout_ms` for each read. Caller frees `*pbuf` */
+bool ipc_read_all(int fd, char **pbuf, size_t *len, size_t max_len, int timeout_ms);
+
+/* Split a request into a NULL-terminated `KEY=VALUE` array. Pointers refer into `buf`. Caller frees the array */
+const char **ipc_request_to_envp(char *buf, size_t len);
+
+#endif // BCE_IPC_H
@@ -0,0 +1,663 @@
+#include "json_import.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "arena.h"
+#include "str_pool.h"
+#include "uuid4.h"
+
+#define JSON_IMPORT_RELEASE_SIZE    (16 * 1024 * 1024)  /* of the file parsed, given back at once */
+#define JSON_ROW_FIELD_COUNT        5
+
+typedef enum json_token_t {
+    JSON_TOKEN_ERROR,
+    JSON_TOKEN_EOF,
+    JSON_TOKEN_OBJECT_START,
+    JSON_TOKEN_OBJECT_END,
+    JSON_TOKEN_ARRAY_START,
+    JSON_TOKEN_ARRAY_END,
+    JSON_TOKEN_COLON,
+    JSON_TOKEN_COMMA,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_SCALAR,          /* number, true or false (as text) */
+    JSON_TOKEN_NULL
+} json_token_t;
+
+typedef struct json_field_t {
+    char *data;                 /* NULL if absent */
+    size_t len;
+} json_field_t;
+
+/* An object being parsed: its fields are kept until its row is written, and its uuid until its nested rows are */
+typedef struct json_row_t {
+    import_table_t table;
+    json_field_t fields[JSON_ROW_FIELD_COUNT];  /* see FIELD_NAMES */
+    const struct json_row_t *parent;
+    bool written;
+} json_row_t;
+
+typedef struct json_parser_t {
+    const char *data;           /* the mapped file */
+    size_t size;
+    const char *pos;
+    size_t released;            /* bytes at the start of the mapping given back */
+    char *text;                 /* the last string (decoded) or scalar, NUL-terminated */
+    size_t text_len;
+    size_t text_capacity;
+    import_writer_t *writer;
+    arena_t *batch;             /* rows queued since the last flush */
+    size_t batch_rows;
+    int depth;
+    bce_error_t err;            /* the first error */
+} json_parser_t;
+
+typedef struct json_nested_t {
+    import_table_t table;
+    const char *key;
+    import_table_t child_table;
+} json_nested_t;
+
+/* The fields of each table, uuid first */
+static const char *FIELD_NAMES[IMPORT_TABLE_COUNT][JSON_ROW_FIELD_COUNT] = {
+        {"uuid", "name"},
+        {"uuid", "name"},
+        {"uuid", "arg_type", "description", "long_name", "short_name"},
+        {"uuid", "name"},
+};
+
+static const json_nested_t NESTED[] = {
+        {IMPORT_TABLE_COMMAND, "aliases",      IMPORT_TABLE_ALIAS},
+        {IMPORT_TABLE_COMMAND, "args",         IMPORT_TABLE_ARG},
+        {IMPORT_TABLE_COMMAND, "sub_commands", IMPORT_TABLE_COMMAND},
+        {IMPORT_TABLE_ARG,     "opts",         IMPORT_TABLE_OPT},
+};
+
+static bool parse_document(json_parser_t *parser);
+
+static bool parse_row(json_parser_t *parser, import_table_t table, const json_row_t *parent);
+
+static bool parse_rows(json_parser_t *parser, json_token_t token, import_table_t table, const json_row_t *parent);
+
+static bool skip_value(json_parser_t *parser, json_token_t token);
+
+static bool write_row(json_parser_t *parser, json_row_t *row);
+
+static bool flush(json_parser_t *parser);
+
+static json_token_t next_token(json_parser_t *parser);
+
+static json_token_t read_string(json_parser_t *parser);
+
+static json_token_t read_scalar(json_parser_t *parser, const char *start);
+
+static bool read_hex4(const char **pos, const char *end, uint32_t *code);
+
+static bool append_utf8(json_parser_t *parser, uint32_t code);
+
+static bool append_text(json_parser_t *parser, const char *str, size_t len);
+
+static bool text_is(const json_parser_t *parser, const char *str);
+
+static bool copy_field(json_parser_t *parser, json_field_t *field, const char *str, size_t len);
+
+static bce_str_t field_str(arena_t *arena, const json_field_t *field);
+
+static bool enter(json_parser_t *parser);
+
+static bool fail(json_parser_t *parser, bce_error_t err);
+
+bce_error_t json_import_file(import_writer_t *writer, const char *filename) {
+    json_parser_t parser;
+    memset(&parser, 0, sizeof(json_parser_t));
+    parser.writer = writer;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return ERR_READ_FILE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return ERR_READ_FILE;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return ERR_INVALID_JSON;
+    }
+    parser.size = (size_t) st.st_size;
+    void *data = mmap(NULL, parser.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        return ERR_READ_FILE;
+    }
+    madvise(data, parser.size, MADV_SEQUENTIAL);
+    parser.data = (const char *) data;
+    parser.pos = parser.data;
+
+    parser.batch = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    if (!parser.batch) {
+        fail(&parser, ERR_OUT_OF_MEMORY);
+    } else {
+        parse_document(&parser);
+        // the rows queued refer to the batch arena
+        flush(&parser);
+    }
+
+    munmap(data, parser.size);
+    parser.batch = arena_destroy(parser.batch);
+    free(parser.text);
+    return parser.err;
+}
+
+/* `{"command": {...}}` */
+static bool parse_document(json_parser_t *parser) {
+    bool found = false;
+    if (next_token(parser) != JSON_TOKEN_OBJECT_START) {
+        return fail(parser, ERR_INVALID_JSON);
+    }
+    json_token_t token = next_token(parser);
+    while (token != JSON_TOKEN_OBJECT_END) {
+        if (token != JSON_TOKEN_STRING) {
+            return fail(parser, ERR_INVALID_JSON);
+        }
+        bool is_command = text_is(parser, "command");
+        if (next_token(parser) != JSON_TOKEN_COLON) {
+            return fail(parser, ERR_INVALID_JSON);
+        }
+        token = next_token(parser);
+        if (is_command && (token == JSON_TOKEN_OBJECT_START)) {
+            if (!parse_row(parser, IMPORT_TABLE_COMMAND, NULL)) {
+                return false;
+            }
+            found = true;
+        } else if (!skip_value(parser, token)) {
+            return false;
+        }
+        token = next_token(parser);
+        if (token == JSON_TOKEN_COMMA) {
+            token = next_token(parser);
+        } else if (token != JSON_TOKEN_OBJECT_END) {
+            return fail(parser, ERR_INVALID_JSON);
+        }
+    }
+    if (next_token(parser) != JSON_TOKEN_EOF) {
+        return fail(parser, ERR_INVALID_JSON);
+    }
+    return found || fail(parser, ERR_INVALID_CMD);
+}
+
+/* A command, alias, arg or opt object (after its `{`) */
+static bool parse_row(json_parser_t *parser, import_table_t table, const json_row_t *parent) {
+    json_row_t row;
+    memset(&row, 0, sizeof(json_row_t));
+    row.table = table;
+    row.parent = parent;
+    bool ok = false;
+
+    if (!enter(parser)) {
+        goto done;
+    }
+    json_token_t token = next_token(parser);
+    while (token != JSON_TOKEN_OBJECT_END) {
+        if (token != JSON_TOKEN_STRING) {
+            fail(parser, ERR_INVALID_JSON);
+            goto done;
+        }
+        // match the key before the value replaces it
+        int field = -1;
+        for (int i = 0; (i < JSON_ROW_FIELD_COUNT) && FIELD_NAMES[table][i]; i++) {
+            if (text_is(parser, FIELD_NAMES[table][i])) {
+                field = i;
+                break;
+            }
+        }
+        const json_nested_t *nested = NULL;
+        for (size_t i = 0; (field < 0) && (i < sizeof(NESTED) / sizeof(NESTED[0])); i++) {
+            if ((NESTED[i].table == table) && text_is(parser, NESTED[i].key)) {
+                nested = &NESTED[i];
+                break;
+            }
+        }
+        if (next_token(parser) != JSON_TOKEN_COLON) {
+            fail(parser, ERR_INVALID_JSON);
+            goto done;
+        }
+
+        token = next_token(parser);
+        if (nested) {
+            if (!parent && !row.fields[1].data) {
+                // the root command is replaced by name
+                fail(parser, ERR_JSON_KEY_ORDER);
+                goto done;
+            }
+            // the row's own fields are known: it goes before the rows nested in it
+            if ((!row.written && !write_row(parser, &row)) || !parse_rows(parser, token, nested->child_table, &row)) {
+                goto done;
+            }
+        } else if ((field >= 0) && ((token == JSON_TOKEN_STRING) || (token == JSON_TOKEN_SCALAR))) {
+            if (row.written) {
+                fail(parser, ERR_JSON_KEY_ORDER);
+                goto done;
+            }
+            if (!copy_field(parser, &row.fields[field], parser->text, parser->text_len)) {
+                goto done;
+            }
+        } else if (!skip_value(parser, token)) {
+            goto done;
+        }
+
+        token = next_token(parser);
+        if (token == JSON_TOKEN_COMMA) {
+            token = next_token(parser);
+        } else if (token != JSON_TOKEN_OBJECT_END) {
+            fail(parser, ERR_INVALID_JSON);
+            goto done;
+        }
+    }
+    ok = row.written || write_row(parser, &row);
+
+    done:
+    parser->depth--;
+    for (int i = 0; i < JSON_ROW_FIELD_COUNT; i++) {
+        free(row.fields[i].data);
+    }
+    return ok;
+}
+
+/* An array of `table` rows; anything else is skipped */
+static bool parse_rows(json_parser_t *parser, json_token_t token, import_table_t table, const json_row_t *parent) {
+    if (token != JSON_TOKEN_ARRAY_START) {
+        return skip_value(parser, token);
+    }
+    bool ok = enter(parser);
+    token = ok ? next_token(parser) : JSON_TOKEN_ARRAY_END;
+    while (token != JSON_TOKEN_ARRAY_END) {
+        ok = (token == JSON_TOKEN_OBJECT_START) ? parse_row(parser, table, parent) : skip_value(parser, token);
+        if (!ok) {
+            break;
+        }
+        token = next_token(parser);
+        if (token == JSON_TOKEN_COMMA) {
+            token = next_token(parser);
+        } else if (token != JSON_TOKEN_ARRAY_END) {
+            ok = fail(parser, ERR_INVALID_JSON);
+            break;
+        }
+    }
+    parser->depth--;
+    return ok;
+}
+
+static bool skip_value(json_parser_t *parser, json_token_t token) {
+    switch (token) {
+        case JSON_TOKEN_STRING:
+        case JSON_TOKEN_SCALAR:
+        case JSON_TOKEN_NULL:
+            return true;
+        case JSON_TOKEN_OBJECT_START:
+        case JSON_TOKEN_ARRAY_START:
+            break;
+        default:
+            return fail(parser, ERR_INVALID_JSON);
+    }
+    bool is_object = (token == JSON_TOKEN_OBJECT_START);
+    json_token_t close = is_object ? JSON_TOKEN_OBJECT_END : JSON_TOKEN_ARRAY_END;
+    bool ok = enter(parser);
+    token = ok ? next_token(parser) : close;
+    while (token != close) {
+        if (is_object) {
+            if ((token != JSON_TOKEN_STRING) || (next_token(parser) != JSON_TOKEN_COLON)) {
+                ok = fail(parser, ERR_INVALID_JSON);
+                break;
+            }
+            token = next_token(parser);
+        }
+        ok = skip_value(parser, token);
+        if (!ok) {
+            break;
+        }
+        token = next_token(parser);
+        if (token == JSON_TOKEN_COMMA) {
+            token = next_token(parser);
+        } else if (token != close) {
+            ok = fail(parser, ERR_INVALID_JSON);
+            break;
+        }
+    }
+    parser->depth--;
+    return ok;
+}
+
+/* Queue the row (copied to the batch arena), with a uuid generated if it has none */
+static bool write_row(json_parser_t *parser, json_row_t *row) {
+    json_field_t *uuid = &row->fields[0];
+    if (!uuid->data) {
+        char generated[UUID4_LEN];
+        uuid4_generate(generated);
+        if (!copy_field(parser, uuid, generated, strlen(generated))) {
+            return false;
+        }
+    }
+    row->written = true;
+
+    arena_t *arena = parser->batch;
+    bce_str_t parent_uuid = row->parent ? field_str(arena, &row->parent->fields[0]) : bce_str_empty();
+    const void *data = NULL;
+    switch (row->table) {
+        case IMPORT_TABLE_COMMAND: {
+            if (!row->parent) {
+                // the command replaces the one with the same name
+                if (!row->fields[1].data || (row->fields[1].len == 0)) {
+                    return fail(parser, ERR_INVALID_CMD_NAME);
+                }
+                bce_error_t err = db_delete_command(parser->writer->conn, row->fields[1].data);
+                if (err != ERR_NONE) {
+                    return fail(parser, err);
+                }
+            }
+            bce_command_t *cmd = arena_calloc(arena, 1, sizeof(bce_command_t));
+            if (cmd) {
+                cmd->uuid = field_str(arena, uuid);
+                cmd->name = field_str(arena, &row->fields[1]);
+                cmd->parent_cmd_uuid = parent_uuid;
+            }
+            data = cmd;
+            break;
+        }
+        case IMPORT_TABLE_ALIAS: {
+            bce_command_alias_t *alias = arena_calloc(arena, 1, sizeof(bce_command_alias_t));
+            if (alias) {
+                alias->uuid = field_str(arena, uuid);
+                alias->cmd_uuid = parent_uuid;
+                alias->name = field_str(arena, &row->fields[1]);
+            }
+            data = alias;
+            break;
+        }
+        case IMPORT_TABLE_ARG: {
+            bce_command_arg_t *arg = arena_calloc(arena, 1, sizeof(bce_command_arg_t));
+            if (arg) {
+                arg->uuid = field_str(arena, uuid);
+                arg->cmd_uuid = parent_uuid;
+                arg->arg_type = field_str(arena, &row->fields[1]);
+                arg->description = field_str(arena, &row->fields[2]);
+                arg->long_name = field_str(arena, &row->fields[3]);
+                arg->short_name = field_str(arena, &row->fields[4]);
+            }
+            data = arg;
+            break;
+        }
+        case IMPORT_TABLE_OPT: {
+            bce_command_opt_t *opt = arena_calloc(arena, 1, sizeof(bce_command_opt_t));
+            if (opt) {
+                opt->uuid = field_str(arena, uuid);
+                opt->cmd_arg_uuid = parent_uuid;
+                opt->name = field_str(arena, &row->fields[1]);
+            }
+            data = opt;
+            break;
+        }
+        default:
+            break;
+    }
+    if (!data) {
+        return fail(parser, ERR_OUT_OF_MEMORY);
+    }
+    bce_error_t err = import_writer_add_row(parser->writer, row->table, data);
+    if (err != ERR_NONE) {
+        return fail(parser, err);
+    }
+    return (++parser->batch_rows < JSON_IMPORT_BATCH_ROWS) || flush(parser);
+}
+
+/* Insert the rows queued, and give back the part of the file they were read from */
+static bool flush(json_parser_t *parser) {
+    bce_error_t err = import_writer_flush(parser->writer);
+    arena_reset(parser->batch);
+    parser->batch_rows = 0;
+    if (err != ERR_NONE) {
+        return fail(parser, err);
+    }
+    size_t parsed = (size_t) (parser->pos - parser->data);
+    if (parsed - parser->released >= JSON_IMPORT_RELEASE_SIZE) {
+        size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+        size_t released = parsed / page_size * page_size;
+        madvise((void *) (parser->data + parser->released), released - parser->released, MADV_DONTNEED);
+        parser->released = released;
+    }
+    return true;
+}
+
+static json_token_t next_token(json_parser_t *parser) {
+    const char *end = parser->data + parser->size;
+    const char *p = parser->pos;
+    while ((p < end) && ((*p == ' ') || (*p == '\n') || (*p == '\r') || (*p == '\t'))) {
+        p++;
+    }
+    if (p == end) {
+        parser->pos = p;
+        return JSON_TOKEN_EOF;
+    }
+    parser->pos = p + 1;
+    switch (*p) {
+        case '{':
+            return JSON_TOKEN_OBJECT_START;
+        case '}':
+            return JSON_TOKEN_OBJECT_END;
+        case '[':
+            return JSON_TOKEN_ARRAY_START;
+        case ']':
+            return JSON_TOKEN_ARRAY_END;
+        case ':':
+            return JSON_TOKEN_COLON;
+        case ',':
+            return JSON_TOKEN_COMMA;
+        case '"':
+            return read_string(parser);
+        default:
+            return read_scalar(parser, p);
+    }
+}
+
+/* After the opening quote: unescaped into `text` */
+static json_token_t read_string(json_parser_t *parser) {
+    const char *end = parser->data + parser->size;
+    const char *p = parser->pos;
+    parser->text_len = 0;
+    while (p < end) {
+        const char *run = p;
+        while ((p < end) && (*p != '"') && (*p != '\\')) {
+            p++;
+        }
+        if (!append_text(parser, run, (size_t) (p - run))) {
+            return JSON_TOKEN_ERROR;
+        }
+        if (p == end) {
+            break;
+        }
+        if (*p++ == '"') {
+            parser->pos = p;
+            return JSON_TOKEN_STRING;
+        }
+        if (p == end) {
+            break;
+        }
+        char c = *p++;
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'u': {
+                uint32_t code;
+                if (!read_hex4(&p, end, &code)) {
+                    return JSON_TOKEN_ERROR;
+                }
+                // a surrogate pair is one character
+                const char *low_pos = p + 2;
+                uint32_t low;
+                if ((code >= 0xD800) && (code <= 0xDBFF) && (end - p >= 6) && (p[0] == '\\') && (p[1] == 'u')
+                    && read_hex4(&low_pos, end, &low) && (low >= 0xDC00) && (low <= 0xDFFF)) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    p = low_pos;
+                }
+                if (!append_utf8(parser, code)) {
+                    return JSON_TOKEN_ERROR;
+                }
+                continue;
+            }
+            default:
+                return JSON_TOKEN_ERROR;
+        }
+        if (!append_text(parser, &c, 1)) {
+            return JSON_TOKEN_ERROR;
+        }
+    }
+    // unterminated
+    return JSON_TOKEN_ERROR;
+}
+
+/* A number, true, false or null, kept as text */
+static json_token_t read_scalar(json_parser_t *parser, const char *start) {
+    const char *end = parser->data + parser->size;
+    const char *p = start;
+    while ((p < end) && (isalnum((unsigned char) *p) || (*p == '-') || (*p == '+') || (*p == '.'))) {
+        p++;
+    }
+    size_t len = (size_t) (p - start);
+    parser->pos = p;
+    if ((len == 4) && (memcmp(start, "null", 4) == 0)) {
+        return JSON_TOKEN_NULL;
+    }
+    bool is_literal = ((len == 4) && (memcmp(start, "true", 4) == 0))
+                      || ((len == 5) && (memcmp(start, "false", 5) == 0));
+    bool is_number = (len > 0) && ((*start == '-') || isdigit((unsigned char) *start));
+    if (!is_literal && !is_number) {
+        return JSON_TOKEN_ERROR;
+    }
+    parser->text_len = 0;
+    return append_text(parser, start, len) ? JSON_TOKEN_SCALAR : JSON_TOKEN_ERROR;
+}
+
+static bool read_hex4(const char **pos, const char *end, uint32_t *code) {
+    if (end - *pos < 4) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = (*pos)[i];
+        value <<= 4;
+        if ((c >= '0') && (c <= '9')) {
+            value |= (uint32_t) (c - '0');
+        } else if ((c >= 'a') && (c <= 'f')) {
+            value |= (uint32_t) (c - 'a' + 10);
+        } else if ((c >= 'A') && (c <= 'F')) {
+            value |= (uint32_t) (c - 'A' + 10);
+        } else {
+            return false;
+        }
+    }
+    *pos += 4;
+    *code = value;
+    return true;
+}
+
+static bool append_utf8(json_parser_t *parser, uint32_t code) {
+    char bytes[4];
+    size_t len;
+    if (code < 0x80) {
+        bytes[0] = (char) code;
+        len = 1;
+    } else if (code < 0x800) {
+        bytes[0] = (char) (0xC0 | (code >> 6));
+        bytes[1] = (char) (0x80 | (code & 0x3F));
+        len = 2;
+    } else if (code < 0x10000) {
+        bytes[0] = (char) (0xE0 | (code >> 12));
+        bytes[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+        bytes[2] = (char) (0x80 | (code & 0x3F));
+        len = 3;
+    } else {
+        bytes[0] = (char) (0xF0 | (code >> 18));
+        bytes[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+        bytes[2] = (char) (0x80 | ((code >> 6) & 0x3F));
+        bytes[3] = (char) (0x80 | (code & 0x3F));
+        len = 4;
+    }
+    return append_text(parser, bytes, len);
+}
+
+static bool append_text(json_parser_t *parser, const char *str, size_t len) {
+    if (parser->text_len + len + 1 > parser->text_capacity) {
+        size_t capacity = (parser->text_capacity > 0) ? parser->text_capacity : 256;
+        while (capacity < parser->text_len + len + 1) {
+            capacity *= 2;
+        }
+        char *text = realloc(parser->text, capacity);
+        if (!text) {
+            return fail(parser, ERR_OUT_OF_MEMORY);
+        }
+        parser->text = text;
+        parser->text_capacity = capacity;
+    }
+    memcpy(parser->text + parser->text_len, str, len);
+    parser->text_len += len;
+    parser->text[parser->text_len] = '\0';
+    return true;
+}
+
+static bool text_is(const json_parser_t *parser, const char *str) {
+    size_t len = strlen(str);
+    return (parser->text_len == len) && (memcmp(parser->text, str, len) == 0);
+}
+
+static bool copy_field(json_parser_t *parser, json_field_t *field, const char *str, size_t len) {
+    char *data = malloc(len + 1);
+    if (!data) {
+        return fail(parser, ERR_OUT_OF_MEMORY);
+    }
+    memcpy(data, str, len);
+    data[len] = '\0';
+    free(field->data);
+    field->data = data;
+    field->len = len;
+    return true;
+}
+
+static bce_str_t field_str(arena_t *arena, const json_field_t *field) {
+    return str_pool_intern_n(arena, field->data, field->len);
+}
+
+/* One more level of nesting (undone by the caller, even if it fails) */
+static bool enter(json_parser_t *parser) {
+    return (++parser->depth <= JSON_IMPORT_MAX_DEPTH) || fail(parser, ERR_INVALID_JSON);
+}
+
+/* Keep the first error */
+static bool fail(json_parser_t *parser, bce_error_t err) {
+    if (parser->err == ERR_NONE) {
+        parser->err = err;
+    }
+    return false;
+}
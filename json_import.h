@@ -0,0 +1,28 @@
+#ifndef BCE_JSON_IMPORT_H
+#define BCE_JSON_IMPORT_H
+
+#include "import_writer.h"
+#include "error.h"
+
+/*
+ * Streaming import of a JSON spec (the `bce --export --format json` layout): the file is mapped and parsed in one
+ * pass, without building a DOM or a command tree. Each command, alias, arg and opt is handed to the import writer as
+ * soon as its own fields are known: when the object's first nested array (aliases, args, sub_commands, opts) starts,
+ * or when the object closes. Rows are flushed every JSON_IMPORT_BATCH_ROWS, and the part of the file already parsed is
+ * released, so memory stays bounded by the nesting depth rather than the size of the spec.
+ *
+ * Since a row is written before its nested arrays are read, its fields must come first (as they do in exported files).
+ * A field after a nested array fails with ERR_JSON_KEY_ORDER: such files need the DOM import instead.
+ */
+
+#define JSON_IMPORT_BATCH_ROWS 4096
+#define JSON_IMPORT_MAX_DEPTH 256       /* nested JSON objects and arrays */
+
+/*
+ * Replace the command in `filename` (deleting the existing one, by name) through `writer`, within the caller's
+ * transaction. Missing uuids are generated (`uuid4_init()` must have been called). Everything parsed is flushed
+ * before returning, including on errors, which leave the transaction to be rolled back
+ */
+bce_error_t json_import_file(import_writer_t *writer, const char *filename);
+
+#endif // BCE_JSON_IMPORT_H
@@ -0,0 +1,212 @@
+#include "line_scan.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define LINE_SCAN_HAVE_SSE2
+#include <immintrin.h>
+#if defined(__GNUC__)
+// compiled for AVX2 regardless of the target flags, only called if the CPU supports it
+#define LINE_SCAN_HAVE_AVX2
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+#endif
+
+typedef size_t (*line_scan_find_func)(const char *line, size_t start, size_t end, line_scan_class_t cls);
+
+static size_t find_scalar(const char *line, size_t start, size_t end, line_scan_class_t cls);
+
+static line_scan_impl_t best_impl(void);
+
+static line_scan_find_func find_impl = NULL;
+
+static inline bool is_space(unsigned char c) {
+    return (c == ' ') || ((c >= '\t') && (c <= '\r'));
+}
+
+static inline bool is_in_class(unsigned char c, line_scan_class_t cls) {
+    switch (cls) {
+        case LINE_SCAN_SPACE_OR_EQUALS:
+            return is_space(c) || (c == '=');
+        case LINE_SCAN_QUOTE:
+            return c == '\'';
+        case LINE_SCAN_DBL_QUOTE:
+            return c == '"';
+        case LINE_SCAN_NOT_SPACE:
+            return !is_space(c);
+    }
+    return false;
+}
+
+static size_t find_scalar(const char *line, size_t start, size_t end, line_scan_class_t cls) {
+    for (size_t i = start; i < end; i++) {
+        if (is_in_class((unsigned char) line[i], cls)) {
+            return i;
+        }
+    }
+    return end;
+}
+
+#ifdef LINE_SCAN_HAVE_SSE2
+
+/*
+ * Bit `n` of the mask is set if byte `n` is in the class.
+ * \t..\r is the unsigned range check `(c - '\t') <= 4`, done with `min(x, 4) == x`.
+ */
+static inline unsigned sse2_class_mask(__m128i v, line_scan_class_t cls) {
+    switch (cls) {
+        case LINE_SCAN_QUOTE:
+            return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+        case LINE_SCAN_DBL_QUOTE:
+            return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        default:
+            break;
+    }
+    __m128i x = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(4)), x),
+                                 _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    if (cls == LINE_SCAN_NOT_SPACE) {
+        return ~(unsigned) _mm_movemask_epi8(space) & 0xFFFFu;
+    }
+    return (unsigned) _mm_movemask_epi8(_mm_or_si128(space, _mm_cmpeq_epi8(v, _mm_set1_epi8('='))));
+}
+
+static size_t find_sse2(const char *line, size_t start, size_t end, line_scan_class_t cls) {
+    size_t i = start;
+    for (; i + 16 <= end; i += 16) {
+        unsigned mask = sse2_class_mask(_mm_loadu_si128((const __m128i *) (line + i)), cls);
+        if (mask) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    return find_scalar(line, i, end, cls);
+}
+
+#endif // LINE_SCAN_HAVE_SSE2
+
+#ifdef LINE_SCAN_HAVE_AVX2
+
+static inline AVX2_FUNC uint32_t avx2_class_mask(__m256i v, line_scan_class_t cls) {
+    switch (cls) {
+        case LINE_SCAN_QUOTE:
+            return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+        case LINE_SCAN_DBL_QUOTE:
+            return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+        default:
+            break;
+    }
+    __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(4)), x),
+                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    if (cls == LINE_SCAN_NOT_SPACE) {
+        return ~(uint32_t) _mm256_movemask_epi8(space);
+    }
+    return (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(space, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('='))));
+}
+
+static AVX2_FUNC size_t find_avx2(const char *line, size_t start, size_t end, line_scan_class_t cls) {
+    size_t i = start;
+    // most words are short: try 16 bytes before setting up the 32-byte loop
+    if (i + 16 <= end) {
+        unsigned mask = sse2_class_mask(_mm_loadu_si128((const __m128i *) (line + i)), cls);
+        if (mask) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    for (; i + 32 <= end; i += 32) {
+        uint32_t mask = avx2_class_mask(_mm256_loadu_si256((const __m256i *) (line + i)), cls);
+        if (mask) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    // finish here rather than calling `find_sse2()`: mixing its (non-VEX) SSE code with AVX is slow
+    if (i + 16 <= end) {
+        unsigned mask = sse2_class_mask(_mm_loadu_si128((const __m128i *) (line + i)), cls);
+        if (mask) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    for (; i < end; i++) {
+        if (is_in_class((unsigned char) line[i], cls)) {
+            return i;
+        }
+    }
+    return end;
+}
+
+#endif // LINE_SCAN_HAVE_AVX2
+
+size_t line_scan_find(const char *line, size_t start, size_t end, line_scan_class_t cls) {
+    if (start >= end) {
+        return end;
+    }
+    if (!find_impl) {
+        line_scan_select(LINE_SCAN_AUTO);
+    }
+    return find_impl(line, start, end, cls);
+}
+
+static bool is_supported(line_scan_impl_t impl) {
+    switch (impl) {
+        case LINE_SCAN_SCALAR:
+            return true;
+#ifdef LINE_SCAN_HAVE_SSE2
+        case LINE_SCAN_SSE2:
+            return true;
+#endif
+#ifdef LINE_SCAN_HAVE_AVX2
+        case LINE_SCAN_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static line_scan_impl_t best_impl(void) {
+    if (is_supported(LINE_SCAN_AVX2)) {
+        return LINE_SCAN_AVX2;
+    }
+    if (is_supported(LINE_SCAN_SSE2)) {
+        return LINE_SCAN_SSE2;
+    }
+    return LINE_SCAN_SCALAR;
+}
+
+line_scan_impl_t line_scan_select(line_scan_impl_t impl) {
+    if (!is_supported(impl)) {
+        impl = best_impl();
+    }
+    switch (impl) {
+#ifdef LINE_SCAN_HAVE_AVX2
+        case LINE_SCAN_AVX2:
+            find_impl = &find_avx2;
+            break;
+#endif
+#ifdef LINE_SCAN_HAVE_SSE2
+        case LINE_SCAN_SSE2:
+            find_impl = &find_sse2;
+            break;
+#endif
+        default:
+            find_impl = &find_scalar;
+            break;
+    }
+    return impl;
+}
+
+const char *line_scan_impl_name(line_scan_impl_t impl) {
+    switch (impl) {
+        case LINE_SCAN_AUTO:
+            return "auto";
+        case LINE_SCAN_SCALAR:
+            return "scalar";
+        case LINE_SCAN_SSE2:
+            return "SSE2";
+        case LINE_SCAN_AVX2:
+            return "AVX2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,38 @@
+#ifndef BCE_LINE_SCAN_H
+#define BCE_LINE_SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Find the word boundaries of a command line, 16 (SSE2) or 32 (AVX2) bytes at a time.
+ *
+ * The implementation is picked on first use, from what the CPU supports; other architectures use the scalar one.
+ * Whitespace is the C locale's `isspace()`: space, \t, \n, \v, \f and \r.
+ */
+
+typedef enum line_scan_class_t {
+    LINE_SCAN_SPACE_OR_EQUALS,      /* the end of an unquoted word */
+    LINE_SCAN_QUOTE,                /* ' */
+    LINE_SCAN_DBL_QUOTE,            /* " */
+    LINE_SCAN_NOT_SPACE             /* the start of the next word */
+} line_scan_class_t;
+
+typedef enum line_scan_impl_t {
+    LINE_SCAN_AUTO = 0,
+    LINE_SCAN_SCALAR,
+    LINE_SCAN_SSE2,
+    LINE_SCAN_AVX2
+} line_scan_impl_t;
+
+/* Offset of the first character of `line[start..end)` in the class (`end` if there is none) */
+size_t line_scan_find(const char *line, size_t start, size_t end, line_scan_class_t cls);
+
+/*
+ * Use a specific implementation (for tests and benchmarks); LINE_SCAN_AUTO picks the best one.
+ * Returns the implementation in use, which falls back to the best supported one.
+ */
+line_scan_impl_t line_scan_select(line_scan_impl_t impl);
+
+const char *line_scan_impl_name(line_scan_impl_t impl);
+
+#endif // BCE_LINE_SCAN_H
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* shared by the lists of every thread (specs are loaded in parallel by `bce --import-dir`) */
 static unsigned long node_id_seq = 1;
 
 /*
@@ -10,18 +11,33 @@ static unsigned long node_id_seq = 1;
  * If `free_node_func` is not NULL, this function will be called to free items from the list.
  */
 linked_list_t *ll_create(void *(*free_func)(void *)) {
-    linked_list_t *list = malloc(sizeof(linked_list_t));
+    return ll_create_in(NULL, free_func);
+}
+
+linked_list_t *ll_create_unique(void *(*free_func)(void *)) {
+    return ll_create_unique_in(NULL, free_func);
+}
+
+/*
+ * Create a new linked list in `arena`. The nodes are allocated from the arena as well, and
+ * `ll_destroy()` / `ll_remove_item()` leave the nodes' data alone: everything is released with the arena.
+ * A NULL arena is the same as `ll_create()`.
+ */
+linked_list_t *ll_create_in(arena_t *arena, void *(*free_func)(void *)) {
+    linked_list_t *list = arena_alloc(arena, sizeof(linked_list_t));
     if (list) {
         list->size = 0;
         list->head = NULL;
+        list->tail = NULL;
         list->unique = false;
         list->free_node_func = free_func;
+        list->arena = arena;
     }
     return list;
 }
 
-linked_list_t *ll_create_unique(void *(*free_func)(void *)) {
-    linked_list_t *list = ll_create(free_func);
+linked_list_t *ll_create_unique_in(arena_t *arena, void *(*free_func)(void *)) {
+    linked_list_t *list = ll_create_in(arena, free_func);
     if (list) {
         list->unique = true;
     }
@@ -37,6 +53,13 @@ linked_list_t *ll_destroy(linked_list_t *list) {
     if (!list) {
         return NULL;
     }
+    if (list->arena) {
+        // nodes and data are released with the arena
+        list->head = NULL;
+        list->tail = NULL;
+        list->size = 0;
+        return NULL;
+    }
 
     linked_list_node_t *node = list->head;
     while (node) {
@@ -55,6 +78,7 @@ linked_list_t *ll_destroy(linked_list_t *list) {
         node = next_node;
     }
     list->head = NULL;
+    list->tail = NULL;
     list->size = 0;
     free(list);
     return NULL;
@@ -73,21 +97,17 @@ bool ll_append_item(linked_list_t *list, const void *data) {
 
         // create a new node
         if (should_append_item) {
-            linked_list_node_t *node = malloc(sizeof(linked_list_node_t));
+            linked_list_node_t *node = arena_alloc(list->arena, sizeof(linked_list_node_t));
             if (node) {
-                node->id = node_id_seq++;
+                node->id = __atomic_fetch_add(&node_id_seq, 1, __ATOMIC_RELAXED);
                 node->data = (void *) data;
                 node->next = NULL;
-                // find the end of the list
-                linked_list_node_t *last = list->head;
-                if (!last) {
+                if (!list->tail) {
                     list->head = node;
                 } else {
-                    while (last->next) {
-                        last = last->next;
-                    }
-                    last->next = node;
+                    list->tail->next = node;
                 }
+                list->tail = node;
                 list->size++;
                 return true;
             }
@@ -184,7 +204,9 @@ bool ll_remove_item(linked_list_t *list, const linked_list_node_t *node_to_remov
     while (node) {
         if (node->id == node_to_remove->id) {
             // free the node's data
-            if (list->free_node_func) {
+            if (list->arena) {
+                // released with the arena
+            } else if (list->free_node_func) {
                 list->free_node_func(node->data);
             } else {
                 free(node->data);
@@ -198,8 +220,13 @@ bool ll_remove_item(linked_list_t *list, const linked_list_node_t *node_to_remov
                 // remove node from head
                 list->head = node->next;
             }
+            if (list->tail == node) {
+                list->tail = prev_node;
+            }
             // free the node
-            free(node);
+            if (!list->arena) {
+                free(node);
+            }
             node = NULL;
             list->size--;
             result = true;
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include "arena.h"
 
 // function signature to free node data; otherwise free() is used by `ll_destroy()` and `ll_remove_item()`
 typedef void *(*ll_free_node_func)(void *);
@@ -16,14 +17,21 @@ typedef struct linked_list_node_t {
 typedef struct linked_list_t {
     size_t size;
     linked_list_node_t *head;
+    linked_list_node_t *tail;   /* the last node, so appending doesn't walk the list */
     bool unique;
     ll_free_node_func free_node_func;
+    arena_t *arena;
 } linked_list_t;
 
 linked_list_t *ll_create(ll_free_node_func free_func);
 
 linked_list_t *ll_create_unique(ll_free_node_func free_func);
 
+// list (and its nodes) allocated from `arena`; its items are expected to live in the arena too
+linked_list_t *ll_create_in(arena_t *arena, ll_free_node_func free_func);
+
+linked_list_t *ll_create_unique_in(arena_t *arena, ll_free_node_func free_func);
+
 linked_list_t *ll_destroy(linked_list_t *list);
 
 bool ll_append_item(linked_list_t *list, const void *data);
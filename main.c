@@ -1,24 +1,44 @@
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
 #include <sqlite3.h>
 #include "linked_list.h"
 #include "dbutil.h"
+#include "stmt_cache.h"
 #include "data_model.h"
 #include "input.h"
 #include "error.h"
-#include "prune.h"
 #include "cli.h"
+#include "completion.h"
+#include "prune.h"
+#include "snapshot.h"
+#include "history_index.h"
+#include "state_file.h"
+#include "output_buffer.h"
+#include "ipc.h"
 
 #define DEBUG
 
-/* Normal BASH completion processing */
-bce_error_t process_completion(void);
+/*
+ * Normal BASH completion processing, from COMP_LINE/COMP_POINT or (with `--words`) from bash's own words.
+ * A `max_results` other than 0 (from `--limit`) overrides $BCE_MAX_RESULTS.
+ */
+bce_error_t process_completion(int word_argc, const char **word_argv, size_t max_results);
+
+/* Create the input from `<COMP_CWORD> <COMP_WORDS...>` */
+completion_input_t *create_completion_input_from_args(int word_argc, const char **word_argv, bce_error_t *err);
 
 /* CLI options, such as 'import', 'export' */
 bce_error_t process_cli(int argc, const char **argv);
 
-/* Display the recommendations to stdout */
-void print_recommendations(const linked_list_t *recommendation_list);
+/*
+ * Display the recommendations to stdout, with a single write (and the number left out by the limit, if any, to
+ * stderr). In OUTPUT_WORDS, only the words are; the whole lines go to $BCE_DESC_FD, if it is open, followed by the
+ * number left out (instead of stderr).
+ */
+void print_recommendations(const linked_list_t *recommendation_list, output_format_t output_format, size_t omitted);
 
 #ifdef DEBUG
 
@@ -29,9 +49,32 @@ void print_command_tree(const bce_command_t *cmd, int level);
 int main(int argc, char **argv) {
     int result = 0;
 
-    if (argc <= 1) {
+    // `--limit <count>` may come first, for completion
+    int first = 1;
+    size_t max_results = 0;
+    if ((argc > 2) && ((strcmp(argv[1], LIMIT_ARG_LONGNAME) == 0) || (strcmp(argv[1], LIMIT_ARG_SHORTNAME) == 0))) {
+        max_results = parse_max_results(argv[2]);
+        first = 3;
+    }
+
+    if (argc <= first) {
         // called from BASH (for completion help)
-        result = process_completion();
+        result = process_completion(0, NULL, max_results);
+    } else if ((strcmp(argv[first], WORDS_ARG_LONGNAME) == 0) || (strcmp(argv[first], WORDS_ARG_SHORTNAME) == 0)) {
+        // called from a `complete -F` function, with the words bash has already split
+        result = process_completion(argc - first - 1, (const char **) argv + first + 1, max_results);
+    } else if ((strcmp(argv[first], RECORD_ARG_LONGNAME) == 0) || (strcmp(argv[first], RECORD_ARG_SHORTNAME) == 0)) {
+        // called after each command (no database: it must not slow the prompt down)
+        if (argc <= first + 1) {
+            fprintf(stderr, "Missing command line (usage: bce %s <command-line>)\n", RECORD_ARG_LONGNAME);
+            result = ERR_INVALID_CLI_ARGUMENT;
+        } else {
+            char usage_filename[PATH_MAX];
+            char usage_log_filename[PATH_MAX];
+            state_file_path(usage_filename, sizeof(usage_filename), BCE_DB_FILENAME, BCE_USAGE_FILENAME);
+            state_file_path(usage_log_filename, sizeof(usage_log_filename), BCE_DB_FILENAME, BCE_USAGE_LOG_FILENAME);
+            result = usage_record(usage_log_filename, usage_filename, argv[first + 1], time(NULL));
+        }
     } else {
         // called with CLI args
         result = process_cli(argc, (const char **) argv);
@@ -45,147 +88,243 @@ bce_error_t process_cli(int argc, const char **argv) {
 }
 
 /* Program called from BASH shell, for completion assistance to user */
-bce_error_t process_completion(void) {
+bce_error_t process_completion(int word_argc, const char **word_argv, size_t max_results) {
     bce_error_t err = ERR_NONE;    // custom error values
-    int rc = 0;     // SQLite return values
-    char command_name[MAX_CMD_LINE_SIZE + 1];
-    char current_word[MAX_CMD_LINE_SIZE + 1];
-    char previous_word[MAX_CMD_LINE_SIZE + 1];
-
-#ifdef DEBUG
-    printf("SQLite version %s\n", sqlite3_libversion());
-#endif
-
-    sqlite3 *conn = db_open(BCE_DB_FILENAME, &rc);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Error %d opening database", rc);
-        err = ERR_OPEN_DATABASE;
-        goto done;
-    }
-
-#ifdef DEBUG
-    // enable extended error codes
-    sqlite3_extended_result_codes(conn, 1);
-#endif
-
-    int schema_version = db_get_schema_version(conn);
-    if (schema_version == 0) {
-        // create the schema
-        err = db_create_schema(conn);
-        if (err != ERR_NONE) {
-            fprintf(stderr, "Unable to create database schema\n");
-            goto done;
-        }
-        schema_version = db_get_schema_version(conn);
-    }
-    if (schema_version != DB_SCHEMA_VERSION) {
-        fprintf(stderr, "Schema version %d does not match expected version %d\n", schema_version, DB_SCHEMA_VERSION);
-        err = ERR_DATABASE_SCHEMA_VERSION_MISMATCH;
-        goto done;
+    bce_str_t command_name = NULL;
+    completion_input_t *input = NULL;
+    bce_command_t *completion_command = NULL;
+    linked_list_t *word_list = NULL;
+    linked_list_t *recommendation_list = NULL;
+    sqlite3 *conn = NULL;
+    snapshot_t *snapshot = NULL;
+    arena_t *arena = NULL;
+    usage_table_t *usage = NULL;
+    history_index_t *history = NULL;
+    char histfile[PATH_MAX];
+
+    if (word_argv) {
+        input = create_completion_input_from_args(word_argc, word_argv, &err);
+    } else {
+        input = create_completion_input(&err);
     }
-
-    completion_input_t *input = create_completion_input(&err);
     if (err != ERR_NONE) {
         switch (err) {
             case ERR_MISSING_ENV_COMP_LINE:
                 fprintf(stderr, "No %s env var\n", BASH_LINE_VAR);
+                break;
             case ERR_MISSING_ENV_COMP_POINT:
                 fprintf(stderr, "No %s env var\n", BASH_CURSOR_VAR);
+                break;
+            case ERR_INVALID_COMP_CWORD:
+                fprintf(stderr, "Invalid word index (usage: bce %s <COMP_CWORD> <COMP_WORDS...>)\n", WORDS_ARG_LONGNAME);
+                break;
             default:
                 fprintf(stderr, "Unknown error: %d\n", err);
         }
         goto done;
     }
+    if (max_results > 0) {
+        input->max_results = max_results;
+    }
+
+    // everything built for this request lives in one arena, released at once
+    arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    if (!arena) {
+        err = ERR_OUT_OF_MEMORY;
+        goto done;
+    }
 
     // load the data provided by environment
-    if (!get_command_from_input(input, command_name, MAX_CMD_LINE_SIZE)) {
+    command_name = get_command_word_in(arena, input);
+    if (bce_str_len(command_name) == 0) {
         fprintf(stderr, "Unable to determine command\n");
         err = ERR_INVALID_CMD_NAME;
         goto done;
     }
-    get_current_word(input, current_word, MAX_CMD_LINE_SIZE);
-    get_previous_word(input, previous_word, MAX_CMD_LINE_SIZE);
 
 #ifdef DEBUG
-    printf("input: %s\n", input->line);
-    printf("command: %s\n", command_name);
-    printf("current_word: %s\n", current_word);
-    printf("previous_word: %s\n", previous_word);
-#endif
-
-    // explicitly start a transaction, since this will be done automatically (per statement) otherwise
-    rc = sqlite3_exec(conn, "BEGIN TRANSACTION;", NULL, NULL, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "begin transaction returned %d\n", rc);
-        err = ERR_SQLITE_ERROR;
-        goto done;
+    // on stderr, so it can't mix with the recommendations; quiet when the shell reads the words output
+    bool verbose = (input->output_format != OUTPUT_WORDS);
+    if (verbose) {
+        fprintf(stderr, "input: %s\n", input->line);
+        fprintf(stderr, "command: %s\n", command_name);
+        fprintf(stderr, "current_word: %s\n", get_current_word_in(arena, input));
+        fprintf(stderr, "previous_word: %s\n", get_previous_word_in(arena, input));
     }
+#endif
 
-    // search for the command directly (load all descendents)
-    bce_command_t *completion_command = bce_command_new();
-    err = db_query_command(conn, completion_command, command_name);
-    if (err != ERR_NONE) {
-        rc = sqlite3_extended_errcode(conn);
-        fprintf(stderr, "db_query_command() returned %d\n", rc);
-        goto done;
+    // prefer the memory-mapped snapshot; fall back to SQLite if it is missing or stale
+    snapshot = snapshot_open(BCE_SNAPSHOT_FILENAME, false, &err);
+    if (!snapshot_is_current(snapshot, BCE_DB_FILENAME)) {
+        snapshot = snapshot_close(snapshot);
     }
 
-    rc = sqlite3_exec(conn, "COMMIT;", NULL, NULL, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "commit transaction returned %d\n", rc);
-        err = ERR_SQLITE_ERROR;
-        goto done;
-    }
+    // search for the command directly (load only the sub-commands on the command line)
+    word_list = completion_input_to_list_in(arena, input);
+    completion_command = bce_command_new_in(arena);
+    if (snapshot) {
+#ifdef DEBUG
+        if (verbose) {
+            fprintf(stderr, "snapshot: %s\n", BCE_SNAPSHOT_FILENAME);
+        }
+#endif
+        err = snapshot_load_command(snapshot, completion_command, command_name, word_list);
+        if (err != ERR_NONE) {
+            goto done;
+        }
+    } else {
+#ifdef DEBUG
+        if (verbose) {
+            fprintf(stderr, "SQLite version %s\n", sqlite3_libversion());
+        }
+#endif
+        conn = completion_db_open_readonly(BCE_DB_FILENAME, &err);
+        if (err != ERR_NONE) {
+            goto done;
+        }
 
 #ifdef DEBUG
-    printf("\nCommand Tree (Database)\n");
-    print_command_tree(completion_command, 0);
+        // enable extended error codes
+        sqlite3_extended_result_codes(conn, 1);
 #endif
 
-    // remove non-relevant command data
-    prune_command(completion_command, input);
+        err = completion_load_command(conn, completion_command, command_name, word_list);
+        if (err != ERR_NONE) {
+            goto done;
+        }
+    }
+
+    // with BCE_CORRECT, load again as if the misspelled words had been typed correctly
+    while (input->correct_words && correct_misspelled_words(completion_command, input)) {
+        word_list = completion_input_to_list_in(arena, input);
+        completion_command = bce_command_new_in(arena);
+        if (snapshot) {
+            err = snapshot_load_command(snapshot, completion_command, command_name, word_list);
+        } else {
+            err = completion_load_command(conn, completion_command, command_name, word_list);
+        }
+        if (err != ERR_NONE) {
+            goto done;
+        }
+    }
 
 #ifdef DEBUG
-    printf("\nCommand Tree (Pruned)\n");
-    print_command_tree(completion_command, 0);
+    if (verbose) {
+        fprintf(stderr, "\nCommand Tree (Database)\n");
+        print_command_tree(completion_command, 0);
+    }
 #endif
 
-    // build the command recommendations
-    linked_list_t *recommendation_list = ll_create_unique(NULL);
-    bool has_required = collect_required_recommendations(recommendation_list, completion_command, current_word,
-                                                         previous_word);
-    if (!has_required) {
-        collect_optional_recommendations(recommendation_list, completion_command, current_word, previous_word);
+    // remove non-relevant command data and build the command recommendations
+    recommendation_list = ll_create_unique_in(arena, NULL);
+    bool has_required = false;
+    size_t omitted = 0;
+    char usage_filename[PATH_MAX];
+    char usage_log_filename[PATH_MAX];
+    char history_index_filename[PATH_MAX];
+    state_file_path(usage_filename, sizeof(usage_filename), BCE_DB_FILENAME, BCE_USAGE_FILENAME);
+    state_file_path(usage_log_filename, sizeof(usage_log_filename), BCE_DB_FILENAME, BCE_USAGE_LOG_FILENAME);
+    state_file_path(history_index_filename, sizeof(history_index_filename), BCE_DB_FILENAME,
+                    BCE_HISTORY_INDEX_FILENAME);
+    usage = usage_load(usage_filename, usage_log_filename, command_name, time(NULL));
+    if (history_file_path(histfile, sizeof(histfile), NULL)) {
+        history = history_index_load(history_index_filename, histfile, command_name);
+        history_index_merge(history, completion_command);
+    }
+    err = completion_collect(completion_command, input, usage, recommendation_list, &has_required, &omitted);
+    if (err != ERR_NONE) {
+        goto done;
     }
 
 #ifdef DEBUG
-    if (has_required) {
-        printf("\nRecommendations (Required)\n");
-    } else {
-        printf("\nRecommendations (Optional)\n");
+    if (verbose) {
+        fprintf(stderr, "\nCommand Tree (Pruned)\n");
+        print_command_tree(completion_command, 0);
+
+        if (has_required) {
+            fprintf(stderr, "\nRecommendations (Required)\n");
+        } else {
+            fprintf(stderr, "\nRecommendations (Optional)\n");
+        }
     }
 #endif
 
     // display the list of recommended completions
-    print_recommendations(recommendation_list);
+    print_recommendations(recommendation_list, input->output_format, omitted);
+
+#ifdef DEBUG
+    if (verbose) {
+        if (conn) {
+            fprintf(stderr, "\n");
+            stmt_cache_print_stats(conn, BCE_DB_FILENAME, stderr);
+        }
+        fprintf(stderr, "arena: %zu allocations, %zu blocks\n", arena->alloc_count, arena->block_count);
+    }
+#endif
 
     done:
     // dispose of everything
     input = free_completion_input(input);
+    usage = usage_free(usage);
+    history = history_index_free(history);
     recommendation_list = ll_destroy(recommendation_list);
     completion_command = bce_command_free(completion_command);
-    sqlite3_close(conn);
+    word_list = ll_destroy(word_list);
+    arena = arena_destroy(arena);
+    snapshot = snapshot_close(snapshot);
+    db_close(conn);
 
     return err;
 }
 
-void print_recommendations(const linked_list_t *recommendation_list) {
+completion_input_t *create_completion_input_from_args(int word_argc, const char **word_argv, bce_error_t *err) {
+    if (word_argc < 1) {
+        *err = ERR_INVALID_COMP_CWORD;
+        return NULL;
+    }
+    char *end = NULL;
+    long current_word = strtol(word_argv[0], &end, 10);
+    if ((end == word_argv[0]) || (*end != '\0') || (current_word < 0) || (current_word > word_argc - 1)) {
+        *err = ERR_INVALID_COMP_CWORD;
+        return NULL;
+    }
+    completion_input_t *input = create_completion_input_from_words(word_argv + 1, (size_t) (word_argc - 1),
+                                                                   (int) current_word, err);
+    if (input) {
+        input->match_mode = parse_match_mode(getenv(BCE_MATCH_VAR));
+        input->correct_words = parse_flag(getenv(BCE_CORRECT_VAR));
+        input->max_results = parse_max_results(getenv(BCE_MAX_RESULTS_VAR));
+        input->output_format = parse_output_format(getenv(BCE_OUTPUT_VAR));
+    }
+    return input;
+}
+
+void print_recommendations(const linked_list_t *recommendation_list, output_format_t output_format, size_t omitted) {
     if (!recommendation_list) {
         return;
     }
 
-    for (linked_list_node_t *node = recommendation_list->head; node != NULL; node = node->next) {
-        printf("%s\n", (char *) node->data);
+    output_buffer_t out;
+    output_buffer_t desc;
+    output_buffer_init(&out);
+    output_buffer_init(&desc);
+    int desc_fd = (output_format == OUTPUT_WORDS) ? parse_fd(getenv(BCE_DESC_FD_VAR)) : -1;
+    output_buffer_format_recommendations(&out, (desc_fd >= 0) ? &desc : NULL, recommendation_list, output_format);
+    if (desc_fd >= 0) {
+        output_buffer_format_omitted(&desc, omitted);
+    }
+    output_buffer_write(&out, STDOUT_FILENO);
+    if (desc_fd >= 0) {
+        output_buffer_write(&desc, desc_fd);
+    }
+    output_buffer_free(&out);
+    output_buffer_free(&desc);
+
+    if ((omitted > 0) && (desc_fd < 0)) {
+        // not a recommendation: kept off stdout
+        char count[32];
+        snprintf(count, sizeof(count), "%zu", omitted);
+        fprintf(stderr, BCE_OMITTED_FORMAT, count);
     }
 }
 
@@ -194,38 +333,38 @@ void print_recommendations(const linked_list_t *recommendation_list) {
 void print_command_tree(const bce_command_t *cmd, const int level) {
     // indent
     for (int i = 0; i < level; i++) {
-        printf("  ");
+        fprintf(stderr, "  ");
     }
-    printf("command: %s\n", cmd->name);
+    fprintf(stderr, "command: %s\n", cmd->name);
 
     if (cmd->aliases && (cmd->aliases->size > 0)) {
         for (int i = 0; i < level; i++) {
-            printf("  ");
+            fprintf(stderr, "  ");
         }
-        printf("  aliases: ");
+        fprintf(stderr, "  aliases: ");
         for (linked_list_node_t *alias_node = cmd->aliases->head; alias_node != NULL; alias_node = alias_node->next) {
             bce_command_alias_t *alias = (bce_command_alias_t *) alias_node->data;
-            printf("%s ", alias->name);
+            fprintf(stderr, "%s ", alias->name);
         }
-        printf("\n");
+        fprintf(stderr, "\n");
     }
 
     if (cmd->args) {
         for (linked_list_node_t *arg_node = cmd->args->head; arg_node != NULL; arg_node = arg_node->next) {
             bce_command_arg_t *arg = (bce_command_arg_t *) arg_node->data;
             for (int i = 0; i < level; i++) {
-                printf("  ");
+                fprintf(stderr, "  ");
             }
-            printf("  arg: %s (%s): %s\n", arg->long_name, arg->short_name, arg->arg_type);
+            fprintf(stderr, "  arg: %s (%s): %s\n", arg->long_name, arg->short_name, arg->arg_type);
 
             // print opts
             if (arg->opts) {
                 for (linked_list_node_t *opt_node = arg->opts->head; opt_node != NULL; opt_node = opt_node->next) {
                     bce_command_opt_t *opt = (bce_command_opt_t *) opt_node->data;
                     for (int i = 0; i < level; i++) {
-                        printf("  ");
+                        fprintf(stderr, "  ");
                     }
-                    printf("    opt: %s\n", opt->name);
+                    fprintf(stderr, "    opt: %s\n", opt->name);
                 }
             }
         }
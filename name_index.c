@@ -0,0 +1,122 @@
+#include "name_index.h"
+#include <string.h>
+
+#define MIN_CAPACITY 8
+
+static int compare_entries(const void *a, const void *b);
+
+static int compare_key(bce_str_t key, const char *str, size_t len);
+
+static size_t lower_bound(const name_index_t *index, const char *str, size_t len);
+
+name_index_t *name_index_create(size_t expected_size) {
+    name_index_t *index = malloc(sizeof(name_index_t));
+    if (!index) {
+        return NULL;
+    }
+    index->capacity = (expected_size > MIN_CAPACITY) ? expected_size : MIN_CAPACITY;
+    index->entries = malloc(index->capacity * sizeof(name_index_entry_t));
+    if (!index->entries) {
+        free(index);
+        return NULL;
+    }
+    index->size = 0;
+    index->is_sorted = true;
+    return index;
+}
+
+name_index_t *name_index_destroy(name_index_t *index) {
+    if (index) {
+        free(index->entries);
+    }
+    free(index);
+    return NULL;
+}
+
+bool name_index_add(name_index_t *index, bce_str_t key, void *item) {
+    if (!index || !key || (bce_str_len(key) == 0)) {
+        return false;
+    }
+    if (index->size == index->capacity) {
+        size_t capacity = index->capacity * 2;
+        name_index_entry_t *entries = realloc(index->entries, capacity * sizeof(name_index_entry_t));
+        if (!entries) {
+            return false;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    index->entries[index->size].key = key;
+    index->entries[index->size].item = item;
+    index->size++;
+    index->is_sorted = false;
+    return true;
+}
+
+void name_index_sort(name_index_t *index) {
+    if (index && !index->is_sorted) {
+        qsort(index->entries, index->size, sizeof(name_index_entry_t), &compare_entries);
+        index->is_sorted = true;
+    }
+}
+
+size_t name_index_find_prefix(const name_index_t *index, const char *prefix, size_t prefix_len, size_t *first) {
+    *first = 0;
+    if (!index || !index->is_sorted) {
+        return 0;
+    }
+    size_t start = lower_bound(index, prefix, prefix_len);
+    size_t end = start;
+    while ((end < index->size) && (bce_str_len(index->entries[end].key) >= prefix_len)
+           && (memcmp(index->entries[end].key, prefix, prefix_len) == 0)) {
+        end++;
+    }
+    *first = start;
+    return end - start;
+}
+
+size_t name_index_find(const name_index_t *index, const char *name, size_t name_len, size_t *first) {
+    *first = 0;
+    if (!index || !index->is_sorted) {
+        return 0;
+    }
+    size_t start = lower_bound(index, name, name_len);
+    size_t end = start;
+    while ((end < index->size) && (compare_key(index->entries[end].key, name, name_len) == 0)) {
+        end++;
+    }
+    *first = start;
+    return end - start;
+}
+
+/*
+ * Byte order, shorter keys first: the keys sharing a prefix are contiguous, right after the prefix itself.
+ */
+static int compare_key(bce_str_t key, const char *str, size_t len) {
+    size_t key_len = bce_str_len(key);
+    int result = memcmp(key, str, (key_len < len) ? key_len : len);
+    if (result != 0) {
+        return result;
+    }
+    return (key_len < len) ? -1 : (key_len > len) ? 1 : 0;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    bce_str_t key = ((const name_index_entry_t *) b)->key;
+    return compare_key(((const name_index_entry_t *) a)->key, key, bce_str_len(key));
+}
+
+/* The first entry whose key is not less than `str[0..len)` */
+static size_t lower_bound(const name_index_t *index, const char *str, size_t len) {
+    size_t low = 0;
+    size_t high = index->size;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (compare_key(index->entries[mid].key, str, len) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
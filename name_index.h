@@ -0,0 +1,44 @@
+#ifndef BCE_NAME_INDEX_H
+#define BCE_NAME_INDEX_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "str_pool.h"
+
+/*
+ * Names sorted once, for exact and prefix lookups in O(log n) (plus the number of matches).
+ * An item may be added under several names (e.g. a sub-command and its aliases).
+ * Keys are not copied; they must outlive the index.
+ */
+
+typedef struct name_index_entry_t {
+    bce_str_t key;
+    void *item;
+} name_index_entry_t;
+
+typedef struct name_index_t {
+    size_t size;
+    size_t capacity;
+    name_index_entry_t *entries;
+    bool is_sorted;
+} name_index_t;
+
+name_index_t *name_index_create(size_t expected_size);
+
+name_index_t *name_index_destroy(name_index_t *index);
+
+/* Add `item` under `key` (empty keys are skipped); call `name_index_sort()` before looking up */
+bool name_index_add(name_index_t *index, bce_str_t key, void *item);
+
+void name_index_sort(name_index_t *index);
+
+/*
+ * The entries whose key starts with `prefix[0..prefix_len)` (every entry for an empty prefix) are
+ * `entries[first..first + count)`, in key order. Returns `count`.
+ */
+size_t name_index_find_prefix(const name_index_t *index, const char *prefix, size_t prefix_len, size_t *first);
+
+/* Same as `name_index_find_prefix()`, for the entries whose key is `name[0..name_len)` */
+size_t name_index_find(const name_index_t *index, const char *name, size_t name_len, size_t *first);
+
+#endif // BCE_NAME_INDEX_H
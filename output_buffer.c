@@ -0,0 +1,117 @@
+#include "output_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include "ipc.h"
+
+static bool reserve(output_buffer_t *buf, size_t len);
+
+void output_buffer_init(output_buffer_t *buf) {
+    buf->data = NULL;
+    buf->len = 0;
+    buf->capacity = 0;
+    buf->failed = false;
+}
+
+void output_buffer_free(output_buffer_t *buf) {
+    free(buf->data);
+    output_buffer_init(buf);
+}
+
+void output_buffer_append(output_buffer_t *buf, const char *str, size_t len) {
+    if ((len == 0) || !reserve(buf, len)) {
+        return;
+    }
+    memcpy(buf->data + buf->len, str, len);
+    buf->len += len;
+}
+
+void output_buffer_append_char(output_buffer_t *buf, char c) {
+    if (!reserve(buf, 1)) {
+        return;
+    }
+    buf->data[buf->len++] = c;
+}
+
+void output_buffer_format_recommendations(output_buffer_t *buf, output_buffer_t *desc,
+                                          const linked_list_t *recommendation_list, output_format_t format) {
+    if (!recommendation_list) {
+        return;
+    }
+    for (linked_list_node_t *node = recommendation_list->head; node != NULL; node = node->next) {
+        const char *data = (const char *) node->data;
+        size_t len = strlen(data);
+        if (format == OUTPUT_WORDS) {
+            // `<word>\t<display>\t<description>`
+            const char *tab = memchr(data, '\t', len);
+            output_buffer_append(buf, data, tab ? (size_t) (tab - data) : len);
+            output_buffer_append_char(buf, '\n');
+            if (desc) {
+                output_buffer_append(desc, data, len);
+                output_buffer_append_char(desc, '\n');
+            }
+        } else {
+            output_buffer_append(buf, data, len);
+            output_buffer_append_char(buf, '\n');
+        }
+    }
+}
+
+void output_buffer_format_omitted(output_buffer_t *desc, size_t omitted) {
+    if (omitted == 0) {
+        return;
+    }
+    char count[32];
+    char record[64];
+    snprintf(count, sizeof(count), "%zu", omitted);
+    int len = snprintf(record, sizeof(record), BCE_OMITTED_RECORD_FORMAT, count);
+    if ((len > 0) && ((size_t) len < sizeof(record))) {
+        output_buffer_append(desc, record, (size_t) len);
+    }
+}
+
+bool output_buffer_write(const output_buffer_t *buf, int fd) {
+    return output_buffer_write_with(buf, fd, write);
+}
+
+bool output_buffer_write_with(const output_buffer_t *buf, int fd, output_write_func write_func) {
+    if (buf->failed) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < buf->len) {
+        ssize_t n = write_func(fd, buf->data + written, buf->len - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += (size_t) n;
+    }
+    return true;
+}
+
+/* Room for `len` more bytes, doubling the capacity as needed */
+static bool reserve(output_buffer_t *buf, size_t len) {
+    if (buf->failed) {
+        return false;
+    }
+    if (buf->len + len <= buf->capacity) {
+        return true;
+    }
+    size_t capacity = (buf->capacity > 0) ? buf->capacity : OUTPUT_BUFFER_INITIAL_SIZE;
+    while (capacity < buf->len + len) {
+        capacity *= 2;
+    }
+    char *data = realloc(buf->data, capacity);
+    if (!data) {
+        buf->failed = true;
+        return false;
+    }
+    buf->data = data;
+    buf->capacity = capacity;
+    return true;
+}
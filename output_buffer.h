@@ -0,0 +1,51 @@
+#ifndef BCE_OUTPUT_BUFFER_H
+#define BCE_OUTPUT_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "linked_list.h"
+#include "input.h"
+
+/*
+ * Completion output, formatted into one growable buffer and written with a single write(2) (bash reads the
+ * recommendations from a pipe: nothing else may go to stdout in between).
+ */
+
+#define OUTPUT_BUFFER_INITIAL_SIZE 4096
+
+typedef struct output_buffer_t {
+    char *data;
+    size_t len;
+    size_t capacity;
+    bool failed;            /* out of memory: nothing is written */
+} output_buffer_t;
+
+void output_buffer_init(output_buffer_t *buf);
+
+void output_buffer_free(output_buffer_t *buf);
+
+void output_buffer_append(output_buffer_t *buf, const char *str, size_t len);
+
+void output_buffer_append_char(output_buffer_t *buf, char c);
+
+/*
+ * One recommendation per line. In OUTPUT_WORDS, only the words go to `buf`; the whole
+ * `<word>\t<display>\t<description>` lines go to `desc` (if not NULL).
+ */
+void output_buffer_format_recommendations(output_buffer_t *buf, output_buffer_t *desc,
+                                          const linked_list_t *recommendation_list, output_format_t format);
+
+/* The number of recommendations left out, as the last `desc` record (see BCE_OMITTED_RECORD_FORMAT); none if 0 */
+void output_buffer_format_omitted(output_buffer_t *desc, size_t omitted);
+
+/* Same signature as write(2) */
+typedef ssize_t (*output_write_func)(int fd, const void *data, size_t len);
+
+/* Write the buffer to `fd`: one write(2), unless it is interrupted or only partly written */
+bool output_buffer_write(const output_buffer_t *buf, int fd);
+
+/* Same as `output_buffer_write()`, with `write_func` instead of write(2) (e.g. to count the calls) */
+bool output_buffer_write_with(const output_buffer_t *buf, int fd, output_write_func write_func);
+
+#endif // BCE_OUTPUT_BUFFER_H
@@ -1,32 +1,79 @@
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "prune.h"
 #include "data_model.h"
 #include "input.h"
 #include "linked_list.h"
 
-static void prune_sub_commands(bce_command_t *cmd, const linked_list_t *word_list);
+static void prune_sub_commands(bce_command_t *cmd, const hash_map_t *word_set);
 
-static void prune_arguments(bce_command_t *cmd, const linked_list_t *word_list);
+static void prune_arguments(bce_command_t *cmd, const hash_map_t *word_set);
+
+static int match_score(const recommendation_filter_t *filter, bce_str_t str);
+
+static int sub_command_score(const bce_command_t *sub_cmd, const recommendation_filter_t *filter, bce_str_t *word);
+
+static int sub_command_usage(const bce_command_t *sub_cmd, const usage_table_t *usage);
+
+static int with_usage(const recommendation_filter_t *filter, int score, int usage);
+
+static char *make_recommendation(arena_t *arena, const recommendation_filter_t *filter, bce_str_t word,
+                                 char *display, bce_str_t description);
+
+static char *copy_text(char *dest, const char *text, size_t len);
+
+static void append_recommendation(linked_list_t *recommendation_list, recommendation_filter_t *filter,
+                                  const char *data, int score);
+
+static int compare_ranked(const void *a, const void *b);
+
+static void keep_recommendation(recommendation_filter_t *filter, const char *data, int score);
+
+static bool is_worse(const scored_recommendation_t *a, const scored_recommendation_t *b);
+
+static void sift_up(scored_recommendation_t *heap, size_t i);
+
+static void sift_down(scored_recommendation_t *heap, size_t count, size_t i);
+
+static int compare_scored(const void *a, const void *b);
+
+static int max_typos(size_t len);
+
+static bool is_correction_candidate(const completion_input_t *input, int index);
+
+static const bce_command_t *find_misspelled_sub_command(const bce_command_t *cmd, const completion_input_t *input,
+                                                        int *index);
+
+static void find_nearest_arg(const bce_command_t *cmd, const edit_pattern_t *pattern, int max_distance,
+                             int *best_distance, bce_str_t *best_name);
+
+/* A recommendation and its score, for ranking */
+typedef struct ranked_node_t {
+    linked_list_node_t *node;
+    int score;
+    size_t order;
+} ranked_node_t;
 
 /*
  * Find the sub-commands and arguments related to the given command.
  * Prune the results based on the current command_line
  */
 void prune_command(bce_command_t *cmd, const completion_input_t *input) {
-    // build a list of words from the command line
-    linked_list_t *word_list = bash_input_to_list(input->line, MAX_CMD_LINE_SIZE);
+    // hash the words from the command line once: every sub-command, alias, arg and opt is looked up in it
+    hash_map_t *word_set = word_set_create_from_input(input);
 
-    prune_arguments(cmd, word_list);
-    prune_sub_commands(cmd, word_list);
+    prune_arguments(cmd, word_set);
+    prune_sub_commands(cmd, word_set);
 
-    word_list = ll_destroy(word_list);
+    word_set = hm_destroy(word_set);
     return;
 }
 
 /*
  * Iterate over the sub-commands and prune any sibling sub-commands.
  */
-static void prune_sub_commands(bce_command_t *cmd, const linked_list_t *word_list) {
+static void prune_sub_commands(bce_command_t *cmd, const hash_map_t *word_set) {
     if (!cmd || !cmd->sub_commands) {
         return;
     }
@@ -37,14 +84,14 @@ static void prune_sub_commands(bce_command_t *cmd, const linked_list_t *word_lis
     while (check_node) {
         bce_command_t *sub_cmd = (bce_command_t *) check_node->data;
         if (sub_cmd) {
-            // check if cmd_name is in word_list
-            sub_cmd->is_present_on_cmdline = ll_is_string_in_list(word_list, sub_cmd->name);
+            // check if cmd_name is on the command line
+            sub_cmd->is_present_on_cmdline = is_word_in_set(word_set, sub_cmd->name);
             if (!sub_cmd->is_present_on_cmdline) {
                 // try harder - examine the aliases
                 if (sub_cmd->aliases) {
                     for (linked_list_node_t *check_alias_node = sub_cmd->aliases->head; check_alias_node != NULL; check_alias_node = check_alias_node->next) {
                         bce_command_alias_t *alias = (bce_command_alias_t *) check_alias_node->data;
-                        bool found_alias = ll_is_string_in_list(word_list, alias->name);
+                        bool found_alias = is_word_in_set(word_set, alias->name);
                         if (found_alias) {
                             sub_cmd->is_present_on_cmdline = true;
                             break;
@@ -75,8 +122,8 @@ static void prune_sub_commands(bce_command_t *cmd, const linked_list_t *word_lis
     linked_list_node_t *sub_node = sub_cmds->head;
     while (sub_node) {
         bce_command_t *sub_cmd = (bce_command_t *) sub_node->data;
-        prune_arguments(sub_cmd, word_list);
-        prune_sub_commands(sub_cmd, word_list);
+        prune_arguments(sub_cmd, word_set);
+        prune_sub_commands(sub_cmd, word_set);
         sub_node = sub_node->next;
     }
 
@@ -103,7 +150,7 @@ static void prune_sub_commands(bce_command_t *cmd, const linked_list_t *word_lis
  * Find the arguments related to the current command.
  * Remove any arguments (without options) that have already been used.
  */
-static void prune_arguments(bce_command_t *cmd, const linked_list_t *word_list) {
+static void prune_arguments(bce_command_t *cmd, const hash_map_t *word_set) {
     if (!cmd) {
         return;
     }
@@ -114,8 +161,8 @@ static void prune_arguments(bce_command_t *cmd, const linked_list_t *word_list)
         while (arg_node) {
             bool arg_removed = false;
             bce_command_arg_t *arg = (bce_command_arg_t *) arg_node->data;
-            // check if arg_name is in word_list
-            if (ll_is_string_in_list(word_list, arg->short_name) || ll_is_string_in_list(word_list, arg->long_name)) {
+            // check if arg_name is on the command line
+            if (is_word_in_set(word_set, arg->short_name) || is_word_in_set(word_set, arg->long_name)) {
                 arg->is_present_on_cmdline = true;
                 // check if the arg has options
                 if (arg->opts && (arg->opts->size > 0)) {
@@ -129,7 +176,7 @@ static void prune_arguments(bce_command_t *cmd, const linked_list_t *word_list)
                         for (linked_list_node_t *opt_node = opts->head; opt_node != NULL; opt_node = opt_node->next) {
                             should_remove_arg = false;
                             bce_command_opt_t *opt = (bce_command_opt_t *) opt_node->data;
-                            if (ll_is_string_in_list(word_list, opt->name)) {
+                            if (is_word_in_set(word_set, opt->name)) {
                                 should_remove_arg = true;
                                 break;
                             }
@@ -152,7 +199,8 @@ static void prune_arguments(bce_command_t *cmd, const linked_list_t *word_list)
 }
 
 bool collect_required_recommendations(linked_list_t *recommendation_list, const bce_command_t *cmd,
-                                      const char *current_word, const char *previous_word) {
+                                      const char *current_word, const char *previous_word,
+                                      recommendation_filter_t *filter) {
     if (!recommendation_list || !cmd) {
         return false;
     }
@@ -167,13 +215,15 @@ bool collect_required_recommendations(linked_list_t *recommendation_list, const
 
     if (arg->opts && (arg->opts->size > 0)) {
         // if the arg_type is NONE, don't expect options
-        if (strncmp(arg->arg_type, "NONE", CMD_TYPE_FIELD_SIZE) != 0) {
+        if (strcmp(arg->arg_type, "NONE") != 0) {
             result = true;
             for (linked_list_node_t *opt_node = arg->opts->head; opt_node != NULL; opt_node = opt_node->next) {
-                char *data = calloc(NAME_FIELD_SIZE + 1, sizeof(char));
                 bce_command_opt_t *opt = (bce_command_opt_t *) opt_node->data;
-                strncat(data, opt->name, NAME_FIELD_SIZE);
-                ll_append_item(recommendation_list, data);
+                char *data = arena_calloc(recommendation_list->arena, bce_str_len(opt->name) + 1, sizeof(char));
+                strcat(data, opt->name);
+                append_recommendation(recommendation_list, filter,
+                                      make_recommendation(recommendation_list->arena, filter, opt->name, data, arg->description),
+                                      with_usage(filter, 0, usage_score(filter->usage, opt->name)));
             }
         }
     }
@@ -182,7 +232,8 @@ bool collect_required_recommendations(linked_list_t *recommendation_list, const
 }
 
 bool collect_optional_recommendations(linked_list_t *recommendation_list, const bce_command_t *cmd,
-                                      const char *current_word, const char *previous_word) {
+                                      const char *current_word, const char *previous_word,
+                                      recommendation_filter_t *filter) {
     if (!recommendation_list || !cmd) {
         return false;
     }
@@ -191,30 +242,32 @@ bool collect_optional_recommendations(linked_list_t *recommendation_list, const
     if (cmd->sub_commands) {
         for (linked_list_node_t *sub_cmd_node = cmd->sub_commands->head; sub_cmd_node != NULL; sub_cmd_node = sub_cmd_node->next) {
             bce_command_t *sub_cmd = (bce_command_t *) sub_cmd_node->data;
-            if (!sub_cmd->is_present_on_cmdline) {
-                char *data = calloc(NAME_FIELD_SIZE + 1, sizeof(char));
-                strncat(data, sub_cmd->name, NAME_FIELD_SIZE);
+            bce_str_t word = sub_cmd->name;
+            int score = sub_cmd->is_present_on_cmdline ? FUZZY_NO_MATCH : sub_command_score(sub_cmd, filter, &word);
+            if (score != FUZZY_NO_MATCH) {
+                bce_str_t shortest = NULL;
                 if (sub_cmd->aliases) {
-                    char *shortest = NULL;
                     for (linked_list_node_t *alias_node = sub_cmd->aliases->head; alias_node != NULL; alias_node = alias_node->next) {
-                        if (!shortest) {
-                            shortest = alias_node->data;
-                        } else {
-                            if (strlen(alias_node->data) < strlen(shortest)) {
-                                shortest = alias_node->data;
-                            }
+                        const bce_command_alias_t *alias = (const bce_command_alias_t *) alias_node->data;
+                        if (!shortest || (bce_str_len(alias->name) < bce_str_len(shortest))) {
+                            shortest = alias->name;
                         }
                     }
-                    // show the shortest alias
-                    if (shortest) {
-                        strcat(data, " (");
-                        strncat(data, shortest, NAME_FIELD_SIZE);
-                        strcat(data, ")");
-                    }
                 }
-                ll_append_item(recommendation_list, data);
+                // "name (alias)", showing the shortest alias
+                size_t len = bce_str_len(sub_cmd->name) + (shortest ? bce_str_len(shortest) + 3 : 0);
+                char *data = arena_calloc(recommendation_list->arena, len + 1, sizeof(char));
+                strcat(data, sub_cmd->name);
+                if (shortest) {
+                    strcat(data, " (");
+                    strcat(data, shortest);
+                    strcat(data, ")");
+                }
+                append_recommendation(recommendation_list, filter,
+                                      make_recommendation(recommendation_list->arena, filter, word, data, bce_str_empty()),
+                                      with_usage(filter, score, sub_command_usage(sub_cmd, filter->usage)));
             }
-            collect_optional_recommendations(recommendation_list, sub_cmd, current_word, previous_word);
+            collect_optional_recommendations(recommendation_list, sub_cmd, current_word, previous_word, filter);
         }
     }
 
@@ -223,26 +276,48 @@ bool collect_optional_recommendations(linked_list_t *recommendation_list, const
         for (linked_list_node_t *arg_node = cmd->args->head; arg_node != NULL; arg_node = arg_node->next) {
             bce_command_arg_t *arg = (bce_command_arg_t *) arg_node->data;
             if (!arg->is_present_on_cmdline) {
-                char *arg_str = calloc(MAX_CMD_LINE_SIZE + 1, sizeof(char));
-                if (strlen(arg->long_name) > 0) {
-                    strncat(arg_str, arg->long_name, NAME_FIELD_SIZE);
-                    if (strlen(arg->short_name) > 0) {
+                int long_score = match_score(filter, arg->long_name);
+                int short_score = match_score(filter, arg->short_name);
+                int score = (long_score > short_score) ? long_score : short_score;
+                if (score == FUZZY_NO_MATCH) {
+                    continue;
+                }
+                // the name that matched (the long one, if both did as well)
+                bce_str_t word = ((bce_str_len(arg->long_name) > 0)
+                                  && ((bce_str_len(arg->short_name) == 0) || (long_score >= short_score)))
+                                 ? arg->long_name : arg->short_name;
+                // "long_name (short_name)"
+                size_t len = bce_str_len(arg->long_name) + bce_str_len(arg->short_name) + 3;
+                char *arg_str = arena_calloc(recommendation_list->arena, len + 1, sizeof(char));
+                if (bce_str_len(arg->long_name) > 0) {
+                    strcat(arg_str, arg->long_name);
+                    if (bce_str_len(arg->short_name) > 0) {
                         strcat(arg_str, " (");
-                        strncat(arg_str, arg->short_name, SHORTNAME_FIELD_SIZE);
+                        strcat(arg_str, arg->short_name);
                         strcat(arg_str, ")");
                     }
                 } else {
-                    strncat(arg_str, arg->short_name, SHORTNAME_FIELD_SIZE);
+                    strcat(arg_str, arg->short_name);
                 }
-                ll_append_item(recommendation_list, arg_str);
+                int usage = usage_score(filter->usage, arg->long_name) + usage_score(filter->usage, arg->short_name);
+                append_recommendation(recommendation_list, filter,
+                                      make_recommendation(recommendation_list->arena, filter, word, arg_str,
+                                                          arg->description), with_usage(filter, score, usage));
             } else {
                 // collect all the options
                 if (arg->opts) {
                     for (linked_list_node_t *opt_node = arg->opts->head; opt_node != NULL; opt_node = opt_node->next) {
-                        char *data = calloc(NAME_FIELD_SIZE + 1, sizeof(char));
                         bce_command_opt_t *opt = (bce_command_opt_t *) opt_node->data;
-                        strncat(data, opt->name, NAME_FIELD_SIZE);
-                        ll_append_item(recommendation_list, data);
+                        int score = match_score(filter, opt->name);
+                        if (score == FUZZY_NO_MATCH) {
+                            continue;
+                        }
+                        char *data = arena_calloc(recommendation_list->arena, bce_str_len(opt->name) + 1, sizeof(char));
+                        strcat(data, opt->name);
+                        append_recommendation(recommendation_list, filter,
+                                              make_recommendation(recommendation_list->arena, filter, opt->name, data,
+                                                                  arg->description),
+                                              with_usage(filter, score, usage_score(filter->usage, opt->name)));
                     }
                 }
             }
@@ -252,6 +327,499 @@ bool collect_optional_recommendations(linked_list_t *recommendation_list, const
     return true;
 }
 
+/*
+ * A sub-command is recommended if its name, or one of its aliases, matches; it scores as its best match,
+ * and `word` is set to it (the name, if it matches as well as any alias).
+ */
+static int sub_command_score(const bce_command_t *sub_cmd, const recommendation_filter_t *filter, bce_str_t *word) {
+    int best = match_score(filter, sub_cmd->name);
+    *word = sub_cmd->name;
+    if (sub_cmd->aliases) {
+        for (linked_list_node_t *node = sub_cmd->aliases->head; node != NULL; node = node->next) {
+            const bce_command_alias_t *alias = (const bce_command_alias_t *) node->data;
+            int score = match_score(filter, alias->name);
+            if (score > best) {
+                best = score;
+                *word = alias->name;
+            }
+        }
+    }
+    return best;
+}
+
+/* The recorded usage of a sub-command, by its name and aliases */
+static int sub_command_usage(const bce_command_t *sub_cmd, const usage_table_t *usage) {
+    if (!usage) {
+        return 0;
+    }
+    int total = usage_score(usage, sub_cmd->name);
+    if (sub_cmd->aliases) {
+        for (linked_list_node_t *node = sub_cmd->aliases->head; node != NULL; node = node->next) {
+            total += usage_score(usage, ((const bce_command_alias_t *) node->data)->name);
+        }
+    }
+    return total;
+}
+
+/*
+ * With recorded usage, the score ranks by the match first, then (among equal matches, e.g. all of them when
+ * matching by prefix) by the usage: the match's score is scaled above the largest usage score.
+ */
+static int with_usage(const recommendation_filter_t *filter, int score, int usage) {
+    if (!filter->usage || (score == FUZZY_NO_MATCH)) {
+        return score;
+    }
+    int max_score = INT_MAX / (USAGE_MAX_SCORE + 1) - 1;
+    if (score > max_score) {
+        score = max_score;
+    } else if (score < -max_score) {
+        score = -max_score;
+    }
+    return (score * (USAGE_MAX_SCORE + 1)) + ((usage > USAGE_MAX_SCORE) ? USAGE_MAX_SCORE : usage);
+}
+
+/*
+ * What is collected for a recommendation: the text to display or, in OUTPUT_WORDS, the word to insert (quoted),
+ * the text to display and the description, separated by tabs (the ones in the text are replaced with spaces).
+ */
+static char *make_recommendation(arena_t *arena, const recommendation_filter_t *filter, bce_str_t word,
+                                 char *display, bce_str_t description) {
+    if (filter->format != OUTPUT_WORDS) {
+        return display;
+    }
+    char *quoted = quote_word_in(arena, word, bce_str_len(word), filter->quote);
+    if (!quoted) {
+        return NULL;
+    }
+    size_t quoted_len = strlen(quoted);
+    size_t display_len = strlen(display);
+    size_t description_len = bce_str_len(description);
+    char *data = arena_alloc(arena, quoted_len + display_len + description_len + 3);
+    if (!data) {
+        return NULL;
+    }
+    char *p = data;
+    memcpy(p, quoted, quoted_len);
+    p += quoted_len;
+    *p++ = '\t';
+    p = copy_text(p, display, display_len);
+    *p++ = '\t';
+    p = copy_text(p, description, description_len);
+    *p = '\0';
+    return data;
+}
+
+/* Copy `len` characters, with spaces instead of control characters (e.g. tabs and newlines) */
+static char *copy_text(char *dest, const char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) text[i];
+        *dest++ = ((c < 0x20) || (c == 0x7f)) ? ' ' : (char) c;
+    }
+    return dest;
+}
+
+bool collect_word_recommendation(linked_list_t *recommendation_list, recommendation_filter_t *filter, bce_str_t word) {
+    if (!recommendation_list) {
+        return false;
+    }
+    char *display = arena_calloc(recommendation_list->arena, bce_str_len(word) + 1, sizeof(char));
+    if (display) {
+        strcat(display, word);
+        append_recommendation(recommendation_list, filter,
+                              make_recommendation(recommendation_list->arena, filter, word, display, bce_str_empty()), 0);
+    }
+    return true;
+}
+
+/* FUZZY_NO_MATCH if `str` doesn't match; when matching by prefix, every match scores 0 */
+static int match_score(const recommendation_filter_t *filter, bce_str_t str) {
+    switch (filter->mode) {
+        case MATCH_FUZZY:
+            return fuzzy_score(&filter->pattern, str, bce_str_len(str));
+        case MATCH_TYPO: {
+            if (filter->max_typos <= 0) {
+                return FUZZY_NO_MATCH;
+            }
+            // nearest first
+            int distance = edit_distance(&filter->typo_pattern, str, bce_str_len(str), filter->max_typos);
+            return (distance <= filter->max_typos) ? -distance : FUZZY_NO_MATCH;
+        }
+        default:
+            return bce_str_has_prefix(str, filter->prefix) ? 0 : FUZZY_NO_MATCH;
+    }
+}
+
+/*
+ * Append, and record the score if it was (i.e. not a duplicate). If the scores can't grow, recording stops:
+ * the count no longer matches the list, so the list is left unranked.
+ */
+static void append_recommendation(linked_list_t *recommendation_list, recommendation_filter_t *filter,
+                                  const char *data, int score) {
+    if (!data) {
+        return;
+    }
+    if (filter->limit > 0) {
+        keep_recommendation(filter, data, score);
+        return;
+    }
+    if (!ll_append_item(recommendation_list, data)) {
+        return;
+    }
+    filter->matched++;
+    if ((filter->mode == MATCH_PREFIX) && !filter->usage) {
+        return;
+    }
+    if (filter->score_count != recommendation_list->size - 1) {
+        return;
+    }
+    if (filter->score_count == filter->score_capacity) {
+        size_t capacity = (filter->score_capacity > 0) ? filter->score_capacity * 2 : 64;
+        int *scores = realloc(filter->scores, capacity * sizeof(int));
+        if (!scores) {
+            return;
+        }
+        filter->scores = scores;
+        filter->score_capacity = capacity;
+    }
+    filter->scores[filter->score_count++] = score;
+}
+
+/*
+ * Keep the best `limit` recommendations in a heap with the worst on top, which a better one replaces: only the
+ * heap is kept in order, not every match. Duplicates are left out (and not counted) by hashing every match.
+ */
+static void keep_recommendation(recommendation_filter_t *filter, const char *data, int score) {
+    size_t len = strlen(data);
+    if (!filter->seen) {
+        filter->seen = hm_create(filter->limit);
+        if (!filter->seen) {
+            return;
+        }
+    }
+    if (hm_get_n(filter->seen, data, len) || !hm_put_n(filter->seen, data, len, (void *) data)) {
+        return;
+    }
+    filter->matched++;
+
+    scored_recommendation_t candidate = {data, score};
+    if (filter->best_count < filter->limit) {
+        if (filter->best_count == filter->best_capacity) {
+            size_t capacity = (filter->best_capacity > 0) ? filter->best_capacity * 2 : 64;
+            if (capacity > filter->limit) {
+                capacity = filter->limit;
+            }
+            scored_recommendation_t *best = realloc(filter->best, capacity * sizeof(scored_recommendation_t));
+            if (!best) {
+                return;
+            }
+            filter->best = best;
+            filter->best_capacity = capacity;
+        }
+        filter->best[filter->best_count] = candidate;
+        sift_up(filter->best, filter->best_count++);
+    } else if (is_worse(&filter->best[0], &candidate)) {
+        filter->best[0] = candidate;
+        sift_down(filter->best, filter->best_count, 0);
+    }
+}
+
+/* A lower score, or the same score and later in alphabetical order */
+static bool is_worse(const scored_recommendation_t *a, const scored_recommendation_t *b) {
+    if (a->score != b->score) {
+        return a->score < b->score;
+    }
+    return strcmp(a->data, b->data) > 0;
+}
+
+/* Move `heap[i]` up, above the better ones */
+static void sift_up(scored_recommendation_t *heap, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!is_worse(&heap[i], &heap[parent])) {
+            break;
+        }
+        scored_recommendation_t swap = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = swap;
+        i = parent;
+    }
+}
+
+/* Move `heap[i]` down, below the worse ones */
+static void sift_down(scored_recommendation_t *heap, size_t count, size_t i) {
+    for (;;) {
+        size_t worst = i;
+        size_t left = (2 * i) + 1;
+        size_t right = left + 1;
+        if ((left < count) && is_worse(&heap[left], &heap[worst])) {
+            worst = left;
+        }
+        if ((right < count) && is_worse(&heap[right], &heap[worst])) {
+            worst = right;
+        }
+        if (worst == i) {
+            break;
+        }
+        scored_recommendation_t swap = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = swap;
+        i = worst;
+    }
+}
+
+void recommendation_filter_init(recommendation_filter_t *filter, match_mode_t mode, bce_str_t prefix,
+                                const completion_input_t *input) {
+    filter->mode = mode;
+    filter->prefix = prefix;
+    filter->scores = NULL;
+    filter->score_count = 0;
+    filter->score_capacity = 0;
+    filter->limit = input ? input->max_results : 0;
+    filter->format = input ? input->output_format : OUTPUT_DISPLAY;
+    filter->quote = input ? get_cursor_quote(input) : TOKEN_UNQUOTED;
+    filter->usage = NULL;
+    filter->best = NULL;
+    filter->best_count = 0;
+    filter->best_capacity = 0;
+    filter->seen = NULL;
+    filter->matched = 0;
+    filter->max_typos = 0;
+    if ((mode == MATCH_FUZZY) && !fuzzy_pattern_init(&filter->pattern, prefix, bce_str_len(prefix))) {
+        filter->mode = MATCH_PREFIX;
+    }
+    if ((mode == MATCH_TYPO) && edit_pattern_init(&filter->typo_pattern, prefix, bce_str_len(prefix))) {
+        filter->max_typos = max_typos(bce_str_len(prefix));
+    }
+}
+
+void recommendation_filter_rank(recommendation_filter_t *filter, linked_list_t *recommendation_list) {
+    if (filter->limit > 0) {
+        if (filter->best_count > 1) {
+            qsort(filter->best, filter->best_count, sizeof(scored_recommendation_t), &compare_scored);
+        }
+        // they are distinct already: skip the list's own (linear) check for each
+        bool unique = recommendation_list->unique;
+        recommendation_list->unique = false;
+        for (size_t i = 0; i < filter->best_count; i++) {
+            ll_append_item(recommendation_list, filter->best[i].data);
+        }
+        recommendation_list->unique = unique;
+        return;
+    }
+    if (((filter->mode == MATCH_PREFIX) && !filter->usage) || (recommendation_list->size < 2)
+        || (filter->score_count != recommendation_list->size)) {
+        return;
+    }
+    ranked_node_t *ranked = malloc(recommendation_list->size * sizeof(ranked_node_t));
+    if (!ranked) {
+        return;
+    }
+    size_t i = 0;
+    for (linked_list_node_t *node = recommendation_list->head; node != NULL; node = node->next, i++) {
+        ranked[i].node = node;
+        ranked[i].score = filter->scores[i];
+        ranked[i].order = i;
+    }
+    qsort(ranked, recommendation_list->size, sizeof(ranked_node_t), &compare_ranked);
+
+    // relink the nodes in their new order
+    for (i = 0; i + 1 < recommendation_list->size; i++) {
+        ranked[i].node->next = ranked[i + 1].node;
+        filter->scores[i] = ranked[i].score;
+    }
+    ranked[i].node->next = NULL;
+    filter->scores[i] = ranked[i].score;
+    recommendation_list->head = ranked[0].node;
+    recommendation_list->tail = ranked[i].node;
+    free(ranked);
+}
+
+size_t recommendation_filter_omitted(const recommendation_filter_t *filter) {
+    return (filter->limit > 0) ? filter->matched - filter->best_count : 0;
+}
+
+void recommendation_filter_free(recommendation_filter_t *filter) {
+    free(filter->scores);
+    filter->scores = NULL;
+    filter->score_count = 0;
+    filter->score_capacity = 0;
+    free(filter->best);
+    filter->best = NULL;
+    filter->best_count = 0;
+    filter->best_capacity = 0;
+    filter->seen = hm_destroy(filter->seen);
+    filter->matched = 0;
+}
+
+/* Higher scores first, then in the order they were collected */
+static int compare_ranked(const void *a, const void *b) {
+    const ranked_node_t *ra = (const ranked_node_t *) a;
+    const ranked_node_t *rb = (const ranked_node_t *) b;
+    if (ra->score != rb->score) {
+        return (ra->score > rb->score) ? -1 : 1;
+    }
+    return (ra->order < rb->order) ? -1 : (ra->order > rb->order) ? 1 : 0;
+}
+
+/* Better first (see `is_worse()`) */
+static int compare_scored(const void *a, const void *b) {
+    const scored_recommendation_t *sa = (const scored_recommendation_t *) a;
+    const scored_recommendation_t *sb = (const scored_recommendation_t *) b;
+    if (is_worse(sa, sb)) {
+        return 1;
+    }
+    return is_worse(sb, sa) ? -1 : 0;
+}
+
+bool correct_misspelled_words(const bce_command_t *cmd, completion_input_t *input) {
+    if (!cmd || !input || (input->token_count < 2)) {
+        return false;
+    }
+    hash_map_t *word_set = word_set_create_from_input(input);
+    bool corrected = false;
+    if (!word_set) {
+        goto done;
+    }
+
+    // sub-commands: follow the ones on the command line, and correct a word where they stop
+    const bce_command_t *level = cmd;
+    while (level->sub_commands && (level->sub_commands->size > 0)) {
+        const bce_command_t *next = NULL;
+        for (linked_list_node_t *node = level->sub_commands->head; node != NULL; node = node->next) {
+            const bce_command_t *sub_cmd = (const bce_command_t *) node->data;
+            if (bce_command_is_on_cmdline(sub_cmd, word_set)) {
+                next = sub_cmd;
+                break;
+            }
+        }
+        if (!next) {
+            int index = -1;
+            next = find_misspelled_sub_command(level, input, &index);
+            if (!next || !correct_completion_input_word(input, index, next->name)) {
+                break;
+            }
+            corrected = true;
+        }
+        level = next;
+    }
+
+    // args: the nearest name in the tree, for each word that starts with '-' and isn't one
+    for (int i = 1; i < (int) input->token_count; i++) {
+        size_t len = 0;
+        const char *word = get_token(input, i, &len);
+        if (!is_correction_candidate(input, i) || (len < 2) || (word[0] != '-')
+            || ((len == 2) && (word[1] == '-'))) {
+            continue;
+        }
+        edit_pattern_t pattern;
+        int max_distance = max_typos(len);
+        if ((max_distance == 0) || !edit_pattern_init(&pattern, word, len)) {
+            continue;
+        }
+        int best_distance = max_distance + 1;
+        bce_str_t best_name = NULL;
+        find_nearest_arg(cmd, &pattern, max_distance, &best_distance, &best_name);
+        if (best_name && (best_distance > 0) && correct_completion_input_word(input, i, best_name)) {
+            corrected = true;
+        }
+    }
+
+    done:
+    word_set = hm_destroy(word_set);
+    return corrected;
+}
+
+/* A word of 3-4 characters may have 1 typo, a longer one 2 (shorter words are too ambiguous to correct) */
+static int max_typos(size_t len) {
+    if (len < 3) {
+        return 0;
+    }
+    return (len < 5) ? 1 : 2;
+}
+
+/*
+ * Not the command, the word being typed, a word already corrected, or the value of an option
+ * (a word after one that starts with '-').
+ */
+static bool is_correction_candidate(const completion_input_t *input, int index) {
+    if ((index < 1) || (index == get_cursor_token(input)) || (input->corrections && input->corrections[index])) {
+        return false;
+    }
+    size_t len = 0;
+    const char *previous = get_token(input, index - 1, &len);
+    return (len == 0) || (previous[0] != '-');
+}
+
+/*
+ * The child of `cmd` nearest to the first word (not starting with '-') that misspells one, by name or alias.
+ * `index` is set to the word's token.
+ */
+static const bce_command_t *find_misspelled_sub_command(const bce_command_t *cmd, const completion_input_t *input,
+                                                        int *index) {
+    for (int i = 1; i < (int) input->token_count; i++) {
+        size_t len = 0;
+        const char *word = get_token(input, i, &len);
+        if (!is_correction_candidate(input, i) || (len == 0) || (word[0] == '-')) {
+            continue;
+        }
+        edit_pattern_t pattern;
+        int max_distance = max_typos(len);
+        if ((max_distance == 0) || !edit_pattern_init(&pattern, word, len)) {
+            continue;
+        }
+        const bce_command_t *best = NULL;
+        int best_distance = max_distance + 1;
+        for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+            const bce_command_t *sub_cmd = (const bce_command_t *) node->data;
+            int distance = edit_distance(&pattern, sub_cmd->name, bce_str_len(sub_cmd->name), max_distance);
+            if (sub_cmd->aliases) {
+                for (linked_list_node_t *alias_node = sub_cmd->aliases->head; alias_node != NULL; alias_node = alias_node->next) {
+                    const bce_command_alias_t *alias = (const bce_command_alias_t *) alias_node->data;
+                    int alias_distance = edit_distance(&pattern, alias->name, bce_str_len(alias->name), max_distance);
+                    if (alias_distance < distance) {
+                        distance = alias_distance;
+                    }
+                }
+            }
+            if (distance < best_distance) {
+                best = sub_cmd;
+                best_distance = distance;
+            }
+        }
+        if (best) {
+            *index = i;
+            return best;
+        }
+    }
+    return NULL;
+}
+
+/* The arg name (long or short) in the tree nearest to the pattern; the first one found wins a tie */
+static void find_nearest_arg(const bce_command_t *cmd, const edit_pattern_t *pattern, int max_distance,
+                             int *best_distance, bce_str_t *best_name) {
+    if (cmd->args) {
+        for (linked_list_node_t *node = cmd->args->head; node != NULL; node = node->next) {
+            const bce_command_arg_t *arg = (const bce_command_arg_t *) node->data;
+            bce_str_t names[] = {arg->long_name, arg->short_name};
+            for (size_t i = 0; i < 2; i++) {
+                if (bce_str_len(names[i]) == 0) {
+                    continue;
+                }
+                int distance = edit_distance(pattern, names[i], bce_str_len(names[i]), max_distance);
+                if (distance < *best_distance) {
+                    *best_distance = distance;
+                    *best_name = names[i];
+                }
+            }
+        }
+    }
+    if (cmd->sub_commands) {
+        for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+            find_nearest_arg((const bce_command_t *) node->data, pattern, max_distance, best_distance, best_name);
+        }
+    }
+}
+
 bce_command_arg_t *get_current_arg(const bce_command_t *cmd, const char *current_word) {
     if (!cmd || !current_word) {
         return NULL;
@@ -263,8 +831,7 @@ bce_command_arg_t *get_current_arg(const bce_command_t *cmd, const char *current
         for (linked_list_node_t *arg_node = cmd->args->head; arg_node != NULL; arg_node = arg_node->next) {
             bce_command_arg_t *arg = (bce_command_arg_t *) arg_node->data;
             if (arg->is_present_on_cmdline) {
-                if ((strncmp(arg->long_name, current_word, NAME_FIELD_SIZE) == 0) ||
-                    (strncmp(arg->short_name, current_word, SHORTNAME_FIELD_SIZE) == 0)) {
+                if ((strcmp(arg->long_name, current_word) == 0) || (strcmp(arg->short_name, current_word) == 0)) {
                     found_arg = arg;
                     break;
                 }
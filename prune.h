@@ -3,14 +3,84 @@
 
 #include "input.h"
 #include "data_model.h"
+#include "fuzzy.h"
+#include "edit_distance.h"
+#include "usage.h"
+
+/* A recommendation kept by a limited filter, and its score */
+typedef struct scored_recommendation_t {
+    const char *data;
+    int score;
+} scored_recommendation_t;
+
+/*
+ * Selects the recommendations by the word under the cursor, and ranks them when matching fuzzily, or by recorded
+ * usage (the most used of equal matches first). With a limit, only the best ones are kept (in a bounded heap),
+ * and the others are only counted.
+ */
+typedef struct recommendation_filter_t {
+    match_mode_t mode;
+    bce_str_t prefix;           /* see `get_completion_prefix_in()` */
+    fuzzy_pattern_t pattern;    /* `prefix`, when matching fuzzily */
+    edit_pattern_t typo_pattern; /* `prefix`, when looking for the names it misspells */
+    int max_typos;
+    int *scores;                /* the score of each collected recommendation, in order (not by prefix, unless usage) */
+    size_t score_count;
+    size_t score_capacity;
+    size_t limit;               /* keep the best `limit` recommendations (0: all of them) */
+    scored_recommendation_t *best;  /* the best ones so far when limited, in a heap with the worst on top */
+    size_t best_count;
+    size_t best_capacity;
+    hash_map_t *seen;           /* the recommendations matched so far when limited, to leave duplicates out */
+    size_t matched;             /* the number of (distinct) recommendations matched */
+    output_format_t format;     /* what is collected for each recommendation */
+    token_quote_t quote;        /* of the word under the cursor, to quote the words to insert for (OUTPUT_WORDS) */
+    const usage_table_t *usage; /* the command's recorded usage (NULL: none; set it after init) */
+} recommendation_filter_t;
+
+/*
+ * Match by `prefix`; patterns longer than FUZZY_MAX_PATTERN are matched by prefix, even in MATCH_FUZZY.
+ * MATCH_TYPO matches the names within 1 (for words of 3-4 characters) or 2 edits (longer words) of the prefix.
+ * The limit (see `recommendation_filter_omitted()`) and the output format are the input's (none, and OUTPUT_DISPLAY,
+ * if it is NULL).
+ */
+void recommendation_filter_init(recommendation_filter_t *filter, match_mode_t mode, bce_str_t prefix,
+                                const completion_input_t *input);
+
+/*
+ * Sort the collected recommendations by score (or distance), then usage, best first (ties keep their order); not for
+ * MATCH_PREFIX without usage. When limited, the ones kept are appended instead, by score and then alphabetically
+ * (without usage, every match scores the same when matching by prefix).
+ */
+void recommendation_filter_rank(recommendation_filter_t *filter, linked_list_t *recommendation_list);
+
+/* The number of recommendations matched but left out by the limit */
+size_t recommendation_filter_omitted(const recommendation_filter_t *filter);
+
+void recommendation_filter_free(recommendation_filter_t *filter);
 
 void prune_command(bce_command_t *cmd, const completion_input_t *input);
 
-/* Collect recommendations that should appear first in the list */
-bool collect_required_recommendations(linked_list_t *recommendation_list, const bce_command_t *cmd, const char *current_word, const char *previous_word);
+/* Collect recommendations that should appear first in the list (all of them match; the filter only limits them) */
+bool collect_required_recommendations(linked_list_t *recommendation_list, const bce_command_t *cmd, const char *current_word, const char *previous_word, recommendation_filter_t *filter);
+
+/*
+ * Collect `word` itself, complete (e.g. the arg under the cursor in OUTPUT_WORDS: its options are for the next word).
+ * Returns true, as it is the only recommendation.
+ */
+bool collect_word_recommendation(linked_list_t *recommendation_list, recommendation_filter_t *filter, bce_str_t word);
+
+/* Collect remaining recommendations, the ones matching the filter (from an empty list, to rank them) */
+bool collect_optional_recommendations(linked_list_t *recommendation_list, const bce_command_t *cmd, const char *current_word, const char *previous_word, recommendation_filter_t *filter);
 
-/* Collect remaining recommendations */
-bool collect_optional_recommendations(linked_list_t *recommendation_list, const bce_command_t *cmd, const char *current_word, const char *previous_word);
+/*
+ * Find the sub-commands and args that words on the command line (other than the one at the cursor) misspell,
+ * within the same number of edits as MATCH_TYPO, and read their names instead (see `correct_completion_input_word()`).
+ * A sub-command is looked for among the children of the last one on the command line. Returns true if any word
+ * was corrected: load the command again (and call again, as it may have more children) to complete as if they
+ * had been typed. Each word is corrected at most once.
+ */
+bool correct_misspelled_words(const bce_command_t *cmd, completion_input_t *input);
 
 /* Determine if the user's cursor is positioned at a `command_arg` */
 bce_command_arg_t *get_current_arg(const bce_command_t *cmd, const char *current_word);
@@ -0,0 +1,334 @@
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "completion.h"
+#include "prune.h"
+#include "input.h"
+#include "ipc.h"
+#include "history_index.h"
+#include "output_buffer.h"
+#include "linked_list.h"
+
+/* A client whose request is being read */
+typedef struct server_client_t {
+    int fd;
+    char *request;
+    size_t len;
+    size_t capacity;
+    int64_t deadline_ms;
+} server_client_t;
+
+typedef enum client_state_t {
+    CLIENT_READING,
+    CLIENT_READY,       /* the whole request was read (the client shut down its end) */
+    CLIENT_FAILED
+} client_state_t;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int sig);
+
+static int open_server_socket(const char *path);
+
+static int64_t monotonic_ms(void);
+
+static bool accept_client(int server_fd, server_client_t *client);
+
+static client_state_t read_request(server_client_t *client);
+
+static void serve_client(completion_cache_t *cache, arena_t *arena, int client_fd, char *request, size_t request_len);
+
+bce_error_t process_serve(const char *db_filename) {
+    bce_error_t err = ERR_NONE;
+    char socket_path[FILENAME_MAX + 1];
+    if (!ipc_socket_path(socket_path, sizeof(socket_path))) {
+        fprintf(stderr, "Unable to determine the socket path\n");
+        return ERR_SOCKET;
+    }
+
+    completion_cache_t *cache = completion_cache_create(db_filename, &err);
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Unable to open database: %s\n", db_filename);
+        return err;
+    }
+
+    // per-request data; reset after each client, so its blocks are reused
+    arena_t *arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    if (!arena) {
+        cache = completion_cache_free(cache);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    int server_fd = open_server_socket(socket_path);
+    if (server_fd < 0) {
+        fprintf(stderr, "Unable to listen on socket: %s\n", socket_path);
+        arena = arena_destroy(arena);
+        cache = completion_cache_free(cache);
+        return ERR_SOCKET;
+    }
+
+    // stop cleanly, so the socket file is removed; a client going away must not kill the server
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // wait for new clients and the requests of the others at once: one that doesn't send holds only its own slot
+    server_client_t clients[SERVER_MAX_CLIENTS];
+    size_t client_count = 0;
+    struct pollfd pfds[1 + SERVER_MAX_CLIENTS];
+    while (!stop_requested) {
+        int timeout_ms = -1;
+        int64_t now = monotonic_ms();
+        pfds[0].fd = server_fd;
+        pfds[0].events = (client_count < SERVER_MAX_CLIENTS) ? POLLIN : 0;
+        for (size_t i = 0; i < client_count; i++) {
+            pfds[i + 1].fd = clients[i].fd;
+            pfds[i + 1].events = POLLIN;
+            int64_t remaining = (clients[i].deadline_ms > now) ? (clients[i].deadline_ms - now) : 0;
+            if ((timeout_ms < 0) || (remaining < timeout_ms)) {
+                timeout_ms = (int) remaining;
+            }
+        }
+        if (poll(pfds, client_count + 1, timeout_ms) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "poll() failed: %s\n", strerror(errno));
+            err = ERR_SOCKET;
+            break;
+        }
+
+        // from the last one, so the one moved into a freed slot was already handled
+        now = monotonic_ms();
+        for (size_t i = client_count; i-- > 0;) {
+            server_client_t *client = &clients[i];
+            client_state_t state = CLIENT_READING;
+            if (pfds[i + 1].revents != 0) {
+                state = read_request(client);
+            } else if (now >= client->deadline_ms) {
+                state = CLIENT_FAILED;
+            }
+            if (state == CLIENT_READING) {
+                continue;
+            }
+            if (state == CLIENT_READY) {
+                serve_client(cache, arena, client->fd, client->request, client->len);
+                arena_reset(arena);
+            } else {
+                free(client->request);
+            }
+            close(client->fd);
+            clients[i] = clients[--client_count];
+        }
+
+        if ((pfds[0].revents & POLLIN) && (client_count < SERVER_MAX_CLIENTS)
+            && accept_client(server_fd, &clients[client_count])) {
+            client_count++;
+        }
+    }
+
+    for (size_t i = 0; i < client_count; i++) {
+        free(clients[i].request);
+        close(clients[i].fd);
+    }
+    close(server_fd);
+    unlink(socket_path);
+    arena = arena_destroy(arena);
+    cache = completion_cache_free(cache);
+    return err;
+}
+
+static void handle_stop_signal(int sig) {
+    (void) sig;
+    stop_requested = 1;
+}
+
+static int open_server_socket(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strncat(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // only the current user may connect
+    mode_t old_mask = umask(0077);
+    int rc = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+    if ((rc < 0) && (errno == EADDRINUSE)) {
+        // a stale socket is left over if nobody is answering on it
+        int probe_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool in_use = (probe_fd >= 0) && (connect(probe_fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+        if (probe_fd >= 0) {
+            close(probe_fd);
+        }
+        if (!in_use) {
+            unlink(path);
+            rc = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+        }
+    }
+    umask(old_mask);
+
+    if ((rc < 0) || (listen(fd, SOMAXCONN) < 0)) {
+        close(fd);
+        return -1;
+    }
+    // a client may be gone by the time it is accepted: never block in accept()
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool accept_client(int server_fd, server_client_t *client) {
+    int fd = accept(server_fd, NULL, NULL);
+    if (fd < 0) {
+        if ((errno != EINTR) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != ECONNABORTED)) {
+            fprintf(stderr, "accept() failed: %s\n", strerror(errno));
+        }
+        return false;
+    }
+    // the response is written in one go: a client that doesn't read it can't hold the server for longer than this
+    struct timeval timeout = {SERVER_READ_TIMEOUT_MS / 1000, (SERVER_READ_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    client->fd = fd;
+    client->request = NULL;
+    client->len = 0;
+    client->capacity = 0;
+    client->deadline_ms = monotonic_ms() + SERVER_READ_TIMEOUT_MS;
+    return true;
+}
+
+/* Read what the client has sent so far (poll() said there is some, so this doesn't block) */
+static client_state_t read_request(server_client_t *client) {
+    if (client->len == client->capacity) {
+        size_t capacity = (client->capacity > 0) ? client->capacity * 2 : 4096;
+        if (capacity > IPC_MAX_REQUEST_SIZE) {
+            return CLIENT_FAILED;
+        }
+        // room for a NUL, as `ipc_read_all()` leaves
+        char *request = realloc(client->request, capacity + 1);
+        if (!request) {
+            return CLIENT_FAILED;
+        }
+        client->request = request;
+        client->capacity = capacity;
+    }
+    ssize_t count = read(client->fd, client->request + client->len, client->capacity - client->len);
+    if (count < 0) {
+        return (errno == EINTR) ? CLIENT_READING : CLIENT_FAILED;
+    }
+    if (count == 0) {
+        client->request[client->len] = '\0';
+        return CLIENT_READY;
+    }
+    client->len += (size_t) count;
+    return CLIENT_READING;
+}
+
+/* Answer the request (freed) */
+static void serve_client(completion_cache_t *cache, arena_t *arena, int client_fd, char *request, size_t request_len) {
+    bce_error_t err = ERR_NONE;
+    const char **envp = ipc_request_to_envp(request, request_len);
+    completion_input_t *input = NULL;
+    bce_command_t *completion_command = NULL;
+    linked_list_t *word_list = NULL;
+    linked_list_t *recommendation_list = NULL;
+    bce_str_t command_name = NULL;
+    usage_table_t *usage = NULL;
+    history_index_t *history = NULL;
+    char histfile[PATH_MAX];
+
+    if (!envp) {
+        goto done;
+    }
+    input = create_completion_input_from_env(envp, &err);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+    command_name = get_command_word_in(arena, input);
+    if (bce_str_len(command_name) == 0) {
+        goto done;
+    }
+
+    // copy only the sub-commands on the command line
+    word_list = completion_input_to_list_in(arena, input);
+    completion_command = completion_cache_get_command(cache, arena, command_name, word_list,
+                                                     completion_index_prefix_in(arena, input), &err);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+
+    // with BCE_CORRECT, copy it again as if the misspelled words had been typed correctly
+    while (input->correct_words && correct_misspelled_words(completion_command, input)) {
+        completion_command = bce_command_free(completion_command);
+        word_list = completion_input_to_list_in(arena, input);
+        completion_command = completion_cache_get_command(cache, arena, command_name, word_list,
+                                                         completion_index_prefix_in(arena, input), &err);
+        if (err != ERR_NONE) {
+            goto done;
+        }
+    }
+
+    recommendation_list = ll_create_unique_in(arena, NULL);
+    size_t omitted = 0;
+    usage = usage_load(cache->usage_filename, cache->usage_log_filename, command_name, time(NULL));
+    // the server's own history file: $HISTFILE is seldom exported
+    if (history_file_path(histfile, sizeof(histfile), NULL)) {
+        history = history_index_load(cache->history_index_filename, histfile, command_name);
+        history_index_merge(history, completion_command);
+    }
+    err = completion_collect(completion_command, input, usage, recommendation_list, NULL, &omitted);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+
+    // one per line, then a NUL and the number of the ones left out, if any (see ipc.h)
+    output_buffer_t response;
+    output_buffer_init(&response);
+    output_buffer_format_recommendations(&response, NULL, recommendation_list, OUTPUT_DISPLAY);
+    if (omitted > 0) {
+        char omitted_str[32];
+        int omitted_len = snprintf(omitted_str, sizeof(omitted_str), "%zu", omitted);
+        output_buffer_append_char(&response, '\0');
+        output_buffer_append(&response, omitted_str, (size_t) omitted_len);
+    }
+    output_buffer_write(&response, client_fd);
+    output_buffer_free(&response);
+
+    done:
+    usage = usage_free(usage);
+    history = history_index_free(history);
+    recommendation_list = ll_destroy(recommendation_list);
+    completion_command = bce_command_free(completion_command);
+    word_list = ll_destroy(word_list);
+    input = free_completion_input(input);
+    free(envp);
+    free(request);
+}
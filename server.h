@@ -0,0 +1,18 @@
+#ifndef BCE_SERVER_H
+#define BCE_SERVER_H
+
+#include "error.h"
+
+/*
+ * Milliseconds a client has to send its request (and to take the response). Clients are read as their data
+ * arrives, so a slow one only holds its own slot, not the others' requests.
+ */
+#define SERVER_READ_TIMEOUT_MS  1000
+
+/* Clients whose request is still being read; while all are taken, no more are accepted */
+#define SERVER_MAX_CLIENTS      64
+
+/* Answer completion requests over a Unix domain socket, until SIGINT/SIGTERM */
+bce_error_t process_serve(const char *db_filename);
+
+#endif // BCE_SERVER_H
@@ -0,0 +1,674 @@
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "linked_list.h"
+#include "input.h"
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+#ifdef __APPLE__
+#define ST_MTIM st_mtimespec
+#else
+#define ST_MTIM st_mtim
+#endif
+
+/* growable byte buffer, used for each section while compiling */
+typedef struct snapshot_buffer_t {
+    char *data;
+    size_t size;
+    size_t capacity;
+} snapshot_buffer_t;
+
+/* string table with de-duplication */
+typedef struct snapshot_strings_t {
+    snapshot_buffer_t buffer;
+    uint32_t *slots;            /* open addressing; 0 is an empty slot */
+    size_t slot_count;
+    size_t used_slots;
+    bool failed;                /* an add ran out of memory: its offset (0) is not the string */
+} snapshot_strings_t;
+
+static uint32_t fnv1a(const void *data, size_t len, uint32_t hash);
+
+static bool buffer_append(snapshot_buffer_t *buffer, const void *data, size_t len);
+
+static bool strings_init(snapshot_strings_t *strings);
+
+static void strings_free(snapshot_strings_t *strings);
+
+static uint32_t strings_add(snapshot_strings_t *strings, const char *str);
+
+static bool strings_grow(snapshot_strings_t *strings);
+
+static bool write_snapshot_file(const char *filename, snapshot_header_t *header, snapshot_buffer_t **sections,
+                                size_t section_count);
+
+static bool is_snapshot_command_named(const snapshot_t *snapshot, const snapshot_command_t *record,
+                                      const char *command_name);
+
+static bool is_snapshot_command_on_cmdline(const snapshot_t *snapshot, const snapshot_command_t *record,
+                                           const hash_map_t *word_set);
+
+static void load_snapshot_command(const snapshot_t *snapshot, const snapshot_command_t *record, bce_command_t *cmd,
+                                  const hash_map_t *word_set, bool with_sub_commands);
+
+static bool stamp_database(const char *db_filename, snapshot_stamp_t *stamp);
+
+static bool is_snapshot_valid(const snapshot_t *snapshot);
+
+static bool is_snapshot_string_valid(const snapshot_t *snapshot, uint32_t offset);
+
+bce_error_t snapshot_compile(struct sqlite3 *conn, const char *filename) {
+    bce_error_t err = ERR_NONE;
+    linked_list_t *cmd_names = ll_create(NULL);
+    linked_list_t *roots = ll_create((ll_free_node_func) &bce_command_free);
+    const bce_command_t **nodes = NULL;
+    snapshot_buffer_t commands = {0}, aliases = {0}, args = {0}, opts = {0};
+    snapshot_strings_t strings;
+    if (!strings_init(&strings)) {
+        err = ERR_SNAPSHOT;
+        goto done;
+    }
+
+    // fold the WAL into the database first, so closing this connection doesn't change the files after they are stamped
+    sqlite3_wal_checkpoint_v2(conn, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL);
+
+    // stamp before reading: a write that lands while compiling makes the snapshot stale, never wrongly current
+    snapshot_stamp_t stamp;
+    const char *db_filename = sqlite3_db_filename(conn, "main");
+    if (!db_filename || !stamp_database(db_filename, &stamp)) {
+        err = ERR_SNAPSHOT;
+        goto done;
+    }
+
+    // load every root command
+    err = db_query_root_command_names(conn, cmd_names);
+    if (err != ERR_NONE) {
+        goto done;
+    }
+    for (linked_list_node_t *node = cmd_names->head; node != NULL; node = node->next) {
+        bce_command_t *cmd = bce_command_new();
+        err = db_query_command(conn, cmd, (const char *) node->data);
+        if (err != ERR_NONE) {
+            bce_command_free(cmd);
+            goto done;
+        }
+        if (strlen(cmd->uuid) == 0) {
+            // not found
+            bce_command_free(cmd);
+            continue;
+        }
+        ll_append_item(roots, cmd);
+    }
+
+    // breadth-first, so the sub-commands of each command are contiguous
+    size_t node_count = roots->size;
+    size_t node_capacity = node_count + 16;
+    nodes = malloc(node_capacity * sizeof(bce_command_t *));
+    if (!nodes) {
+        err = ERR_SNAPSHOT;
+        goto done;
+    }
+    size_t n = 0;
+    for (linked_list_node_t *node = roots->head; node != NULL; node = node->next) {
+        nodes[n++] = (const bce_command_t *) node->data;
+    }
+
+    uint32_t alias_count = 0, arg_count = 0, opt_count = 0;
+    for (size_t i = 0; i < node_count; i++) {
+        const bce_command_t *cmd = nodes[i];
+        snapshot_command_t record;
+        record.uuid = strings_add(&strings, cmd->uuid);
+        record.name = strings_add(&strings, cmd->name);
+        record.parent_cmd_uuid = strings_add(&strings, cmd->parent_cmd_uuid);
+
+        record.first_alias = alias_count;
+        record.alias_count = 0;
+        if (cmd->aliases) {
+            for (linked_list_node_t *node = cmd->aliases->head; node != NULL; node = node->next) {
+                const bce_command_alias_t *alias = (const bce_command_alias_t *) node->data;
+                snapshot_alias_t alias_record = {strings_add(&strings, alias->uuid), strings_add(&strings, alias->name)};
+                buffer_append(&aliases, &alias_record, sizeof(alias_record));
+                record.alias_count++;
+            }
+        }
+        alias_count += record.alias_count;
+
+        record.first_arg = arg_count;
+        record.arg_count = 0;
+        if (cmd->args) {
+            for (linked_list_node_t *node = cmd->args->head; node != NULL; node = node->next) {
+                const bce_command_arg_t *arg = (const bce_command_arg_t *) node->data;
+                snapshot_arg_t arg_record;
+                arg_record.uuid = strings_add(&strings, arg->uuid);
+                arg_record.arg_type = strings_add(&strings, arg->arg_type);
+                arg_record.description = strings_add(&strings, arg->description);
+                arg_record.long_name = strings_add(&strings, arg->long_name);
+                arg_record.short_name = strings_add(&strings, arg->short_name);
+                arg_record.first_opt = opt_count;
+                arg_record.opt_count = 0;
+                if (arg->opts) {
+                    for (linked_list_node_t *opt_node = arg->opts->head; opt_node != NULL; opt_node = opt_node->next) {
+                        const bce_command_opt_t *opt = (const bce_command_opt_t *) opt_node->data;
+                        snapshot_opt_t opt_record = {strings_add(&strings, opt->uuid), strings_add(&strings, opt->name)};
+                        buffer_append(&opts, &opt_record, sizeof(opt_record));
+                        arg_record.opt_count++;
+                    }
+                }
+                opt_count += arg_record.opt_count;
+                buffer_append(&args, &arg_record, sizeof(arg_record));
+                record.arg_count++;
+            }
+        }
+        arg_count += record.arg_count;
+
+        record.first_sub_command = (uint32_t) node_count;
+        record.sub_command_count = 0;
+        if (cmd->sub_commands) {
+            for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+                if (node_count == node_capacity) {
+                    node_capacity *= 2;
+                    const bce_command_t **bigger = realloc(nodes, node_capacity * sizeof(bce_command_t *));
+                    if (!bigger) {
+                        err = ERR_SNAPSHOT;
+                        goto done;
+                    }
+                    nodes = bigger;
+                }
+                nodes[node_count++] = (const bce_command_t *) node->data;
+                record.sub_command_count++;
+            }
+        }
+        buffer_append(&commands, &record, sizeof(record));
+    }
+
+    if ((commands.size != node_count * sizeof(snapshot_command_t)) || (aliases.size != alias_count * sizeof(snapshot_alias_t))
+        || (args.size != arg_count * sizeof(snapshot_arg_t)) || (opts.size != opt_count * sizeof(snapshot_opt_t))
+        || strings.failed) {
+        // an append ran out of memory
+        err = ERR_SNAPSHOT;
+        goto done;
+    }
+
+    snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.command_count = (uint32_t) node_count;
+    header.alias_count = alias_count;
+    header.arg_count = arg_count;
+    header.opt_count = opt_count;
+    header.root_count = (uint32_t) roots->size;
+    header.strings_size = (uint32_t) strings.buffer.size;
+
+    header.commands_offset = sizeof(snapshot_header_t);
+    header.aliases_offset = header.commands_offset + (uint32_t) commands.size;
+    header.args_offset = header.aliases_offset + (uint32_t) aliases.size;
+    header.opts_offset = header.args_offset + (uint32_t) args.size;
+    header.strings_offset = header.opts_offset + (uint32_t) opts.size;
+    header.file_size = header.strings_offset + header.strings_size;
+    header.stamp = stamp;
+
+    snapshot_buffer_t *sections[] = {&commands, &aliases, &args, &opts, &strings.buffer};
+    if (!write_snapshot_file(filename, &header, sections, sizeof(sections) / sizeof(sections[0]))) {
+        fprintf(stderr, "Unable to write snapshot: %s\n", filename);
+        err = ERR_SNAPSHOT;
+        goto done;
+    }
+
+    // make sure the file reads back
+    snapshot_t *snapshot = snapshot_open(filename, true, &err);
+    snapshot = snapshot_close(snapshot);
+
+    done:
+    free(nodes);
+    free(commands.data);
+    free(aliases.data);
+    free(args.data);
+    free(opts.data);
+    strings_free(&strings);
+    roots = ll_destroy(roots);
+    cmd_names = ll_destroy(cmd_names);
+    return err;
+}
+
+snapshot_t *snapshot_open(const char *filename, bool verify, bce_error_t *err) {
+    *err = ERR_SNAPSHOT;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || ((size_t) st.st_size < sizeof(snapshot_header_t))) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t) st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    const snapshot_header_t *header = (const snapshot_header_t *) data;
+    bool valid = (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0)
+                 && (header->version == SNAPSHOT_VERSION)
+                 && (header->file_size == size)
+                 && (header->commands_offset >= sizeof(snapshot_header_t))
+                 && (header->aliases_offset >= sizeof(snapshot_header_t))
+                 && (header->args_offset >= sizeof(snapshot_header_t))
+                 && (header->opts_offset >= sizeof(snapshot_header_t))
+                 && (header->strings_offset >= sizeof(snapshot_header_t))
+                 && (((header->commands_offset | header->aliases_offset | header->args_offset | header->opts_offset
+                       | header->strings_offset) % sizeof(uint32_t)) == 0)
+                 && (header->commands_offset + (uint64_t) header->command_count * sizeof(snapshot_command_t) <= size)
+                 && (header->aliases_offset + (uint64_t) header->alias_count * sizeof(snapshot_alias_t) <= size)
+                 && (header->args_offset + (uint64_t) header->arg_count * sizeof(snapshot_arg_t) <= size)
+                 && (header->opts_offset + (uint64_t) header->opt_count * sizeof(snapshot_opt_t) <= size)
+                 && (header->strings_offset + (uint64_t) header->strings_size <= size)
+                 && (header->root_count <= header->command_count);
+    if (valid && verify) {
+        uint32_t checksum = fnv1a((const char *) data + sizeof(snapshot_header_t), size - sizeof(snapshot_header_t),
+                                  FNV_OFFSET_BASIS);
+        valid = (checksum == header->checksum);
+    }
+    if (!valid) {
+        munmap(data, size);
+        return NULL;
+    }
+
+    snapshot_t *snapshot = malloc(sizeof(snapshot_t));
+    if (!snapshot) {
+        munmap(data, size);
+        return NULL;
+    }
+    snapshot->data = (const char *) data;
+    snapshot->size = size;
+    snapshot->header = header;
+    snapshot->commands = (const snapshot_command_t *) (snapshot->data + header->commands_offset);
+    snapshot->aliases = (const snapshot_alias_t *) (snapshot->data + header->aliases_offset);
+    snapshot->args = (const snapshot_arg_t *) (snapshot->data + header->args_offset);
+    snapshot->opts = (const snapshot_opt_t *) (snapshot->data + header->opts_offset);
+    snapshot->strings = snapshot->data + header->strings_offset;
+
+    // checked once here, so loading a command can follow the records without bounds checks
+    if (!is_snapshot_valid(snapshot)) {
+        snapshot_close(snapshot);
+        return NULL;
+    }
+
+    *err = ERR_NONE;
+    return snapshot;
+}
+
+snapshot_t *snapshot_close(snapshot_t *snapshot) {
+    if (!snapshot) {
+        return NULL;
+    }
+
+    munmap((void *) snapshot->data, snapshot->size);
+    free(snapshot);
+    return NULL;
+}
+
+bool snapshot_is_current(const snapshot_t *snapshot, const char *db_filename) {
+    if (!snapshot) {
+        return false;
+    }
+    snapshot_stamp_t stamp;
+    if (!stamp_database(db_filename, &stamp)) {
+        return false;
+    }
+    const snapshot_stamp_t *compiled = &snapshot->header->stamp;
+    return (stamp.db_size == compiled->db_size) && (stamp.db_mtime_ns == compiled->db_mtime_ns)
+           && (stamp.wal_size == compiled->wal_size) && (stamp.wal_mtime_ns == compiled->wal_mtime_ns);
+}
+
+bce_str_t snapshot_string(const snapshot_t *snapshot, uint32_t offset) {
+    if (!is_snapshot_string_valid(snapshot, offset)) {
+        return bce_str_empty();
+    }
+    // skip the length prefix
+    return snapshot->strings + offset + sizeof(uint32_t);
+}
+
+bce_error_t snapshot_load_command(const snapshot_t *snapshot, bce_command_t *cmd, const char *command_name,
+                                  const linked_list_t *word_list) {
+    if (!snapshot) {
+        return ERR_SNAPSHOT;
+    }
+    if (!cmd || !command_name) {
+        return ERR_INVALID_CMD_NAME;
+    }
+
+    hash_map_t *word_set = word_set_create(word_list);
+    if (word_list && !word_set) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    for (uint32_t i = 0; i < snapshot->header->root_count; i++) {
+        const snapshot_command_t *record = &snapshot->commands[i];
+        if (is_snapshot_command_named(snapshot, record, command_name)) {
+            load_snapshot_command(snapshot, record, cmd, word_set, true);
+            break;
+        }
+    }
+    word_set = hm_destroy(word_set);
+    return ERR_NONE;
+}
+
+static bool is_snapshot_command_named(const snapshot_t *snapshot, const snapshot_command_t *record,
+                                      const char *command_name) {
+    if (strcmp(snapshot_string(snapshot, record->name), command_name) == 0) {
+        return true;
+    }
+    for (uint32_t i = 0; i < record->alias_count; i++) {
+        const snapshot_alias_t *alias = &snapshot->aliases[record->first_alias + i];
+        if (strcmp(snapshot_string(snapshot, alias->name), command_name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool is_snapshot_command_on_cmdline(const snapshot_t *snapshot, const snapshot_command_t *record,
+                                           const hash_map_t *word_set) {
+    if (is_word_in_set(word_set, snapshot_string(snapshot, record->name))) {
+        return true;
+    }
+    for (uint32_t i = 0; i < record->alias_count; i++) {
+        const snapshot_alias_t *alias = &snapshot->aliases[record->first_alias + i];
+        if (is_word_in_set(word_set, snapshot_string(snapshot, alias->name))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Materialize a command record. With a `word_set`, only the sub-commands on the command line are followed
+ * (plus the children of the deepest one, without their sub-commands).
+ */
+static void load_snapshot_command(const snapshot_t *snapshot, const snapshot_command_t *record, bce_command_t *cmd,
+                                  const hash_map_t *word_set, bool with_sub_commands) {
+    cmd->uuid = snapshot_string(snapshot, record->uuid);
+    cmd->name = snapshot_string(snapshot, record->name);
+    cmd->parent_cmd_uuid = snapshot_string(snapshot, record->parent_cmd_uuid);
+
+    for (uint32_t i = 0; i < record->alias_count; i++) {
+        const snapshot_alias_t *alias_record = &snapshot->aliases[record->first_alias + i];
+        bce_command_alias_t *alias = bce_command_alias_new_in(cmd->arena);
+        alias->uuid = snapshot_string(snapshot, alias_record->uuid);
+        alias->cmd_uuid = cmd->uuid;
+        alias->name = snapshot_string(snapshot, alias_record->name);
+        ll_append_item(cmd->aliases, alias);
+    }
+
+    for (uint32_t i = 0; i < record->arg_count; i++) {
+        const snapshot_arg_t *arg_record = &snapshot->args[record->first_arg + i];
+        bce_command_arg_t *arg = bce_command_arg_new_in(cmd->arena);
+        arg->uuid = snapshot_string(snapshot, arg_record->uuid);
+        arg->cmd_uuid = cmd->uuid;
+        arg->arg_type = snapshot_string(snapshot, arg_record->arg_type);
+        arg->description = snapshot_string(snapshot, arg_record->description);
+        arg->long_name = snapshot_string(snapshot, arg_record->long_name);
+        arg->short_name = snapshot_string(snapshot, arg_record->short_name);
+        for (uint32_t j = 0; j < arg_record->opt_count; j++) {
+            const snapshot_opt_t *opt_record = &snapshot->opts[arg_record->first_opt + j];
+            bce_command_opt_t *opt = bce_command_opt_new_in(cmd->arena);
+            opt->uuid = snapshot_string(snapshot, opt_record->uuid);
+            opt->cmd_arg_uuid = arg->uuid;
+            opt->name = snapshot_string(snapshot, opt_record->name);
+            ll_append_item(arg->opts, opt);
+        }
+        ll_append_item(cmd->args, arg);
+    }
+
+    if (!with_sub_commands) {
+        return;
+    }
+
+    if (word_set) {
+        for (uint32_t i = 0; i < record->sub_command_count; i++) {
+            const snapshot_command_t *sub_record = &snapshot->commands[record->first_sub_command + i];
+            if (is_snapshot_command_on_cmdline(snapshot, sub_record, word_set)) {
+                bce_command_t *sub_cmd = bce_command_new_in(cmd->arena);
+                load_snapshot_command(snapshot, sub_record, sub_cmd, word_set, true);
+                ll_append_item(cmd->sub_commands, sub_cmd);
+                return;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < record->sub_command_count; i++) {
+        const snapshot_command_t *sub_record = &snapshot->commands[record->first_sub_command + i];
+        bce_command_t *sub_cmd = bce_command_new_in(cmd->arena);
+        load_snapshot_command(snapshot, sub_record, sub_cmd, NULL, word_set == NULL);
+        ll_append_item(cmd->sub_commands, sub_cmd);
+    }
+}
+
+static bool stamp_database(const char *db_filename, snapshot_stamp_t *stamp) {
+    memset(stamp, 0, sizeof(snapshot_stamp_t));
+    struct stat st;
+    if (stat(db_filename, &st) != 0) {
+        return false;
+    }
+    stamp->db_size = (int64_t) st.st_size;
+    stamp->db_mtime_ns = (int64_t) st.ST_MTIM.tv_sec * 1000000000 + st.ST_MTIM.tv_nsec;
+
+    // recent writes may only exist in the WAL file
+    char wal_filename[FILENAME_MAX + 1];
+    snprintf(wal_filename, sizeof(wal_filename), "%s-wal", db_filename);
+    if ((stat(wal_filename, &st) == 0) && (st.st_size > 0)) {
+        stamp->wal_size = (int64_t) st.st_size;
+        stamp->wal_mtime_ns = (int64_t) st.ST_MTIM.tv_sec * 1000000000 + st.ST_MTIM.tv_nsec;
+    }
+    return true;
+}
+
+/*
+ * Every string offset must be in the string table, and every record range in its section.
+ * Sub-commands always come after their parent (breadth-first), so following them can't loop.
+ */
+static bool is_snapshot_valid(const snapshot_t *snapshot) {
+    const snapshot_header_t *header = snapshot->header;
+    for (uint32_t i = 0; i < header->command_count; i++) {
+        const snapshot_command_t *record = &snapshot->commands[i];
+        if (!is_snapshot_string_valid(snapshot, record->uuid)
+            || !is_snapshot_string_valid(snapshot, record->name)
+            || !is_snapshot_string_valid(snapshot, record->parent_cmd_uuid)
+            || ((uint64_t) record->first_alias + record->alias_count > header->alias_count)
+            || ((uint64_t) record->first_arg + record->arg_count > header->arg_count)
+            || ((uint64_t) record->first_sub_command + record->sub_command_count > header->command_count)
+            || ((record->sub_command_count > 0) && (record->first_sub_command <= i))) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->alias_count; i++) {
+        const snapshot_alias_t *record = &snapshot->aliases[i];
+        if (!is_snapshot_string_valid(snapshot, record->uuid) || !is_snapshot_string_valid(snapshot, record->name)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->arg_count; i++) {
+        const snapshot_arg_t *record = &snapshot->args[i];
+        if (!is_snapshot_string_valid(snapshot, record->uuid)
+            || !is_snapshot_string_valid(snapshot, record->arg_type)
+            || !is_snapshot_string_valid(snapshot, record->description)
+            || !is_snapshot_string_valid(snapshot, record->long_name)
+            || !is_snapshot_string_valid(snapshot, record->short_name)
+            || ((uint64_t) record->first_opt + record->opt_count > header->opt_count)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->opt_count; i++) {
+        const snapshot_opt_t *record = &snapshot->opts[i];
+        if (!is_snapshot_string_valid(snapshot, record->uuid) || !is_snapshot_string_valid(snapshot, record->name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* The length prefix, the characters and the NUL terminator must all be inside the string table */
+static bool is_snapshot_string_valid(const snapshot_t *snapshot, uint32_t offset) {
+    uint64_t strings_size = snapshot->header->strings_size;
+    if ((offset % sizeof(uint32_t) != 0) || ((uint64_t) offset + sizeof(uint32_t) >= strings_size)) {
+        return false;
+    }
+    uint32_t len;
+    memcpy(&len, snapshot->strings + offset, sizeof(uint32_t));
+    uint64_t end = (uint64_t) offset + sizeof(uint32_t) + len;
+    return (end < strings_size) && (snapshot->strings[end] == '\0');
+}
+
+static uint32_t fnv1a(const void *data, size_t len, uint32_t hash) {
+    const unsigned char *p = (const unsigned char *) data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static bool buffer_append(snapshot_buffer_t *buffer, const void *data, size_t len) {
+    if (buffer->size + len > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->size + len) {
+            capacity *= 2;
+        }
+        char *bigger = realloc(buffer->data, capacity);
+        if (!bigger) {
+            return false;
+        }
+        buffer->data = bigger;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, len);
+    buffer->size += len;
+    return true;
+}
+
+static bool strings_init(snapshot_strings_t *strings) {
+    memset(strings, 0, sizeof(snapshot_strings_t));
+    strings->slot_count = 1024;
+    strings->slots = calloc(strings->slot_count, sizeof(uint32_t));
+    if (!strings->slots) {
+        return false;
+    }
+    // offset 0 is the empty string
+    const char empty[8] = {0};
+    return buffer_append(&strings->buffer, empty, sizeof(empty));
+}
+
+static void strings_free(snapshot_strings_t *strings) {
+    free(strings->buffer.data);
+    free(strings->slots);
+    memset(strings, 0, sizeof(snapshot_strings_t));
+}
+
+static uint32_t strings_add(snapshot_strings_t *strings, const char *str) {
+    if (!str || (str[0] == '\0') || strings->failed) {
+        return 0;
+    }
+
+    uint32_t len = (uint32_t) strlen(str);
+    size_t mask = strings->slot_count - 1;
+    size_t slot = fnv1a(str, len, FNV_OFFSET_BASIS) & mask;
+    while (strings->slots[slot] != 0) {
+        uint32_t offset = strings->slots[slot];
+        uint32_t existing_len;
+        memcpy(&existing_len, strings->buffer.data + offset, sizeof(uint32_t));
+        if ((existing_len == len) && (memcmp(strings->buffer.data + offset + sizeof(uint32_t), str, len) == 0)) {
+            return offset;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // append: length, characters, NUL, padding to 4 bytes
+    uint32_t offset = (uint32_t) strings->buffer.size;
+    const char padding[4] = {0};
+    size_t padded_len = (len + 1 + 3) & ~((size_t) 3);
+    if (!buffer_append(&strings->buffer, &len, sizeof(uint32_t))
+        || !buffer_append(&strings->buffer, str, len)
+        || !buffer_append(&strings->buffer, padding, padded_len - len)) {
+        strings->failed = true;
+        return 0;
+    }
+    strings->slots[slot] = offset;
+    strings->used_slots++;
+
+    // keep the load factor below 1/2
+    // (if it can't grow, it fills up: don't add more)
+    if ((strings->used_slots * 2 > strings->slot_count) && !strings_grow(strings)) {
+        strings->failed = true;
+    }
+    return offset;
+}
+
+static bool strings_grow(snapshot_strings_t *strings) {
+    size_t slot_count = strings->slot_count * 2;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (!slots) {
+        return false;
+    }
+    size_t mask = slot_count - 1;
+    for (size_t i = 0; i < strings->slot_count; i++) {
+        uint32_t offset = strings->slots[i];
+        if (offset == 0) {
+            continue;
+        }
+        uint32_t len;
+        memcpy(&len, strings->buffer.data + offset, sizeof(uint32_t));
+        size_t slot = fnv1a(strings->buffer.data + offset + sizeof(uint32_t), len, FNV_OFFSET_BASIS) & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = offset;
+    }
+    free(strings->slots);
+    strings->slots = slots;
+    strings->slot_count = slot_count;
+    return true;
+}
+
+static bool write_snapshot_file(const char *filename, snapshot_header_t *header, snapshot_buffer_t **sections,
+                                size_t section_count) {
+    uint32_t checksum = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < section_count; i++) {
+        checksum = fnv1a(sections[i]->data, sections[i]->size, checksum);
+    }
+    header->checksum = checksum;
+
+    // write to a temporary file, then rename, so readers never map a partial snapshot
+    char tmp_filename[FILENAME_MAX + 1];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+    FILE *f = fopen(tmp_filename, "wb");
+    if (!f) {
+        return false;
+    }
+    bool result = (fwrite(header, sizeof(snapshot_header_t), 1, f) == 1);
+    for (size_t i = 0; result && (i < section_count); i++) {
+        if (sections[i]->size > 0) {
+            result = (fwrite(sections[i]->data, sections[i]->size, 1, f) == 1);
+        }
+    }
+    if (fclose(f) != 0) {
+        result = false;
+    }
+    if (result) {
+        result = (rename(tmp_filename, filename) == 0);
+    }
+    if (!result) {
+        remove(tmp_filename);
+    }
+    return result;
+}
@@ -0,0 +1,124 @@
+#ifndef BCE_SNAPSHOT_H
+#define BCE_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "data_model.h"
+#include "error.h"
+
+/*
+ * Read-only, memory-mapped copy of completion.db (see `bce --compile-snapshot`).
+ *
+ * layout: header | commands[] | aliases[] | args[] | opts[] | strings
+ *
+ * Records refer to each other by index into their section; children of a record are contiguous.
+ * Strings are referenced by byte offset into the string table. Each string is stored as a
+ * uint32 length, followed by the characters and a NUL terminator (padded to 4 bytes).
+ * Offset 0 is the empty string.
+ */
+
+#define SNAPSHOT_MAGIC      "BCESNAP"
+#define SNAPSHOT_VERSION    2
+
+/* What the database files looked like when the snapshot was compiled (a missing or empty WAL file is all zeros) */
+typedef struct snapshot_stamp_t {
+    int64_t db_size;
+    int64_t db_mtime_ns;
+    int64_t wal_size;
+    int64_t wal_mtime_ns;
+} snapshot_stamp_t;
+
+typedef struct snapshot_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t checksum;          /* FNV-1a of everything after the header */
+    uint32_t file_size;
+    uint32_t command_count;
+    uint32_t commands_offset;
+    uint32_t alias_count;
+    uint32_t aliases_offset;
+    uint32_t arg_count;
+    uint32_t args_offset;
+    uint32_t opt_count;
+    uint32_t opts_offset;
+    uint32_t root_count;        /* roots are the first `root_count` commands */
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint32_t reserved;          /* keeps the stamp 8-byte aligned */
+    snapshot_stamp_t stamp;
+} snapshot_header_t;
+
+typedef struct snapshot_command_t {
+    uint32_t uuid;
+    uint32_t name;
+    uint32_t parent_cmd_uuid;
+    uint32_t first_alias;
+    uint32_t alias_count;
+    uint32_t first_arg;
+    uint32_t arg_count;
+    uint32_t first_sub_command;
+    uint32_t sub_command_count;
+} snapshot_command_t;
+
+typedef struct snapshot_alias_t {
+    uint32_t uuid;
+    uint32_t name;
+} snapshot_alias_t;
+
+typedef struct snapshot_arg_t {
+    uint32_t uuid;
+    uint32_t arg_type;
+    uint32_t description;
+    uint32_t long_name;
+    uint32_t short_name;
+    uint32_t first_opt;
+    uint32_t opt_count;
+} snapshot_arg_t;
+
+typedef struct snapshot_opt_t {
+    uint32_t uuid;
+    uint32_t name;
+} snapshot_opt_t;
+
+typedef struct snapshot_t {
+    const char *data;
+    size_t size;
+    const snapshot_header_t *header;
+    const snapshot_command_t *commands;
+    const snapshot_alias_t *aliases;
+    const snapshot_arg_t *args;
+    const snapshot_opt_t *opts;
+    const char *strings;
+} snapshot_t;
+
+/*
+ * Flatten every command in the database into a snapshot file, stamped with the state of the database files.
+ * The WAL is checkpointed first, so the stamp still matches once the connection is closed.
+ */
+bce_error_t snapshot_compile(struct sqlite3 *conn, const char *filename);
+
+/*
+ * Map a snapshot file. Every record index, count and string offset is checked against its section,
+ * so a truncated or damaged file is rejected. When `verify` is set, the checksum of the whole file is checked too.
+ */
+snapshot_t *snapshot_open(const char *filename, bool verify, bce_error_t *err);
+
+snapshot_t *snapshot_close(snapshot_t *snapshot);
+
+/* The snapshot is current if the database (and its WAL file) are unchanged since it was compiled */
+bool snapshot_is_current(const snapshot_t *snapshot, const char *db_filename);
+
+/*
+ * Build the command hierarchy for `command_name` (or one of its aliases) from the snapshot.
+ * If `word_list` is not NULL, only the sub-commands on the command line are loaded (see `db_query_command_path()`).
+ * The command's strings point into the snapshot (no copies), so it must not outlive `snapshot_close()`.
+ */
+bce_error_t snapshot_load_command(const snapshot_t *snapshot, bce_command_t *cmd, const char *command_name,
+                                  const linked_list_t *word_list);
+
+/* Get a string from the snapshot's string table (length-prefixed, like a `bce_str_t`) */
+bce_str_t snapshot_string(const snapshot_t *snapshot, uint32_t offset);
+
+#endif // BCE_SNAPSHOT_H
@@ -0,0 +1,104 @@
+#include "state_file.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+bool state_file_path(char *dest, size_t max_len, const char *db_filename, const char *name) {
+    char resolved[PATH_MAX];
+    if (realpath(db_filename, resolved)) {
+        db_filename = resolved;
+    }
+    const char *slash = strrchr(db_filename, '/');
+    int len = slash ? snprintf(dest, max_len, "%.*s/%s", (int) (slash - db_filename), db_filename, name)
+                    : snprintf(dest, max_len, "%s", name);
+    if ((len < 0) || ((size_t) len >= max_len)) {
+        dest[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
+char *state_file_read(const char *filename, size_t *size) {
+    *size = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    char *data = NULL;
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+        goto done;
+    }
+    data = malloc((size_t) st.st_size + 1);
+    if (!data) {
+        goto done;
+    }
+    while (*size < (size_t) st.st_size) {
+        ssize_t n = read(fd, data + *size, (size_t) st.st_size - *size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        *size += (size_t) n;
+    }
+    data[*size] = '\0';
+
+    done:
+    close(fd);
+    return data;
+}
+
+const char *state_file_next_field(const char **pos, const char *line_end, size_t *len) {
+    const char *field = *pos;
+    if (field > line_end) {
+        return NULL;
+    }
+    const char *tab = memchr(field, '\t', (size_t) (line_end - field));
+    const char *field_end = tab ? tab : line_end;
+    *len = (size_t) (field_end - field);
+    *pos = field_end + 1;
+    return field;
+}
+
+bool state_file_write_begin(state_file_writer_t *writer, const char *filename) {
+    writer->file = NULL;
+    writer->filename = filename;
+    if (snprintf(writer->tmp_filename, sizeof(writer->tmp_filename), "%s.%ld", filename, (long) getpid())
+        >= (int) sizeof(writer->tmp_filename)) {
+        return false;
+    }
+    writer->file = fopen(writer->tmp_filename, "w");
+    return writer->file != NULL;
+}
+
+bool state_file_write_end(state_file_writer_t *writer, bool written) {
+    if (!writer->file) {
+        return false;
+    }
+    written = (fflush(writer->file) == 0) && written;
+    written = (fclose(writer->file) == 0) && written;
+    writer->file = NULL;
+    if (!written || (rename(writer->tmp_filename, writer->filename) != 0)) {
+        unlink(writer->tmp_filename);
+        return false;
+    }
+    return true;
+}
+
+bool is_command_separator(const char *word, size_t len) {
+    static const char *separators[] = {"|", "||", "&&", ";", "&", NULL};
+    for (const char **separator = separators; *separator != NULL; separator++) {
+        if ((strlen(*separator) == len) && (strncmp(*separator, word, len) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,41 @@
+#ifndef BCE_STATE_FILE_H
+#define BCE_STATE_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <limits.h>
+
+/*
+ * The tab-separated files that completion keeps besides the database (see usage.h and history_index.h):
+ * read whole, one line per record, and replaced with a temporary file renamed over them.
+ */
+
+typedef struct state_file_writer_t {
+    FILE *file;
+    const char *filename;
+    char tmp_filename[PATH_MAX];    /* `<filename>.<pid>` */
+} state_file_writer_t;
+
+/*
+ * The state file `name` (e.g. BCE_USAGE_FILENAME), in the directory of the database: the database's path is resolved
+ * first, so the current directory (which changes in a shell) doesn't matter once it is open
+ */
+bool state_file_path(char *dest, size_t max_len, const char *db_filename, const char *name);
+
+/* The whole file, NUL-terminated (NULL if it is missing or empty). Caller frees */
+char *state_file_read(const char *filename, size_t *size);
+
+/* The field at `*pos` (up to a tab or the end of the line), moving `*pos` past it; NULL at the end of the line */
+const char *state_file_next_field(const char **pos, const char *line_end, size_t *len);
+
+/* Start replacing `filename` (not copied): the lines are written to a temporary file */
+bool state_file_write_begin(state_file_writer_t *writer, const char *filename);
+
+/* Rename the temporary file over the file if it was all `written`, or remove it */
+bool state_file_write_end(state_file_writer_t *writer, bool written);
+
+/* The words after it on a command line are another command's (`|`, `||`, `&&`, `;` or `&`) */
+bool is_command_separator(const char *word, size_t len);
+
+#endif // BCE_STATE_FILE_H
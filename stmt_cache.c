@@ -0,0 +1,180 @@
+#include "stmt_cache.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STMT_CACHE_MIN_CAPACITY 16
+
+// registered on each connection with a cache, so the cache is freed when the connection really closes
+#define STMT_CACHE_FUNCTION_NAME "bce_stmt_cache"
+
+// one cache per open connection; the list is shared by every thread, each cache only by its connection's thread
+static stmt_cache_t *caches = NULL;
+static pthread_mutex_t caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static stmt_cache_t *find_cache(const sqlite3 *conn);
+
+static stmt_cache_t *create_cache(sqlite3 *conn, int *rc);
+
+static void destroy_cache(void *data);
+
+static void cache_function(sqlite3_context *context, int argc, sqlite3_value **argv);
+
+static stmt_cache_entry_t *append_entry(stmt_cache_t *cache);
+
+sqlite3_stmt *stmt_cache_acquire(sqlite3 *conn, const char *sql, int *rc) {
+    *rc = SQLITE_OK;
+    stmt_cache_t *cache = find_cache(conn);
+    if (!cache) {
+        cache = create_cache(conn, rc);
+        if (!cache) {
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < cache->size; i++) {
+        stmt_cache_entry_t *entry = &cache->entries[i];
+        if ((entry->sql == sql) && !entry->in_use) {
+            entry->in_use = true;
+            cache->reuse_count++;
+            return entry->stmt;
+        }
+    }
+
+    sqlite3_stmt *stmt = NULL;
+    *rc = sqlite3_prepare_v3(conn, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL);
+    if (*rc != SQLITE_OK) {
+        return NULL;
+    }
+    stmt_cache_entry_t *entry = append_entry(cache);
+    if (!entry) {
+        // still usable, just not cached
+        return stmt;
+    }
+    entry->sql = sql;
+    entry->stmt = stmt;
+    entry->in_use = true;
+    cache->prepare_count++;
+    return stmt;
+}
+
+void stmt_cache_release(sqlite3_stmt *stmt) {
+    if (!stmt) {
+        return;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    stmt_cache_t *cache = find_cache(sqlite3_db_handle(stmt));
+    if (cache) {
+        for (size_t i = 0; i < cache->size; i++) {
+            if (cache->entries[i].stmt == stmt) {
+                cache->entries[i].in_use = false;
+                return;
+            }
+        }
+    }
+    // not owned by a cache
+    sqlite3_finalize(stmt);
+}
+
+const stmt_cache_t *stmt_cache_find(const sqlite3 *conn) {
+    return find_cache(conn);
+}
+
+void stmt_cache_print_stats(const sqlite3 *conn, const char *label, FILE *out) {
+    const stmt_cache_t *cache = find_cache(conn);
+    if (!cache) {
+        fprintf(out, "%s: no statements prepared\n", label);
+        return;
+    }
+    fprintf(out, "%s: %lu statements prepared, %lu reused\n", label, cache->prepare_count, cache->reuse_count);
+}
+
+void stmt_cache_close(sqlite3 *conn) {
+    stmt_cache_t *cache = find_cache(conn);
+    if (!cache) {
+        return;
+    }
+    for (size_t i = 0; i < cache->size; i++) {
+        // every acquired statement must have been released
+        assert(!cache->entries[i].in_use);
+        sqlite3_finalize(cache->entries[i].stmt);
+    }
+    cache->size = 0;
+    // the cache itself goes away with the connection (see `destroy_cache()`)
+}
+
+static stmt_cache_t *find_cache(const sqlite3 *conn) {
+    pthread_mutex_lock(&caches_mutex);
+    stmt_cache_t *cache = caches;
+    while ((cache != NULL) && (cache->conn != conn)) {
+        cache = cache->next;
+    }
+    pthread_mutex_unlock(&caches_mutex);
+    return cache;
+}
+
+/*
+ * SQLite calls the destructor of an app-defined function when the connection is closed for good,
+ * which is the only point its address can be reused. Tying the cache to it means a connection closed
+ * without `db_close()` can't leave a cache behind for the next connection at the same address.
+ * (Statements keep their connection open, so by then the cache holds none.)
+ */
+static stmt_cache_t *create_cache(sqlite3 *conn, int *rc) {
+    stmt_cache_t *cache = calloc(1, sizeof(stmt_cache_t));
+    if (!cache) {
+        *rc = SQLITE_NOMEM;
+        return NULL;
+    }
+    cache->conn = conn;
+
+    // on failure, SQLite has already called `destroy_cache()`
+    *rc = sqlite3_create_function_v2(conn, STMT_CACHE_FUNCTION_NAME, 0, SQLITE_UTF8, cache, &cache_function, NULL,
+                                     NULL, &destroy_cache);
+    if (*rc != SQLITE_OK) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&caches_mutex);
+    cache->next = caches;
+    caches = cache;
+    pthread_mutex_unlock(&caches_mutex);
+    return cache;
+}
+
+static void destroy_cache(void *data) {
+    stmt_cache_t *cache = (stmt_cache_t *) data;
+    pthread_mutex_lock(&caches_mutex);
+    for (stmt_cache_t **link = &caches; *link != NULL; link = &(*link)->next) {
+        if (*link == cache) {
+            *link = cache->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&caches_mutex);
+
+    assert(cache->size == 0);
+    free(cache->entries);
+    free(cache);
+}
+
+static void cache_function(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    (void) argc;
+    (void) argv;
+    sqlite3_result_null(context);
+}
+
+static stmt_cache_entry_t *append_entry(stmt_cache_t *cache) {
+    if (cache->size == cache->capacity) {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : STMT_CACHE_MIN_CAPACITY;
+        stmt_cache_entry_t *entries = realloc(cache->entries, capacity * sizeof(stmt_cache_entry_t));
+        if (!entries) {
+            return NULL;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+    return &cache->entries[cache->size++];
+}
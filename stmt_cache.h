@@ -0,0 +1,51 @@
+#ifndef BCE_STMT_CACHE_H
+#define BCE_STMT_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sqlite3.h>
+
+/*
+ * Prepared statements owned by a connection, for the life of the connection.
+ *
+ * Statements are keyed by their SQL (compared by address, so use the static SQL strings).
+ * Loaders can recurse while a statement is still stepping, so each SQL has a pool of statements:
+ * `stmt_cache_acquire()` hands out an idle one (or prepares another), `stmt_cache_release()` resets it.
+ * Use `db_close()` rather than `sqlite3_close()`, so the statements are finalized first.
+ * The cache lives as long as its connection, and is freed when SQLite closes the connection.
+ * A connection (and its cache) must only be used by one thread at a time; the list of caches is locked.
+ */
+
+typedef struct stmt_cache_entry_t {
+    const char *sql;
+    sqlite3_stmt *stmt;
+    bool in_use;
+} stmt_cache_entry_t;
+
+typedef struct stmt_cache_t {
+    sqlite3 *conn;
+    size_t size;
+    size_t capacity;
+    stmt_cache_entry_t *entries;
+    unsigned long prepare_count;    /* statements prepared */
+    unsigned long reuse_count;      /* statements handed out again, without preparing */
+    struct stmt_cache_t *next;
+} stmt_cache_t;
+
+/* Get an idle statement for `sql`, preparing one if needed. `rc` is the SQLite result code */
+sqlite3_stmt *stmt_cache_acquire(sqlite3 *conn, const char *sql, int *rc);
+
+/* Reset the statement, and make it available again. NULL is ignored */
+void stmt_cache_release(sqlite3_stmt *stmt);
+
+/* The connection's cache (NULL if no statement has been prepared yet) */
+const stmt_cache_t *stmt_cache_find(const sqlite3 *conn);
+
+/* Print the prepare/reuse counts for the connection to `out` (debug output) */
+void stmt_cache_print_stats(const sqlite3 *conn, const char *label, FILE *out);
+
+/* Finalize every statement owned by the connection. Every acquired statement must have been released */
+void stmt_cache_close(sqlite3 *conn);
+
+#endif // BCE_STMT_CACHE_H
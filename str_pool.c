@@ -0,0 +1,128 @@
+#include "str_pool.h"
+#include "hash_map.h"
+
+#define STR_POOL_INITIAL_SLOTS 64
+
+// the characters of the empty string, after its (zero) length prefix
+static const struct {
+    uint32_t len;
+    char data[4];
+} empty_string = {0, ""};
+
+// backs the strings interned without an arena
+static arena_t *heap_arena = NULL;
+static str_pool_t heap_pool = {NULL, 0, 0};
+
+static str_pool_t *get_pool(arena_t **arena);
+
+static bool pool_grow(arena_t *arena, str_pool_t *pool);
+
+bce_str_t bce_str_empty(void) {
+    return empty_string.data;
+}
+
+bce_str_t str_pool_intern(arena_t *arena, const char *str) {
+    return str_pool_intern_n(arena, str, str ? strlen(str) : 0);
+}
+
+bce_str_t str_pool_intern_n(arena_t *arena, const char *str, size_t len) {
+    if (!str || (len == 0)) {
+        return bce_str_empty();
+    }
+
+    str_pool_t *pool = get_pool(&arena);
+    if (!pool) {
+        return NULL;
+    }
+    if ((pool->size + 1) * 2 > pool->slot_count) {
+        // keep the load factor below 1/2
+        if (!pool_grow(arena, pool)) {
+            return NULL;
+        }
+    }
+
+    size_t mask = pool->slot_count - 1;
+    size_t slot = hm_hash(str, len) & mask;
+    while (pool->slots[slot]) {
+        bce_str_t existing = pool->slots[slot];
+        if ((bce_str_len(existing) == len) && (memcmp(existing, str, len) == 0)) {
+            return existing;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // length, characters, NUL
+    char *data = arena_alloc(arena, sizeof(uint32_t) + len + 1);
+    if (!data) {
+        return NULL;
+    }
+    uint32_t len32 = (uint32_t) len;
+    memcpy(data, &len32, sizeof(uint32_t));
+    memcpy(data + sizeof(uint32_t), str, len);
+    data[sizeof(uint32_t) + len] = '\0';
+
+    pool->slots[slot] = data + sizeof(uint32_t);
+    pool->size++;
+    return pool->slots[slot];
+}
+
+bce_str_t str_pool_copy(arena_t *arena, bce_str_t str) {
+    return str_pool_intern_n(arena, str, bce_str_len(str));
+}
+
+size_t str_pool_size(arena_t *arena) {
+    if (!arena) {
+        return heap_pool.size;
+    }
+    return arena->strings ? arena->strings->size : 0;
+}
+
+/*
+ * The pool for `arena` (created on first use, inside the arena itself).
+ * A NULL arena is replaced with the one backing the process-wide pool.
+ */
+static str_pool_t *get_pool(arena_t **arena) {
+    if (!*arena) {
+        if (!heap_arena) {
+            heap_arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+        }
+        *arena = heap_arena;
+        return heap_arena ? &heap_pool : NULL;
+    }
+
+    if (!(*arena)->strings) {
+        str_pool_t *pool = arena_calloc(*arena, 1, sizeof(str_pool_t));
+        if (!pool) {
+            return NULL;
+        }
+        (*arena)->strings = pool;
+    }
+    return (*arena)->strings;
+}
+
+/*
+ * Double the slot table. The old table stays in the arena until it is reset.
+ */
+static bool pool_grow(arena_t *arena, str_pool_t *pool) {
+    size_t slot_count = pool->slot_count ? pool->slot_count * 2 : STR_POOL_INITIAL_SLOTS;
+    bce_str_t *slots = arena_calloc(arena, slot_count, sizeof(bce_str_t));
+    if (!slots) {
+        return false;
+    }
+
+    size_t mask = slot_count - 1;
+    for (size_t i = 0; i < pool->slot_count; i++) {
+        bce_str_t str = pool->slots[i];
+        if (!str) {
+            continue;
+        }
+        size_t slot = hm_hash(str, bce_str_len(str)) & mask;
+        while (slots[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = str;
+    }
+    pool->slots = slots;
+    pool->slot_count = slot_count;
+    return true;
+}
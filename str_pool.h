@@ -0,0 +1,68 @@
+#ifndef BCE_STR_POOL_H
+#define BCE_STR_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+
+/*
+ * Interned, length-prefixed strings for the command model.
+ *
+ * A `bce_str_t` points at NUL-terminated characters, preceded by their uint32 length: the same layout as the
+ * snapshot string table, so snapshot strings are used in place. A string is interned once per pool, so two
+ * strings from the same pool are equal only if they are the same pointer.
+ *
+ * Each arena has its own pool, released with the arena. Strings interned with a NULL arena go to a
+ * process-wide pool, which is never freed and not locked: it is for one-off heap trees (import, export) on the
+ * main thread. Trees kept by a long-lived process (see `completion_cache_t`) live in arenas of their own.
+ */
+typedef const char *bce_str_t;
+
+typedef struct str_pool_t {
+    bce_str_t *slots;
+    size_t slot_count;
+    size_t size;
+} str_pool_t;
+
+/* The (shared) empty string */
+bce_str_t bce_str_empty(void);
+
+/* Intern `str` (NULL is the empty string) */
+bce_str_t str_pool_intern(arena_t *arena, const char *str);
+
+/* Same as `str_pool_intern()`, for strings that are not NUL-terminated */
+bce_str_t str_pool_intern_n(arena_t *arena, const char *str, size_t len);
+
+/* Intern a string from another pool (or the snapshot); no-op if it is already in this pool */
+bce_str_t str_pool_copy(arena_t *arena, bce_str_t str);
+
+/* Number of strings interned in the arena's pool (the process-wide pool if `arena` is NULL) */
+size_t str_pool_size(arena_t *arena);
+
+static inline size_t bce_str_len(bce_str_t str) {
+    uint32_t len;
+    memcpy(&len, str - sizeof(uint32_t), sizeof(uint32_t));
+    return len;
+}
+
+/* Equal strings (from any pool, or the snapshot) */
+static inline bool bce_str_equal(bce_str_t a, bce_str_t b) {
+    if (a == b) {
+        return true;
+    }
+    size_t len = bce_str_len(a);
+    return (len == bce_str_len(b)) && (memcmp(a, b, len) == 0);
+}
+
+/* Check if `str` starts with `prefix` */
+static inline bool bce_str_has_prefix(bce_str_t str, bce_str_t prefix) {
+    if (str == prefix) {
+        return true;
+    }
+    size_t len = bce_str_len(prefix);
+    return (len <= bce_str_len(str)) && (memcmp(str, prefix, len) == 0);
+}
+
+#endif // BCE_STR_POOL_H
@@ -0,0 +1,158 @@
+#include "catch.hpp"
+#include <string.h>
+#include <stdint.h>
+
+extern "C" {
+#include <stdio.h>
+#include <sqlite3.h>
+#include "../arena.h"
+#include "../linked_list.h"
+#include "../dbutil.h"
+#include "../data_model.h"
+#include "../input.h"
+#include "../completion.h"
+#include "../error.h"
+};
+#include "test_data.h"
+
+TEST_CASE("arena") {
+    arena_t *arena = arena_create(1024);
+    REQUIRE(arena != NULL);
+
+    SECTION("aligned allocations") {
+        char *a = (char *) arena_alloc(arena, 3);
+        char *b = (char *) arena_alloc(arena, 5);
+        REQUIRE(a != NULL);
+        REQUIRE(b != NULL);
+        CHECK(a != b);
+        CHECK(((uintptr_t) a % 16) == 0);
+        CHECK(((uintptr_t) b % 16) == 0);
+        CHECK(arena->alloc_count == 2);
+        CHECK(arena->block_count == 1);
+
+        char *c = (char *) arena_calloc(arena, 10, sizeof(char));
+        for (int i = 0; i < 10; i++) {
+            CHECK(c[i] == '\0');
+        }
+    }
+
+    SECTION("blocks are reused after a reset") {
+        for (int i = 0; i < 10; i++) {
+            arena_alloc(arena, 200);
+        }
+        size_t block_count = arena->block_count;
+        CHECK(block_count > 1);
+
+        arena_reset(arena);
+        CHECK(arena->alloc_count == 0);
+        for (int i = 0; i < 10; i++) {
+            arena_alloc(arena, 200);
+        }
+        CHECK(arena->block_count == block_count);
+    }
+
+    SECTION("allocations larger than a block") {
+        char *big = (char *) arena_alloc(arena, 4096);
+        REQUIRE(big != NULL);
+        memset(big, 'x', 4096);
+        char *small = (char *) arena_alloc(arena, 16);
+        CHECK(small != NULL);
+    }
+
+    SECTION("NULL arena uses the heap") {
+        size_t heap_count = arena_heap_alloc_count();
+        char *ptr = (char *) arena_alloc(NULL, 16);
+        REQUIRE(ptr != NULL);
+        CHECK(arena_heap_alloc_count() == heap_count + 1);
+        free(ptr);
+    }
+
+    SECTION("lists in an arena") {
+        linked_list_t *list = ll_create_in(arena, NULL);
+        for (int i = 0; i < 5; i++) {
+            char *data = (char *) arena_calloc(arena, 8, sizeof(char));
+            sprintf(data, "item%d", i);
+            ll_append_item(list, data);
+        }
+        CHECK(list->size == 5);
+        CHECK(strcmp((char *) ll_get_nth_item(list, 4), "item4") == 0);
+        CHECK(ll_remove_item(list, list->head));
+        CHECK(list->size == 4);
+        // nothing to free; the memory is released with the arena
+        list = ll_destroy(list);
+        CHECK(list == NULL);
+    }
+
+    arena = arena_destroy(arena);
+    CHECK(arena == NULL);
+}
+
+/*
+ * Run one completion request (load, prune and collect), with everything allocated from `arena` (or the heap).
+ */
+static linked_list_t *complete(sqlite3 *conn, arena_t *arena, const completion_input_t *input) {
+    linked_list_t *word_list = completion_input_to_list_in(arena, input);
+    bce_command_t *cmd = bce_command_new_in(arena);
+    REQUIRE(completion_load_command(conn, cmd, "kubectl", word_list) == ERR_NONE);
+
+    linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+    REQUIRE(completion_collect(cmd, input, NULL, recommendation_list, NULL, NULL) == ERR_NONE);
+
+    bce_command_free(cmd);
+    ll_destroy(word_list);
+    return recommendation_list;
+}
+
+TEST_CASE("arena allocation count") {
+    int rc;
+    const char *database_file = "test/arena.db";
+    remove(database_file);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    REQUIRE(exec_sql_file(conn, "test/kubectl_data.sql"));
+
+    const char *envp[] = {"COMP_LINE=kubectl get pods -", "COMP_POINT=26", NULL};
+    bce_error_t err = ERR_NONE;
+    completion_input_t *input = create_completion_input_from_env(envp, &err);
+    REQUIRE(err == ERR_NONE);
+
+    // heap: one allocation per struct, list, node and string
+    size_t heap_count = arena_heap_alloc_count();
+    linked_list_t *heap_recommendations = complete(conn, NULL, input);
+    size_t heap_allocs = arena_heap_alloc_count() - heap_count;
+
+    // arena: the same objects, but only the arena's blocks come from the heap
+    arena_t *arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    heap_count = arena_heap_alloc_count();
+    linked_list_t *arena_recommendations = complete(conn, arena, input);
+    size_t arena_allocs = arena_heap_alloc_count() - heap_count;
+
+    INFO("heap: " << heap_allocs << " allocations; arena: " << arena->alloc_count << " allocations in "
+                  << arena->block_count << " block(s)");
+    CHECK(heap_allocs > 0);
+    CHECK(arena_allocs == 0);
+    // the arena also holds the interned strings (the heap version uses the process-wide pool)
+    CHECK(arena->alloc_count >= heap_allocs);
+    CHECK(arena->block_count == 1);
+
+    // same recommendations either way
+    REQUIRE(heap_recommendations->size > 0);
+    REQUIRE(arena_recommendations->size == heap_recommendations->size);
+    for (size_t i = 0; i < heap_recommendations->size; i++) {
+        CHECK(strcmp((char *) ll_get_nth_item(heap_recommendations, i),
+                     (char *) ll_get_nth_item(arena_recommendations, i)) == 0);
+    }
+
+    // a second request reuses the block
+    arena_reset(arena);
+    complete(conn, arena, input);
+    CHECK(arena->block_count == 1);
+
+    ll_destroy(heap_recommendations);
+    arena = arena_destroy(arena);
+    input = free_completion_input(input);
+    db_close(conn);
+    remove(database_file);
+}
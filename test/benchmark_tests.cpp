@@ -0,0 +1,431 @@
+#include "catch.hpp"
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <stdio.h>
+#include <sqlite3.h>
+#include "../dbutil.h"
+#include "../completion.h"
+#include "../data_model.h"
+#include "../input.h"
+#include "../prune.h"
+#include "../line_scan.h"
+#include "../fuzzy.h"
+#include "../usage.h"
+#include "../history_index.h"
+#include "../json_import.h"
+#include "../uuid4.h"
+#include "../error.h"
+};
+#include "test_data.h"
+
+/*
+ * Hidden from the default run. Use: `tests [benchmark]`
+ */
+
+TEST_CASE("benchmark command loading", "[.][benchmark]") {
+    int rc;
+    const char *database_file = "test/benchmark.db";
+    remove(database_file);
+
+    // roughly the size of a large CLI (e.g. kubectl, aws): 1 + 8 + 64 + 512 commands
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    bce_command_t *cmd = create_synthetic_command("bench", 3, 8, 4, 3);
+    REQUIRE(db_store_command(conn, cmd) == ERR_NONE);
+    cmd = bce_command_free(cmd);
+
+    BENCHMARK("db_query_command (per-node queries)") {
+        bce_command_t *loaded = (bce_command_t *) calloc(1, sizeof(bce_command_t));
+        db_query_command(conn, loaded, "bench");
+        return bce_command_free(loaded);
+    };
+
+    BENCHMARK("db_query_command_tree (recursive CTE)") {
+        bce_command_t *loaded = bce_command_new();
+        db_query_command_tree(conn, loaded, "bench");
+        return bce_command_free(loaded);
+    };
+
+    linked_list_t *word_list = bash_input_to_list("bench bench.3 bench.3.5 ", SIZE_MAX);
+    BENCHMARK("db_query_command_path (command line only)") {
+        bce_command_t *loaded = bce_command_new();
+        db_query_command_path(conn, loaded, "bench", word_list);
+        return bce_command_free(loaded);
+    };
+    word_list = ll_destroy(word_list);
+
+    db_close(conn);
+    remove(database_file);
+}
+
+TEST_CASE("benchmark database open", "[.][benchmark]") {
+    int rc;
+    const char *database_file = "test/benchmark_open.db";
+    remove(database_file);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    bce_command_t *cmd = create_synthetic_command("open", 2, 8, 4, 3);
+    REQUIRE(db_store_command(conn, cmd) == ERR_NONE);
+    cmd = bce_command_free(cmd);
+    db_close(conn);
+
+    // open-to-first-row: open, check the schema, find the root command
+    BENCHMARK("completion_db_open (read-write, pragmas)") {
+        bce_error_t err;
+        sqlite3 *db = completion_db_open(database_file, &err);
+        int names = 0;
+        linked_list_t *cmd_names = ll_create(NULL);
+        db_query_root_command_names(db, cmd_names);
+        names = (int) cmd_names->size;
+        cmd_names = ll_destroy(cmd_names);
+        db_close(db);
+        return names;
+    };
+
+    BENCHMARK("completion_db_open_readonly (read-only, mmap)") {
+        bce_error_t err;
+        sqlite3 *db = completion_db_open_readonly(database_file, &err);
+        int names = 0;
+        linked_list_t *cmd_names = ll_create(NULL);
+        db_query_root_command_names(db, cmd_names);
+        names = (int) cmd_names->size;
+        cmd_names = ll_destroy(cmd_names);
+        db_close(db);
+        return names;
+    };
+
+    remove(database_file);
+}
+
+TEST_CASE("benchmark pruning", "[.][benchmark]") {
+    // every sub-command, alias, arg and opt is looked up in the words on the command line
+    for (int fanout : {128, 1024, 4096}) {
+        bce_command_t *cmd = create_synthetic_command("wide", 1, fanout, 2, 2);
+        std::string line = "wide --wide-0 wide." + std::to_string(fanout - 1) + " --wide." +
+                           std::to_string(fanout - 1) + "-1 ";
+        bce_error_t err;
+        completion_input_t *input = create_completion_input_from_line(line.c_str(), (int) line.size(), &err);
+        REQUIRE(err == ERR_NONE);
+
+        // pruning modifies the command, so each run gets its own copy
+        BENCHMARK_ADVANCED("prune_command (" + std::to_string(fanout) + " sub-commands)")(
+                Catch::Benchmark::Chronometer meter) {
+            std::vector<bce_command_t *> copies((size_t) meter.runs());
+            for (auto &copy : copies) {
+                copy = bce_command_clone(cmd);
+            }
+            meter.measure([&](int i) { prune_command(copies[i], input); });
+            for (auto copy : copies) {
+                bce_command_free(copy);
+            }
+        };
+        cmd = bce_command_free(cmd);
+        free_completion_input(input);
+    }
+}
+
+TEST_CASE("benchmark prefix filtering", "[.][benchmark]") {
+    // a cached tree: copy the path and collect the recommendations for a word that matches one sub-command
+    for (int fanout : {128, 1024, 4096}) {
+        bce_command_t *tree = create_synthetic_command("wide", 1, fanout, 2, 2);
+        bce_command_t *indexed = bce_command_clone(tree);
+        bce_command_build_index(indexed);
+        std::string line = "wide wide." + std::to_string(fanout - 1);
+        bce_error_t err;
+        completion_input_t *input = create_completion_input_from_line(line.c_str(), (int) line.size(), &err);
+        REQUIRE(err == ERR_NONE);
+        arena_t *arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+
+        for (const bce_command_t *cmd : {(const bce_command_t *) tree, (const bce_command_t *) indexed}) {
+            std::string name = std::string(cmd->sub_command_index ? "index" : "no index") + " (" +
+                               std::to_string(fanout) + " sub-commands)";
+            BENCHMARK("clone and collect, " + name) {
+                arena_reset(arena);
+                linked_list_t *word_list = completion_input_to_list_in(arena, input);
+                bce_command_t *copy = bce_command_clone_path_prefix_in(arena, cmd, word_list,
+                                                                       get_completion_prefix_in(arena, input));
+                linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+                completion_collect(copy, input, NULL, recommendation_list, NULL, NULL);
+                return recommendation_list->size;
+            };
+        }
+
+        arena = arena_destroy(arena);
+        free_completion_input(input);
+        indexed = bce_command_free(indexed);
+        tree = bce_command_free(tree);
+    }
+}
+
+TEST_CASE("benchmark fuzzy matching", "[.][benchmark]") {
+    // every sub-command is a candidate: the index can't narrow a fuzzy match
+    const int fanout = 50000;
+    bce_command_t *tree = create_synthetic_command("fuzzy", 1, fanout, 0, 0);
+    std::vector<bce_str_t> names;
+    for (linked_list_node_t *node = tree->sub_commands->head; node != NULL; node = node->next) {
+        names.push_back(((const bce_command_t *) node->data)->name);
+    }
+    fuzzy_pattern_t pattern;
+    fuzzy_pattern_init(&pattern, "z4999", 5);
+
+    BENCHMARK("fuzzy_score (" + std::to_string(fanout) + " names)") {
+        int matches = 0;
+        for (bce_str_t name : names) {
+            matches += (fuzzy_score(&pattern, name, bce_str_len(name)) != FUZZY_NO_MATCH);
+        }
+        return matches;
+    };
+
+    const char *line = "fuzzy z4999";
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_line(line, (int) strlen(line), &err);
+    REQUIRE(err == ERR_NONE);
+    input->match_mode = MATCH_FUZZY;
+    arena_t *arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    BENCHMARK("clone, collect and rank (" + std::to_string(fanout) + " sub-commands)") {
+        arena_reset(arena);
+        linked_list_t *word_list = completion_input_to_list_in(arena, input);
+        bce_command_t *copy = bce_command_clone_path_prefix_in(arena, tree, word_list,
+                                                               completion_index_prefix_in(arena, input));
+        linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+        completion_collect(copy, input, NULL, recommendation_list, NULL, NULL);
+        return recommendation_list->size;
+    };
+
+    arena = arena_destroy(arena);
+    free_completion_input(input);
+    tree = bce_command_free(tree);
+}
+
+TEST_CASE("benchmark limited results", "[.][benchmark]") {
+    // an arg with a huge option list: every option is recommended
+    for (int opt_count : {1000, 5000}) {
+        bce_command_t *tree = create_synthetic_command("opts", 0, 0, 1, opt_count);
+        const char *line = "opts --opts-0 ";
+        bce_error_t err;
+        completion_input_t *input = create_completion_input_from_line(line, (int) strlen(line), &err);
+        REQUIRE(err == ERR_NONE);
+        arena_t *arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+
+        for (size_t max_results : {(size_t) 0, (size_t) 20}) {
+            input->max_results = max_results;
+            std::string name = (max_results > 0) ? "best " + std::to_string(max_results) : std::string("all");
+            BENCHMARK("clone and collect, " + name + " (" + std::to_string(opt_count) + " options)") {
+                arena_reset(arena);
+                linked_list_t *word_list = completion_input_to_list_in(arena, input);
+                bce_command_t *copy = bce_command_clone_path_in(arena, tree, word_list);
+                linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+                completion_collect(copy, input, NULL, recommendation_list, NULL, NULL);
+                return recommendation_list->size;
+            };
+        }
+
+        arena = arena_destroy(arena);
+        free_completion_input(input);
+        tree = bce_command_free(tree);
+    }
+}
+
+TEST_CASE("benchmark usage", "[.][benchmark]") {
+    const char *log_file = "test/benchmark_usage.log";
+    const char *table_file = "test/benchmark_usage.table";
+    const time_t now = 1700000000;
+    remove(log_file);
+    remove(table_file);
+
+    // the worst case: as many entries as aging keeps (USAGE_MAX_TOTAL, each used once), and a full log
+    FILE *table = fopen(table_file, "w");
+    REQUIRE(table);
+    for (int i = 0; i < (int) USAGE_MAX_TOTAL; i++) {
+        fprintf(table, "1.000\t%lld\tcmd-%d\tsub-command-%d\n", (long long) now, i % 50, i);
+    }
+    fclose(table);
+    FILE *log = fopen(log_file, "w");
+    REQUIRE(log);
+    for (int i = 0; ftell(log) < USAGE_LOG_MAX_SIZE - 100; i++) {
+        fprintf(log, "%lld\tcmd-%d\tsub-command-%d\t--arg-%d\topt-%d\n", (long long) now, i % 50, i, i, i);
+    }
+    fclose(log);
+
+    bce_command_t *tree = create_synthetic_command("cmd-0", 1, 100, 10, 10);
+    const char *line = "cmd-0 ";
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_line(line, (int) strlen(line), &err);
+    REQUIRE(err == ERR_NONE);
+    arena_t *arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+
+    BENCHMARK("load (" + std::to_string((int) USAGE_MAX_TOTAL) + " entries, full log)") {
+        usage_table_t *usage = usage_load(table_file, log_file, "cmd-0", now);
+        size_t count = usage ? usage->entry_count : 0;
+        usage_free(usage);
+        return count;
+    };
+
+    usage_table_t *usage = usage_load(table_file, log_file, "cmd-0", now);
+    REQUIRE(usage != NULL);
+    for (const usage_table_t *ranked_by : {(const usage_table_t *) NULL, (const usage_table_t *) usage}) {
+        BENCHMARK(std::string("clone and collect, ") + (ranked_by ? "ranked by usage" : "no usage")) {
+            arena_reset(arena);
+            linked_list_t *word_list = completion_input_to_list_in(arena, input);
+            bce_command_t *copy = bce_command_clone_path_in(arena, tree, word_list);
+            linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+            completion_collect(copy, input, ranked_by, recommendation_list, NULL, NULL);
+            return recommendation_list->size;
+        };
+    }
+
+    // compacted whenever the log is full again: included, as it would be for the user
+    BENCHMARK("record") {
+        return usage_record(log_file, table_file, "cmd-0 cmd-0.1 --cmd-0.1-2 cmd-0.1-2-3", now);
+    };
+
+    usage = usage_free(usage);
+    arena = arena_destroy(arena);
+    free_completion_input(input);
+    tree = bce_command_free(tree);
+    remove(log_file);
+    remove(table_file);
+}
+
+TEST_CASE("benchmark tokenizing", "[.][benchmark]") {
+    // a pasted file list and a long label selector (4 KB), and an `xargs`-style line (1 MB)
+    std::string files = "kubectl apply";
+    for (int i = 0; files.size() < 4000; i++) {
+        files += " -f manifests/deployment-" + std::to_string(i) + ".yaml";
+    }
+    std::string selector = "kubectl get pods --selector='app in (";
+    for (int i = 0; selector.size() < 4000; i++) {
+        selector += "service-" + std::to_string(i) + ",";
+    }
+    selector += "web)' -o wide";
+    std::string xargs = "rm";
+    for (int i = 0; xargs.size() < 1024 * 1024; i++) {
+        xargs += " /var/log/archive/service-" + std::to_string(i) + ".log.gz";
+    }
+
+    const line_scan_impl_t impls[] = {LINE_SCAN_SCALAR, LINE_SCAN_SSE2, LINE_SCAN_AVX2};
+    for (line_scan_impl_t impl : impls) {
+        std::string name = line_scan_impl_name(line_scan_select(impl));
+        for (const std::string *line : {&files, &selector, &xargs}) {
+            bce_error_t err;
+            completion_input_t *input = create_completion_input_from_line(line->c_str(), (int) line->size(), &err);
+            REQUIRE(err == ERR_NONE);
+            BENCHMARK("tokenize " + std::to_string(line->size()) + " bytes, " +
+                      std::to_string(input->token_count) + " words, " + name) {
+                tokenize_completion_input(input);
+                return input->token_count;
+            };
+            free_completion_input(input);
+        }
+    }
+    line_scan_select(LINE_SCAN_AUTO);
+}
+
+TEST_CASE("benchmark history index", "[.][benchmark]") {
+    const char *history_file = "test/benchmark_history.txt";
+    const char *index_file = "test/benchmark_history.index";
+    remove(history_file);
+    remove(index_file);
+
+    // a long history (more than the HISTORY_MAX_READ read from the start), with timestamps
+    FILE *history = fopen(history_file, "w");
+    REQUIRE(history);
+    for (int i = 0; i < 100000; i++) {
+        fprintf(history, "#%d\ncmd-%d get pods -n ns-%d -o wide --selector app=web-%d\n", 1700000000 + i, i % 50,
+                i % 300, i % 70);
+    }
+    fclose(history);
+
+    BENCHMARK("update from scratch (100000 lines)") {
+        remove(index_file);
+        return history_index_update(index_file, history_file);
+    };
+
+    BENCHMARK("update, nothing new") {
+        return history_index_update(index_file, history_file);
+    };
+
+    int line = 0;
+    BENCHMARK("update, one new line") {
+        FILE *file = fopen(history_file, "a");
+        fprintf(file, "cmd-0 get pods -n new-%d\n", line++);
+        fclose(file);
+        return history_index_update(index_file, history_file);
+    };
+
+    bce_command_t *tree = create_synthetic_command("cmd-0", 1, 10, 10, 10);
+    BENCHMARK("load and merge, nothing new") {
+        history_index_t *index = history_index_load(index_file, history_file, "cmd-0");
+        bce_command_t *copy = bce_command_clone(tree);
+        history_index_merge(index, copy);
+        size_t count = index ? index->value_count : 0;
+        bce_command_free(copy);
+        history_index_free(index);
+        return count;
+    };
+
+    tree = bce_command_free(tree);
+    remove(history_file);
+    remove(index_file);
+}
+
+TEST_CASE("benchmark import", "[.][benchmark]") {
+    int rc;
+    const char *database_file = "test/benchmark_import.db";
+    remove(database_file);
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+
+    // an option-heavy spec: 73 commands, 730 args, 109500 opts
+    bce_command_t *cmd = create_synthetic_command("import", 2, 8, 10, 150);
+    BENCHMARK("db_store_command (110304 rows, rolled back)") {
+        sqlite3_exec(conn, "BEGIN;", NULL, NULL, NULL);
+        bce_error_t err = db_store_command(conn, cmd);
+        sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL);
+        return err;
+    };
+
+    cmd = bce_command_free(cmd);
+    db_close(conn);
+    remove(database_file);
+}
+
+TEST_CASE("benchmark json import", "[.][benchmark]") {
+    int rc;
+    const char *database_file = "test/benchmark_json.db";
+    const char *spec_file = "test/benchmark_spec.json";
+    remove(database_file);
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    REQUIRE(uuid4_init() == UUID4_ESUCCESS);
+
+    // the option-heavy spec of "benchmark import", as json (about 16 MB)
+    bce_command_t *cmd = create_synthetic_command("import", 2, 8, 10, 150);
+    FILE *file = fopen(spec_file, "w");
+    REQUIRE(file);
+    write_json_spec(file, cmd);
+    fclose(file);
+    cmd = bce_command_free(cmd);
+
+    BENCHMARK("json_import_file (110304 rows, rolled back)") {
+        sqlite3_exec(conn, "BEGIN;", NULL, NULL, NULL);
+        import_writer_t writer;
+        import_writer_init(&writer, conn);
+        bce_error_t err = json_import_file(&writer, spec_file);
+        import_writer_finish(&writer);
+        sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL);
+        return err;
+    };
+
+    db_close(conn);
+    remove(database_file);
+    remove(spec_file);
+}
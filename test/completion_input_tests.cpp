@@ -1,5 +1,6 @@
 #include "catch.hpp"
 #include <string.h>
+#include <string>
 
 extern "C" {
 #include "../input.h"
@@ -167,4 +168,373 @@ TEST_CASE("current_word") {
         free_completion_input(input);
     }
 
-}
\ No newline at end of file
+}
+TEST_CASE("completion_input from envp") {
+    const char *envp[] = {"OTHER=1", "COMP_LINE=kubectl get pods", "COMP_POINT=11", NULL};
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_env(envp, &err);
+    REQUIRE(err == ERR_NONE);
+    CHECK(strcmp(input->line, "kubectl get pods") == 0);
+    CHECK(input->cursor_pos == 11);
+    CHECK(input->match_mode == MATCH_PREFIX);
+    free_completion_input(input);
+
+    SECTION("match mode") {
+        const char *fuzzy_envp[] = {"COMP_LINE=kubectl gt", "COMP_POINT=10", "BCE_MATCH=fuzzy", NULL};
+        input = create_completion_input_from_env(fuzzy_envp, &err);
+        REQUIRE(err == ERR_NONE);
+        CHECK(input->match_mode == MATCH_FUZZY);
+        free_completion_input(input);
+        CHECK(parse_match_mode("prefix") == MATCH_PREFIX);
+        CHECK(parse_match_mode("Fuzzy") == MATCH_PREFIX);
+        CHECK(parse_match_mode(NULL) == MATCH_PREFIX);
+    }
+
+    SECTION("correction") {
+        const char *correct_envp[] = {"COMP_LINE=kubectl gte", "COMP_POINT=11", "BCE_CORRECT=1", NULL};
+        input = create_completion_input_from_env(correct_envp, &err);
+        REQUIRE(err == ERR_NONE);
+        CHECK(input->correct_words);
+        free_completion_input(input);
+        CHECK(parse_flag("on"));
+        CHECK_FALSE(parse_flag("0"));
+        CHECK_FALSE(parse_flag(NULL));
+    }
+
+    SECTION("missing COMP_POINT") {
+        const char *partial_envp[] = {"COMP_LINE=kubectl", "COMP_POINTER=3", NULL};
+        input = create_completion_input_from_env(partial_envp, &err);
+        CHECK(err == ERR_MISSING_ENV_COMP_POINT);
+        CHECK(input == NULL);
+    }
+}
+
+TEST_CASE("word set") {
+    linked_list_t *word_list = bash_input_to_list("kubectl get pods --namespace=kube-system ''", SIZE_MAX);
+    REQUIRE(word_list->size == 6);
+    hash_map_t *word_set = word_set_create(word_list);
+    REQUIRE(word_set != NULL);
+
+    CHECK(is_word_in_set(word_set, str_pool_intern(NULL, "get")));
+    CHECK(is_word_in_set(word_set, str_pool_intern(NULL, "--namespace")));
+    CHECK(is_word_in_set(word_set, str_pool_intern(NULL, "kube-system")));
+
+    SECTION("exact match") {
+        // prefixes and extensions of a word are not on the command line
+        CHECK_FALSE(is_word_in_set(word_set, str_pool_intern(NULL, "po")));
+        CHECK_FALSE(is_word_in_set(word_set, str_pool_intern(NULL, "podsx")));
+        CHECK_FALSE(is_word_in_set(word_set, str_pool_intern(NULL, "--name")));
+    }
+
+    SECTION("empty strings") {
+        // e.g. an arg without a short name
+        CHECK_FALSE(is_word_in_set(word_set, bce_str_empty()));
+    }
+
+    SECTION("no word list") {
+        CHECK(word_set_create(NULL) == NULL);
+        CHECK_FALSE(is_word_in_set(NULL, str_pool_intern(NULL, "get")));
+    }
+
+    word_set = hm_destroy(word_set);
+    word_list = ll_destroy(word_list);
+}
+
+TEST_CASE("completion_input tokens") {
+    const char *envp[] = {"COMP_LINE=kubectl get --namespace='kube system' \"pods", "COMP_POINT=30", NULL};
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_env(envp, &err);
+    REQUIRE(err == ERR_NONE);
+
+    // split once, on creation
+    REQUIRE(input->token_count == 5);
+    size_t len = 0;
+    const char *text = get_token(input, 3, &len);
+    CHECK(std::string(text, len) == "kube system");
+    CHECK(input->tokens[3].offset == 25);
+    CHECK(input->tokens[3].quote == TOKEN_SINGLE_QUOTED);
+    CHECK(input->tokens[2].quote == TOKEN_UNQUOTED);
+    // the last quote is still open
+    text = get_token(input, 4, &len);
+    CHECK(std::string(text, len) == "pods");
+    CHECK(input->tokens[4].quote == TOKEN_DOUBLE_QUOTED);
+    CHECK(get_token(input, 5, &len) == NULL);
+    CHECK(get_token(input, -1, &len) == NULL);
+
+    SECTION("cursor inside a quoted word") {
+        CHECK(input->current_token == 3);
+        char word[1024];
+        CHECK(get_current_word(input, word, sizeof(word) - 1));
+        CHECK(strcmp(word, "kube ") == 0);
+        CHECK(get_previous_word(input, word, sizeof(word) - 1));
+        CHECK(strcmp(word, "--namespace") == 0);
+    }
+
+    SECTION("cursor after an opening quote") {
+        input->cursor_pos = 39;
+        tokenize_completion_input(input);
+        CHECK(input->current_token == 4);
+        char word[1024];
+        CHECK(get_current_word(input, word, sizeof(word) - 1));
+        CHECK(strlen(word) == 0);
+    }
+
+    SECTION("cursor before the 1st word") {
+        input->cursor_pos = 0;
+        tokenize_completion_input(input);
+        CHECK(input->current_token == -1);
+        char word[1024];
+        CHECK_FALSE(get_current_word(input, word, sizeof(word) - 1));
+        CHECK(get_command_from_input(input, word, sizeof(word) - 1));
+        CHECK(strcmp(word, "kubectl") == 0);
+    }
+
+    SECTION("same words as bash_input_to_list(), but the one under the cursor") {
+        linked_list_t *expected = bash_input_to_list(input->line, SIZE_MAX);
+        linked_list_t *words = completion_input_to_list_in(NULL, input);
+        REQUIRE(get_cursor_token(input) == 3);
+        REQUIRE(words->size == expected->size - 1);
+        linked_list_node_t *x = words->head;
+        int i = 0;
+        for (linked_list_node_t *y = expected->head; x && y; y = y->next, i++) {
+            if (i != 3) {
+                CHECK(x->data == y->data);
+                x = x->next;
+            }
+        }
+        words = ll_destroy(words);
+        expected = ll_destroy(expected);
+    }
+
+    SECTION("the word under the cursor is not in the word set") {
+        hash_map_t *word_set = word_set_create_from_input(input);
+        CHECK(is_word_in_set(word_set, str_pool_intern(NULL, "--namespace")));
+        CHECK(is_word_in_set(word_set, str_pool_intern(NULL, "pods")));
+        CHECK_FALSE(is_word_in_set(word_set, str_pool_intern(NULL, "kube system")));
+        word_set = hm_destroy(word_set);
+
+        // the cursor at the end of the line: the last word is the one being completed
+        input->cursor_pos = (int) input->line_len;
+        REQUIRE(tokenize_completion_input(input) == ERR_NONE);
+        word_set = word_set_create_from_input(input);
+        CHECK(is_word_in_set(word_set, str_pool_intern(NULL, "kube system")));
+        CHECK_FALSE(is_word_in_set(word_set, str_pool_intern(NULL, "pods")));
+        word_set = hm_destroy(word_set);
+    }
+
+    SECTION("corrected words") {
+        bce_str_t got = str_pool_intern(NULL, "got");
+        REQUIRE(correct_completion_input_word(input, 1, got));
+        CHECK_FALSE(correct_completion_input_word(input, 5, got));
+        // read instead of the token, everywhere
+        CHECK(get_token(input, 1, &len) == got);
+        CHECK(len == 3);
+        hash_map_t *word_set = word_set_create_from_input(input);
+        CHECK(is_word_in_set(word_set, got));
+        CHECK_FALSE(is_word_in_set(word_set, str_pool_intern(NULL, "get")));
+        word_set = hm_destroy(word_set);
+        linked_list_t *words = completion_input_to_list_in(NULL, input);
+        CHECK(words->head->next->data == got);
+        words = ll_destroy(words);
+        // until the line is split again
+        tokenize_completion_input(input);
+        text = get_token(input, 1, &len);
+        CHECK(std::string(text, len) == "get");
+    }
+
+    free_completion_input(input);
+}
+
+static std::string current_word_of(completion_input_t *input) {
+    char word[1024];
+    get_current_word(input, word, sizeof(word) - 1);
+    return word;
+}
+
+static std::string previous_word_of(completion_input_t *input) {
+    char word[1024];
+    get_previous_word(input, word, sizeof(word) - 1);
+    return word;
+}
+
+TEST_CASE("completion prefix") {
+    arena_t *arena = arena_create(0);
+    bce_error_t err;
+    struct {
+        const char *line;
+        int cursor_pos;
+        const char *prefix;
+    } cases[] = {
+            {"kubectl get po",             14, "po"},
+            {"kubectl get ",               12, ""},
+            {"kubectl get po",             10, "ge"},
+            {"kubectl get 'po'",           16, "po"},
+            {"kubectl get 'po' ",          17, ""},
+            {"kubectl get \"po",           15, "po"},
+            {"kubectl --namespace=",       20, ""},
+            {"kubectl --namespace=ku",     22, "ku"},
+            {"kubectl",                    0,  ""},
+    };
+    for (auto &c : cases) {
+        INFO(c.line << " (" << c.cursor_pos << ")");
+        completion_input_t *input = create_completion_input_from_line(c.line, c.cursor_pos, &err);
+        REQUIRE(err == ERR_NONE);
+        CHECK(std::string(get_completion_prefix_in(arena, input)) == c.prefix);
+        free_completion_input(input);
+    }
+    arena = arena_destroy(arena);
+}
+
+TEST_CASE("completion_input from words") {
+    bce_error_t err;
+
+    SECTION("same tokens as COMP_LINE") {
+        // how bash splits `kubectl get pods --namespace=kube-system -o ` (COMP_WORDBREAKS includes '=')
+        const char *words[] = {"kubectl", "get", "pods", "--namespace", "=", "kube-system", "-o", ""};
+        completion_input_t *input = create_completion_input_from_words(words, 8, 7, &err);
+        REQUIRE(err == ERR_NONE);
+        const char *line = "kubectl get pods --namespace=kube-system -o ";
+        completion_input_t *expected = create_completion_input_from_line(line, (int) strlen(line), &err);
+        REQUIRE(err == ERR_NONE);
+
+        REQUIRE(input->token_count == expected->token_count);
+        for (size_t i = 0; i < input->token_count; i++) {
+            size_t len = 0, expected_len = 0;
+            const char *token = get_token(input, (int) i, &len);
+            const char *expected_token = get_token(expected, (int) i, &expected_len);
+            CHECK(std::string(token, len) == std::string(expected_token, expected_len));
+        }
+        CHECK(input->current_token == expected->current_token);
+        CHECK(current_word_of(input) == "-o");
+        CHECK(previous_word_of(input) == "kube-system");
+
+        free_completion_input(expected);
+        free_completion_input(input);
+    }
+
+    SECTION("quotes and escapes") {
+        const char *words[] = {"ls", "my\\ file", "'kube system'", "\"say \\\"hi\\\" \\n", "\"\""};
+        completion_input_t *input = create_completion_input_from_words(words, 5, 3, &err);
+        REQUIRE(err == ERR_NONE);
+        REQUIRE(input->token_count == 5);
+        size_t len = 0;
+        const char *token = get_token(input, 1, &len);
+        CHECK(std::string(token, len) == "my file");
+        token = get_token(input, 2, &len);
+        CHECK(std::string(token, len) == "kube system");
+        CHECK(input->tokens[2].quote == TOKEN_SINGLE_QUOTED);
+        token = get_token(input, 3, &len);
+        CHECK(std::string(token, len) == "say \"hi\" \\n");
+        CHECK(input->tokens[3].quote == TOKEN_DOUBLE_QUOTED);
+        token = get_token(input, 4, &len);
+        CHECK(len == 0);
+        CHECK(current_word_of(input) == "say \"hi\" \\n");
+        free_completion_input(input);
+    }
+
+    SECTION("cursor in a new word") {
+        const char *words[] = {"kubectl", "get"};
+        completion_input_t *input = create_completion_input_from_words(words, 2, 2, &err);
+        REQUIRE(err == ERR_NONE);
+        CHECK(strcmp(input->line, "kubectl get ") == 0);
+        CHECK(current_word_of(input) == "get");
+
+        // keeps bash's words
+        input->cursor_pos = 0;
+        REQUIRE(tokenize_completion_input(input) == ERR_NONE);
+        CHECK(input->token_count == 2);
+        CHECK(input->current_token == -1);
+        free_completion_input(input);
+    }
+
+    SECTION("bad COMP_CWORD") {
+        const char *words[] = {"kubectl", "get"};
+        CHECK(create_completion_input_from_words(words, 2, 3, &err) == NULL);
+        CHECK(err == ERR_INVALID_COMP_CWORD);
+        CHECK(create_completion_input_from_words(words, 2, -1, &err) == NULL);
+        CHECK(err == ERR_INVALID_COMP_CWORD);
+    }
+}
+
+TEST_CASE("completion_input long command line") {
+    // an `xargs`-style line of about 1 MB, with a last word longer than any fixed buffer
+    std::string line = "rm";
+    size_t count = 1;
+    for (int i = 0; line.size() < 1024 * 1024; i++, count++) {
+        line += " /var/log/archive/service-" + std::to_string(i) + ".log.gz";
+    }
+    std::string previous = line.substr(line.rfind(' ') + 1);
+    std::string last(64 * 1024, 'x');
+    line += " " + last;
+    count++;
+
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_line(line.c_str(), (int) line.size(), &err);
+    REQUIRE(err == ERR_NONE);
+    CHECK(input->line_len == line.size());
+    CHECK(input->token_count == count);
+    CHECK(input->current_token == (int) count - 1);
+
+    arena_t *arena = arena_create(0);
+    CHECK(bce_str_equal(get_command_word_in(arena, input), str_pool_intern(arena, "rm")));
+    CHECK(bce_str_equal(get_previous_word_in(arena, input), str_pool_intern(arena, previous.c_str())));
+    bce_str_t current = get_current_word_in(arena, input);
+    CHECK(bce_str_len(current) == last.size());
+
+    SECTION("cursor in the middle of the last word") {
+        input->cursor_pos -= 1000;
+        REQUIRE(tokenize_completion_input(input) == ERR_NONE);
+        CHECK(bce_str_len(get_current_word_in(arena, input)) == last.size() - 1000);
+    }
+
+    SECTION("same words as bash_input_to_list(), but the one under the cursor") {
+        linked_list_t *words = completion_input_to_list_in(arena, input);
+        CHECK(words->size == count - 1);
+        linked_list_t *expected = bash_input_to_list(line.c_str(), SIZE_MAX);
+        CHECK(expected->size == count);
+        expected = ll_destroy(expected);
+    }
+
+    arena = arena_destroy(arena);
+    free_completion_input(input);
+}
+
+TEST_CASE("shell-ready words") {
+    arena_t *arena = arena_create(0);
+
+    SECTION("quoted as the word under the cursor is") {
+        CHECK(std::string(quote_word_in(arena, "pods", 4, TOKEN_UNQUOTED)) == "pods");
+        CHECK(std::string(quote_word_in(arena, "a b$c'd", 7, TOKEN_UNQUOTED)) == "a\\ b\\$c\\'d");
+        CHECK(std::string(quote_word_in(arena, "a b$c\"d", 7, TOKEN_DOUBLE_QUOTED)) == "a b\\$c\\\"d");
+        CHECK(std::string(quote_word_in(arena, "a b$c'd", 7, TOKEN_SINGLE_QUOTED)) == "a b$c'\\''d");
+        // no tabs or newlines left
+        CHECK(std::string(quote_word_in(arena, "a\tb", 3, TOKEN_UNQUOTED)) == "a$'\\011'b");
+        CHECK(std::string(quote_word_in(arena, "a\nb", 3, TOKEN_SINGLE_QUOTED)) == "a'$'\\012''b");
+        CHECK(std::string(quote_word_in(arena, "", 0, TOKEN_UNQUOTED)).empty());
+    }
+
+    SECTION("quote of the word under the cursor") {
+        bce_error_t err;
+        completion_input_t *input = create_completion_input_from_line("kubectl get 'po", 15, &err);
+        REQUIRE(err == ERR_NONE);
+        CHECK(get_cursor_quote(input) == TOKEN_SINGLE_QUOTED);
+        free_completion_input(input);
+        input = create_completion_input_from_line("kubectl get ", 12, &err);
+        REQUIRE(err == ERR_NONE);
+        CHECK(get_cursor_quote(input) == TOKEN_UNQUOTED);
+        free_completion_input(input);
+    }
+
+    SECTION("BCE_OUTPUT") {
+        CHECK(parse_output_format("words") == OUTPUT_WORDS);
+        CHECK(parse_output_format("display") == OUTPUT_DISPLAY);
+        CHECK(parse_output_format("") == OUTPUT_DISPLAY);
+        CHECK(parse_output_format(NULL) == OUTPUT_DISPLAY);
+        CHECK(parse_fd("1") == 1);
+        CHECK(parse_fd("x") == -1);
+        CHECK(parse_fd("-1") == -1);
+        CHECK(parse_fd(NULL) == -1);
+    }
+
+    arena = arena_destroy(arena);
+}
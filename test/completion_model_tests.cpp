@@ -1,12 +1,21 @@
 #include "catch.hpp"
+#include <string.h>
 
 extern "C" {
 #include <stdio.h>
 #include <sqlite3.h>
 #include "../dbutil.h"
 #include "../data_model.h"
+#include "../input.h"
+#include "../completion.h"
+#include "../prune.h"
+#include "../fuzzy.h"
 #include "../error.h"
 };
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "test_data.h"
 
 TEST_CASE("create schema") {
     int rc;
@@ -42,3 +51,565 @@ TEST_CASE("load data") {
         CHECK(result == ERR_NONE);
     }
 }
+
+TEST_CASE("clone command") {
+    bce_command_t *cmd = bce_command_new();
+    cmd->uuid = str_pool_intern(cmd->arena, "00000000-0000-0000-0000-000000000001");
+    cmd->name = str_pool_intern(cmd->arena, "kubectl");
+
+    bce_command_alias_t *alias = bce_command_alias_new();
+    alias->name = str_pool_intern(alias->arena, "bbb");
+    ll_append_item(cmd->aliases, alias);
+
+    bce_command_arg_t *arg = bce_command_arg_new();
+    arg->long_name = str_pool_intern(arg->arena, "--output");
+    arg->short_name = str_pool_intern(arg->arena, "-o");
+    arg->arg_type = str_pool_intern(arg->arena, "OPTION");
+    bce_command_opt_t *opt = bce_command_opt_new();
+    opt->name = str_pool_intern(opt->arena, "wide");
+    ll_append_item(arg->opts, opt);
+    ll_append_item(cmd->args, arg);
+
+    bce_command_t *sub_cmd = bce_command_new();
+    sub_cmd->name = str_pool_intern(sub_cmd->arena, "get");
+    sub_cmd->parent_cmd_uuid = cmd->uuid;
+    ll_append_item(cmd->sub_commands, sub_cmd);
+
+    bce_command_t *copy = bce_command_clone(cmd);
+    REQUIRE(copy != NULL);
+    CHECK(copy != cmd);
+    CHECK(strcmp(copy->name, "kubectl") == 0);
+    CHECK(strcmp(copy->uuid, cmd->uuid) == 0);
+    REQUIRE(copy->aliases->size == 1);
+    CHECK(strcmp(((bce_command_alias_t *) copy->aliases->head->data)->name, "bbb") == 0);
+    REQUIRE(copy->args->size == 1);
+    bce_command_arg_t *arg_copy = (bce_command_arg_t *) copy->args->head->data;
+    CHECK(arg_copy != arg);
+    CHECK(strcmp(arg_copy->long_name, "--output") == 0);
+    REQUIRE(arg_copy->opts->size == 1);
+    CHECK(strcmp(((bce_command_opt_t *) arg_copy->opts->head->data)->name, "wide") == 0);
+    REQUIRE(copy->sub_commands->size == 1);
+    bce_command_t *sub_copy = (bce_command_t *) copy->sub_commands->head->data;
+    CHECK(strcmp(sub_copy->name, "get") == 0);
+    CHECK(strcmp(sub_copy->parent_cmd_uuid, cmd->uuid) == 0);
+
+    // pruning the copy must not affect the original
+    ll_remove_item(copy->sub_commands, copy->sub_commands->head);
+    CHECK(copy->sub_commands->size == 0);
+    CHECK(cmd->sub_commands->size == 1);
+
+    copy = bce_command_free(copy);
+    cmd = bce_command_free(cmd);
+}
+
+TEST_CASE("load command tree") {
+    int rc;
+    const char *database_file = "test/tree.db";
+    remove(database_file);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    bce_command_t *cmd = create_synthetic_command("tree", 3, 3, 2, 2);
+    REQUIRE(db_store_command(conn, cmd) == ERR_NONE);
+    cmd = bce_command_free(cmd);
+
+    SECTION("same result as loading one level at a time") {
+        // db_query_command() allocates the lists itself
+        bce_command_t *expected = (bce_command_t *) calloc(1, sizeof(bce_command_t));
+        REQUIRE(db_query_command(conn, expected, "tree") == ERR_NONE);
+        bce_command_t *actual = bce_command_new();
+        REQUIRE(db_query_command_tree(conn, actual, "tree-alias") == ERR_NONE);
+
+        CHECK(strcmp(actual->name, "tree") == 0);
+        CHECK(actual->sub_commands->size == 3);
+        CHECK(commands_equal(expected, actual));
+
+        expected = bce_command_free(expected);
+        actual = bce_command_free(actual);
+    }
+
+    SECTION("unknown command") {
+        bce_command_t *actual = bce_command_new();
+        CHECK(db_query_command_tree(conn, actual, "xyz") == ERR_NONE);
+        CHECK(strlen(actual->uuid) == 0);
+        CHECK(actual->sub_commands->size == 0);
+        actual = bce_command_free(actual);
+    }
+
+    db_close(conn);
+    remove(database_file);
+}
+
+TEST_CASE("load command path") {
+    int rc;
+    const char *database_file = "test/path.db";
+    remove(database_file);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    bce_command_t *tree = create_synthetic_command("path", 3, 3, 2, 2);
+    REQUIRE(db_store_command(conn, tree) == ERR_NONE);
+
+    SECTION("sub-commands on the command line") {
+        linked_list_t *word_list = bash_input_to_list("path path.1 --path.1-0 path.1.2 ", SIZE_MAX);
+        bce_command_t *cmd = bce_command_new();
+        REQUIRE(db_query_command_path(conn, cmd, "path", word_list) == ERR_NONE);
+
+        CHECK(cmd->aliases->size == 1);
+        CHECK(cmd->args->size == 2);
+        REQUIRE(cmd->sub_commands->size == 1);
+        bce_command_t *sub_cmd = (bce_command_t *) cmd->sub_commands->head->data;
+        CHECK(strcmp(sub_cmd->name, "path.1") == 0);
+        CHECK(sub_cmd->args->size == 2);
+        REQUIRE(sub_cmd->sub_commands->size == 1);
+        bce_command_t *deepest = (bce_command_t *) sub_cmd->sub_commands->head->data;
+        CHECK(strcmp(deepest->name, "path.1.2") == 0);
+
+        // the children of the deepest command are loaded, but not their sub-commands
+        REQUIRE(deepest->sub_commands->size == 3);
+        for (linked_list_node_t *node = deepest->sub_commands->head; node != NULL; node = node->next) {
+            bce_command_t *child = (bce_command_t *) node->data;
+            CHECK(child->args->size == 2);
+            CHECK(child->sub_commands->size == 0);
+        }
+
+        // same as copying the path from the whole tree
+        bce_command_t *copy = bce_command_clone_path(tree, word_list);
+        CHECK(commands_equal(cmd, copy));
+
+        copy = bce_command_free(copy);
+        cmd = bce_command_free(cmd);
+        word_list = ll_destroy(word_list);
+    }
+
+    SECTION("no sub-commands on the command line") {
+        linked_list_t *word_list = bash_input_to_list("path-alias --path-0 ", SIZE_MAX);
+        bce_command_t *cmd = bce_command_new();
+        REQUIRE(db_query_command_path(conn, cmd, "path-alias", word_list) == ERR_NONE);
+
+        CHECK(strcmp(cmd->name, "path") == 0);
+        REQUIRE(cmd->sub_commands->size == 3);
+        bce_command_t *child = (bce_command_t *) cmd->sub_commands->head->data;
+        CHECK(child->args->size == 2);
+        CHECK(child->sub_commands->size == 0);
+
+        bce_command_t *copy = bce_command_clone_path(tree, word_list);
+        CHECK(commands_equal(cmd, copy));
+
+        copy = bce_command_free(copy);
+        cmd = bce_command_free(cmd);
+        word_list = ll_destroy(word_list);
+    }
+
+    tree = bce_command_free(tree);
+    db_close(conn);
+    remove(database_file);
+}
+
+/* Collect the recommendations for the input (freed) */
+static std::vector<std::string> collect_for_input(const bce_command_t *tree, completion_input_t *input,
+                                                  bool use_prefix, size_t *omitted) {
+    bool correct_words = input->correct_words;
+    arena_t *arena = arena_create(0);
+    linked_list_t *word_list = completion_input_to_list_in(arena, input);
+    bce_str_t prefix = use_prefix ? completion_index_prefix_in(arena, input) : bce_str_empty();
+    bce_command_t *cmd = bce_command_clone_path_prefix_in(arena, tree, word_list, prefix);
+    while (correct_words && correct_misspelled_words(cmd, input)) {
+        word_list = completion_input_to_list_in(arena, input);
+        cmd = bce_command_clone_path_prefix_in(arena, tree, word_list, prefix);
+    }
+    linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+    completion_collect(cmd, input, NULL, recommendation_list, NULL, omitted);
+
+    std::vector<std::string> recommendations;
+    for (linked_list_node_t *node = recommendation_list->head; node != NULL; node = node->next) {
+        recommendations.push_back((const char *) node->data);
+    }
+    arena = arena_destroy(arena);
+    free_completion_input(input);
+    return recommendations;
+}
+
+static std::vector<std::string> collect_for_line(const bce_command_t *tree, const char *line, bool use_prefix,
+                                                 match_mode_t match_mode = MATCH_PREFIX, bool correct_words = false,
+                                                 size_t max_results = 0, size_t *omitted = nullptr,
+                                                 output_format_t output_format = OUTPUT_DISPLAY, int cursor_pos = -1) {
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_line(line, (cursor_pos < 0) ? (int) strlen(line)
+                                                                                         : cursor_pos, &err);
+    input->match_mode = match_mode;
+    input->correct_words = correct_words;
+    input->max_results = max_results;
+    input->output_format = output_format;
+    return collect_for_input(tree, input, use_prefix, omitted);
+}
+
+/* As `bce --words <current_word> <words...>` does, with BCE_OUTPUT=words */
+static std::vector<std::string> collect_for_words(const bce_command_t *tree, std::vector<const char *> words,
+                                                  int current_word) {
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_words(words.data(), words.size(), current_word, &err);
+    input->output_format = OUTPUT_WORDS;
+    return collect_for_input(tree, input, true, nullptr);
+}
+
+TEST_CASE("prefix filtering") {
+    bce_command_t *tree = create_synthetic_command("pre", 2, 4, 2, 2);
+    bce_command_t *indexed = bce_command_clone(tree);
+    REQUIRE(bce_command_build_index(indexed));
+    REQUIRE(indexed->sub_command_index != NULL);
+    CHECK(indexed->sub_command_index->size == 4 * (1 + 2 * 3));
+
+    SECTION("only the recommendations starting with the word under the cursor") {
+        std::vector<std::string> all = collect_for_line(tree, "pre pre.1 ", true);
+        std::vector<std::string> matching = collect_for_line(tree, "pre pre.1 pre.1.", true);
+        CHECK(matching == std::vector<std::string>({"pre.1.0", "pre.1.1", "pre.1.2", "pre.1.3"}));
+        CHECK(all.size() > matching.size());
+
+        // args of the sub-commands
+        matching = collect_for_line(tree, "pre pre.1 --pre.1.2", true);
+        CHECK(matching == std::vector<std::string>({"--pre.1.2-0", "--pre.1.2-1"}));
+
+        // opts of an arg on the command line
+        matching = collect_for_line(tree, "pre --pre-1 pre-1-", true);
+        CHECK(matching == std::vector<std::string>({"pre-1-0", "pre-1-1"}));
+    }
+
+    SECTION("the index copies only the matching sub-commands") {
+        bce_error_t err;
+        const char *line = "pre pre.1 --pre.1.2";
+        completion_input_t *input = create_completion_input_from_line(line, (int) strlen(line), &err);
+        arena_t *arena = arena_create(0);
+        linked_list_t *word_list = completion_input_to_list_in(arena, input);
+        bce_str_t prefix = get_completion_prefix_in(arena, input);
+        bce_command_t *copy = bce_command_clone_path_prefix_in(arena, indexed, word_list, prefix);
+        REQUIRE(copy->sub_commands->size == 1);
+        bce_command_t *sub_cmd = (bce_command_t *) copy->sub_commands->head->data;
+        CHECK(strcmp(sub_cmd->name, "pre.1") == 0);
+        REQUIRE(sub_cmd->sub_commands->size == 1);
+        CHECK(strcmp(((bce_command_t *) sub_cmd->sub_commands->head->data)->name, "pre.1.2") == 0);
+        arena = arena_destroy(arena);
+        free_completion_input(input);
+    }
+
+    SECTION("same recommendations with or without the index") {
+        const char *lines[] = {"pre ", "pre p", "pre pre.", "pre pre.2", "pre pre.1 ", "pre pre.1 pre.1.3",
+                               "pre pre.1 --pre.1.0-", "pre pre.1 pre.1.2-1-", "pre pre.1 x", "pre --pre-1 pre-1-",
+                               "pre pre.3 --pre.3-0 "};
+        for (const char *line : lines) {
+            INFO(line);
+            CHECK(collect_for_line(indexed, line, true) == collect_for_line(tree, line, true));
+        }
+    }
+
+    SECTION("fuzzy matching") {
+        // "pre.1.3" and "pre.3.1" both contain "p", "1" and "3", but the first one has them closer together
+        std::vector<std::string> matching = collect_for_line(tree, "pre pre.1 p13", true, MATCH_FUZZY);
+        REQUIRE(matching.size() >= 1);
+        CHECK(matching[0] == "pre.1.3");
+        for (const std::string &recommendation : matching) {
+            CHECK(recommendation.find('1') != std::string::npos);
+            CHECK(recommendation.find('3') != std::string::npos);
+        }
+        CHECK(collect_for_line(tree, "pre pre.1 p13", true) == std::vector<std::string>());
+
+        // the index is bypassed, so it finds the same
+        const char *lines[] = {"pre p", "pre pr1", "pre pre.1 13", "pre pre.1 -1-0", "pre --pre-1 p-1", "pre pre.1 zz"};
+        for (const char *line : lines) {
+            INFO(line);
+            std::vector<std::string> fuzzy = collect_for_line(indexed, line, true, MATCH_FUZZY);
+            CHECK(fuzzy == collect_for_line(tree, line, true, MATCH_FUZZY));
+            // and at least what matching by prefix finds
+            for (const std::string &recommendation : collect_for_line(tree, line, true)) {
+                CHECK(std::find(fuzzy.begin(), fuzzy.end(), recommendation) != fuzzy.end());
+            }
+        }
+        CHECK(collect_for_line(tree, "pre pre.1 zz", true, MATCH_FUZZY).empty());
+    }
+
+    indexed = bce_command_free(indexed);
+    tree = bce_command_free(tree);
+}
+
+TEST_CASE("limited results") {
+    bce_command_t *tree = create_synthetic_command("lim", 2, 6, 3, 5);
+    size_t omitted = 0;
+
+    SECTION("the first ones in alphabetical order, when matching by prefix") {
+        const char *lines[] = {"lim ", "lim lim.2 ", "lim lim.2 lim.2.", "lim lim.4 --lim.4-", "lim --lim-1 lim-1-"};
+        for (const char *line : lines) {
+            INFO(line);
+            std::vector<std::string> all = collect_for_line(tree, line, false);
+            REQUIRE(all.size() > 2);
+            std::sort(all.begin(), all.end());
+            for (size_t limit = 1; limit <= all.size() + 1; limit++) {
+                INFO(limit);
+                std::vector<std::string> best = collect_for_line(tree, line, false, MATCH_PREFIX, false, limit, &omitted);
+                size_t kept = std::min(limit, all.size());
+                CHECK(best == std::vector<std::string>(all.begin(), all.begin() + (long) kept));
+                CHECK(omitted == all.size() - kept);
+            }
+        }
+        collect_for_line(tree, "lim ", false, MATCH_PREFIX, false, 0, &omitted);
+        CHECK(omitted == 0);
+    }
+
+    SECTION("the options of the arg at the cursor") {
+        std::vector<std::string> best = collect_for_line(tree, "lim --lim-1 ", false, MATCH_PREFIX, false, 2, &omitted);
+        CHECK(best == std::vector<std::string>({"lim-1-0", "lim-1-1"}));
+        CHECK(omitted == 3);
+    }
+
+    SECTION("the best scores first (then in alphabetical order), when matching fuzzily") {
+        // the synthetic names have no aliases or short names: each recommendation scores as itself
+        fuzzy_pattern_t pattern;
+        fuzzy_pattern_init(&pattern, "l21", 3);
+        std::vector<std::string> all = collect_for_line(tree, "lim lim.2 l21", false, MATCH_FUZZY);
+        REQUIRE(all.size() > 3);
+        std::stable_sort(all.begin(), all.end(), [&pattern](const std::string &a, const std::string &b) {
+            int score_a = fuzzy_score(&pattern, a.c_str(), a.size());
+            int score_b = fuzzy_score(&pattern, b.c_str(), b.size());
+            return (score_a != score_b) ? (score_a > score_b) : (a < b);
+        });
+        std::vector<std::string> best = collect_for_line(tree, "lim lim.2 l21", false, MATCH_FUZZY, false, 3, &omitted);
+        CHECK(best == std::vector<std::string>(all.begin(), all.begin() + 3));
+        CHECK(omitted == all.size() - 3);
+    }
+
+    SECTION("did you mean") {
+        CHECK(collect_for_line(tree, "lim lmi.2", false, MATCH_PREFIX, false, 1, &omitted)
+              == std::vector<std::string>({"lim.2"}));
+        CHECK(omitted > 0);
+    }
+
+    tree = bce_command_free(tree);
+}
+
+TEST_CASE("typo correction") {
+    int rc;
+    const char *database_file = "test/typo.db";
+    remove(database_file);
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    REQUIRE(exec_sql_file(conn, "test/kubectl_data.sql"));
+    bce_command_t *tree = bce_command_new();
+    REQUIRE(completion_load_command(conn, tree, "kubectl", NULL) == ERR_NONE);
+    REQUIRE(tree->sub_commands->size == 1);
+    bce_command_t *indexed = bce_command_clone(tree);
+    REQUIRE(bce_command_build_index(indexed));
+
+    for (const bce_command_t *cmd : {(const bce_command_t *) tree, (const bce_command_t *) indexed}) {
+        INFO((cmd->sub_command_index ? "index" : "no index"));
+
+        SECTION(std::string("did you mean, ") + (cmd->sub_command_index ? "index" : "no index")) {
+            CHECK(collect_for_line(cmd, "kubectl gte", true) == std::vector<std::string>({"get"}));
+            CHECK(collect_for_line(cmd, "kubectl get pods --outptu", true) ==
+                  std::vector<std::string>({"--output (-o)"}));
+            CHECK(collect_for_line(cmd, "kubectl get replicaste", true) ==
+                  std::vector<std::string>({"replicasets (rs)"}));
+            // nearest first
+            std::vector<std::string> nearest = collect_for_line(cmd, "kubectl get pods --namespac", true);
+            REQUIRE(!nearest.empty());
+            CHECK(nearest[0] == "--namespace (-n)");
+            // too short, or too far
+            CHECK(collect_for_line(cmd, "kubectl gx", true).empty());
+            CHECK(collect_for_line(cmd, "kubectl apply", true).empty());
+            // fuzzy matching falls back too
+            CHECK(collect_for_line(cmd, "kubectl gte", true, MATCH_FUZZY) == std::vector<std::string>({"get"}));
+        }
+
+        SECTION(std::string("words output, ") + (cmd->sub_command_index ? "index" : "no index")) {
+            // `<word>\t<display>\t<description>`
+            CHECK(collect_for_line(cmd, "kubectl get re", true, MATCH_PREFIX, false, 0, nullptr, OUTPUT_WORDS) ==
+                  std::vector<std::string>({"replicasets\treplicasets (rs)\t"}));
+            // the name, if an alias matches as well
+            CHECK(collect_for_line(cmd, "kubectl get r", true, MATCH_PREFIX, false, 0, nullptr, OUTPUT_WORDS) ==
+                  std::vector<std::string>({"replicasets\treplicasets (rs)\t"}));
+            CHECK(collect_for_line(cmd, "kubectl get pods --out", true, MATCH_PREFIX, false, 0, nullptr, OUTPUT_WORDS) ==
+                  std::vector<std::string>({"--output\t--output (-o)\tOutput format"}));
+            // the cursor in a complete arg: the arg itself, not the options that follow it
+            CHECK(collect_for_line(cmd, "kubectl get pods -o", true, MATCH_PREFIX, false, 0, nullptr, OUTPUT_WORDS) ==
+                  std::vector<std::string>({"-o\t--output (-o)\tOutput format"}));
+            // the same recommendations, in the same order
+            for (const char *line : {"kubectl ", "kubectl get ", "kubectl get pods -o ", "kubectl g"}) {
+                std::vector<std::string> words;
+                for (const std::string &record : collect_for_line(cmd, line, true, MATCH_PREFIX, false, 0, nullptr,
+                                                                  OUTPUT_WORDS)) {
+                    size_t tab = record.find('\t');
+                    words.push_back(record.substr(tab + 1, record.find('\t', tab + 1) - tab - 1));
+                }
+                CHECK(words == collect_for_line(cmd, line, true));
+            }
+        }
+
+        SECTION(std::string("words output, the cursor on a word, ") + (cmd->sub_command_index ? "index" : "no index")) {
+            // the word being completed, whether partial, complete, or an alias
+            const std::vector<std::string> pods({"pods\tpods (po)\t"});
+            CHECK(collect_for_words(cmd, {"kubectl", "get", "pod"}, 2) == pods);
+            CHECK(collect_for_words(cmd, {"kubectl", "get", "pods"}, 2) == pods);
+            CHECK(collect_for_words(cmd, {"kubectl", "get", "po"}, 2) == pods);
+            CHECK(collect_for_words(cmd, {"kubectl", "ge"}, 1) == std::vector<std::string>({"get\tget\t"}));
+            CHECK(collect_for_words(cmd, {"kubectl", "get"}, 1) == std::vector<std::string>({"get\tget\t"}));
+            // with words after it
+            CHECK(collect_for_words(cmd, {"kubectl", "get", "pods", "-o"}, 1) ==
+                  std::vector<std::string>({"get\tget\t"}));
+            CHECK(collect_for_words(cmd, {"kubectl", "get", "pods", "-o"}, 2) == pods);
+        }
+
+        SECTION(std::string("the cursor in a sub-command, ") + (cmd->sub_command_index ? "index" : "no index")) {
+            // the word under the cursor is being completed, not typed yet: it doesn't prune its siblings
+            CHECK(collect_for_line(cmd, "kubectl get", true) == std::vector<std::string>({"get"}));
+            CHECK(collect_for_line(cmd, "kubectl get po", true) == std::vector<std::string>({"pods (po)"}));
+            CHECK(collect_for_line(cmd, "kubectl get pod", true) == std::vector<std::string>({"pods (po)"}));
+            CHECK(collect_for_line(cmd, "kubectl get pods", true) == std::vector<std::string>({"pods (po)"}));
+            // a complete alias
+            CHECK(collect_for_line(cmd, "kubectl get rs", true) == std::vector<std::string>({"replicasets (rs)"}));
+            // the cursor inside the word: completed up to the cursor, the words after it are still typed
+            CHECK(collect_for_line(cmd, "kubectl get pods", true, MATCH_PREFIX, false, 0, nullptr, OUTPUT_DISPLAY, 9) ==
+                  std::vector<std::string>({"get"}));
+            CHECK(collect_for_line(cmd, "kubectl get pods -o", true, MATCH_PREFIX, false, 0, nullptr, OUTPUT_DISPLAY,
+                                   14) == std::vector<std::string>({"pods (po)"}));
+        }
+
+        SECTION(std::string("continue as if corrected, ") + (cmd->sub_command_index ? "index" : "no index")) {
+            CHECK(collect_for_line(cmd, "kubectl gte ", true, MATCH_PREFIX, true) ==
+                  collect_for_line(cmd, "kubectl get ", true));
+            CHECK(collect_for_line(cmd, "kubectl gte pdos ", true, MATCH_PREFIX, true) ==
+                  collect_for_line(cmd, "kubectl get pods ", true));
+            CHECK(collect_for_line(cmd, "kubectl get pods --outptu ", true, MATCH_PREFIX, true) ==
+                  collect_for_line(cmd, "kubectl get pods --output ", true));
+            // not without BCE_CORRECT
+            CHECK(collect_for_line(cmd, "kubectl gte ", true) != collect_for_line(cmd, "kubectl get ", true));
+            // the word being typed, short words and the values of options are left alone
+            CHECK(collect_for_line(cmd, "kubectl get pdos", true, MATCH_PREFIX, true) ==
+                  std::vector<std::string>({"pods (po)"}));
+            CHECK(collect_for_line(cmd, "kubectl gt ", true, MATCH_PREFIX, true) ==
+                  collect_for_line(cmd, "kubectl gt ", true));
+            CHECK(collect_for_line(cmd, "kubectl -n gte ", true, MATCH_PREFIX, true) ==
+                  collect_for_line(cmd, "kubectl -n gte ", true));
+        }
+    }
+
+    indexed = bce_command_free(indexed);
+    tree = bce_command_free(tree);
+    db_close(conn);
+    remove(database_file);
+}
+
+TEST_CASE("completion cache") {
+    int rc;
+    bce_error_t err;
+    const char *database_file = "test/cache.db";
+    remove(database_file);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    bce_command_t *tree = create_synthetic_command("cache", 2, 3, 2, 2);
+    REQUIRE(db_store_command(conn, tree) == ERR_NONE);
+
+    completion_cache_t *cache = completion_cache_create(database_file, &err);
+    REQUIRE(err == ERR_NONE);
+    arena_t *arena = arena_create(0);
+    linked_list_t *word_list = bash_input_to_list("cache cache.1 ", SIZE_MAX);
+
+    SECTION("reloading a tree doesn't grow the process-wide string pool") {
+        size_t heap_strings = str_pool_size(NULL);
+        for (int i = 0; i < 3; i++) {
+            // another connection changes the database, so the cached tree is loaded again (with new strings)
+            std::string sql = "UPDATE command_arg SET description = 'changed " + std::to_string(i) + "'";
+            REQUIRE(sqlite3_exec(conn, sql.c_str(), NULL, NULL, NULL) == SQLITE_OK);
+
+            bce_command_t *cmd = completion_cache_get_command(cache, arena, "cache", word_list, bce_str_empty(), &err);
+            REQUIRE(err == ERR_NONE);
+            REQUIRE(cmd->args->size > 0);
+            CHECK(strcmp(((bce_command_arg_t *) cmd->args->head->data)->description,
+                         ("changed " + std::to_string(i)).c_str()) == 0);
+            REQUIRE(cmd->sub_commands->size == 1);
+            CHECK(strcmp(((bce_command_t *) cmd->sub_commands->head->data)->name, "cache.1") == 0);
+            arena_reset(arena);
+        }
+        CHECK(str_pool_size(NULL) == heap_strings);
+    }
+
+    word_list = ll_destroy(word_list);
+    arena = arena_destroy(arena);
+    cache = completion_cache_free(cache);
+    tree = bce_command_free(tree);
+    db_close(conn);
+    remove(database_file);
+}
+
+TEST_CASE("read-only open") {
+    int rc;
+    const char *database_file = "test/readonly.db";
+    remove(database_file);
+
+    CHECK(db_read_schema_stamp(database_file) == -1);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    bce_command_t *cmd = create_synthetic_command("readonly", 1, 2, 1, 1);
+    REQUIRE(db_store_command(conn, cmd) == ERR_NONE);
+    cmd = bce_command_free(cmd);
+    REQUIRE(db_close(conn) == SQLITE_OK);
+
+    SECTION("schema stamp from the file header") {
+        CHECK_FALSE(db_has_wal_content(database_file));
+        CHECK(db_read_schema_stamp(database_file) == DB_SCHEMA_VERSION);
+    }
+
+    SECTION("filename to URI") {
+        char *uri = db_filename_to_uri("dir/a?b#c%d.db");
+        CHECK(strcmp(uri, "file:dir/a%3Fb%23c%25d.db?mode=ro") == 0);
+        free(uri);
+        uri = db_filename_to_uri("completion.db");
+        CHECK(strcmp(uri, "file:completion.db?mode=ro") == 0);
+        free(uri);
+    }
+
+    SECTION("SQLite's result code, if it can't be opened") {
+        CHECK(db_open_readonly("test/missing/readonly.db", &rc) == NULL);
+        CHECK(rc == SQLITE_CANTOPEN);
+    }
+
+    SECTION("query, but no writes") {
+        conn = db_open_readonly(database_file, &rc);
+        REQUIRE(rc == SQLITE_OK);
+        bce_command_t *loaded = bce_command_new();
+        CHECK(db_query_command_tree(conn, loaded, "readonly") == ERR_NONE);
+        CHECK(loaded->sub_commands->size == 2);
+        loaded = bce_command_free(loaded);
+        CHECK(db_delete_command(conn, "readonly") != ERR_NONE);
+        CHECK(db_close(conn) == SQLITE_OK);
+    }
+
+    SECTION("sees writes committed while open") {
+        conn = db_open_readonly(database_file, &rc);
+        REQUIRE(rc == SQLITE_OK);
+        linked_list_t *cmd_names = ll_create(NULL);
+        CHECK(db_query_root_command_names(conn, cmd_names) == ERR_NONE);
+        CHECK(cmd_names->size == 1);
+        cmd_names = ll_destroy(cmd_names);
+
+        sqlite3 *writer = db_open(database_file, &rc);
+        REQUIRE(rc == SQLITE_OK);
+        cmd = create_synthetic_command("written", 1, 1, 1, 1);
+        REQUIRE(db_store_command(writer, cmd) == ERR_NONE);
+        cmd = bce_command_free(cmd);
+        REQUIRE(sqlite3_wal_checkpoint_v2(writer, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL) == SQLITE_OK);
+        REQUIRE(db_close(writer) == SQLITE_OK);
+
+        cmd_names = ll_create(NULL);
+        CHECK(db_query_root_command_names(conn, cmd_names) == ERR_NONE);
+        CHECK(cmd_names->size == 2);
+        cmd_names = ll_destroy(cmd_names);
+        CHECK(db_close(conn) == SQLITE_OK);
+    }
+
+    remove(database_file);
+}
@@ -0,0 +1,124 @@
+#include "catch.hpp"
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "../edit_distance.h"
+};
+
+static int distance(const char *pattern, const char *str, int max_distance) {
+    edit_pattern_t p;
+    REQUIRE(edit_pattern_init(&p, pattern, strlen(pattern)));
+    return edit_distance(&p, str, strlen(str), max_distance);
+}
+
+/* The textbook dynamic programming (optimal string alignment), as the reference */
+static int reference_distance(const std::string &a, const std::string &b) {
+    std::vector<std::vector<int>> d(a.size() + 1, std::vector<int>(b.size() + 1));
+    for (size_t i = 0; i <= a.size(); i++) {
+        d[i][0] = (int) i;
+    }
+    for (size_t j = 0; j <= b.size(); j++) {
+        d[0][j] = (int) j;
+    }
+    for (size_t i = 1; i <= a.size(); i++) {
+        for (size_t j = 1; j <= b.size(); j++) {
+            int cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+            d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + cost});
+            if ((i > 1) && (j > 1) && (a[i - 1] == b[j - 2]) && (a[i - 2] == b[j - 1])) {
+                d[i][j] = std::min(d[i][j], d[i - 2][j - 2] + 1);
+            }
+        }
+    }
+    return d[a.size()][b.size()];
+}
+
+TEST_CASE("edit distance") {
+    SECTION("typos") {
+        CHECK(distance("get", "get", 2) == 0);
+        CHECK(distance("gte", "get", 2) == 1);          // a transposition is 1 edit
+        CHECK(distance("ca", "abc", 5) == 3);           // but the transposed characters are not edited again
+        CHECK(distance("gett", "get", 2) == 1);
+        CHECK(distance("gt", "get", 2) == 1);
+        CHECK(distance("dscribe", "describe", 2) == 1);
+        CHECK(distance("--namspace", "--namespace", 2) == 1);
+        CHECK(distance("Get", "get", 2) == 1);          // case-sensitive
+        CHECK(distance("", "get", 5) == 3);
+        CHECK(distance("get", "", 5) == 3);
+    }
+
+    SECTION("too far") {
+        CHECK(distance("apply", "delete", 2) == 3);
+        // the lengths alone are too far apart
+        CHECK(distance("get", "replicasets", 2) == 3);
+        CHECK(distance("kubectl", "k", 1) == 2);
+    }
+
+    SECTION("pattern too long") {
+        std::string long_pattern(EDIT_DISTANCE_MAX_PATTERN + 1, 'a');
+        edit_pattern_t p;
+        CHECK_FALSE(edit_pattern_init(&p, long_pattern.c_str(), long_pattern.size()));
+        // the longest pattern uses every bit
+        long_pattern.pop_back();
+        REQUIRE(edit_pattern_init(&p, long_pattern.c_str(), long_pattern.size()));
+        std::string str = long_pattern;
+        str[63] = 'b';
+        CHECK(edit_distance(&p, str.c_str(), str.size(), 2) == 1);
+    }
+
+    SECTION("same as the dynamic programming") {
+        const char alphabet[] = "abcd-";
+        std::mt19937 rng(777);
+        std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+        std::uniform_int_distribution<size_t> length(0, 70);
+        for (int round = 0; round < 2000; round++) {
+            std::string a;
+            std::string b;
+            for (size_t i = length(rng) % (EDIT_DISTANCE_MAX_PATTERN + 1); i > 0; i--) {
+                a += alphabet[pick(rng)];
+            }
+            if (round % 2 == 0) {
+                for (size_t i = length(rng); i > 0; i--) {
+                    b += alphabet[pick(rng)];
+                }
+            } else {
+                // a few typos away
+                b = a;
+                for (size_t edits = length(rng) % 4; edits > 0; edits--) {
+                    size_t pos = b.empty() ? 0 : length(rng) % b.size();
+                    switch (length(rng) % 4) {
+                        case 0:
+                            b.insert(pos, 1, alphabet[pick(rng)]);
+                            break;
+                        case 1:
+                            if (!b.empty()) {
+                                b.erase(pos, 1);
+                            }
+                            break;
+                        case 2:
+                            if (!b.empty()) {
+                                b[pos] = alphabet[pick(rng)];
+                            }
+                            break;
+                        default:
+                            if (pos + 1 < b.size()) {
+                                std::swap(b[pos], b[pos + 1]);
+                            }
+                            break;
+                    }
+                }
+            }
+            int expected = reference_distance(a, b);
+            INFO("'" << a << "' and '" << b << "'");
+            edit_pattern_t p;
+            REQUIRE(edit_pattern_init(&p, a.c_str(), a.size()));
+            CHECK(edit_distance(&p, b.c_str(), b.size(), 100) == expected);
+            for (int max_distance : {0, 1, 2, 5}) {
+                CHECK(edit_distance(&p, b.c_str(), b.size(), max_distance) == std::min(expected, max_distance + 1));
+            }
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include "catch.hpp"
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+
+extern "C" {
+#include "../fuzzy.h"
+};
+
+static int score(const char *pattern, const char *str) {
+    fuzzy_pattern_t p;
+    fuzzy_pattern_init(&p, pattern, strlen(pattern));
+    return fuzzy_score(&p, str, strlen(str));
+}
+
+static int score_n(const char *pattern, const char *str, size_t len) {
+    fuzzy_pattern_t p;
+    fuzzy_pattern_init(&p, pattern, strlen(pattern));
+    return fuzzy_score(&p, str, len);
+}
+
+/* The pattern is a (case-insensitive) subsequence of the string */
+static bool is_subsequence(const std::string &pattern, const std::string &str) {
+    size_t p = 0;
+    for (size_t i = 0; (i < str.size()) && (p < pattern.size()); i++) {
+        if (tolower((unsigned char) str[i]) == tolower((unsigned char) pattern[p])) {
+            p++;
+        }
+    }
+    return p == pattern.size();
+}
+
+TEST_CASE("fuzzy matching") {
+    SECTION("subsequences match") {
+        CHECK(score("gt", "get") > 0);
+        CHECK(score("po", "pods") > 0);
+        CHECK(score("rs", "replicasets") > 0);
+        CHECK(score("", "anything") == 0);
+        CHECK(score("", "") == 0);
+        CHECK(score("tg", "get") == FUZZY_NO_MATCH);
+        CHECK(score("gets", "get") == FUZZY_NO_MATCH);
+        CHECK(score("x", "") == FUZZY_NO_MATCH);
+    }
+
+    SECTION("case-insensitive") {
+        CHECK(score("GT", "get") == score("gt", "get"));
+        CHECK(score("gt", "GET") > 0);
+        CHECK(score("-", "--dry-run") > 0);
+    }
+
+    SECTION("ranking") {
+        // consecutive, and at the start of a word, beats scattered
+        CHECK(score("get", "get") > score("get", "garbage-test"));
+        CHECK(score("ns", "namespace") > score("ns", "dns"));
+        CHECK(score("ns", "no-such") > score("ns", "dns"));
+        CHECK(score("pf", "port-forward") > score("pf", "explain-config"));
+        CHECK(score("cc", "createConfig") > score("cc", "accept"));
+        // the shortest window is scored
+        CHECK(score("ab", "a-------ab") == score("ab", "ab"));
+        // a shorter gap is better
+        CHECK(score("ab", "axb") > score("ab", "axxxxb"));
+    }
+
+    SECTION("long strings") {
+        // the SIMD scan, across 16-byte blocks
+        std::string name(100, 'x');
+        name[17] = 'a';
+        name[50] = 'B';
+        name[99] = 'c';
+        CHECK(score("abc", name.c_str()) != FUZZY_NO_MATCH);
+        CHECK(score("abcd", name.c_str()) == FUZZY_NO_MATCH);
+        CHECK(score("cab", name.c_str()) == FUZZY_NO_MATCH);
+    }
+
+    SECTION("strings at the end of a page") {
+        // nothing is read from the guard page after the string
+        long page_size = sysconf(_SC_PAGESIZE);
+        char *pages = (char *) mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        REQUIRE(pages != MAP_FAILED);
+        REQUIRE(mprotect(pages + page_size, page_size, PROT_NONE) == 0);
+        for (size_t len = 2; len <= 40; len++) {
+            char *str = pages + page_size - len;
+            memset(str, 'x', len);
+            str[len - 1] = 'b';
+            str[0] = 'A';
+            INFO(len);
+            CHECK(score_n("ab", str, len) != FUZZY_NO_MATCH);
+            CHECK(score_n("abx", str, len) == FUZZY_NO_MATCH);
+        }
+        munmap(pages, 2 * page_size);
+    }
+
+    SECTION("pattern too long") {
+        std::string long_pattern(FUZZY_MAX_PATTERN + 1, 'a');
+        fuzzy_pattern_t p;
+        CHECK_FALSE(fuzzy_pattern_init(&p, long_pattern.c_str(), long_pattern.size()));
+        CHECK(p.len == FUZZY_MAX_PATTERN);
+        CHECK(fuzzy_pattern_init(&p, long_pattern.c_str(), FUZZY_MAX_PATTERN));
+    }
+
+    SECTION("matches exactly the subsequences") {
+        const char alphabet[] = "abcABC-_.x";
+        std::mt19937 rng(4242);
+        std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+        std::uniform_int_distribution<size_t> str_length(0, 70);
+        std::uniform_int_distribution<size_t> pattern_length(0, 5);
+        for (int round = 0; round < 2000; round++) {
+            std::string str;
+            std::string pattern;
+            for (size_t i = str_length(rng); i > 0; i--) {
+                str += alphabet[pick(rng)];
+            }
+            for (size_t i = pattern_length(rng); i > 0; i--) {
+                pattern += alphabet[pick(rng)];
+            }
+            INFO("'" << pattern << "' in '" << str << "'");
+            CHECK((score(pattern.c_str(), str.c_str()) != FUZZY_NO_MATCH) == is_subsequence(pattern, str));
+        }
+    }
+}
@@ -0,0 +1,180 @@
+#include "catch.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test_data.h"
+
+extern "C" {
+#include "../history_index.h"
+#include "../completion.h"
+#include "../input.h"
+#include "../data_model.h"
+#include "../linked_list.h"
+#include "../str_pool.h"
+};
+
+static const char *HISTORY_FILE = "test/history.txt";
+static const char *INDEX_FILE = "test/history.index";
+
+static std::string read_text(const char *filename) {
+    std::ifstream file(filename);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+static void write_text(const char *filename, const std::string &text, const char *mode = "w") {
+    FILE *file = fopen(filename, mode);
+    REQUIRE(file);
+    fputs(text.c_str(), file);
+    fclose(file);
+}
+
+/* The index's values, without the header */
+static std::string read_values(const char *filename) {
+    std::string text = read_text(filename);
+    size_t header_end = text.find('\n');
+    return (header_end == std::string::npos) ? "" : text.substr(header_end + 1);
+}
+
+static std::vector<std::string> collect_with_history(const bce_command_t *tree, const char *line,
+                                                     const history_index_t *history) {
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_line(line, (int) strlen(line), &err);
+    arena_t *arena = arena_create(0);
+    linked_list_t *word_list = completion_input_to_list_in(arena, input);
+    bce_command_t *cmd = bce_command_clone_path_prefix_in(arena, tree, word_list, bce_str_empty());
+    history_index_merge(history, cmd);
+    linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+    completion_collect(cmd, input, NULL, recommendation_list, NULL, NULL);
+
+    std::vector<std::string> recommendations;
+    for (linked_list_node_t *node = recommendation_list->head; node != NULL; node = node->next) {
+        recommendations.push_back((const char *) node->data);
+    }
+    arena = arena_destroy(arena);
+    free_completion_input(input);
+    return recommendations;
+}
+
+TEST_CASE("history index") {
+    remove(HISTORY_FILE);
+    remove(INDEX_FILE);
+
+    SECTION("the values typed after args") {
+        write_text(HISTORY_FILE, "#1700000000\n"
+                                 "kubectl get pods -n kube-system -o wide | grep -v x\n"
+                                 "kubectl logs --namespace=default web --tail 10\n"
+                                 "ls -l /tmp\n"
+                                 "./run.sh -f x\n");
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        CHECK(read_values(INDEX_FILE) == "3\tls\t-l\t/tmp\n"
+                                         "2\tkubectl\t--namespace\tdefault\n"
+                                         "2\tkubectl\t--tail\t10\n"
+                                         "1\tkubectl\t-n\tkube-system\n"
+                                         "1\tkubectl\t-o\twide\n");
+    }
+
+    SECTION("only the lines added since the last update") {
+        write_text(HISTORY_FILE, "kubectl get pods -n one\n");
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        // rewritten in place: not read again
+        write_text(HISTORY_FILE, "kubectl get pods -n two\n");
+        write_text(HISTORY_FILE, "kubectl get pods -n three\n"
+                                 "kubectl get pods -n fo", "a");
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        CHECK(read_values(INDEX_FILE) == "2\tkubectl\t-n\tthree\n"
+                                         "1\tkubectl\t-n\tone\n");
+        // the partial line, once complete
+        write_text(HISTORY_FILE, "ur\n", "a");
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        CHECK(read_values(INDEX_FILE) == "3\tkubectl\t-n\tfour\n"
+                                         "2\tkubectl\t-n\tthree\n"
+                                         "1\tkubectl\t-n\tone\n");
+    }
+
+    SECTION("read again when the file is truncated") {
+        write_text(HISTORY_FILE, "kubectl get pods -n one\n"
+                                 "kubectl get pods -n two\n");
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        std::string indexed = read_text(INDEX_FILE);
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        CHECK(read_text(INDEX_FILE) == indexed);
+
+        write_text(HISTORY_FILE, "kubectl get pods -n one\n");
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        CHECK(read_values(INDEX_FILE) == "3\tkubectl\t-n\tone\n"
+                                         "2\tkubectl\t-n\ttwo\n");
+    }
+
+    SECTION("the most recent values of each arg") {
+        std::string history;
+        for (int i = 0; i < HISTORY_MAX_VALUES + 4; i++) {
+            history += "kubectl get pods -n ns" + std::to_string(i) + " -o wide\n";
+        }
+        write_text(HISTORY_FILE, history);
+        REQUIRE(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        std::string values = read_values(INDEX_FILE);
+        CHECK(values.find("\t-n\tns3\n") == std::string::npos);
+        CHECK(values.find("\t-n\tns4\n") != std::string::npos);
+        CHECK(values.find("\t-o\twide\n") != std::string::npos);
+        CHECK(std::count(values.begin(), values.end(), '\n') == HISTORY_MAX_VALUES + 1);
+    }
+
+    SECTION("no history") {
+        CHECK(history_index_update(INDEX_FILE, HISTORY_FILE) == ERR_NONE);
+        CHECK(history_index_load(INDEX_FILE, HISTORY_FILE, "kubectl") == NULL);
+    }
+
+    remove(HISTORY_FILE);
+    remove(INDEX_FILE);
+}
+
+TEST_CASE("history values") {
+    remove(HISTORY_FILE);
+    remove(INDEX_FILE);
+    bce_command_t *tree = create_synthetic_command("hist", 1, 2, 2, 3);
+    write_text(HISTORY_FILE, "hist hist.1 --hist.1-0 typed-0\n"
+                             "hist --hist-1 typed-1\n"
+                             "hist --hist-0 hist-0-2\n"
+                             "other --hist-1 other-1\n"
+                             "hist --hist-1 typed-2\n");
+    history_index_t *history = history_index_load(INDEX_FILE, HISTORY_FILE, "hist");
+    REQUIRE(history != NULL);
+    // only the command's
+    CHECK(history->value_count == 4);
+
+    SECTION("the most recent first, then the ones in the database") {
+        CHECK(collect_with_history(tree, "hist --hist-1 ", history)
+              == std::vector<std::string>({"typed-2", "typed-1", "hist-1-0", "hist-1-1", "hist-1-2"}));
+    }
+
+    SECTION("a value in the database is not repeated") {
+        CHECK(collect_with_history(tree, "hist --hist-0 ", history)
+              == std::vector<std::string>({"hist-0-2", "hist-0-0", "hist-0-1"}));
+    }
+
+    SECTION("filtered by the word under the cursor") {
+        CHECK(collect_with_history(tree, "hist --hist-1 ty", history)
+              == std::vector<std::string>({"typed-2", "typed-1"}));
+    }
+
+    SECTION("the args of sub-commands too") {
+        CHECK(collect_with_history(tree, "hist hist.1 --hist.1-0 ", history)
+              == std::vector<std::string>({"typed-0", "hist.1-0-0", "hist.1-0-1", "hist.1-0-2"}));
+    }
+
+    SECTION("nothing without a history") {
+        CHECK(collect_with_history(tree, "hist --hist-1 ", NULL)
+              == std::vector<std::string>({"hist-1-0", "hist-1-1", "hist-1-2"}));
+    }
+
+    history_index_free(history);
+    bce_command_free(tree);
+    remove(HISTORY_FILE);
+    remove(INDEX_FILE);
+}
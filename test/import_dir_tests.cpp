@@ -0,0 +1,238 @@
+#include "catch.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include <sqlite3.h>
+#include "../import_dir.h"
+#include "../import_writer.h"
+#include "../dbutil.h"
+#include "../data_model.h"
+#include "../str_pool.h"
+#include "../error.h"
+};
+
+static const size_t OPTS_PER_ARG = 2;
+
+static bce_str_t intern(arena_t *arena, const std::string &str) {
+    return str_pool_intern(arena, str.c_str());
+}
+
+/* Stands in for the json conversion: a spec is "<name> <arg count> [<load time, in ms>]", or fails to load */
+static bce_command_t *load_spec(arena_t *arena, const char *filename, bce_error_t *err) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        *err = ERR_READ_FILE;
+        return NULL;
+    }
+    char name[64];
+    int arg_count = 0;
+    int load_ms = 0;
+    int field_count = fscanf(file, "%63s %d %d", name, &arg_count, &load_ms);
+    fclose(file);
+    if (field_count < 2) {
+        *err = ERR_INVALID_JSON;
+        return NULL;
+    }
+    if (load_ms > 0) {
+        usleep((useconds_t) load_ms * 1000);
+    }
+
+    std::string cmd_name(name);
+    bce_command_t *cmd = bce_command_new_in(arena);
+    cmd->uuid = intern(arena, cmd_name + "-uuid");
+    cmd->name = intern(arena, cmd_name);
+    bce_command_alias_t *alias = bce_command_alias_new_in(arena);
+    alias->uuid = intern(arena, cmd_name + "-alias");
+    alias->cmd_uuid = cmd->uuid;
+    alias->name = cmd->name;
+    ll_append_item(cmd->aliases, alias);
+    for (int i = 0; i < arg_count; i++) {
+        std::string arg_name = cmd_name + "-arg" + std::to_string(i);
+        bce_command_arg_t *arg = bce_command_arg_new_in(arena);
+        arg->uuid = intern(arena, arg_name);
+        arg->cmd_uuid = cmd->uuid;
+        arg->arg_type = intern(arena, "OPTION");
+        arg->description = intern(arena, "an arg");
+        arg->long_name = intern(arena, "--" + arg_name);
+        for (size_t j = 0; j < OPTS_PER_ARG; j++) {
+            bce_command_opt_t *opt = bce_command_opt_new_in(arena);
+            opt->uuid = intern(arena, arg_name + "-opt" + std::to_string(j));
+            opt->cmd_arg_uuid = arg->uuid;
+            opt->name = intern(arena, "opt" + std::to_string(j));
+            ll_append_item(arg->opts, opt);
+        }
+        ll_append_item(cmd->args, arg);
+    }
+    *err = ERR_NONE;
+    return cmd;
+}
+
+static std::string write_spec(const std::string &dir_name, const std::string &name, const std::string &text) {
+    std::string filename = dir_name + "/" + name;
+    FILE *file = fopen(filename.c_str(), "w");
+    REQUIRE(file);
+    fputs(text.c_str(), file);
+    fclose(file);
+    return filename;
+}
+
+static size_t spec_rows(size_t arg_count) {
+    return 1 + 1 + arg_count + arg_count * OPTS_PER_ARG;
+}
+
+static import_dir_t *import_dir(sqlite3 *conn, const std::string &dir_name, int worker_count, bce_error_t *err) {
+    import_writer_t writer;
+    import_writer_init(&writer, conn);
+    import_dir_t *result = import_dir_run(&writer, dir_name.c_str(), worker_count, load_spec, err);
+    bce_error_t finish_err = import_writer_finish(&writer);
+    if (*err == ERR_NONE) {
+        *err = finish_err;
+    }
+    return result;
+}
+
+static int count_rows(sqlite3 *conn, const char *table) {
+    std::string sql = std::string("SELECT count(*) FROM ") + table;
+    sqlite3_stmt *stmt = NULL;
+    REQUIRE(sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, NULL) == SQLITE_OK);
+    REQUIRE(sqlite3_step(stmt) == SQLITE_ROW);
+    int count = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+TEST_CASE("import dir") {
+    int rc;
+    const char *database_file = "test/import_dir.db";
+    remove(database_file);
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+
+    char dir_template[] = "/tmp/bce_import_dir_XXXXXX";
+    REQUIRE(mkdtemp(dir_template));
+    std::string dir_name(dir_template);
+    std::string sub_dir_name = dir_name + "/skipped.json";
+    REQUIRE(mkdir(sub_dir_name.c_str(), 0700) == 0);
+    std::vector<std::string> filenames;
+    filenames.push_back(write_spec(dir_name, "notes.txt", "notes 1"));
+    filenames.push_back(write_spec(dir_name, ".hidden.json", "hidden 1"));
+
+    SECTION("specs, by name") {
+        filenames.push_back(write_spec(dir_name, "c.json", "gamma 3"));
+        filenames.push_back(write_spec(dir_name, "a.json", "alpha 1"));
+        filenames.push_back(write_spec(dir_name, "b.json", "not a spec"));
+        filenames.push_back(write_spec(dir_name, "d.json", "delta 0"));
+
+        bce_error_t err = ERR_NONE;
+        import_dir_t *result = import_dir(conn, dir_name, 2, &err);
+        REQUIRE(result);
+        CHECK(err == ERR_NONE);
+        CHECK(result->worker_count == 2);
+        REQUIRE(result->file_count == 4);
+        CHECK(result->failed_count == 1);
+        CHECK(std::string(result->files[0].filename) == dir_name + "/a.json");
+        CHECK(result->files[0].row_count == spec_rows(1));
+        CHECK(std::string(result->files[1].filename) == dir_name + "/b.json");
+        CHECK(result->files[1].err == ERR_INVALID_JSON);
+        CHECK(result->files[1].row_count == 0);
+        CHECK(result->files[2].row_count == spec_rows(3));
+        CHECK(result->files[3].row_count == spec_rows(0));
+        CHECK(count_rows(conn, "command") == 3);
+        CHECK(count_rows(conn, "command_opt") == (int) ((1 + 3) * OPTS_PER_ARG));
+
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command(conn, loaded, "gamma") == SQLITE_OK);
+        CHECK(loaded->args->size == 3);
+        loaded = bce_command_free(loaded);
+        result = import_dir_free(result);
+    }
+
+    SECTION("the same command in two specs: the last one by name is kept, whichever loads first") {
+        filenames.push_back(write_spec(dir_name, "a.json", "dup 1 100"));
+        filenames.push_back(write_spec(dir_name, "b.json", "dup 4"));
+
+        bce_error_t err = ERR_NONE;
+        import_dir_t *result = import_dir(conn, dir_name, 2, &err);
+        REQUIRE(result);
+        CHECK(err == ERR_NONE);
+        REQUIRE(result->file_count == 2);
+        CHECK(result->failed_count == 0);
+        CHECK(result->files[0].row_count == spec_rows(1));
+        CHECK(result->files[1].row_count == spec_rows(4));
+        CHECK(count_rows(conn, "command") == 1);
+
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command(conn, loaded, "dup") == SQLITE_OK);
+        CHECK(loaded->args->size == 4);
+        loaded = bce_command_free(loaded);
+        result = import_dir_free(result);
+    }
+
+    SECTION("more specs than workers and queue slots, replaced when imported again") {
+        size_t spec_count = IMPORT_DIR_QUEUE_SIZE * 5;
+        size_t row_count = 0;
+        for (size_t i = 0; i < spec_count; i++) {
+            std::string name = "spec" + std::to_string(i);
+            filenames.push_back(write_spec(dir_name, name + ".json", name + " " + std::to_string(i % 7)));
+            row_count += spec_rows(i % 7);
+        }
+
+        for (int pass = 0; pass < 2; pass++) {
+            bce_error_t err = ERR_NONE;
+            import_dir_t *result = import_dir(conn, dir_name, 4, &err);
+            REQUIRE(result);
+            CHECK(err == ERR_NONE);
+            CHECK(result->file_count == spec_count);
+            CHECK(result->failed_count == 0);
+            size_t imported_rows = 0;
+            for (size_t i = 0; i < result->file_count; i++) {
+                imported_rows += result->files[i].row_count;
+            }
+            CHECK(imported_rows == row_count);
+            CHECK(count_rows(conn, "command") == (int) spec_count);
+            CHECK(count_rows(conn, "command_alias") == (int) spec_count);
+            result = import_dir_free(result);
+        }
+    }
+
+    SECTION("one worker per CPU, at most one per spec") {
+        filenames.push_back(write_spec(dir_name, "only.json", "only 2"));
+        bce_error_t err = ERR_NONE;
+        import_dir_t *result = import_dir(conn, dir_name, 0, &err);
+        REQUIRE(result);
+        CHECK(err == ERR_NONE);
+        CHECK(result->worker_count == 1);
+        CHECK(result->failed_count == 0);
+        result = import_dir_free(result);
+    }
+
+    SECTION("no specs") {
+        bce_error_t err = ERR_NONE;
+        import_dir_t *result = import_dir(conn, dir_name, 4, &err);
+        REQUIRE(result);
+        CHECK(err == ERR_NONE);
+        CHECK(result->file_count == 0);
+        result = import_dir_free(result);
+    }
+
+    SECTION("missing directory") {
+        bce_error_t err = ERR_NONE;
+        CHECK(import_dir(conn, dir_name + "/missing", 4, &err) == NULL);
+        CHECK(err == ERR_READ_FILE);
+    }
+
+    for (const std::string &filename : filenames) {
+        remove(filename.c_str());
+    }
+    rmdir(sub_dir_name.c_str());
+    rmdir(dir_name.c_str());
+    db_close(conn);
+    remove(database_file);
+}
@@ -0,0 +1,70 @@
+#include "catch.hpp"
+#include <stdio.h>
+#include "test_data.h"
+
+extern "C" {
+#include <sqlite3.h>
+#include "../import_writer.h"
+#include "../dbutil.h"
+#include "../data_model.h"
+#include "../error.h"
+};
+
+TEST_CASE("import writer") {
+    int rc;
+    const char *database_file = "test/import_writer.db";
+    remove(database_file);
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+
+    // 73 commands, 1 alias, 657 args and 5913 opts: none a multiple of the batch size
+    // (fewer than 10 of each per parent, so that they are queried back in the same order)
+    bce_command_t *cmd = create_synthetic_command("writer", 2, 8, 9, 9);
+    size_t row_count = 73 + 1 + 657 + 5913;
+
+    SECTION("round trip") {
+        import_writer_t writer;
+        REQUIRE(import_writer_init(&writer, conn) == ERR_NONE);
+        REQUIRE(import_writer_add_command(&writer, cmd) == ERR_NONE);
+        REQUIRE(import_writer_finish(&writer) == ERR_NONE);
+        CHECK(writer.row_count == row_count);
+        // multi-row INSERTs, not one per row
+        CHECK(writer.statement_count * (IMPORT_WRITER_BATCH_ROWS / 4) < row_count);
+
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command(conn, loaded, "writer") == SQLITE_OK);
+        CHECK(commands_equal(cmd, loaded));
+        loaded = bce_command_free(loaded);
+    }
+
+    SECTION("flushed per command") {
+        bce_command_t *other = create_synthetic_command("other", 1, 3, 2, 1);
+        import_writer_t writer;
+        REQUIRE(import_writer_init(&writer, conn) == ERR_NONE);
+        REQUIRE(import_writer_add_command(&writer, cmd) == ERR_NONE);
+        REQUIRE(import_writer_flush(&writer) == ERR_NONE);
+        CHECK(writer.row_count == row_count);
+        REQUIRE(import_writer_add_command(&writer, other) == ERR_NONE);
+        REQUIRE(import_writer_finish(&writer) == ERR_NONE);
+
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command(conn, loaded, "other") == SQLITE_OK);
+        CHECK(commands_equal(other, loaded));
+        loaded = bce_command_free(loaded);
+        other = bce_command_free(other);
+    }
+
+    SECTION("stops at the first error") {
+        REQUIRE(db_store_command(conn, cmd) == ERR_NONE);
+        import_writer_t writer;
+        REQUIRE(import_writer_init(&writer, conn) == ERR_NONE);
+        import_writer_add_command(&writer, cmd);
+        CHECK(import_writer_finish(&writer) == ERR_SQLITE_ERROR);
+        CHECK(writer.row_count < row_count);
+    }
+
+    cmd = bce_command_free(cmd);
+    db_close(conn);
+    remove(database_file);
+}
@@ -0,0 +1,148 @@
+#include "catch.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "test_data.h"
+
+extern "C" {
+#include <sqlite3.h>
+#include "../json_import.h"
+#include "../import_writer.h"
+#include "../dbutil.h"
+#include "../data_model.h"
+#include "../uuid4.h"
+#include "../error.h"
+};
+
+static const char *SPEC_FILE = "test/json_import.json";
+
+static void write_text(const char *filename, const std::string &text) {
+    FILE *file = fopen(filename, "w");
+    REQUIRE(file);
+    fputs(text.c_str(), file);
+    fclose(file);
+}
+
+static bce_error_t import_file(sqlite3 *conn, const char *filename, size_t *row_count = NULL) {
+    import_writer_t writer;
+    import_writer_init(&writer, conn);
+    bce_error_t err = json_import_file(&writer, filename);
+    bce_error_t finish_err = import_writer_finish(&writer);
+    if (row_count) {
+        *row_count = writer.row_count;
+    }
+    return (err != ERR_NONE) ? err : finish_err;
+}
+
+static bce_error_t import_text(sqlite3 *conn, const std::string &text) {
+    write_text(SPEC_FILE, text);
+    return import_file(conn, SPEC_FILE);
+}
+
+TEST_CASE("json import") {
+    int rc;
+    const char *database_file = "test/json_import.db";
+    remove(database_file);
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    REQUIRE(uuid4_init() == UUID4_ESUCCESS);
+
+    SECTION("same rows as the sql script") {
+        REQUIRE(import_file(conn, "test/kubectl.json") == ERR_NONE);
+        bce_command_t *imported = bce_command_new();
+        REQUIRE(db_query_command(conn, imported, "kubectl") == SQLITE_OK);
+
+        sqlite3 *expected_conn = db_open(":memory:", &rc);
+        REQUIRE(db_create_schema(expected_conn) == ERR_NONE);
+        REQUIRE(exec_sql_file(expected_conn, "test/kubectl_data.sql"));
+        // the only command not in the json
+        REQUIRE(sqlite3_exec(expected_conn, "DELETE FROM command WHERE name = 'replicasets'", NULL, NULL, NULL)
+                == SQLITE_OK);
+        bce_command_t *expected = bce_command_new();
+        REQUIRE(db_query_command(expected_conn, expected, "kubectl") == SQLITE_OK);
+        CHECK(commands_equal(expected, imported));
+
+        expected = bce_command_free(expected);
+        imported = bce_command_free(imported);
+        db_close(expected_conn);
+    }
+
+    SECTION("round trip, across batches") {
+        // 57 commands, 1 alias, 513 args and 4617 opts (fewer than 10 of each per parent: queried back in order)
+        bce_command_t *cmd = create_synthetic_command("spec", 2, 7, 9, 9);
+        FILE *file = fopen(SPEC_FILE, "w");
+        REQUIRE(file);
+        write_json_spec(file, cmd);
+        fclose(file);
+
+        size_t row_count = 0;
+        REQUIRE(import_file(conn, SPEC_FILE, &row_count) == ERR_NONE);
+        CHECK(row_count == 57 + 1 + 513 + 4617);
+        CHECK(row_count > JSON_IMPORT_BATCH_ROWS);
+
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command(conn, loaded, "spec") == SQLITE_OK);
+        CHECK(commands_equal(cmd, loaded));
+        loaded = bce_command_free(loaded);
+        cmd = bce_command_free(cmd);
+    }
+
+    SECTION("uuids generated, and the command replaced") {
+        REQUIRE(import_file(conn, "test/xyz.json") == ERR_NONE);
+        REQUIRE(import_file(conn, "test/xyz.json") == ERR_NONE);
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command(conn, loaded, "xyz") == SQLITE_OK);
+        CHECK(strlen(loaded->uuid) == UUID4_LEN - 1);
+        CHECK(loaded->aliases->size == 2);
+        REQUIRE(loaded->args->size == 2);
+        const bce_command_arg_t *format = (const bce_command_arg_t *) loaded->args->head->data;
+        CHECK(strcmp(format->long_name, "--format") == 0);
+        CHECK(strcmp(format->description, "output format") == 0);
+        CHECK(format->opts->size == 3);
+        loaded = bce_command_free(loaded);
+    }
+
+    SECTION("escapes, scalars and unknown keys") {
+        REQUIRE(import_text(conn, "{\"version\": [1, {\"x\": null}], \"command\": {\"name\": \"esc\", \"extra\": true,"
+                                  " \"aliases\": [{\"name\": \"esc\"}],"
+                                  " \"args\": [{\"arg_type\": \"TEXT\", \"long_name\": \"--n\\u00e9\\ud83d\\ude00\","
+                                  " \"short_name\": 5, \"description\": \"a \\\"b\\\"\\n\\\\c\\/\"}, 7],"
+                                  " \"sub_commands\": null}}") == ERR_NONE);
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command(conn, loaded, "esc") == SQLITE_OK);
+        REQUIRE(loaded->args->size == 1);
+        const bce_command_arg_t *arg = (const bce_command_arg_t *) loaded->args->head->data;
+        CHECK(std::string(arg->long_name) == "--n\xc3\xa9\xf0\x9f\x98\x80");
+        CHECK(std::string(arg->short_name) == "5");
+        CHECK(std::string(arg->description) == "a \"b\"\n\\c/");
+        loaded = bce_command_free(loaded);
+    }
+
+    SECTION("fields after the nested arrays") {
+        CHECK(import_text(conn, "{\"command\": {\"name\": \"late\", \"args\": [], \"uuid\": \"x\"}}")
+              == ERR_JSON_KEY_ORDER);
+        CHECK(import_text(conn, "{\"command\": {\"args\": [], \"name\": \"late\"}}") == ERR_JSON_KEY_ORDER);
+        CHECK(import_text(conn, "{\"command\": {\"name\": \"late\", \"args\": [{\"opts\": [], \"long_name\": \"--x\"}]}}")
+              == ERR_JSON_KEY_ORDER);
+    }
+
+    SECTION("invalid json") {
+        CHECK(import_text(conn, "") == ERR_INVALID_JSON);
+        CHECK(import_text(conn, "{\"command\": {\"name\": \"bad\", \"args\": [{\"arg_type\": \"TEXT\"}") == ERR_INVALID_JSON);
+        CHECK(import_text(conn, "{\"command\": {\"name\": \"bad\"}} x") == ERR_INVALID_JSON);
+        CHECK(import_text(conn, "{\"command\": {\"name\": \"bad\\q\"}}") == ERR_INVALID_JSON);
+        CHECK(import_text(conn, "{\"command\": {\"name\" \"bad\"}}") == ERR_INVALID_JSON);
+        CHECK(import_text(conn, "{\"command\": {\"name\": \"bad\", \"args\": [nope]}}") == ERR_INVALID_JSON);
+        CHECK(import_text(conn, std::string(JSON_IMPORT_MAX_DEPTH + 1, '[')) == ERR_INVALID_JSON);
+        CHECK(import_text(conn, "{\"command\": " + std::string(JSON_IMPORT_MAX_DEPTH + 1, '[')) == ERR_INVALID_JSON);
+        CHECK(import_text(conn, "{\"commands\": {}}") == ERR_INVALID_CMD);
+        CHECK(import_text(conn, "{\"command\": {\"aliases\": []}}") == ERR_JSON_KEY_ORDER);
+        CHECK(import_text(conn, "{\"command\": {}}") == ERR_INVALID_CMD_NAME);
+        CHECK(import_file(conn, "test/missing.json") == ERR_READ_FILE);
+    }
+
+    db_close(conn);
+    remove(database_file);
+    remove(SPEC_FILE);
+}
@@ -0,0 +1,152 @@
+#include "catch.hpp"
+#include <ctype.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "../input.h"
+#include "../line_scan.h"
+};
+
+enum states {
+    NADA, IN_WORD, IN_QUOTE, IN_DBL_QUOTE
+};
+
+static completion_token_t make_token(size_t start, size_t length, states state) {
+    uint8_t quote = (state == IN_QUOTE) ? TOKEN_SINGLE_QUOTED
+                                        : (state == IN_DBL_QUOTE) ? TOKEN_DOUBLE_QUOTED : TOKEN_UNQUOTED;
+    completion_token_t token = {(uint32_t) start, (uint32_t) length, quote};
+    return token;
+}
+
+/*
+ * The byte-at-a-time tokenizer that `line_scan_find()` replaced, kept as the reference.
+ */
+static std::vector<completion_token_t> reference_tokens(const char *line, size_t max_len) {
+    states state = NADA;
+    std::vector<completion_token_t> tokens;
+    size_t start = 0;
+    size_t i = 0;
+    for (; (i < max_len) && (line[i] != '\0'); i++) {
+        int c = (unsigned char) line[i];
+        bool got_word = false;
+        switch (state) {
+            case NADA:
+                if (isspace(c)) {
+                    break;
+                }
+                if (c == '\'') {
+                    state = IN_QUOTE;
+                    start = i + 1;
+                } else if (c == '"') {
+                    state = IN_DBL_QUOTE;
+                    start = i + 1;
+                } else {
+                    state = IN_WORD;
+                    start = i;
+                }
+                break;
+            case IN_WORD:
+                got_word = isspace(c) || (c == '=');
+                break;
+            case IN_QUOTE:
+                got_word = (c == '\'');
+                break;
+            case IN_DBL_QUOTE:
+                got_word = (c == '"');
+                break;
+        }
+        if (got_word) {
+            tokens.push_back(make_token(start, i - start, state));
+            state = NADA;
+        }
+    }
+    if (state != NADA) {
+        tokens.push_back(make_token(start, i - start, state));
+    }
+    return tokens;
+}
+
+static bool tokens_equal(const completion_input_t *input, const std::vector<completion_token_t> &expected) {
+    if (input->token_count != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        if ((input->tokens[i].offset != expected[i].offset) || (input->tokens[i].length != expected[i].length) ||
+            (input->tokens[i].quote != expected[i].quote)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("line scan") {
+    const line_scan_impl_t impls[] = {LINE_SCAN_SCALAR, LINE_SCAN_SSE2, LINE_SCAN_AVX2};
+
+    SECTION("find") {
+        // 40 characters, so the SIMD loops see a full block and a tail
+        const char *line = "abcdefghijklmnopqrstuvwxyz0123456789\v='\"";
+        size_t len = strlen(line);
+        for (line_scan_impl_t impl : impls) {
+            INFO(line_scan_impl_name(line_scan_select(impl)));
+            CHECK(line_scan_find(line, 0, len, LINE_SCAN_SPACE_OR_EQUALS) == 36);
+            CHECK(line_scan_find(line, 37, len, LINE_SCAN_SPACE_OR_EQUALS) == 37);
+            CHECK(line_scan_find(line, 0, len, LINE_SCAN_QUOTE) == 38);
+            CHECK(line_scan_find(line, 0, len, LINE_SCAN_DBL_QUOTE) == 39);
+            CHECK(line_scan_find(line, 5, len, LINE_SCAN_NOT_SPACE) == 5);
+            CHECK(line_scan_find(line, 36, len, LINE_SCAN_NOT_SPACE) == 37);
+            // not found, or an empty range
+            CHECK(line_scan_find(line, 0, 36, LINE_SCAN_QUOTE) == 36);
+            CHECK(line_scan_find(line, 10, 10, LINE_SCAN_NOT_SPACE) == 10);
+            CHECK(line_scan_find(line, 11, 10, LINE_SCAN_NOT_SPACE) == 10);
+        }
+    }
+
+    SECTION("same tokens as the byte-at-a-time tokenizer") {
+        // mostly word characters, with every kind of boundary (and bytes >= 0x80, which are not spaces)
+        const char alphabet[] = "abcdefgh-./:0123456789      \t\n\v\f\r===''\"\"\x80\xa0\xff";
+        std::mt19937 rng(12345);
+        std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+        std::uniform_int_distribution<size_t> length(0, 4096);
+
+        for (int round = 0; round < 500; round++) {
+            size_t len = (round < 100) ? (size_t) round : length(rng);
+            std::string line;
+            for (size_t i = 0; i < len; i++) {
+                line += alphabet[pick(rng)];
+            }
+            std::vector<completion_token_t> expected = reference_tokens(line.c_str(), line.size());
+
+            for (line_scan_impl_t impl : impls) {
+                INFO("round " << round << ", " << line_scan_impl_name(line_scan_select(impl)));
+                bce_error_t err;
+                completion_input_t *input = create_completion_input_from_line(line.c_str(), (int) len, &err);
+                REQUIRE(err == ERR_NONE);
+                CHECK(tokens_equal(input, expected));
+                free_completion_input(input);
+            }
+        }
+    }
+
+    SECTION("max_len") {
+        const char *line = "kubectl get pods --selector='app in (web, api)' -o wide";
+        for (line_scan_impl_t impl : impls) {
+            line_scan_select(impl);
+            for (size_t max_len = 0; max_len <= strlen(line); max_len++) {
+                std::vector<completion_token_t> expected = reference_tokens(line, max_len);
+                linked_list_t *words = bash_input_to_list(line, max_len);
+                REQUIRE(words->size == expected.size());
+                size_t i = 0;
+                for (linked_list_node_t *node = words->head; node != NULL; node = node->next, i++) {
+                    CHECK(bce_str_equal((bce_str_t) node->data,
+                                        str_pool_intern_n(NULL, line + expected[i].offset, expected[i].length)));
+                }
+                words = ll_destroy(words);
+            }
+        }
+    }
+
+    line_scan_select(LINE_SCAN_AUTO);
+}
@@ -0,0 +1,71 @@
+#include "catch.hpp"
+#include <string.h>
+#include <string>
+#include <set>
+
+extern "C" {
+#include "../arena.h"
+#include "../str_pool.h"
+#include "../name_index.h"
+};
+
+static std::set<std::string> items_in(const name_index_t *index, size_t first, size_t count) {
+    std::set<std::string> items;
+    for (size_t i = first; i < first + count; i++) {
+        items.insert((const char *) index->entries[i].item);
+    }
+    return items;
+}
+
+TEST_CASE("name index") {
+    arena_t *arena = arena_create(1024);
+    name_index_t *index = name_index_create(2);
+    REQUIRE(index != NULL);
+
+    // items under several names, and names that are prefixes of each other (added out of order)
+    const char *names[][2] = {{"replicasets", "replicasets"}, {"rs", "replicasets"}, {"get", "get"},
+                              {"gets", "gets"}, {"pods", "pods"}, {"po", "pods"}, {"pod", "pods"},
+                              {"get-all", "get-all"}, {"g", "get"}};
+    for (auto &name : names) {
+        CHECK(name_index_add(index, str_pool_intern(arena, name[0]), (void *) name[1]));
+    }
+    CHECK_FALSE(name_index_add(index, bce_str_empty(), (void *) "empty"));
+    CHECK(index->size == 9);
+    name_index_sort(index);
+
+    size_t first;
+    SECTION("prefix") {
+        size_t count = name_index_find_prefix(index, "ge", 2, &first);
+        CHECK(count == 3);
+        CHECK(items_in(index, first, count) == std::set<std::string>({"get", "gets", "get-all"}));
+
+        count = name_index_find_prefix(index, "po", 2, &first);
+        CHECK(count == 3);
+        CHECK(items_in(index, first, count) == std::set<std::string>({"pods"}));
+
+        CHECK(name_index_find_prefix(index, "x", 1, &first) == 0);
+        CHECK(name_index_find_prefix(index, "getss", 5, &first) == 0);
+        CHECK(name_index_find_prefix(index, "", 0, &first) == 9);
+        CHECK(first == 0);
+    }
+
+    SECTION("exact") {
+        size_t count = name_index_find(index, "get", 3, &first);
+        REQUIRE(count == 1);
+        CHECK(strcmp((const char *) index->entries[first].item, "get") == 0);
+        count = name_index_find(index, "rs", 2, &first);
+        REQUIRE(count == 1);
+        CHECK(strcmp((const char *) index->entries[first].item, "replicasets") == 0);
+        CHECK(name_index_find(index, "ge", 2, &first) == 0);
+        CHECK(name_index_find(index, "", 0, &first) == 0);
+    }
+
+    SECTION("sorted") {
+        for (size_t i = 1; i < index->size; i++) {
+            CHECK(strcmp(index->entries[i - 1].key, index->entries[i].key) < 0);
+        }
+    }
+
+    index = name_index_destroy(index);
+    arena = arena_destroy(arena);
+}
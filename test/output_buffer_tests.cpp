@@ -0,0 +1,119 @@
+#include "catch.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+extern "C" {
+#include "../output_buffer.h"
+#include "../linked_list.h"
+#include "../arena.h"
+};
+
+static size_t write_calls = 0;
+static size_t max_write_len = 0;
+
+/* write(2), counting the calls; no more than `max_write_len` bytes at a time, if set */
+static ssize_t counting_write(int fd, const void *data, size_t len) {
+    write_calls++;
+    if ((max_write_len > 0) && (len > max_write_len)) {
+        len = max_write_len;
+    }
+    return write(fd, data, len);
+}
+
+static std::string read_fd(FILE *file) {
+    std::string text;
+    char chunk[4096];
+    rewind(file);
+    for (size_t n = fread(chunk, 1, sizeof(chunk), file); n > 0; n = fread(chunk, 1, sizeof(chunk), file)) {
+        text.append(chunk, n);
+    }
+    return text;
+}
+
+TEST_CASE("output buffer") {
+    arena_t *arena = arena_create(0);
+    linked_list_t *recommendation_list = ll_create_in(arena, NULL);
+    ll_append_item(recommendation_list, "get\tget (g)\tDisplay resources");
+    ll_append_item(recommendation_list, "'a b'\ta b\t");
+    ll_append_item(recommendation_list, "--namespace");
+    output_buffer_t out;
+    output_buffer_t desc;
+    output_buffer_init(&out);
+    output_buffer_init(&desc);
+
+    SECTION("one recommendation per line") {
+        output_buffer_format_recommendations(&out, NULL, recommendation_list, OUTPUT_DISPLAY);
+        CHECK(std::string(out.data, out.len) == "get\tget (g)\tDisplay resources\n'a b'\ta b\t\n--namespace\n");
+    }
+
+    SECTION("only the words, and the whole lines to the descriptions") {
+        output_buffer_format_recommendations(&out, &desc, recommendation_list, OUTPUT_WORDS);
+        CHECK(std::string(out.data, out.len) == "get\n'a b'\n--namespace\n");
+        CHECK(std::string(desc.data, desc.len) == "get\tget (g)\tDisplay resources\n'a b'\ta b\t\n--namespace\n");
+    }
+
+    SECTION("the number left out, as a last description with no word") {
+        output_buffer_format_recommendations(&out, &desc, recommendation_list, OUTPUT_WORDS);
+        output_buffer_format_omitted(&desc, 0);
+        CHECK(std::string(desc.data, desc.len) == "get\tget (g)\tDisplay resources\n'a b'\ta b\t\n--namespace\n");
+        output_buffer_format_omitted(&desc, 6);
+        CHECK(std::string(desc.data, desc.len) == "get\tget (g)\tDisplay resources\n'a b'\ta b\t\n--namespace\n"
+                                                  "\t... and 6 more\t\n");
+        // never among the words to insert
+        CHECK(std::string(out.data, out.len) == "get\n'a b'\n--namespace\n");
+    }
+
+    SECTION("nothing to write") {
+        write_calls = 0;
+        CHECK(output_buffer_write_with(&out, STDOUT_FILENO, counting_write));
+        CHECK(write_calls == 0);
+    }
+
+    output_buffer_free(&out);
+    output_buffer_free(&desc);
+    arena = arena_destroy(arena);
+}
+
+TEST_CASE("output buffer written at once") {
+    arena_t *arena = arena_create(0);
+    linked_list_t *recommendation_list = ll_create_in(arena, NULL);
+    std::string expected;
+    for (int i = 0; i < 10000; i++) {
+        std::string recommendation = "--option-" + std::to_string(i);
+        char *data = (char *) arena_alloc(arena, recommendation.size() + 1);
+        memcpy(data, recommendation.c_str(), recommendation.size() + 1);
+        ll_append_item(recommendation_list, data);
+        expected += recommendation + "\n";
+    }
+    FILE *file = tmpfile();
+    REQUIRE(file);
+
+    output_buffer_t out;
+    output_buffer_init(&out);
+    output_buffer_format_recommendations(&out, NULL, recommendation_list, OUTPUT_DISPLAY);
+    // grown by doubling, not per recommendation
+    CHECK(out.capacity < 2 * out.len);
+
+    SECTION("one write") {
+        write_calls = 0;
+        max_write_len = 0;
+        REQUIRE(output_buffer_write_with(&out, fileno(file), counting_write));
+        CHECK(write_calls == 1);
+        CHECK(read_fd(file) == expected);
+    }
+
+    SECTION("the rest written again, when only part of it was") {
+        write_calls = 0;
+        max_write_len = out.len / 2 + 1;
+        REQUIRE(output_buffer_write_with(&out, fileno(file), counting_write));
+        max_write_len = 0;
+        CHECK(write_calls == 2);
+        CHECK(read_fd(file) == expected);
+    }
+
+    output_buffer_free(&out);
+    fclose(file);
+    arena = arena_destroy(arena);
+}
@@ -0,0 +1,218 @@
+#include "catch.hpp"
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include <stdio.h>
+#include <sqlite3.h>
+#include "../dbutil.h"
+#include "../data_model.h"
+#include "../snapshot.h"
+#include "../input.h"
+#include "../error.h"
+};
+#include "test_data.h"
+
+static bce_command_t *create_test_command(void) {
+    bce_command_t *cmd = bce_command_new();
+    cmd->uuid = str_pool_intern(cmd->arena, "00000000-0000-0000-0000-000000000001");
+    cmd->name = str_pool_intern(cmd->arena, "kubectl");
+
+    bce_command_alias_t *alias = bce_command_alias_new();
+    alias->uuid = str_pool_intern(alias->arena, "00000000-0000-0000-0003-000000000000");
+    alias->cmd_uuid = cmd->uuid;
+    alias->name = str_pool_intern(alias->arena, "bbb");
+    ll_append_item(cmd->aliases, alias);
+
+    bce_command_t *sub_cmd = bce_command_new();
+    sub_cmd->uuid = str_pool_intern(sub_cmd->arena, "00000000-0000-0000-0000-000000000002");
+    sub_cmd->name = str_pool_intern(sub_cmd->arena, "get");
+    sub_cmd->parent_cmd_uuid = cmd->uuid;
+    ll_append_item(cmd->sub_commands, sub_cmd);
+
+    bce_command_arg_t *arg = bce_command_arg_new();
+    arg->uuid = str_pool_intern(arg->arena, "00000000-0000-0000-1111-000000000001");
+    arg->cmd_uuid = sub_cmd->uuid;
+    arg->arg_type = str_pool_intern(arg->arena, "OPTION");
+    arg->description = str_pool_intern(arg->arena, "Output format");
+    arg->long_name = str_pool_intern(arg->arena, "--output");
+    arg->short_name = str_pool_intern(arg->arena, "-o");
+    ll_append_item(sub_cmd->args, arg);
+
+    const char *opt_names[] = {"json", "wide", "yaml"};
+    for (int i = 0; i < 3; i++) {
+        bce_command_opt_t *opt = bce_command_opt_new();
+        opt->uuid = format_str(opt->arena, "00000000-0000-0000-2222-00000000000%d", i);
+        opt->cmd_arg_uuid = arg->uuid;
+        opt->name = str_pool_intern(opt->arena, opt_names[i]);
+        ll_append_item(arg->opts, opt);
+    }
+    return cmd;
+}
+
+TEST_CASE("snapshot") {
+    int rc;
+    const char *database_file = "test/snapshot.db";
+    const char *snapshot_file = "test/snapshot.bin";
+    remove(database_file);
+    remove(snapshot_file);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+    REQUIRE(db_create_schema(conn) == ERR_NONE);
+    bce_command_t *cmd = create_test_command();
+    REQUIRE(db_store_command(conn, cmd) == ERR_NONE);
+    cmd = bce_command_free(cmd);
+
+    REQUIRE(snapshot_compile(conn, snapshot_file) == ERR_NONE);
+    db_close(conn);
+
+    SECTION("load command by alias") {
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, true, &err);
+        REQUIRE(err == ERR_NONE);
+        REQUIRE(snapshot != NULL);
+        CHECK(snapshot->header->root_count == 1);
+        CHECK(snapshot->header->command_count == 2);
+
+        bce_command_t *loaded = bce_command_new();
+        CHECK(snapshot_load_command(snapshot, loaded, "bbb", NULL) == ERR_NONE);
+        CHECK(strcmp(loaded->name, "kubectl") == 0);
+        REQUIRE(loaded->sub_commands->size == 1);
+        bce_command_t *sub_cmd = (bce_command_t *) loaded->sub_commands->head->data;
+        CHECK(strcmp(sub_cmd->name, "get") == 0);
+        CHECK(strcmp(sub_cmd->parent_cmd_uuid, loaded->uuid) == 0);
+        REQUIRE(sub_cmd->args->size == 1);
+        bce_command_arg_t *arg = (bce_command_arg_t *) sub_cmd->args->head->data;
+        CHECK(strcmp(arg->long_name, "--output") == 0);
+        CHECK(strcmp(arg->description, "Output format") == 0);
+        CHECK(arg->opts->size == 3);
+
+        loaded = bce_command_free(loaded);
+        snapshot = snapshot_close(snapshot);
+    }
+
+    SECTION("load command path") {
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, false, &err);
+        REQUIRE(snapshot != NULL);
+        linked_list_t *word_list = bash_input_to_list("kubectl get -o ", SIZE_MAX);
+        bce_command_t *loaded = bce_command_new();
+        CHECK(snapshot_load_command(snapshot, loaded, "kubectl", word_list) == ERR_NONE);
+        REQUIRE(loaded->sub_commands->size == 1);
+        bce_command_t *sub_cmd = (bce_command_t *) loaded->sub_commands->head->data;
+        CHECK(strcmp(sub_cmd->name, "get") == 0);
+        CHECK(sub_cmd->args->size == 1);
+
+        loaded = bce_command_free(loaded);
+        word_list = ll_destroy(word_list);
+        snapshot = snapshot_close(snapshot);
+    }
+
+    SECTION("unknown command") {
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, false, &err);
+        REQUIRE(snapshot != NULL);
+        bce_command_t *loaded = bce_command_new();
+        CHECK(snapshot_load_command(snapshot, loaded, "xyz", NULL) == ERR_NONE);
+        CHECK(strlen(loaded->uuid) == 0);
+        loaded = bce_command_free(loaded);
+        snapshot = snapshot_close(snapshot);
+    }
+
+    SECTION("corrupt snapshot") {
+        // flip a byte after the header
+        FILE *f = fopen(snapshot_file, "r+b");
+        REQUIRE(f != NULL);
+        fseek(f, sizeof(snapshot_header_t) + 1, SEEK_SET);
+        int c = fgetc(f);
+        fseek(f, sizeof(snapshot_header_t) + 1, SEEK_SET);
+        fputc(c ^ 0xff, f);
+        fclose(f);
+
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, true, &err);
+        CHECK(snapshot == NULL);
+        CHECK(err == ERR_SNAPSHOT);
+    }
+
+    SECTION("record out of range") {
+        // point the root command's sub-commands past the end of the commands section
+        FILE *f = fopen(snapshot_file, "r+b");
+        REQUIRE(f != NULL);
+        uint32_t first_sub_command = 1000;
+        fseek(f, sizeof(snapshot_header_t) + offsetof(snapshot_command_t, first_sub_command), SEEK_SET);
+        fwrite(&first_sub_command, sizeof(first_sub_command), 1, f);
+        fclose(f);
+
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, false, &err);
+        CHECK(snapshot == NULL);
+        CHECK(err == ERR_SNAPSHOT);
+    }
+
+    SECTION("string out of range") {
+        // a length prefix that runs past the end of the string table
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, false, &err);
+        REQUIRE(snapshot != NULL);
+        long name_offset = (long) (snapshot->header->strings_offset + snapshot->commands[0].name);
+        snapshot = snapshot_close(snapshot);
+
+        FILE *f = fopen(snapshot_file, "r+b");
+        REQUIRE(f != NULL);
+        uint32_t len = 0x7fffffff;
+        fseek(f, name_offset, SEEK_SET);
+        fwrite(&len, sizeof(len), 1, f);
+        fclose(f);
+
+        snapshot = snapshot_open(snapshot_file, false, &err);
+        CHECK(snapshot == NULL);
+        CHECK(err == ERR_SNAPSHOT);
+    }
+
+    SECTION("truncated snapshot") {
+        FILE *f = fopen(snapshot_file, "rb");
+        REQUIRE(f != NULL);
+        std::vector<char> data(sizeof(snapshot_header_t) + sizeof(snapshot_command_t));
+        REQUIRE(fread(data.data(), data.size(), 1, f) == 1);
+        fclose(f);
+        // keep the header consistent with the shorter file, so only the record checks can catch it
+        snapshot_header_t *header = (snapshot_header_t *) data.data();
+        header->file_size = (uint32_t) data.size();
+        header->command_count = 1;
+        header->root_count = 1;
+        header->alias_count = header->arg_count = header->opt_count = header->strings_size = 0;
+        header->aliases_offset = header->args_offset = header->opts_offset = header->strings_offset = header->file_size;
+        f = fopen(snapshot_file, "wb");
+        REQUIRE(f != NULL);
+        fwrite(data.data(), data.size(), 1, f);
+        fclose(f);
+
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, false, &err);
+        CHECK(snapshot == NULL);
+        CHECK(err == ERR_SNAPSHOT);
+    }
+
+    SECTION("stale snapshot") {
+        bce_error_t err;
+        snapshot_t *snapshot = snapshot_open(snapshot_file, false, &err);
+        REQUIRE(snapshot != NULL);
+        CHECK(snapshot_is_current(snapshot, database_file));
+
+        // a write within the same second as the compile must still be noticed
+        conn = db_open(database_file, &rc);
+        REQUIRE(rc == SQLITE_OK);
+        REQUIRE(sqlite3_exec(conn, "UPDATE command SET name = 'kubectl2' WHERE name = 'kubectl'", NULL, NULL, NULL)
+                == SQLITE_OK);
+        CHECK(!snapshot_is_current(snapshot, database_file));
+        db_close(conn);
+        CHECK(!snapshot_is_current(snapshot, database_file));
+        snapshot = snapshot_close(snapshot);
+    }
+
+    remove(database_file);
+    remove(snapshot_file);
+}
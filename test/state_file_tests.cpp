@@ -0,0 +1,98 @@
+#include "catch.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string>
+
+extern "C" {
+#include "../state_file.h"
+};
+
+static const char *STATE_FILE = "test/state.txt";
+
+TEST_CASE("state files") {
+    remove(STATE_FILE);
+
+    SECTION("missing or empty") {
+        size_t size = 1;
+        CHECK(state_file_read(STATE_FILE, &size) == NULL);
+        CHECK(size == 0);
+        FILE *file = fopen(STATE_FILE, "w");
+        REQUIRE(file);
+        fclose(file);
+        CHECK(state_file_read(STATE_FILE, &size) == NULL);
+    }
+
+    SECTION("replaced with a temporary file") {
+        state_file_writer_t writer;
+        REQUIRE(state_file_write_begin(&writer, STATE_FILE));
+        fprintf(writer.file, "1\tkubectl\tget\n");
+        CHECK(access(STATE_FILE, F_OK) != 0);
+        REQUIRE(state_file_write_end(&writer, true));
+        CHECK(access(writer.tmp_filename, F_OK) != 0);
+
+        // left as it was, if the new one wasn't all written
+        REQUIRE(state_file_write_begin(&writer, STATE_FILE));
+        fprintf(writer.file, "2\tkubectl\n");
+        CHECK(!state_file_write_end(&writer, false));
+        CHECK(access(writer.tmp_filename, F_OK) != 0);
+
+        size_t size = 0;
+        char *data = state_file_read(STATE_FILE, &size);
+        REQUIRE(data != NULL);
+        CHECK(std::string(data, size) == "1\tkubectl\tget\n");
+        CHECK(data[size] == '\0');
+
+        // the fields of a line
+        const char *pos = data;
+        const char *line_end = data + size - 1;
+        size_t len = 0;
+        const char *field = state_file_next_field(&pos, line_end, &len);
+        CHECK(std::string(field, len) == "1");
+        field = state_file_next_field(&pos, line_end, &len);
+        CHECK(std::string(field, len) == "kubectl");
+        field = state_file_next_field(&pos, line_end, &len);
+        CHECK(std::string(field, len) == "get");
+        CHECK(state_file_next_field(&pos, line_end, &len) == NULL);
+        free(data);
+    }
+
+    SECTION("next to the database, wherever the current directory is") {
+        FILE *file = fopen(STATE_FILE, "w");
+        REQUIRE(file);
+        fclose(file);
+        char cwd[PATH_MAX];
+        REQUIRE(getcwd(cwd, sizeof(cwd)));
+        const std::string expected = std::string(cwd) + "/test/completion.usage";
+        char path[PATH_MAX];
+        REQUIRE(state_file_path(path, sizeof(path), STATE_FILE, "completion.usage"));
+        CHECK(path == expected);
+        REQUIRE(state_file_path(path, sizeof(path), "./test/../test/state.txt", "completion.usage"));
+        CHECK(path == expected);
+        // resolved once, the path holds after a `cd`
+        REQUIRE(chdir("test") == 0);
+        CHECK(std::string(path) == expected);
+        REQUIRE(state_file_path(path, sizeof(path), "state.txt", "completion.usage"));
+        CHECK(path == expected);
+        REQUIRE(chdir(cwd) == 0);
+
+        // a database that doesn't exist (yet): its directory, as given
+        REQUIRE(state_file_path(path, sizeof(path), "missing.db", "completion.usage"));
+        CHECK(std::string(path) == "completion.usage");
+        REQUIRE(state_file_path(path, sizeof(path), "/no/such/dir/missing.db", "completion.usage"));
+        CHECK(std::string(path) == "/no/such/dir/completion.usage");
+        CHECK(!state_file_path(path, 8, "/no/such/dir/missing.db", "completion.usage"));
+    }
+
+    SECTION("command separators") {
+        for (const char *separator : {"|", "||", "&&", ";", "&"}) {
+            CHECK(is_command_separator(separator, strlen(separator)));
+        }
+        CHECK(!is_command_separator("--", 2));
+        CHECK(!is_command_separator("get", 3));
+    }
+
+    remove(STATE_FILE);
+}
@@ -0,0 +1,94 @@
+#include "catch.hpp"
+#include <string.h>
+
+extern "C" {
+#include <stdio.h>
+#include <sqlite3.h>
+#include "../dbutil.h"
+#include "../data_model.h"
+#include "../stmt_cache.h"
+#include "../error.h"
+};
+#include "test_data.h"
+
+static const char *TEST_SQL = " SELECT 1 ";
+
+TEST_CASE("statement cache") {
+    int rc;
+    const char *database_file = "test/stmt_cache.db";
+    remove(database_file);
+
+    sqlite3 *conn = db_open(database_file, &rc);
+    REQUIRE(rc == SQLITE_OK);
+
+    SECTION("reuse released statements") {
+        sqlite3_stmt *stmt = stmt_cache_acquire(conn, TEST_SQL, &rc);
+        REQUIRE(rc == SQLITE_OK);
+        REQUIRE(stmt != NULL);
+        CHECK(sqlite3_step(stmt) == SQLITE_ROW);
+        stmt_cache_release(stmt);
+
+        sqlite3_stmt *again = stmt_cache_acquire(conn, TEST_SQL, &rc);
+        CHECK(again == stmt);
+        // released statements are reset
+        CHECK(sqlite3_stmt_busy(again) == 0);
+        stmt_cache_release(again);
+
+        const stmt_cache_t *cache = stmt_cache_find(conn);
+        REQUIRE(cache != NULL);
+        CHECK(cache->prepare_count == 1);
+        CHECK(cache->reuse_count == 1);
+    }
+
+    SECTION("statements in use are not shared") {
+        sqlite3_stmt *outer = stmt_cache_acquire(conn, TEST_SQL, &rc);
+        sqlite3_stmt *inner = stmt_cache_acquire(conn, TEST_SQL, &rc);
+        CHECK(outer != inner);
+        stmt_cache_release(inner);
+        stmt_cache_release(outer);
+        CHECK(stmt_cache_find(conn)->prepare_count == 2);
+    }
+
+    SECTION("invalid SQL") {
+        static const char *bad_sql = " SELECT FROM nowhere ";
+        sqlite3_stmt *stmt = stmt_cache_acquire(conn, bad_sql, &rc);
+        CHECK(rc != SQLITE_OK);
+        CHECK(stmt == NULL);
+    }
+
+    SECTION("the cache goes away with its connection") {
+        // a cache without statements doesn't keep the connection open, even without db_close()
+        sqlite3 *other = NULL;
+        REQUIRE(sqlite3_open(":memory:", &other) == SQLITE_OK);
+        static const char *bad_sql = " SELECT FROM nowhere ";
+        CHECK(stmt_cache_acquire(other, bad_sql, &rc) == NULL);
+        REQUIRE(stmt_cache_find(other) != NULL);
+        CHECK(sqlite3_close(other) == SQLITE_OK);
+        CHECK(stmt_cache_find(other) == NULL);
+    }
+
+    SECTION("each query is prepared once per connection") {
+        REQUIRE(db_create_schema(conn) == ERR_NONE);
+        bce_command_t *cmd = create_synthetic_command("cached", 2, 3, 2, 2);
+        REQUIRE(db_store_command(conn, cmd) == ERR_NONE);
+        cmd = bce_command_free(cmd);
+
+        for (int i = 0; i < 3; i++) {
+            bce_command_t *loaded = bce_command_new();
+            REQUIRE(db_query_command_tree(conn, loaded, "cached") == ERR_NONE);
+            CHECK(loaded->sub_commands->size == 3);
+            loaded = bce_command_free(loaded);
+        }
+        unsigned long prepared = stmt_cache_find(conn)->prepare_count;
+
+        bce_command_t *loaded = bce_command_new();
+        REQUIRE(db_query_command_tree(conn, loaded, "cached") == ERR_NONE);
+        loaded = bce_command_free(loaded);
+        CHECK(stmt_cache_find(conn)->prepare_count == prepared);
+    }
+
+    // the cached statements must not keep the connection open
+    CHECK(db_close(conn) == SQLITE_OK);
+    CHECK(stmt_cache_find(conn) == NULL);
+    remove(database_file);
+}
@@ -0,0 +1,74 @@
+#include "catch.hpp"
+#include <string.h>
+
+extern "C" {
+#include "../arena.h"
+#include "../str_pool.h"
+};
+
+TEST_CASE("string pool") {
+    arena_t *arena = arena_create(1024);
+    REQUIRE(arena != NULL);
+
+    SECTION("interned strings are unique") {
+        char buffer[16];
+        strcpy(buffer, "kubectl");
+        bce_str_t a = str_pool_intern(arena, "kubectl");
+        bce_str_t b = str_pool_intern(arena, buffer);
+        bce_str_t c = str_pool_intern_n(arena, "kubectl get", 7);
+        CHECK(a == b);
+        CHECK(a == c);
+        CHECK(strcmp(a, "kubectl") == 0);
+        CHECK(bce_str_len(a) == 7);
+        CHECK(str_pool_size(arena) == 1);
+
+        bce_str_t d = str_pool_intern(arena, "kube");
+        CHECK(d != a);
+        CHECK(bce_str_has_prefix(a, d));
+        CHECK_FALSE(bce_str_has_prefix(d, a));
+        CHECK_FALSE(bce_str_equal(a, d));
+    }
+
+    SECTION("empty strings") {
+        CHECK(str_pool_intern(arena, "") == bce_str_empty());
+        CHECK(str_pool_intern(arena, NULL) == bce_str_empty());
+        CHECK(bce_str_len(bce_str_empty()) == 0);
+        CHECK(strcmp(bce_str_empty(), "") == 0);
+        CHECK(str_pool_size(arena) == 0);
+    }
+
+    SECTION("no length limit") {
+        char name[300];
+        memset(name, 'x', sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        bce_str_t str = str_pool_intern(arena, name);
+        CHECK(bce_str_len(str) == sizeof(name) - 1);
+        CHECK(strcmp(str, name) == 0);
+    }
+
+    SECTION("the pool grows") {
+        bce_str_t first = str_pool_intern(arena, "name-0");
+        char name[32];
+        for (int i = 1; i < 1000; i++) {
+            sprintf(name, "name-%d", i);
+            str_pool_intern(arena, name);
+        }
+        CHECK(str_pool_size(arena) == 1000);
+        CHECK(str_pool_intern(arena, "name-0") == first);
+    }
+
+    SECTION("pools are per arena") {
+        bce_str_t a = str_pool_intern(arena, "get");
+        bce_str_t b = str_pool_intern(NULL, "get");
+        CHECK(a != b);
+        CHECK(bce_str_equal(a, b));
+        CHECK(str_pool_intern(NULL, "get") == b);
+
+        // the pool is released with the arena
+        arena_reset(arena);
+        CHECK(str_pool_size(arena) == 0);
+        CHECK(strcmp(str_pool_intern(arena, "get"), "get") == 0);
+    }
+
+    arena = arena_destroy(arena);
+}
@@ -0,0 +1,187 @@
+#include "test_data.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int next_uuid = 0;
+
+bce_str_t format_str(arena_t *arena, const char *format, ...) {
+    char buffer[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return str_pool_intern(arena, buffer);
+}
+
+static bce_str_t make_uuid(arena_t *arena) {
+    return format_str(arena, "00000000-0000-0000-0000-%012x", ++next_uuid);
+}
+
+static void populate_command(bce_command_t *cmd, int depth, int fanout, int arg_count, int opt_count) {
+    for (int i = 0; i < arg_count; i++) {
+        bce_command_arg_t *arg = bce_command_arg_new();
+        arg->uuid = make_uuid(arg->arena);
+        arg->cmd_uuid = cmd->uuid;
+        arg->arg_type = str_pool_intern(arg->arena, opt_count > 0 ? "OPTION" : "NONE");
+        arg->description = format_str(arg->arena, "Description of %s arg %d", cmd->name, i);
+        arg->long_name = format_str(arg->arena, "--%s-%d", cmd->name, i);
+        for (int j = 0; j < opt_count; j++) {
+            bce_command_opt_t *opt = bce_command_opt_new();
+            opt->uuid = make_uuid(opt->arena);
+            opt->cmd_arg_uuid = arg->uuid;
+            opt->name = format_str(opt->arena, "%s-%d-%d", cmd->name, i, j);
+            ll_append_item(arg->opts, opt);
+        }
+        ll_append_item(cmd->args, arg);
+    }
+
+    if (depth <= 0) {
+        return;
+    }
+    for (int i = 0; i < fanout; i++) {
+        bce_command_t *sub_cmd = bce_command_new();
+        sub_cmd->uuid = make_uuid(sub_cmd->arena);
+        sub_cmd->parent_cmd_uuid = cmd->uuid;
+        sub_cmd->name = format_str(sub_cmd->arena, "%s.%d", cmd->name, i);
+        populate_command(sub_cmd, depth - 1, fanout, arg_count, opt_count);
+        ll_append_item(cmd->sub_commands, sub_cmd);
+    }
+}
+
+bce_command_t *create_synthetic_command(const char *name, int depth, int fanout, int arg_count, int opt_count) {
+    bce_command_t *cmd = bce_command_new();
+    cmd->uuid = make_uuid(cmd->arena);
+    cmd->name = str_pool_intern(cmd->arena, name);
+
+    bce_command_alias_t *alias = bce_command_alias_new();
+    alias->uuid = make_uuid(alias->arena);
+    alias->cmd_uuid = cmd->uuid;
+    alias->name = format_str(alias->arena, "%s-alias", name);
+    ll_append_item(cmd->aliases, alias);
+
+    populate_command(cmd, depth, fanout, arg_count, opt_count);
+    return cmd;
+}
+
+static bool args_equal(const bce_command_arg_t *a, const bce_command_arg_t *b) {
+    if (strcmp(a->uuid, b->uuid) != 0 || strcmp(a->cmd_uuid, b->cmd_uuid) != 0 ||
+        strcmp(a->arg_type, b->arg_type) != 0 || strcmp(a->description, b->description) != 0 ||
+        strcmp(a->long_name, b->long_name) != 0 || strcmp(a->short_name, b->short_name) != 0 ||
+        a->opts->size != b->opts->size) {
+        return false;
+    }
+    for (linked_list_node_t *x = a->opts->head, *y = b->opts->head; x && y; x = x->next, y = y->next) {
+        const bce_command_opt_t *opt_a = (const bce_command_opt_t *) x->data;
+        const bce_command_opt_t *opt_b = (const bce_command_opt_t *) y->data;
+        if (strcmp(opt_a->uuid, opt_b->uuid) != 0 || strcmp(opt_a->name, opt_b->name) != 0 ||
+            strcmp(opt_a->cmd_arg_uuid, opt_b->cmd_arg_uuid) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool commands_equal(const bce_command_t *a, const bce_command_t *b) {
+    if (strcmp(a->uuid, b->uuid) != 0 || strcmp(a->name, b->name) != 0 ||
+        strcmp(a->parent_cmd_uuid, b->parent_cmd_uuid) != 0 ||
+        a->aliases->size != b->aliases->size || a->args->size != b->args->size ||
+        a->sub_commands->size != b->sub_commands->size) {
+        return false;
+    }
+    for (linked_list_node_t *x = a->aliases->head, *y = b->aliases->head; x && y; x = x->next, y = y->next) {
+        const bce_command_alias_t *alias_a = (const bce_command_alias_t *) x->data;
+        const bce_command_alias_t *alias_b = (const bce_command_alias_t *) y->data;
+        if (strcmp(alias_a->uuid, alias_b->uuid) != 0 || strcmp(alias_a->name, alias_b->name) != 0) {
+            return false;
+        }
+    }
+    for (linked_list_node_t *x = a->args->head, *y = b->args->head; x && y; x = x->next, y = y->next) {
+        if (!args_equal((const bce_command_arg_t *) x->data, (const bce_command_arg_t *) y->data)) {
+            return false;
+        }
+    }
+    for (linked_list_node_t *x = a->sub_commands->head, *y = b->sub_commands->head; x && y; x = x->next, y = y->next) {
+        if (!commands_equal((const bce_command_t *) x->data, (const bce_command_t *) y->data)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool exec_sql_file(sqlite3 *conn, const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *sql = (char *) calloc(size + 1, sizeof(char));
+    bool result = (fread(sql, 1, size, fp) == (size_t) size);
+    fclose(fp);
+    if (result) {
+        result = (sqlite3_exec(conn, sql, NULL, NULL, NULL) == SQLITE_OK);
+    }
+    free(sql);
+    return result;
+}
+
+static void write_json_str(FILE *file, const char *key, const char *value, const char *separator) {
+    fprintf(file, "\"%s\": \"", key);
+    for (const char *c = value; *c; c++) {
+        if ((*c == '"') || (*c == '\\')) {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fprintf(file, "\"%s", separator);
+}
+
+static void write_json_command(FILE *file, const bce_command_t *cmd) {
+    fputc('{', file);
+    write_json_str(file, "uuid", cmd->uuid, ", ");
+    write_json_str(file, "name", cmd->name, ", ");
+    fputs("\"aliases\": [", file);
+    for (linked_list_node_t *node = cmd->aliases->head; node != NULL; node = node->next) {
+        const bce_command_alias_t *alias = (const bce_command_alias_t *) node->data;
+        fputc('{', file);
+        write_json_str(file, "uuid", alias->uuid, ", ");
+        write_json_str(file, "name", alias->name, "}");
+        fputs(node->next ? ", " : "", file);
+    }
+    fputs("], \"args\": [", file);
+    for (linked_list_node_t *node = cmd->args->head; node != NULL; node = node->next) {
+        const bce_command_arg_t *arg = (const bce_command_arg_t *) node->data;
+        fputc('{', file);
+        write_json_str(file, "uuid", arg->uuid, ", ");
+        write_json_str(file, "arg_type", arg->arg_type, ", ");
+        write_json_str(file, "description", arg->description, ", ");
+        write_json_str(file, "long_name", arg->long_name, ", ");
+        write_json_str(file, "short_name", arg->short_name, ", ");
+        fputs("\"opts\": [", file);
+        for (linked_list_node_t *opt_node = arg->opts->head; opt_node != NULL; opt_node = opt_node->next) {
+            const bce_command_opt_t *opt = (const bce_command_opt_t *) opt_node->data;
+            fputc('{', file);
+            write_json_str(file, "uuid", opt->uuid, ", ");
+            write_json_str(file, "name", opt->name, "}");
+            fputs(opt_node->next ? ", " : "", file);
+        }
+        fputs("]}", file);
+        fputs(node->next ? ", " : "", file);
+    }
+    fputs("], \"sub_commands\": [", file);
+    for (linked_list_node_t *node = cmd->sub_commands->head; node != NULL; node = node->next) {
+        write_json_command(file, (const bce_command_t *) node->data);
+        fputs(node->next ? ", " : "", file);
+    }
+    fputs("]}", file);
+}
+
+void write_json_spec(FILE *file, const bce_command_t *cmd) {
+    fputs("{\"command\": ", file);
+    write_json_command(file, cmd);
+    fputs("}\n", file);
+}
@@ -0,0 +1,28 @@
+#ifndef BCE_TEST_DATA_H
+#define BCE_TEST_DATA_H
+
+extern "C" {
+#include <stdio.h>
+#include "../data_model.h"
+};
+
+/*
+ * Build a synthetic command hierarchy (names are unique across the whole tree).
+ * Every command has `fanout` sub-commands (down to `depth` levels), `arg_count` args and `opt_count` opts per arg.
+ * The root command gets an alias, since it can only be looked up through one.
+ */
+bce_command_t *create_synthetic_command(const char *name, int depth, int fanout, int arg_count, int opt_count);
+
+/* printf-style, interned in the arena's string pool */
+bce_str_t format_str(arena_t *arena, const char *format, ...);
+
+/* Compare two command hierarchies, field by field and in list order */
+bool commands_equal(const bce_command_t *a, const bce_command_t *b);
+
+/* Write the command hierarchy as a JSON spec (the `bce --export --format json` layout) */
+void write_json_spec(FILE *file, const bce_command_t *cmd);
+
+/* Run a SQL script (e.g. test/kubectl_data.sql) against the database */
+bool exec_sql_file(sqlite3 *conn, const char *filename);
+
+#endif // BCE_TEST_DATA_H
@@ -0,0 +1,216 @@
+#include "catch.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test_data.h"
+
+extern "C" {
+#include "../usage.h"
+#include "../completion.h"
+#include "../input.h"
+#include "../data_model.h"
+#include "../linked_list.h"
+#include "../str_pool.h"
+};
+
+static const char *LOG_FILE = "test/usage.log";
+static const char *TABLE_FILE = "test/usage.table";
+static const time_t NOW = 1700000000;
+
+static std::string read_text(const char *filename) {
+    std::ifstream file(filename);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+static std::vector<std::string> collect_with_usage(const bce_command_t *tree, const char *line,
+                                                   const usage_table_t *usage, size_t max_results = 0) {
+    bce_error_t err;
+    completion_input_t *input = create_completion_input_from_line(line, (int) strlen(line), &err);
+    input->max_results = max_results;
+    arena_t *arena = arena_create(0);
+    linked_list_t *word_list = completion_input_to_list_in(arena, input);
+    bce_command_t *cmd = bce_command_clone_path_prefix_in(arena, tree, word_list, bce_str_empty());
+    linked_list_t *recommendation_list = ll_create_unique_in(arena, NULL);
+    completion_collect(cmd, input, usage, recommendation_list, NULL, NULL);
+
+    std::vector<std::string> recommendations;
+    for (linked_list_node_t *node = recommendation_list->head; node != NULL; node = node->next) {
+        recommendations.push_back((const char *) node->data);
+    }
+    arena = arena_destroy(arena);
+    free_completion_input(input);
+    return recommendations;
+}
+
+TEST_CASE("usage recording") {
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+
+    SECTION("the words that could be sub-commands or args") {
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl get pods --namespace=kube -o wide ./x.yaml | grep x",
+                             NOW) == ERR_NONE);
+        CHECK(read_text(LOG_FILE) == "1700000000\tkubectl\tget\tpods\t--namespace\t-o\n");
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl 'get' && ls", NOW + 1) == ERR_NONE);
+        CHECK(read_text(LOG_FILE) == "1700000000\tkubectl\tget\tpods\t--namespace\t-o\n"
+                                     "1700000001\tkubectl\tget\n");
+    }
+
+    SECTION("not the values of args") {
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl --token s3cr3t get secrets --password=hunter2 -A "
+                                                   "-n kube-system -- cat key", NOW) == ERR_NONE);
+        std::string log = read_text(LOG_FILE);
+        CHECK(log == "1700000000\tkubectl\t--token\tget\tsecrets\t--password\t-A\t-n\n");
+        for (const char *value : {"s3cr3t", "hunter2", "kube-system", "cat", "key"}) {
+            INFO(value);
+            CHECK(log.find(value) == std::string::npos);
+        }
+    }
+
+    SECTION("nothing to record") {
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "ls", NOW) == ERR_NONE);
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "", NOW) == ERR_NONE);
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "/bin/ls /tmp", NOW) == ERR_NONE);
+        CHECK(usage_load(TABLE_FILE, LOG_FILE, "ls", NOW) == NULL);
+    }
+
+    SECTION("compacted once the log is full") {
+        size_t count = 0;
+        while (read_text(TABLE_FILE).empty()) {
+            REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl get pods", NOW) == ERR_NONE);
+            count++;
+            REQUIRE(count < USAGE_LOG_MAX_SIZE);
+        }
+        CHECK(read_text(LOG_FILE).empty());
+        CHECK(read_text(TABLE_FILE) == "" + std::to_string(count) + ".000\t1700000000\tkubectl\tget\n"
+                                       + std::to_string(count) + ".000\t1700000000\tkubectl\tpods\n");
+    }
+
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+}
+
+TEST_CASE("usage compaction") {
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+
+    SECTION("the log is merged into the table") {
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl get pods", NOW) == ERR_NONE);
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "git commit", NOW + 5) == ERR_NONE);
+        REQUIRE(usage_compact(LOG_FILE, TABLE_FILE, NOW + 10) == ERR_NONE);
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl get", NOW + 20) == ERR_NONE);
+        REQUIRE(usage_compact(LOG_FILE, TABLE_FILE, NOW + 30) == ERR_NONE);
+        CHECK(read_text(LOG_FILE).empty());
+        CHECK(read_text(TABLE_FILE) == "2.000\t1700000020\tkubectl\tget\n"
+                                       "1.000\t1700000000\tkubectl\tpods\n"
+                                       "1.000\t1700000005\tgit\tcommit\n");
+        // nothing to merge
+        CHECK(usage_compact(LOG_FILE, TABLE_FILE, NOW + 40) == ERR_NONE);
+        CHECK(read_text(TABLE_FILE).size() > 0);
+    }
+
+    SECTION("aged when the counts add up to more than USAGE_MAX_TOTAL") {
+        FILE *table = fopen(TABLE_FILE, "w");
+        REQUIRE(table);
+        fprintf(table, "%.3f\t%lld\tkubectl\tget\n", USAGE_MAX_TOTAL, (long long) NOW);
+        fprintf(table, "1.000\t%lld\tkubectl\tpods\n", (long long) NOW);
+        fclose(table);
+        REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl get", NOW) == ERR_NONE);
+        REQUIRE(usage_compact(LOG_FILE, TABLE_FILE, NOW) == ERR_NONE);
+
+        // the rare ones are dropped
+        usage_table_t *usage = usage_load(TABLE_FILE, LOG_FILE, "kubectl", NOW);
+        REQUIRE(usage != NULL);
+        REQUIRE(usage->entry_count == 1);
+        CHECK(usage->entries[0].count < USAGE_MAX_TOTAL);
+        CHECK(usage->entries[0].count > USAGE_MAX_TOTAL * 0.8);
+        usage_free(usage);
+    }
+
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+}
+
+TEST_CASE("usage scores") {
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+    FILE *table = fopen(TABLE_FILE, "w");
+    REQUIRE(table);
+    fprintf(table, "3.000\t%lld\tkubectl\tget\n", (long long) NOW - 60);
+    fprintf(table, "3.000\t%lld\tkubectl\tapply\n", (long long) NOW - (30 * 24 * 60 * 60));
+    fprintf(table, "9.000\t%lld\tgit\tcommit\n", (long long) NOW);
+    fclose(table);
+    REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "kubectl describe", NOW) == ERR_NONE);
+
+    usage_table_t *usage = usage_load(TABLE_FILE, LOG_FILE, "kubectl", NOW);
+    REQUIRE(usage != NULL);
+    arena_t *arena = arena_create(0);
+    auto score = [usage, arena](const char *word) {
+        return usage_score(usage, str_pool_intern(arena, word));
+    };
+    // only the command's words
+    CHECK(usage->entry_count == 3);
+    CHECK(score("commit") == 0);
+    CHECK(score("delete") == 0);
+    // more recent, or more frequent
+    CHECK(score("get") > score("describe"));
+    CHECK(score("describe") > score("apply"));
+    CHECK(score("apply") > 0);
+    CHECK(usage_score(NULL, str_pool_intern(arena, "get")) == 0);
+    arena = arena_destroy(arena);
+    usage_free(usage);
+
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+}
+
+TEST_CASE("ranked by usage") {
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+    bce_command_t *tree = create_synthetic_command("use", 1, 4, 3, 3);
+    REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "use use.2 --use-1 use-1-2", NOW) == ERR_NONE);
+    REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "use use.2", NOW) == ERR_NONE);
+    REQUIRE(usage_record(LOG_FILE, TABLE_FILE, "use use.3", NOW) == ERR_NONE);
+    usage_table_t *usage = usage_load(TABLE_FILE, LOG_FILE, "use", NOW);
+    REQUIRE(usage != NULL);
+
+    SECTION("the most used first, then in their order") {
+        std::vector<std::string> all = collect_with_usage(tree, "use ", NULL);
+        REQUIRE(all.size() > 3);
+        REQUIRE(all[0] == "use.0");
+        std::vector<std::string> ranked = collect_with_usage(tree, "use ", usage);
+        REQUIRE(ranked.size() == all.size());
+        CHECK(ranked[0] == "use.2");
+        CHECK(ranked[1] == "use.3");
+        CHECK(ranked[2] == "--use-1");
+        all.erase(std::find(all.begin(), all.end(), "use.2"));
+        all.erase(std::find(all.begin(), all.end(), "use.3"));
+        all.erase(std::find(all.begin(), all.end(), "--use-1"));
+        CHECK(std::vector<std::string>(ranked.begin() + 3, ranked.end()) == all);
+    }
+
+    SECTION("not the options of an arg: they are values, which aren't recorded") {
+        CHECK(collect_with_usage(tree, "use --use-1 use-1-", usage)
+              == std::vector<std::string>({"use-1-0", "use-1-1", "use-1-2"}));
+    }
+
+    SECTION("the best kept when limited") {
+        // ties in alphabetical order, as without usage
+        CHECK(collect_with_usage(tree, "use ", usage, 2) == std::vector<std::string>({"use.2", "--use-1"}));
+    }
+
+    SECTION("not the options of the arg at the cursor") {
+        CHECK(collect_with_usage(tree, "use --use-1 ", usage)
+              == std::vector<std::string>({"use-1-0", "use-1-1", "use-1-2"}));
+    }
+
+    usage_free(usage);
+    bce_command_free(tree);
+    remove(LOG_FILE);
+    remove(TABLE_FILE);
+}
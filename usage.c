@@ -0,0 +1,354 @@
+#include "usage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "input.h"
+#include "state_file.h"
+
+#define USAGE_HOUR              (60 * 60)
+#define USAGE_DAY               (24 * USAGE_HOUR)
+#define USAGE_WEEK              (7 * USAGE_DAY)
+#define USAGE_AGING             0.9
+#define USAGE_LOG_LINE_SIZE     4096    /* no more than PIPE_BUF: appended in one piece */
+
+static bool is_recorded_word(const char *word, size_t len);
+
+static bool init_counts(usage_table_t *usage, size_t expected_size);
+
+static usage_entry_t *add_count(usage_table_t *usage, const char *key, size_t key_len, double count, int64_t last);
+
+static bool read_table(usage_table_t *usage, const char *data, size_t size, const char *command_name);
+
+static bool read_log(usage_table_t *usage, const char *data, size_t size, const char *command_name);
+
+static bool write_table(const usage_table_t *usage, const char *table_filename);
+
+bce_error_t usage_record(const char *log_filename, const char *table_filename, const char *line, time_t now) {
+    bce_error_t err = ERR_NONE;
+    completion_input_t *input = create_completion_input_from_line(line, (int) strlen(line), &err);
+    if (err != ERR_NONE) {
+        return err;
+    }
+
+    char buf[USAGE_LOG_LINE_SIZE];
+    size_t len = 0;
+    size_t word_len = 0;
+    const char *command = get_token(input, 0, &word_len);
+    if (!command || !is_recorded_word(command, word_len)) {
+        goto done;
+    }
+    len = (size_t) snprintf(buf, sizeof(buf), "%lld\t%.*s", (long long) now, (int) word_len, command);
+
+    size_t word_count = 0;
+    bool after_arg = false;
+    for (int i = 1; ((size_t) i < input->token_count) && (word_count < USAGE_MAX_WORDS); i++) {
+        const char *word = get_token(input, i, &word_len);
+        if (is_command_separator(word, word_len) || ((word_len == 2) && (strncmp(word, "--", 2) == 0))) {
+            break;
+        }
+        // the value of an arg (`--name value`, or `--name=value`: split the same way) may be anything, e.g. a secret
+        bool is_arg = (word_len > 0) && (word[0] == '-');
+        bool is_value = after_arg && !is_arg;
+        after_arg = is_arg;
+        if (is_value || !is_recorded_word(word, word_len)) {
+            continue;
+        }
+        buf[len++] = '\t';
+        memcpy(buf + len, word, word_len);
+        len += word_len;
+        word_count++;
+    }
+    if (word_count == 0) {
+        goto done;
+    }
+    buf[len++] = '\n';
+
+    int fd = open(log_filename, O_WRONLY | O_APPEND | O_CREAT, 0600);
+    if (fd < 0) {
+        err = ERR_READ_FILE;
+        goto done;
+    }
+    struct stat st;
+    bool written = (write(fd, buf, len) == (ssize_t) len);
+    bool full = written && (fstat(fd, &st) == 0) && (st.st_size >= USAGE_LOG_MAX_SIZE);
+    close(fd);
+    if (!written) {
+        err = ERR_READ_FILE;
+    } else if (full) {
+        err = usage_compact(log_filename, table_filename, now);
+    }
+
+    done:
+    free_completion_input(input);
+    return err;
+}
+
+bce_error_t usage_compact(const char *log_filename, const char *table_filename, time_t now) {
+    char compacting[PATH_MAX];
+    if (snprintf(compacting, sizeof(compacting), "%s.%ld", log_filename, (long) getpid()) >= (int) sizeof(compacting)) {
+        return ERR_READ_FILE;
+    }
+    if (rename(log_filename, compacting) != 0) {
+        // already being compacted
+        return (errno == ENOENT) ? ERR_NONE : ERR_READ_FILE;
+    }
+
+    bce_error_t err = ERR_NONE;
+    usage_table_t usage = {0};
+    size_t table_size = 0;
+    size_t log_size = 0;
+    usage.now = now;
+    usage.table_data = state_file_read(table_filename, &table_size);
+    usage.log_data = state_file_read(compacting, &log_size);
+    usage.arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    if (!usage.arena || !init_counts(&usage, 256)
+        || !read_table(&usage, usage.table_data, table_size, NULL)
+        || !read_log(&usage, usage.log_data, log_size, NULL)) {
+        err = ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    double total = 0;
+    for (size_t i = 0; i < usage.entry_count; i++) {
+        total += usage.entries[i].count;
+    }
+    if (total > USAGE_MAX_TOTAL) {
+        double factor = (USAGE_AGING * USAGE_MAX_TOTAL) / total;
+        for (size_t i = 0; i < usage.entry_count; i++) {
+            usage.entries[i].count *= factor;
+        }
+    }
+    if (!write_table(&usage, table_filename)) {
+        err = ERR_CREATE_TEMP_FILE;
+        goto done;
+    }
+    unlink(compacting);
+
+    done:
+    if (err != ERR_NONE) {
+        // keep what was recorded for the next compaction
+        rename(compacting, log_filename);
+    }
+    free(usage.table_data);
+    free(usage.log_data);
+    usage.index = hm_destroy(usage.index);
+    free(usage.entries);
+    usage.arena = arena_destroy(usage.arena);
+    return err;
+}
+
+usage_table_t *usage_load(const char *table_filename, const char *log_filename, const char *command_name,
+                          time_t now) {
+    size_t table_size = 0;
+    size_t log_size = 0;
+    char *table_data = state_file_read(table_filename, &table_size);
+    char *log_data = state_file_read(log_filename, &log_size);
+    if (!table_data && !log_data) {
+        return NULL;
+    }
+
+    usage_table_t *usage = calloc(1, sizeof(usage_table_t));
+    if (!usage) {
+        free(table_data);
+        free(log_data);
+        return NULL;
+    }
+    usage->table_data = table_data;
+    usage->log_data = log_data;
+    usage->now = now;
+    if (!init_counts(usage, 64)
+        || !read_table(usage, table_data, table_size, command_name)
+        || !read_log(usage, log_data, log_size, command_name)
+        || (usage->entry_count == 0)) {
+        return usage_free(usage);
+    }
+    return usage;
+}
+
+usage_table_t *usage_free(usage_table_t *usage) {
+    if (!usage) {
+        return NULL;
+    }
+    free(usage->table_data);
+    free(usage->log_data);
+    hm_destroy(usage->index);
+    free(usage->entries);
+    arena_destroy(usage->arena);
+    free(usage);
+    return NULL;
+}
+
+int usage_score(const usage_table_t *usage, bce_str_t word) {
+    if (!usage || (bce_str_len(word) == 0)) {
+        return 0;
+    }
+    size_t position = (size_t) (uintptr_t) hm_get_n(usage->index, word, bce_str_len(word));
+    if (position == 0) {
+        return 0;
+    }
+    const usage_entry_t *entry = &usage->entries[position - 1];
+    int64_t age = (int64_t) usage->now - entry->last;
+    double weight = (age < USAGE_HOUR) ? 4.0 : (age < USAGE_DAY) ? 2.0 : (age < USAGE_WEEK) ? 0.5 : 0.25;
+    // a single use a week ago still ranks above none
+    double score = entry->count * weight * 16.0;
+    if (score < 1.0) {
+        return 1;
+    }
+    return (score > USAGE_MAX_SCORE) ? USAGE_MAX_SCORE : (int) score;
+}
+
+/* Not paths (files), and nothing that would break a line of the log */
+static bool is_recorded_word(const char *word, size_t len) {
+    if ((len == 0) || (len > USAGE_MAX_WORD_LEN)) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) word[i];
+        if ((c < 0x20) || (c == 0x7f) || (c == '/')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool init_counts(usage_table_t *usage, size_t expected_size) {
+    usage->index = hm_create(expected_size);
+    return usage->index != NULL;
+}
+
+/* Add to the count of `key` (a new entry if it has none), keeping the latest use */
+static usage_entry_t *add_count(usage_table_t *usage, const char *key, size_t key_len, double count, int64_t last) {
+    size_t position = (size_t) (uintptr_t) hm_get_n(usage->index, key, key_len);
+    if (position > 0) {
+        usage_entry_t *entry = &usage->entries[position - 1];
+        entry->count += count;
+        if (last > entry->last) {
+            entry->last = last;
+        }
+        return entry;
+    }
+    if (usage->entry_count == usage->entry_capacity) {
+        size_t capacity = (usage->entry_capacity > 0) ? usage->entry_capacity * 2 : 64;
+        usage_entry_t *entries = realloc(usage->entries, capacity * sizeof(usage_entry_t));
+        if (!entries) {
+            return NULL;
+        }
+        usage->entries = entries;
+        usage->entry_capacity = capacity;
+    }
+    if (!hm_put_n(usage->index, key, key_len, (void *) (uintptr_t) (usage->entry_count + 1))) {
+        return NULL;
+    }
+    usage_entry_t *entry = &usage->entries[usage->entry_count++];
+    entry->key = key;
+    entry->key_len = key_len;
+    entry->count = count;
+    entry->last = last;
+    return entry;
+}
+
+/*
+ * `<count>\t<last use>\t<command>\t<word>` lines: with a `command_name`, only its words are kept (keyed by the word);
+ * otherwise, all of them are (keyed by `<command>\t<word>`).
+ */
+static bool read_table(usage_table_t *usage, const char *data, size_t size, const char *command_name) {
+    const char *end = data + size;
+    size_t command_len = command_name ? strlen(command_name) : 0;
+    for (const char *line = data; line && (line < end);) {
+        const char *line_end = memchr(line, '\n', (size_t) (end - line));
+        if (!line_end) {
+            break;
+        }
+        const char *pos = line;
+        size_t len = 0;
+        state_file_next_field(&pos, line_end, &len);
+        state_file_next_field(&pos, line_end, &len);
+        const char *command = state_file_next_field(&pos, line_end, &len);
+        const char *word = command ? state_file_next_field(&pos, line_end, &len) : NULL;
+        // the numbers are only parsed for the lines that are kept
+        if (word && (len > 0)
+            && (!command_name || ((word - command - 1 == (ptrdiff_t) command_len)
+                                  && (strncmp(command, command_name, command_len) == 0)))) {
+            char *count_end = NULL;
+            double count = strtod(line, &count_end);
+            long long last = strtoll(count_end, NULL, 10);
+            if ((count > 0) && !add_count(usage, command_name ? word : command,
+                                          command_name ? len : (size_t) (word + len - command), count, last)) {
+                return false;
+            }
+        }
+        line = line_end + 1;
+    }
+    return true;
+}
+
+/*
+ * `<time>\t<command>\t<word>\t<word>...` lines (a partial last line is being appended: skipped), one use of each word,
+ * keyed as in `read_table()`.
+ */
+static bool read_log(usage_table_t *usage, const char *data, size_t size, const char *command_name) {
+    const char *end = data + size;
+    size_t command_len = command_name ? strlen(command_name) : 0;
+    for (const char *line = data; line && (line < end);) {
+        const char *line_end = memchr(line, '\n', (size_t) (end - line));
+        if (!line_end) {
+            break;
+        }
+        const char *pos = line;
+        size_t len = 0;
+        size_t this_command_len = 0;
+        state_file_next_field(&pos, line_end, &len);
+        const char *command = state_file_next_field(&pos, line_end, &this_command_len);
+        if (command && command_name
+            && ((this_command_len != command_len) || (strncmp(command, command_name, command_len) != 0))) {
+            command = NULL;
+        }
+        long long time = command ? strtoll(line, NULL, 10) : 0;
+        for (const char *word = command ? state_file_next_field(&pos, line_end, &len) : NULL; word != NULL;
+             word = state_file_next_field(&pos, line_end, &len)) {
+            if (len == 0) {
+                continue;
+            }
+            const char *key = word;
+            size_t key_len = len;
+            if (!command_name) {
+                char *command_word = arena_alloc(usage->arena, this_command_len + 1 + len);
+                if (!command_word) {
+                    return false;
+                }
+                memcpy(command_word, command, this_command_len);
+                command_word[this_command_len] = '\t';
+                memcpy(command_word + this_command_len + 1, word, len);
+                key = command_word;
+                key_len = this_command_len + 1 + len;
+            }
+            if (!add_count(usage, key, key_len, 1.0, time)) {
+                return false;
+            }
+        }
+        line = line_end + 1;
+    }
+    return true;
+}
+
+/* Write the counts that are still worth keeping (to a temporary file, renamed over the table) */
+static bool write_table(const usage_table_t *usage, const char *table_filename) {
+    state_file_writer_t writer;
+    if (!state_file_write_begin(&writer, table_filename)) {
+        return false;
+    }
+    for (size_t i = 0; i < usage->entry_count; i++) {
+        const usage_entry_t *entry = &usage->entries[i];
+        if (entry->count < 1.0) {
+            continue;
+        }
+        fprintf(writer.file, "%.3f\t%lld\t%.*s\n", entry->count, (long long) entry->last, (int) entry->key_len,
+                entry->key);
+    }
+    return state_file_write_end(&writer, true);
+}
@@ -0,0 +1,75 @@
+#ifndef BCE_USAGE_H
+#define BCE_USAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "hash_map.h"
+#include "arena.h"
+#include "str_pool.h"
+#include "error.h"
+
+/*
+ * Recorded usage of the sub-commands and args, to rank the recommendations by frecency.
+ *
+ * log:   `<time>\t<command>\t<word>\t<word>...` per command line (see `usage_record()`), appended with one write
+ * table: `<count>\t<last use>\t<command>\t<word>` per word, compacted from the log once it is USAGE_LOG_MAX_SIZE
+ *
+ * Neither opens the database. Completion reads both (see `usage_load()`), keeping only the lines of the command
+ * being completed: their sizes are bounded, so the cost is too.
+ */
+
+#define USAGE_LOG_MAX_SIZE      (64 * 1024)
+#define USAGE_MAX_TOTAL         5000.0  /* when the counts add up to more, they are aged to 90% of it */
+#define USAGE_MAX_WORDS         32      /* words recorded per command line */
+#define USAGE_MAX_WORD_LEN      64
+#define USAGE_MAX_SCORE         0xffff
+
+typedef struct usage_entry_t {
+    const char *key;            /* the word (`<command>\t<word>` when compacting); not NUL-terminated */
+    size_t key_len;
+    double count;
+    int64_t last;               /* time of the last use */
+} usage_entry_t;
+
+/* The usage of the words of one command */
+typedef struct usage_table_t {
+    char *table_data;           /* the files, as read; the keys point into them */
+    char *log_data;
+    arena_t *arena;             /* the keys that don't */
+    hash_map_t *index;          /* key -> position in `entries`, plus 1 */
+    usage_entry_t *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    time_t now;
+} usage_table_t;
+
+/*
+ * Append the words of a command line (e.g. from `history 1`) to the log: the ones that could be sub-commands or
+ * args (`--name` of `--name=value`), up to the first `|`, `;`, `&&` or `--`. The word after an arg is taken for its
+ * value, and never recorded (neither is the `value` of `--name=value`). Compacts the log into the table when it has
+ * grown past USAGE_LOG_MAX_SIZE.
+ */
+bce_error_t usage_record(const char *log_filename, const char *table_filename, const char *line, time_t now);
+
+/*
+ * Merge the log into the table, aging the counts (and dropping the ones below 1) when they add up to more than
+ * USAGE_MAX_TOTAL. The log is renamed first: lines appended meanwhile go to a new one, and a concurrent compaction
+ * finds no log to merge.
+ */
+bce_error_t usage_compact(const char *log_filename, const char *table_filename, time_t now);
+
+/* Read the usage of `command_name`'s words from the table and the log. NULL if there is none */
+usage_table_t *usage_load(const char *table_filename, const char *log_filename, const char *command_name,
+                          time_t now);
+
+usage_table_t *usage_free(usage_table_t *usage);
+
+/*
+ * The frecency of `word`, from 0 (never used) to USAGE_MAX_SCORE: its count, weighted by how recent its last use
+ * is (x4 within the hour, x2 within the day, x0.5 within the week, x0.25 after that).
+ */
+int usage_score(const usage_table_t *usage, bce_str_t word);
+
+#endif // BCE_USAGE_H